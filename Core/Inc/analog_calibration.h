@@ -0,0 +1,74 @@
+/**
+ * @file analog_calibration.h
+ * @brief Per-output calibration of the analog simulation outputs
+ *
+ * The RC filter and buffer of each board output deviate from the ideal
+ * linear mapping. A calibration table maps the nominal output value (the
+ * ideal compare value for a setpoint, in fine steps) to the compare value
+ * that produces it on this board, by piecewise-linear interpolation
+ * between measured points. Segment slopes are precomputed in fixed point
+ * when a table is loaded, so applying it takes no division.
+ */
+
+#ifndef ANALOG_CALIBRATION_H
+#define ANALOG_CALIBRATION_H
+
+#include "main.h"
+
+#define ANALOG_CALIBRATION_MAX_POINTS  16
+
+// Upload header, followed by count AnalogCalibrationPoint entries (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  output;              // ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+    uint8_t  count;               // Number of points (2-ANALOG_CALIBRATION_MAX_POINTS), 0 in GET for uncalibrated
+} AnalogCalibrationHeader;
+
+// One measured point
+typedef struct __attribute__((packed)) {
+    uint16_t nominal;             // Nominal value in fine steps, strictly increasing
+    uint16_t compare;             // Compare value producing it in fine steps (0-ANALOG_FINE_MAX)
+} AnalogCalibrationPoint;
+
+/**
+ * @brief Clear all tables, every output maps 1:1
+ */
+void Analog_Calibration_Init(void);
+
+/**
+ * @brief Load the table of one output from an upload payload
+ * @param light_index Light index (0-2)
+ * @param payload AnalogCalibrationHeader followed by the points
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Calibration_Load(uint8_t light_index, const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Remove the table of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Calibration_Clear(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Map a nominal value to the calibrated compare value
+ * Values outside the table extend its first and last segment.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param nominal Nominal value in fine steps
+ * @return Compare value in fine steps (0-ANALOG_FINE_MAX)
+ */
+uint16_t Analog_Calibration_Apply(uint8_t light_index, uint8_t output, uint16_t nominal);
+
+/**
+ * @brief Copy the table of one output in upload format
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param buffer Destination for the header and up to ANALOG_CALIBRATION_MAX_POINTS points
+ * @param size Size of the buffer in bytes
+ * @return Number of bytes written, 0 if invalid
+ */
+uint16_t Analog_Calibration_Get(uint8_t light_index, uint8_t output, uint8_t* buffer, uint16_t size);
+
+#endif /* ANALOG_CALIBRATION_H */
@@ -0,0 +1,47 @@
+/**
+ * @file analog_dac.h
+ * @brief On-chip DAC backend for the analog simulation outputs
+ *
+ * The PWM outputs settle through their RC filter in milliseconds. The
+ * two 12-bit DAC channels settle in microseconds instead: channel 1
+ * (PA4) can take over the current output and channel 2 (PA5) the
+ * temperature output of one light each. The channels run without a
+ * trigger, a write to the holding register reaches the pin on the next
+ * APB1 clock, so DMA-paced waveforms can target them like a CCR.
+ */
+
+#ifndef ANALOG_DAC_H
+#define ANALOG_DAC_H
+
+#include "main.h"
+
+#define ANALOG_DAC_MAX       4095    // 12-bit full scale
+#define ANALOG_DAC_CHANNELS  2       // Channel index equals ANALOG_OUTPUT_* it serves
+
+/**
+ * @brief Configure the DAC pins and switch both channels off
+ */
+void Analog_DAC_Init(void);
+
+/**
+ * @brief Switch one DAC channel on (buffered output) or off (high impedance)
+ * @param channel DAC channel index (0-1)
+ * @param enable 1 to enable, 0 to disable
+ */
+void Analog_DAC_Enable(uint8_t channel, uint8_t enable);
+
+/**
+ * @brief Write one DAC channel
+ * @param channel DAC channel index (0-1)
+ * @param code Output code (0-ANALOG_DAC_MAX)
+ */
+void Analog_DAC_Write(uint8_t channel, uint16_t code);
+
+/**
+ * @brief Get the 12-bit right-aligned holding register of a DAC channel
+ * @param channel DAC channel index (0-1)
+ * @return Pointer to the DHR12Rx register, or NULL if invalid
+ */
+volatile uint32_t* Analog_DAC_GetRegister(uint8_t channel);
+
+#endif /* ANALOG_DAC_H */
@@ -0,0 +1,135 @@
+/**
+ * @file analog_fault.h
+ * @brief Sensor and wiring fault profiles on the analog simulation outputs
+ *
+ * A fault profile occupies one of ANALOG_FAULT_SLOTS slots and targets
+ * one current or temperature output from start_ms for duration_ms on a
+ * common fault timeline. The timeline starts at 0 on request and is
+ * stepped by the shared 1 kHz TIM4 tick, so the faults of a sequence
+ * keep their relative timing to the millisecond. Where active profiles
+ * overlap on an output, the one in the higher slot applies.
+ *
+ * Fault types:
+ *   Open     - line disconnected (PWM pin to input, DAC channel off)
+ *   Short    - line held at 0
+ *   Stuck    - line held at the setpoint it had when the fault started
+ *   Drift    - offset growing by rate fine steps per second
+ *   Dropout  - line open for width_ms at the start of every period_ms
+ */
+
+#ifndef ANALOG_FAULT_H
+#define ANALOG_FAULT_H
+
+#include "main.h"
+#include "tim.h"
+
+#define ANALOG_FAULT_SLOTS    8
+#define ANALOG_FAULT_TICK_HZ  1000    // Timeline resolution (TIM4)
+
+// Fault types
+#define ANALOG_FAULT_NONE     0       // Empty slot
+#define ANALOG_FAULT_OPEN     1
+#define ANALOG_FAULT_SHORT    2
+#define ANALOG_FAULT_STUCK    3
+#define ANALOG_FAULT_DRIFT    4
+#define ANALOG_FAULT_DROPOUT  5
+
+// Slot states
+#define ANALOG_FAULT_SLOT_EMPTY    0
+#define ANALOG_FAULT_SLOT_PENDING  1  // Waiting for start_ms
+#define ANALOG_FAULT_SLOT_ACTIVE   2
+#define ANALOG_FAULT_SLOT_DONE     3  // duration_ms elapsed
+
+// Fault profile, uploaded as-is (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  slot;                // Slot index (0-ANALOG_FAULT_SLOTS-1)
+    uint8_t  light;               // Light index (0-2)
+    uint8_t  output;              // ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+    uint8_t  type;                // ANALOG_FAULT_*, ANALOG_FAULT_NONE empties the slot
+    uint32_t start_ms;            // Start on the fault timeline
+    uint32_t duration_ms;         // Length, 0 until the timeline is stopped
+    int16_t  rate;                // Drift: fine steps per second
+    uint16_t period_ms;           // Dropout: repetition period
+    uint16_t width_ms;            // Dropout: open time per period
+    uint16_t reserved;
+} AnalogFaultProfile;
+
+// State of one slot as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  state;               // ANALOG_FAULT_SLOT_*
+    uint8_t  type;
+    uint8_t  light;
+    uint8_t  output;
+    uint32_t start_ms;
+    uint32_t duration_ms;
+} AnalogFaultSlotStatus;
+
+// Fault engine state as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  running;             // 1 while the timeline runs
+    uint8_t  active_mask;         // Bit (light * 2 + output) per output with an active fault
+    uint16_t reserved;
+    uint32_t elapsed_ms;          // Timeline position
+    AnalogFaultSlotStatus slot[ANALOG_FAULT_SLOTS];
+} AnalogFaultStatus;
+
+/**
+ * @brief Empty all slots and stop the timeline
+ */
+void Analog_Fault_Init(void);
+
+/**
+ * @brief Load one fault profile into its slot
+ * @param payload AnalogFaultProfile structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise (also while the timeline runs)
+ */
+uint8_t Analog_Fault_Load(const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Start the fault timeline at 0
+ * @return 1 if successful, 0 if running or a target output plays a waveform
+ */
+uint8_t Analog_Fault_Start(void);
+
+/**
+ * @brief Stop the fault timeline, all lines return to healthy
+ */
+void Analog_Fault_Stop(void);
+
+/**
+ * @brief Check whether a slot of the running timeline targets an output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if targeted, 0 otherwise
+ */
+uint8_t Analog_Fault_IsTargeted(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Get the fault type applied to an output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return ANALOG_FAULT_* of the applied profile, ANALOG_FAULT_NONE if healthy
+ */
+uint8_t Analog_Fault_GetActive(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Get the fault engine state
+ * @param status Destination for the state
+ */
+void Analog_Fault_GetStatus(AnalogFaultStatus* status);
+
+/**
+ * @brief Advance the fault timeline by one millisecond
+ * This function is called from the TIM4 update interrupt
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void Analog_Fault_Tick(TIM_HandleTypeDef *htim);
+
+/**
+ * @brief Send the completion event of a finished timeline
+ * Call this in the main loop, events share the UART with responses.
+ */
+void Analog_Fault_ProcessEvents(void);
+
+#endif /* ANALOG_FAULT_H */
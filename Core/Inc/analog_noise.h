@@ -0,0 +1,81 @@
+/**
+ * @file analog_noise.h
+ * @brief Pseudo-random noise on the analog simulation outputs
+ *
+ * Each output can carry noise on top of its setpoint, with a new sample
+ * every PWM period (the TIM2 update interrupt shared with dithering).
+ * Samples come from a per-output xorshift32 generator, so a seed
+ * reproduces the same sequence. Uniform noise spans +-amplitude, the
+ * Gaussian approximation (sum of four uniform bytes) has a standard
+ * deviation of amplitude. An optional first-order low-pass limits the
+ * bandwidth; its input is scaled so the filtered noise keeps the
+ * variance of the unfiltered source.
+ */
+
+#ifndef ANALOG_NOISE_H
+#define ANALOG_NOISE_H
+
+#include "main.h"
+
+#define ANALOG_NOISE_MAX_AMPLITUDE  8192    // Fine steps, 128 compare steps
+
+// Distributions
+#define ANALOG_NOISE_OFF            0
+#define ANALOG_NOISE_UNIFORM        1
+#define ANALOG_NOISE_GAUSSIAN       2
+
+// Noise configuration of one output, uploaded as-is (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  output;              // ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+    uint8_t  distribution;        // ANALOG_NOISE_*
+    uint16_t amplitude;           // Peak (uniform) or standard deviation (Gaussian) in fine steps
+    uint16_t bandwidth_hz;        // Low-pass corner, 0 for white noise at the PWM rate
+    uint16_t reserved;
+    uint32_t seed;                // Generator seed, 0 selects a fixed default
+} AnalogNoiseConfig;
+
+/**
+ * @brief Switch noise off on all outputs
+ * @param sample_rate_hz Sample rate (PWM carrier frequency)
+ */
+void Analog_Noise_Init(uint32_t sample_rate_hz);
+
+/**
+ * @brief Configure the noise of one output and restart its generator from the seed
+ * @param light_index Light index (0-2)
+ * @param config Noise configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Noise_Configure(uint8_t light_index, const AnalogNoiseConfig* config);
+
+/**
+ * @brief Get the noise configuration of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param config Destination for the configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Noise_Get(uint8_t light_index, uint8_t output, AnalogNoiseConfig* config);
+
+/**
+ * @brief Get the outputs with noise
+ * @return Bit (light_index * 2 + output) per noisy output
+ */
+uint8_t Analog_Noise_GetMask(void);
+
+/**
+ * @brief Recompute the filters for a new sample rate
+ * @param sample_rate_hz Sample rate (PWM carrier frequency)
+ */
+void Analog_Noise_SetSampleRate(uint32_t sample_rate_hz);
+
+/**
+ * @brief Draw the next noise sample of one output
+ * This function is called from the TIM2 update interrupt
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return Noise in fine steps
+ */
+int32_t Analog_Noise_Sample(uint8_t light_index, uint8_t output);
+
+#endif /* ANALOG_NOISE_H */
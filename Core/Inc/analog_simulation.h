@@ -12,6 +12,58 @@
 #include "main.h"
 #include "tim.h"
 
+// Output full scale (compare value ANALOG_PWM_MAX)
+#define ANALOG_PWM_MAX                 1023    // 10-bit PWM resolution
+#define ANALOG_CURRENT_FULL_SCALE      330     // 33.0 A in 0.1 A units
+#define ANALOG_TEMPERATURE_FULL_SCALE  330     // Temperature input units at full scale
+
+// Fine output resolution: compare values carry ANALOG_FINE_BITS fraction bits,
+// realised on dithered outputs by sigma-delta modulation across PWM periods
+#define ANALOG_FINE_BITS               6
+#define ANALOG_FINE_MAX                (ANALOG_PWM_MAX << ANALOG_FINE_BITS)
+
+// Carrier: 84 MHz / (prescaler + 1) / 1024, 5.1 kHz at the default prescaler 15
+#define ANALOG_CARRIER_PRESCALER_MAX   15
+
+// Analog outputs of one light
+#define ANALOG_OUTPUT_CURRENT      0
+#define ANALOG_OUTPUT_TEMPERATURE  1
+
+// Staging sets, see Analog_StageSimulation
+#define ANALOG_STAGE_HOST          0       // SET Y / SET S Y from the main loop
+#define ANALOG_STAGE_SEQUENCER     1       // Scenario steps in the TIM5 interrupt
+#define ANALOG_STAGE_SETS          2
+
+#define ANALOG_RAMP_TICK_HZ        1000    // Ramp interpolation rate (TIM4)
+
+// Fault drives, see Analog_SetFaultDrive
+#define ANALOG_FAULT_DRIVE_NONE    0       // Healthy line
+#define ANALOG_FAULT_DRIVE_FORCE   1       // Line held at a level
+#define ANALOG_FAULT_DRIVE_OFFSET  2       // Level added to the setpoint
+#define ANALOG_FAULT_DRIVE_OPEN    3       // Line disconnected (high impedance)
+
+// Ramp flags
+#define ANALOG_RAMP_FLAG_SLOPE     0x01    // time holds a slope instead of a duration
+#define ANALOG_RAMP_FLAG_NOTIFY    0x02    // Send an event when the target is reached
+
+// Ramp command, uploaded as-is (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  output;              // ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+    uint8_t  flags;               // ANALOG_RAMP_FLAG_* bits
+    uint16_t target;              // Target in the units of the C/T SET commands
+    uint32_t time;                // Duration in ms, or slope in 0.001 units per second
+} AnalogRampCommand;
+
+// Ramp state of one output as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  active;              // 1 while ramping
+    uint8_t  flags;               // Flags of the last ramp
+    uint16_t target;              // Target of the last ramp in C/T units
+    uint16_t pwm_value;           // Present compare value (0-1023)
+    uint16_t reserved;
+    uint32_t remaining_ms;        // Time left until the target is reached
+} AnalogRampStatus;
+
 /**
  * @brief Initialize analog simulation components
  */
@@ -35,6 +87,14 @@ void Analog_Simulation_Stop(void);
  */
 uint8_t Analog_SetCurrentSimulation(uint8_t light_index, uint16_t current_value);
 
+/**
+ * @brief Set the current output compare value of a specific light directly
+ * @param light_index Light index (0-2)
+ * @param pwm_value PWM compare value (0-1023)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetCurrentPWM(uint8_t light_index, uint16_t pwm_value);
+
 /**
  * @brief Get current PWM value for a specific light
  * @param light_index Light index (0-2)
@@ -50,6 +110,14 @@ uint16_t Analog_GetCurrentPWM(uint8_t light_index);
  */
 uint8_t Analog_SetTemperatureSimulation(uint8_t light_index, uint16_t temperature_value);
 
+/**
+ * @brief Set the temperature output compare value of a specific light directly
+ * @param light_index Light index (0-2)
+ * @param pwm_value PWM compare value (0-1023)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetTemperaturePWM(uint8_t light_index, uint16_t pwm_value);
+
 /**
  * @brief Get temperature PWM value for a specific light
  * @param light_index Light index (0-2)
@@ -57,4 +125,252 @@ uint8_t Analog_SetTemperatureSimulation(uint8_t light_index, uint16_t temperatur
  */
 uint16_t Analog_GetTemperaturePWM(uint8_t light_index);
 
+/**
+ * @brief Get the register that sets an analog output
+ * Used by DMA-driven sources that write output codes without the CPU.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return Pointer to the CCR register, or the DAC holding register on a DAC output, NULL if invalid
+ */
+volatile uint32_t* Analog_GetCompareRegister(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Set one output directly in the code of its backend
+ * Like the raw PWM setters this bypasses sensor model and calibration.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param code Compare value (0-1023), or DAC code (0-4095) on a DAC output
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetOutputCode(uint8_t light_index, uint8_t output, uint16_t code);
+
+/**
+ * @brief Get the largest code of an output's backend
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return ANALOG_DAC_MAX on a DAC output, ANALOG_PWM_MAX otherwise
+ */
+uint16_t Analog_GetOutputMax(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Route the outputs of a light to the DAC or back to the PWM
+ * DAC channel 1 serves one current output, channel 2 one temperature
+ * output. The Analog_Set* functions, ramps, the plant model and staged
+ * updates keep working unchanged; a DAC output settles in microseconds
+ * at 12-bit resolution, and a staged DAC value applies at the commit
+ * rather than on the next PWM period. The present value moves along.
+ * @param light_index Light index (0-2)
+ * @param mask Bit (1 << ANALOG_OUTPUT_*) per output to drive from the DAC
+ * @return 1 if successful, 0 if a channel is taken by another light or the output dithers
+ */
+uint8_t Analog_SetBackend(uint8_t light_index, uint8_t mask);
+
+/**
+ * @brief Get the outputs of a light that are driven from the DAC
+ * @param light_index Light index (0-2)
+ * @return Bit (1 << ANALOG_OUTPUT_*) per DAC output
+ */
+uint8_t Analog_GetBackend(uint8_t light_index);
+
+/**
+ * @brief Check whether an output is driven from the DAC
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if on the DAC, 0 otherwise
+ */
+uint8_t Analog_IsOnDAC(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Set one output in fine compare steps
+ * Like the C/T setpoints the value passes the output's calibration table,
+ * only the raw PWM setters bypass it.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param fine_value Nominal value in fine steps (0-ANALOG_FINE_MAX)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetOutputFine(uint8_t light_index, uint8_t output, uint16_t fine_value);
+
+/**
+ * @brief Rewrite one output from its last nominal value
+ * Applies a changed sensor model or calibration table to a static output.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_RefreshOutput(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Enable sigma-delta dithering on the outputs of a light
+ * Dithered outputs reach ANALOG_FINE_BITS more resolution after the RC
+ * filter, at the cost of ripple down to carrier / 64.
+ * @param light_index Light index (0-2)
+ * @param mask Bit (1 << ANALOG_OUTPUT_*) per output to dither
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetDither(uint8_t light_index, uint8_t mask);
+
+/**
+ * @brief Get the dithered outputs of a light
+ * @param light_index Light index (0-2)
+ * @return Bit (1 << ANALOG_OUTPUT_*) per dithered output
+ */
+uint8_t Analog_GetDither(uint8_t light_index);
+
+/**
+ * @brief Check whether an output is dithered
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if dithered, 0 otherwise
+ */
+uint8_t Analog_IsDithered(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Set the PWM carrier prescaler of all analog outputs
+ * A higher carrier lowers ripple, the RC filter must still pass the signal band.
+ * @param prescaler Timer prescaler (0-ANALOG_CARRIER_PRESCALER_MAX)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetCarrier(uint8_t prescaler);
+
+/**
+ * @brief Get the PWM carrier prescaler of the analog outputs
+ * @return Timer prescaler
+ */
+uint8_t Analog_GetCarrier(void);
+
+/**
+ * @brief Set the fault drive of one output
+ * The drive applies on the line below all setpoint sources (C/T, ramps,
+ * plant model, sequencer, noise); readback keeps reporting the setpoint.
+ * Waveform samples bypass it.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param mode ANALOG_FAULT_DRIVE_*
+ * @param value Forced level or offset in fine steps
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetFaultDrive(uint8_t light_index, uint8_t output, uint8_t mode, int32_t value);
+
+/**
+ * @brief Get the present setpoint of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return Value in fine steps, without noise and fault drive
+ */
+uint16_t Analog_GetOutputFine(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Configure the noise of one output from an upload payload
+ * A new sample is added to the setpoint every PWM period.
+ * @param light_index Light index (0-2)
+ * @param payload AnalogNoiseConfig structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetNoise(uint8_t light_index, const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Switch the noise of one output off
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_ClearNoise(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Check whether an output has noise
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if noisy, 0 otherwise
+ */
+uint8_t Analog_HasNoise(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Per-period update of all dithered and noisy outputs
+ * This function is called from the TIM2 update interrupt
+ */
+void Analog_UpdateIRQHandler(void);
+
+/**
+ * @brief Stage a new value for one output without applying it
+ * Staged values of all outputs are applied together by Analog_CommitStaged.
+ * Each set must only be used from one priority level.
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param value Value in the units of Analog_SetCurrentSimulation / Analog_SetTemperatureSimulation
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_StageSimulation(uint8_t set, uint8_t light_index, uint8_t output, uint16_t value);
+
+/**
+ * @brief Get the outputs with a staged value
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ * @return Bit (light_index * 2 + output) per staged output
+ */
+uint8_t Analog_GetStagedMask(uint8_t set);
+
+/**
+ * @brief Apply all staged values of one set in the same PWM period
+ * TIM3 is slaved to TIM2, so both timers load their compare preload
+ * registers on one common update event. Commits must not preempt each
+ * other: the host commit runs with the TIM5 interrupt disabled.
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ */
+void Analog_CommitStaged(uint8_t set);
+
+/**
+ * @brief Drop all staged values of one set
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ */
+void Analog_DiscardStaged(uint8_t set);
+
+/**
+ * @brief Start a linear ramp of one output from its present value
+ * A running ramp on the same output is retargeted from where it is.
+ * @param light_index Light index (0-2)
+ * @param payload AnalogRampCommand structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_StartRamp(uint8_t light_index, const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Stop the ramp of one output, holding its present value
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_StopRamp(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Check whether an output is ramping
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if ramping, 0 otherwise
+ */
+uint8_t Analog_IsRamping(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Get the ramp state of both outputs of a light
+ * @param light_index Light index (0-2)
+ * @param status Destination array indexed by ANALOG_OUTPUT_*
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_GetRampStatus(uint8_t light_index, AnalogRampStatus* status);
+
+/**
+ * @brief Advance all active ramps by one step
+ * This function is called from the TIM4 update interrupt
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void Analog_RampTick(TIM_HandleTypeDef *htim);
+
+/**
+ * @brief Send the completion events of finished ramps
+ * Call this in the main loop, events share the UART with responses.
+ */
+void Analog_ProcessRampEvents(void);
+
 #endif /* ANALOG_SIMULATION_H */
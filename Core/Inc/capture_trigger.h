@@ -0,0 +1,97 @@
+/**
+ * @file capture_trigger.h
+ * @brief Triggered PWM capture with pre/post-trigger window
+ *
+ * Logic-analyzer style capture for one light: completed PWM cycles are
+ * recorded continuously into a circular pre-trigger buffer. When the
+ * armed condition fires, a fixed number of post-trigger cycles is
+ * recorded and the window is frozen until it is read out or re-armed.
+ */
+
+#ifndef CAPTURE_TRIGGER_H
+#define CAPTURE_TRIGGER_H
+
+#include "main.h"
+
+#define TRIGGER_BUFFER_DEPTH  512   // Cycles in pre-trigger + trigger + post-trigger window
+
+// Trigger conditions
+typedef enum {
+    TRIGGER_NONE          = 0,   // Disarmed
+    TRIGGER_DUTY_ABOVE    = 1,   // Duty rises to or above threshold (0.01 % units)
+    TRIGGER_DUTY_BELOW    = 2,   // Duty falls to or below threshold (0.01 % units)
+    TRIGGER_PERIOD_CHANGE = 3,   // Period differs from the previous one by more than threshold (0.01 % units)
+    TRIGGER_SET_COMMAND   = 4    // A SET command changes an analog output
+} TriggerCondition;
+
+// Trigger engine state
+typedef enum {
+    TRIGGER_STATE_IDLE      = 0,
+    TRIGGER_STATE_ARMED     = 1,
+    TRIGGER_STATE_TRIGGERED = 2,   // Recording post-trigger cycles
+    TRIGGER_STATE_DONE      = 3    // Window frozen
+} TriggerState;
+
+// Trigger configuration, uploaded with CMD_UPLOAD (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  condition;       // TriggerCondition
+    uint8_t  reserved;
+    uint16_t threshold;       // Condition parameter in 0.01 % units
+    uint16_t pre_count;       // Cycles kept before the trigger
+    uint16_t post_count;      // Cycles recorded after the trigger
+} TriggerConfig;
+
+// Readout header, followed by 'count' PWMHistoryEntry records from oldest to newest
+typedef struct __attribute__((packed)) {
+    uint8_t  state;           // TriggerState
+    uint8_t  light;           // Light index the trigger is armed on
+    uint16_t count;           // Entries that follow
+    uint16_t trigger_index;   // Position of the triggering cycle among the entries
+} TriggerReadoutHeader;
+
+/**
+ * @brief Reset the trigger engine to idle
+ */
+void Capture_Trigger_Init(void);
+
+/**
+ * @brief Configure and arm the trigger on one light
+ * @param light_index Light index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param config Trigger configuration
+ * @param length Size of the configuration in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Capture_Trigger_Configure(uint8_t light_index, const void* config, uint16_t length);
+
+/**
+ * @brief Re-arm the last configuration or disarm the trigger
+ * @param light_index Light index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param arm 1 to re-arm, 0 to disarm
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Capture_Trigger_Arm(uint8_t light_index, uint8_t arm);
+
+/**
+ * @brief Record one completed capture
+ * This function is called from the TIM1 input capture interrupt
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param pulse_width Pulse width in timer ticks
+ * @param period Period in timer ticks
+ */
+void Capture_Trigger_AddSample(uint8_t channel, uint16_t pulse_width, uint16_t period);
+
+/**
+ * @brief Fire a TRIGGER_SET_COMMAND trigger
+ * Called from the main loop after a SET command changed an output.
+ */
+void Capture_Trigger_NotifyCommand(void);
+
+/**
+ * @brief Send the trigger state and frozen window as one bulk response
+ * @param light_index Light index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param request Request being answered
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Capture_Trigger_Send(uint8_t light_index, const HILMessage* request);
+
+#endif /* CAPTURE_TRIGGER_H */
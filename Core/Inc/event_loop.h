@@ -0,0 +1,50 @@
+/**
+ * @file event_loop.h
+ * @brief Event flags and sleep for the main loop
+ *
+ * Interrupts that leave work for the main loop signal an event flag. The
+ * main loop takes all pending flags, dispatches the matching handlers and
+ * sleeps (WFI) while none are pending, so it runs only when there is
+ * work and a new flag wakes it within the interrupt exit time. The time
+ * spent asleep is measured with the DWT cycle counter and gives the idle
+ * share of the CPU over one-second windows.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "main.h"
+
+// Event flags
+#define EVENT_LOOP_HIL        0x01    // Message queued by the UART receiver
+#define EVENT_LOOP_RAMP       0x02    // Ramp finished with notification
+#define EVENT_LOOP_SEQUENCER  0x04    // Scenario finished
+#define EVENT_LOOP_FAULT      0x08    // Fault timeline finished
+#define EVENT_LOOP_SCHEDULER  0x10    // Scheduler slot released
+
+#define EVENT_LOOP_IDLE_FULL  1000    // Idle share scale (per mille)
+
+/**
+ * @brief Clear all flags and start the idle measurement
+ */
+void Event_Loop_Init(void);
+
+/**
+ * @brief Signal events to the main loop, safe from any interrupt
+ * @param events EVENT_LOOP_* flags
+ */
+void Event_Loop_Signal(uint32_t events);
+
+/**
+ * @brief Sleep until at least one event is pending and take all pending events
+ * @return EVENT_LOOP_* flags
+ */
+uint32_t Event_Loop_Wait(void);
+
+/**
+ * @brief Get the idle share of the last complete measurement window
+ * @return Idle time in per mille (0-EVENT_LOOP_IDLE_FULL)
+ */
+uint16_t Event_Loop_GetIdle(void);
+
+#endif /* EVENT_LOOP_H */
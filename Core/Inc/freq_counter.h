@@ -0,0 +1,75 @@
+/**
+ * @file freq_counter.h
+ * @brief Gated frequency counter for high-frequency DUT outputs
+ *
+ * Edge-by-edge capture cannot follow DUT PWM or switching nodes in the
+ * 100 kHz to MHz range. In counter mode the light input clocks TIM1
+ * directly (external clock mode 1 from TI1FP1 or TI2FP2), so frequency
+ * is measured by counting with no per-edge CPU work.
+ *
+ * Every TIM8 update (1 ms) requests a DMA2 transfer that copies TIM1->CNT
+ * to memory, so the gate edges are latched in hardware and interrupt
+ * latency does not widen or narrow a gate. The transfer complete
+ * interrupt only accumulates the latched counts. TIM12 cannot do this on
+ * the F446: it is no trigger input of TIM1 and has no DMA request, and
+ * TIM1 sits on APB2 where only DMA2 reaches it.
+ *
+ * Counter mode takes over TIM1, so PWM capture on all lights is
+ * suspended while it is active. Light 3 (TIM1_CH3) cannot clock the
+ * timer and is not supported.
+ */
+
+#ifndef FREQ_COUNTER_H
+#define FREQ_COUNTER_H
+
+#include "main.h"
+
+#define FREQ_COUNTER_MAX_GATE_MS  10000   // Longest gate time
+
+// Result of the last completed gate (little endian on the wire)
+typedef struct __attribute__((packed)) {
+    uint32_t frequency_hz;    // Edges per second, rounded
+    uint32_t edges;           // Rising edges counted during the gate
+    uint16_t gate_ms;         // Gate time in milliseconds
+} FreqCounterResult;
+
+/**
+ * @brief Initialize the frequency counter state
+ */
+void Freq_Counter_Init(void);
+
+/**
+ * @brief Switch TIM1 to counter mode on one light
+ * @param light_index Light index (0-1)
+ * @param gate_ms Gate time in milliseconds (1-FREQ_COUNTER_MAX_GATE_MS)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Freq_Counter_Start(uint8_t light_index, uint16_t gate_ms);
+
+/**
+ * @brief Leave counter mode and resume PWM capture on all lights
+ */
+void Freq_Counter_Stop(void);
+
+/**
+ * @brief Check whether counter mode is active
+ * @return 1 if TIM1 is in counter mode, 0 otherwise
+ */
+uint8_t Freq_Counter_IsActive(void);
+
+/**
+ * @brief Process a gate timer tick
+ * This function is called from the gate DMA transfer complete interrupt
+ * @param count TIM1 counter latched by the DMA at the tick
+ */
+void Freq_Counter_GateTick(uint16_t count);
+
+/**
+ * @brief Get the result of the last completed gate
+ * @param light_index Light index (0-2)
+ * @param result Destination for a consistent copy of the result
+ * @return 1 if a gate has completed on this light, 0 otherwise
+ */
+uint8_t Freq_Counter_GetResult(uint8_t light_index, FreqCounterResult* result);
+
+#endif /* FREQ_COUNTER_H */
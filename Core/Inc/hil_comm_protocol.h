@@ -11,6 +11,7 @@
 // Protocol Constants
 #define HIL_START_MARKER    0xAA
 #define HIL_END_MARKER      0x55
+#define HIL_RX_TIMEOUT_MS   100     // Gap after which a partial frame is dropped
 
 // Light/Channel Identifiers
 typedef enum {
@@ -23,7 +24,8 @@ typedef enum {
 typedef enum {
     CMD_GET = 'G',
     CMD_SET = 'S',
-    CMD_PING = 'P'
+    CMD_PING = 'P',
+    CMD_UPLOAD = 'U'    // Header followed by a payload (see below)
 } HILCommandType;
 
 // Function/Signal Types
@@ -31,13 +33,36 @@ typedef enum {
     SIGNAL_PWM_INPUT   = 'P',
     SIGNAL_CURRENT     = 'C',
     SIGNAL_TEMPERATURE = 'T',
-    SIGNAL_SYSTEM      = 'S'
+    SIGNAL_SYSTEM      = 'S',
+    SIGNAL_PWM_STATS   = 'M',  // Capture statistics window (GET summary, SET window length)
+    SIGNAL_PWM_HISTORY = 'H',  // Capture history ring (GET bulk download, SET clear)
+    SIGNAL_PWM_STATUS  = 'Q',  // Capture status flags (GET only)
+    SIGNAL_PWM_RANGE   = 'R',  // Capture auto-ranging (GET range, SET enable)
+    SIGNAL_FREQUENCY   = 'F',  // Gated frequency counter (GET result, SET gate ms or 0 to stop)
+    SIGNAL_TRIGGER     = 'E',  // Triggered capture (UPLOAD config, SET re-arm/disarm, GET window)
+    SIGNAL_PWM_PHASE   = 'X',  // Cross-channel phase and overlap against this light (GET only)
+    SIGNAL_CAPTURE_CFG = 'K',  // Capture input filter, polarity and prescaler (GET/SET packed value)
+    SIGNAL_PLANT       = 'L',  // Plant model (UPLOAD parameters, SET enable, GET state)
+    SIGNAL_RAMP        = 'A',  // Timed C/T ramp (UPLOAD command, SET stop output, GET state)
+    SIGNAL_SYNC        = 'Y',  // Synchronized C/T update (SET stages on a light, SET commits and GET mask on 'S')
+    SIGNAL_DITHER      = 'D',  // Output dither (GET/SET output mask on a light, carrier prescaler on 'S')
+    SIGNAL_CALIBRATION = 'B',  // Output calibration table (UPLOAD table, SET clear / GET table of output = value)
+    SIGNAL_NTC         = 'N',  // Temperature sensor model (UPLOAD model, SET linear, GET model and table)
+    SIGNAL_NOISE       = 'J',  // Output noise (UPLOAD configuration, SET off / GET configuration of output = value)
+    SIGNAL_DAC         = 'V',  // Output backend (GET/SET mask of outputs driven from the DAC on a light)
+    SIGNAL_ISR_CYCLES  = 'I',  // Light 'S': capture cycles per edge (value 0) or latency and run time per interrupt (value 1), GET / SET reset
+    SIGNAL_WAVEFORM    = 'W',  // Light 'S': DMA waveform players (UPLOAD samples, SET start/stop, GET status)
+    SIGNAL_SEQUENCER   = 'Z',  // Light 'S': stimulus sequencer (UPLOAD steps, SET start/stop, GET status)
+    SIGNAL_FAULT       = 'G',  // Fault profiles (UPLOAD slot, SET start/stop and GET status on 'S', GET active types on a light)
+    SIGNAL_LOAD        = 'U',  // Light 'S': idle per mille of the last second (GET value 0), cycle profile (GET / SET reset value 1)
+    SIGNAL_SCHEDULER   = 'O'   // Light 'S': periodic task accounting (GET status, SET reset)
 } HILSignalType;
 
 // Response Status
 typedef enum {
     RESPONSE_OK    = 'O',
-    RESPONSE_ERROR = 'N'
+    RESPONSE_ERROR = 'N',
+    RESPONSE_EVENT = 'E'    // Unsolicited notification, see HIL_SendEvent
 } HILResponseStatus;
 
 // HIL Message Structure
@@ -51,6 +76,20 @@ typedef struct {
     uint8_t     end;        // End marker (0x55)
 } HILMessage;
 
+/*
+ * Bulk responses carry more data than fits in a HILMessage value. They are
+ * sent as a regular response header whose value holds the payload length,
+ * followed by the payload bytes, an XOR checksum of the payload and the
+ * end marker:
+ *
+ *   [HILMessage header][payload (value bytes)][payload XOR][0x55]
+ *
+ * Uploads (CMD_UPLOAD) use the same framing from host to device. Only one
+ * upload is buffered at a time; the device answers with a regular
+ * OK/error response once the payload has been applied.
+ */
+#define HIL_UPLOAD_MAX_SIZE 512
+
 
 typedef struct {
     uint16_t current_capture;     // Most recent capture value
@@ -59,8 +98,14 @@ typedef struct {
     uint16_t period;              // Total period in timer ticks
     uint16_t duty_cycle;          // Duty cycle (0-1000 range)
     uint8_t  capture_complete;    // Flag indicating a complete capture cycle
+    uint8_t  capture_flags;       // PWM_CAPTURE_FLAG_* status bits
 } PWMCaptureData;
 
+// Capture status flags
+#define PWM_CAPTURE_FLAG_STATIC      0x01  // No edges within the timeout, duty is the static pin level
+#define PWM_CAPTURE_FLAG_LEVEL_HIGH  0x02  // Static line is held high (100 % duty)
+#define PWM_CAPTURE_FLAG_PERIOD_ONLY 0x04  // Input capture prescaler active, duty cycle not updated
+
 // Declare the global array as an extern
 extern PWMCaptureData pwm_capture[3];
 extern uint8_t rx_byte;
@@ -71,8 +116,45 @@ uint8_t HIL_ValidateChecksum(const HILMessage* msg);
 void HIL_ProcessGetCommand(const HILMessage* msg);
 void HIL_ProcessSetCommand(const HILMessage* msg);
 void HIL_ProcessPingCommand(const HILMessage* msg);
+void HIL_ProcessUploadCommand(const HILMessage* msg);
 void HIL_SendResponse(HILResponseStatus status, const HILMessage* original_msg);
 
+/**
+ * Send an unsolicited event message, only from the main loop
+ * @param light Light channel the event belongs to
+ * @param function Signal type that raised the event
+ * @param value Event specific value
+ */
+void HIL_SendEvent(char light, char function, uint16_t value);
+
+// Bulk Response Functions
+/**
+ * Send a complete bulk response from a single buffer
+ * @param request Request being answered (light and function are echoed)
+ * @param payload Payload bytes
+ * @param length Payload length in bytes
+ */
+void HIL_SendBulkResponse(const HILMessage* request, const void* payload, uint16_t length);
+
+/**
+ * Start a bulk response whose payload is sent in several pieces
+ * @param request Request being answered (light and function are echoed)
+ * @param length Total payload length in bytes
+ */
+void HIL_BeginBulkResponse(const HILMessage* request, uint16_t length);
+
+/**
+ * Send the next piece of a bulk response payload
+ * @param data Payload bytes
+ * @param length Number of bytes
+ */
+void HIL_WriteBulkResponse(const void* data, uint16_t length);
+
+/**
+ * Finish a bulk response by sending the payload checksum and end marker
+ */
+void HIL_EndBulkResponse(void);
+
 // New Interrupt-Driven UART Functions
 /**
  * Start UART reception in interrupt mode
@@ -90,4 +172,10 @@ void HIL_StopUARTReception(void);
  */
 void HIL_ProcessReceivedMessages(void);
 
+/**
+ * Drop a partially received frame after HIL_RX_TIMEOUT_MS without bytes
+ * Runs as a periodic scheduler task
+ */
+void HIL_CheckReceiveTimeout(void);
+
 #endif // WISELED_HIL_COMM_PROTOCOL_H
@@ -0,0 +1,100 @@
+/**
+ * @file isr_timing.h
+ * @brief Worst-case entry latency and execution time per interrupt
+ *
+ * Each instrumented interrupt records its execution time with the DWT
+ * cycle counter. Where the hardware leaves a timestamp of the event, the
+ * entry latency is recorded as well: timer update interrupts read how far
+ * the counter has run since the update (for the gate DMA, the TIM8
+ * update that latched the count), the capture interrupt compares
+ * the counter with the captured value and SysTick reads its own down
+ * counter. Execution times include preemption by higher priorities.
+ *
+ * Interrupt priority map (preemption levels of NVIC_PRIORITYGROUP_4 as
+ * set in the .ioc NVIC configuration, lower is more urgent):
+ *   0  TIM1 capture and overflow
+ *   1  USART3 (HIL reception)
+ *   2  TIM2 update, TIM4 tick, TIM5 sequencer,
+ *      frequency counter gate DMA, waveform DMA
+ *   3  SysTick, TIM14 scheduler
+ * All interrupts writing the analog outputs share one level, so they
+ * never preempt each other.
+ */
+
+#ifndef ISR_TIMING_H
+#define ISR_TIMING_H
+
+#include "main.h"
+
+// Record interrupt latency and execution time with the DWT cycle counter
+#ifndef ISR_TIMING
+#define ISR_TIMING  1
+#endif
+
+// Instrumented interrupts
+#define ISR_TIMING_CAPTURE    0     // TIM1 capture/compare
+#define ISR_TIMING_OVERFLOW   1     // TIM1 update (capture timebase overflow)
+#define ISR_TIMING_UART       2     // USART3
+#define ISR_TIMING_OUTPUT     3     // TIM2 update (dither, noise, faults)
+#define ISR_TIMING_TICK       4     // TIM4 1 kHz tick (plant model, ramps, faults)
+#define ISR_TIMING_SEQUENCER  5     // TIM5 compare (sequencer steps)
+#define ISR_TIMING_GATE       6     // DMA2 stream 1 (frequency counter gate, TIM8 latched)
+#define ISR_TIMING_SCHEDULER  7     // TIM14 scheduler release
+#define ISR_TIMING_WAVEFORM   8     // DMA1 streams 1 and 4 (waveform players)
+#define ISR_TIMING_SYSTICK    9
+#define ISR_TIMING_COUNT      10
+
+// Entry flags
+#define ISR_TIMING_FLAG_LATENCY  0x01   // Entry latency is measured
+
+// Timing of one interrupt (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  priority;            // NVIC preemption priority
+    uint8_t  flags;               // ISR_TIMING_FLAG_*
+    uint16_t reserved;
+    uint32_t count;               // Interrupts recorded
+    uint32_t max_latency;         // Worst event-to-entry latency in core cycles
+    uint32_t max_cycles;          // Worst execution time in core cycles
+} IsrTimingEntry;
+
+// Timing report as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint32_t core_hz;             // Core clock, converts cycles to time
+    IsrTimingEntry isr[ISR_TIMING_COUNT];
+} IsrTimingReport;
+
+#if ISR_TIMING
+/**
+ * @brief Enable the cycle counter and clear all records
+ */
+void ISR_Timing_Init(void);
+
+/**
+ * @brief Clear all records
+ */
+void ISR_Timing_Reset(void);
+
+/**
+ * @brief Get the records of all interrupts
+ * @param report Destination for the report
+ */
+void ISR_Timing_GetReport(IsrTimingReport* report);
+
+/**
+ * @brief Convert timer ticks to core cycles
+ * @param tim Timer instance
+ * @param ticks Ticks at the present prescaler
+ * @return Core cycles
+ */
+uint32_t ISR_Timing_TimerCycles(const TIM_TypeDef* tim, uint32_t ticks);
+
+/**
+ * @brief Record one interrupt
+ * @param isr ISR_TIMING_*
+ * @param latency Entry latency in core cycles, 0 if not measured
+ * @param start DWT->CYCCNT at entry
+ */
+void ISR_Timing_Record(uint8_t isr, uint32_t latency, uint32_t start);
+#endif
+
+#endif /* ISR_TIMING_H */
@@ -0,0 +1,99 @@
+/**
+ * @file ntc_emulation.h
+ * @brief NTC thermistor divider emulation for the temperature outputs
+ *
+ * By default a temperature output is linear (100 °C/V). With a sensor
+ * model selected, a commanded temperature produces the voltage the DUT's
+ * thermistor divider would show instead. The model (Beta, Steinhart-Hart
+ * or an uploaded curve) is evaluated once into a uniform table when it is
+ * configured; each update then interpolates between two table entries in
+ * constant time, so ramps and the plant model keep their tick cost.
+ */
+
+#ifndef NTC_EMULATION_H
+#define NTC_EMULATION_H
+
+#include "main.h"
+#include "analog_simulation.h"
+
+#define NTC_TABLE_SHIFT        9                                   // Nominal fine steps per table segment (log2)
+#define NTC_TABLE_SIZE         ((ANALOG_FINE_MAX >> NTC_TABLE_SHIFT) + 2)
+#define NTC_FULL_SCALE_MV      3300                                // Output voltage at ANALOG_FINE_MAX
+#define NTC_CURVE_MAX_POINTS   32
+
+// Sensor models
+#define NTC_MODEL_LINEAR          0   // 100 °C/V, no thermistor
+#define NTC_MODEL_BETA            1   // R = R25 * exp(B * (1/T - 1/298.15 K))
+#define NTC_MODEL_STEINHART_HART  2   // 1/T = A + B ln R + C (ln R)^3
+#define NTC_MODEL_CURVE           3   // Uploaded temperature/voltage points
+
+// Divider topologies
+#define NTC_TOPOLOGY_LOW_SIDE     0   // Fixed resistor to supply, NTC to ground, output across the NTC
+#define NTC_TOPOLOGY_HIGH_SIDE    1   // NTC to supply, fixed resistor to ground
+
+// Upload header, followed by the model parameters (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  model;               // NTC_MODEL_*
+    uint8_t  topology;            // NTC_TOPOLOGY_* (ignored by linear and curve models)
+    uint16_t supply_mv;           // Divider supply voltage in mV
+    uint32_t fixed_ohm;           // Fixed divider resistor in ohms
+} NTCHeader;
+
+// Beta model parameters
+typedef struct __attribute__((packed)) {
+    float    r25_ohm;             // Resistance at 25 °C
+    float    beta;                // Beta constant in K
+} NTCBetaParams;
+
+// Steinhart-Hart model parameters
+typedef struct __attribute__((packed)) {
+    float    a;
+    float    b;
+    float    c;
+} NTCSteinhartHartParams;
+
+// Curve model: uint8_t count, uint8_t reserved, then count points with increasing temperature
+typedef struct __attribute__((packed)) {
+    uint16_t temperature;         // Temperature in C/T SET units (°C)
+    uint16_t millivolts;          // Divider output voltage
+} NTCCurvePoint;
+
+/**
+ * @brief Set all temperature outputs to the linear model
+ */
+void NTC_Emulation_Init(void);
+
+/**
+ * @brief Select and evaluate the sensor model of a temperature output
+ * @param light_index Light index (0-2)
+ * @param payload NTCHeader followed by the model parameters
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t NTC_Emulation_Configure(uint8_t light_index, const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Return a temperature output to the linear model
+ * @param light_index Light index (0-2)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t NTC_Emulation_Clear(uint8_t light_index);
+
+/**
+ * @brief Map a nominal temperature to the nominal output level of the sensor model
+ * @param light_index Light index (0-2)
+ * @param nominal Temperature in nominal fine steps (linear scale)
+ * @return Output level in nominal fine steps (0-ANALOG_FINE_MAX)
+ */
+uint16_t NTC_Emulation_Apply(uint8_t light_index, uint16_t nominal);
+
+/**
+ * @brief Get the model header and evaluated table of a temperature output
+ * @param light_index Light index (0-2)
+ * @param header Destination for the header
+ * @param table Destination for NTC_TABLE_SIZE output levels, or NULL
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t NTC_Emulation_Get(uint8_t light_index, NTCHeader* header, uint16_t* table);
+
+#endif /* NTC_EMULATION_H */
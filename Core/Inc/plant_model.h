@@ -0,0 +1,86 @@
+/**
+ * @file plant_model.h
+ * @brief On-device closed-loop plant model for Wiseled_LBR HIL
+ *
+ * Each light can drive its analog outputs from a model instead of host
+ * setpoints. The current output follows the captured DUT duty cycle through
+ * a gain, and the temperature output follows a first-order thermal RC model
+ * heated by the dissipated power. TIM4 steps the model at 1 kHz, so thermal
+ * feedback loops close on the device without a host round trip.
+ */
+
+#ifndef PLANT_MODEL_H
+#define PLANT_MODEL_H
+
+#include "main.h"
+
+#define PLANT_MODEL_TICK_HZ  1000    // TIM4 update rate
+
+// Model parameters of one light, uploaded as-is (little endian)
+typedef struct __attribute__((packed)) {
+    uint16_t current_gain;        // Output current at 100 % duty in 0.1 A (0-330)
+    uint16_t forward_voltage;     // Load voltage at the modelled current in mV
+    uint16_t heat_fraction;       // Share of electrical power turned into heat in 0.1 % (0-1000)
+    uint16_t ambient;             // Ambient temperature in 0.1 °C (0-3300)
+    uint16_t thermal_resistance;  // Junction to ambient in 0.01 K/W
+    uint16_t time_constant;       // Thermal RC time constant in ms (1-65535)
+} PlantParams;
+
+// Model state of one light as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  enabled;             // 1 while the model drives the outputs
+    uint8_t  reserved;
+    uint16_t duty;                // Captured duty used by the last step in 0.01 %
+    uint16_t current;             // Modelled current in 0.1 A
+    uint16_t temperature;         // Modelled temperature in 0.1 °C
+    uint32_t power_mw;            // Dissipated power in mW
+    uint32_t steps;               // Model steps since enabling
+} PlantState;
+
+/**
+ * @brief Reset all lights to the default parameters with the model disabled
+ */
+void Plant_Model_Init(void);
+
+/**
+ * @brief Load the parameters of a light from an upload payload
+ * The modelled temperature restarts from ambient.
+ * @param light_index Light index (0-2)
+ * @param payload PlantParams structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Plant_Model_Configure(uint8_t light_index, const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Enable or disable the model of a light
+ * While enabled the model owns the current and temperature outputs of the light.
+ * @param light_index Light index (0-2)
+ * @param enable 1 to enable, 0 to disable
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Plant_Model_Enable(uint8_t light_index, uint8_t enable);
+
+/**
+ * @brief Check whether the model drives the outputs of a light
+ * @param light_index Light index (0-2)
+ * @return 1 if enabled, 0 otherwise
+ */
+uint8_t Plant_Model_IsEnabled(uint8_t light_index);
+
+/**
+ * @brief Step all enabled models
+ * This function is called from the TIM4 update interrupt
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void Plant_Model_Tick(TIM_HandleTypeDef *htim);
+
+/**
+ * @brief Get the model state of a light
+ * @param light_index Light index (0-2)
+ * @param state Destination for the state
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Plant_Model_GetState(uint8_t light_index, PlantState* state);
+
+#endif /* PLANT_MODEL_H */
@@ -0,0 +1,88 @@
+/**
+ * @file profiler.h
+ * @brief Cycle profile of interrupts, command handlers and idle time
+ *
+ * The DWT cycle counter is accumulated per profile entry: one entry per
+ * instrumented interrupt (fed by the ISR_TIMING hooks), one per HIL
+ * command type, the main loop event reporting, the scheduler tasks and
+ * the time asleep in the main loop. Together with the elapsed cycles of
+ * the profile window this gives the CPU share of each entry; what is left
+ * is main loop overhead. An interrupt preempted by a higher priority one
+ * includes the cycles of that one as well.
+ *
+ * Build with PROFILER 0 to remove the profiler entirely.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "main.h"
+#include "isr_timing.h"
+
+// Accumulate cycles per interrupt, command handler and idle time
+#ifndef PROFILER
+#define PROFILER  1
+#endif
+
+#if PROFILER && !ISR_TIMING
+#error "PROFILER takes the interrupt cycles from the ISR_TIMING hooks"
+#endif
+
+// Profile entries, interrupts first (ISR_TIMING_*)
+#define PROFILER_GET        (ISR_TIMING_COUNT + 0)   // HIL_ProcessGetCommand
+#define PROFILER_SET        (ISR_TIMING_COUNT + 1)   // HIL_ProcessSetCommand
+#define PROFILER_PING       (ISR_TIMING_COUNT + 2)   // HIL_ProcessPingCommand
+#define PROFILER_UPLOAD     (ISR_TIMING_COUNT + 3)   // HIL_ProcessUploadCommand
+#define PROFILER_EVENTS     (ISR_TIMING_COUNT + 4)   // Ramp, sequencer and fault event reports
+#define PROFILER_SCHEDULER  (ISR_TIMING_COUNT + 5)   // Scheduler tasks
+#define PROFILER_IDLE       (ISR_TIMING_COUNT + 6)   // Main loop asleep
+#define PROFILER_ENTRIES    (ISR_TIMING_COUNT + 7)
+
+// One profile entry (little endian)
+typedef struct __attribute__((packed)) {
+    uint32_t count;               // Runs (sleeps for PROFILER_IDLE)
+    uint64_t cycles;              // Accumulated core cycles
+} ProfilerEntry;
+
+// Profile as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint32_t core_hz;             // Core clock, converts cycles to time
+    uint32_t reserved;
+    uint64_t elapsed_cycles;      // Length of the profile window
+    ProfilerEntry entry[PROFILER_ENTRIES];
+} ProfilerReport;
+
+#if PROFILER
+/**
+ * @brief Enable the cycle counter and start a new profile window
+ */
+void Profiler_Init(void);
+
+/**
+ * @brief Clear all entries and start a new profile window
+ */
+void Profiler_Reset(void);
+
+/**
+ * @brief Extend the profile window to the present cycle count
+ * Call this at least once per cycle counter wrap (25 s at 168 MHz); the
+ * main loop does on every wake-up.
+ */
+void Profiler_Update(void);
+
+/**
+ * @brief Add one run to an entry
+ * Each entry must be fed from a single priority level.
+ * @param entry PROFILER_* or ISR_TIMING_*
+ * @param cycles Core cycles of the run
+ */
+void Profiler_Add(uint8_t entry, uint32_t cycles);
+
+/**
+ * @brief Get the profile of the present window
+ * @param report Destination for the profile
+ */
+void Profiler_GetReport(ProfilerReport* report);
+#endif
+
+#endif /* PROFILER_H */
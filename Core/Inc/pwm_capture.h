@@ -8,6 +8,65 @@
 
 #include "main.h"
 
+/*
+ * Capture ranges (TIM1 prescaler, 168 MHz timer clock, 10000-tick wrap):
+ *   0: PSC 839 - 5 us ticks,    up to 50 ms periods
+ *   1: PSC 83  - 0.5 us ticks,  up to 5 ms periods (default)
+ *   2: PSC 7   - 47.6 ns ticks, up to 476 us periods
+ *   3: PSC 0   - 5.95 ns ticks, up to 59.5 us periods
+ */
+#define PWM_RANGE_COUNT    4
+#define PWM_RANGE_DEFAULT  1
+
+// Number of entries in the capture channel table
+#define PWM_CAPTURE_CHANNELS  3
+
+// Input filter loaded at start-up (ICxF, 0-15)
+#define PWM_CAPTURE_DEFAULT_FILTER  5
+#define PWM_CAPTURE_FILTER_MAX      15
+
+// Capture configuration as carried in a SET/GET value
+#define PWM_CAPTURE_CONFIG_FILTER_MASK      0x000F  // ICxF digital filter
+#define PWM_CAPTURE_CONFIG_ACTIVE_LOW       0x0010  // On-time starts with the falling edge
+#define PWM_CAPTURE_CONFIG_PRESCALER_POS    8       // log2 of the input capture prescaler (0-3)
+#define PWM_CAPTURE_CONFIG_PRESCALER_MASK   0x0300
+
+// Measure capture interrupt cost with the DWT cycle counter
+#ifndef PWM_CAPTURE_CYCLE_COUNT
+#define PWM_CAPTURE_CYCLE_COUNT  1
+#endif
+
+// Route capture interrupts through HAL_TIM_IRQHandler (reference for cycle comparisons)
+#ifndef PWM_CAPTURE_HAL_DISPATCH
+#define PWM_CAPTURE_HAL_DISPATCH  0
+#endif
+
+// Consistent copy of one published capture
+typedef struct {
+    uint16_t pulse_width;         // Pulse width in timer ticks
+    uint16_t period;              // Period in timer ticks
+    uint16_t duty_cycle;          // Duty cycle (0-100 range)
+    uint8_t  capture_flags;       // PWM_CAPTURE_FLAG_* status bits
+    uint8_t  timebase_epoch;      // Timestamps are only comparable within one epoch
+    uint32_t rise_time;           // Latest leading edge in ticks of the shared TIM1 timebase
+    uint32_t sequence;            // Number of captures published so far
+} PWMCaptureSnapshot;
+
+// Runtime input configuration of one channel
+typedef struct {
+    uint8_t filter;           // ICxF digital filter (0-15)
+    uint8_t active_low;       // 1: DUT output is active low
+    uint8_t prescaler;        // log2 of the input capture prescaler, >0 selects period-only capture
+} PWMCaptureConfig;
+
+// Capture interrupt cost in CPU cycles per edge (little endian on the wire)
+typedef struct __attribute__((packed)) {
+    uint32_t edges;           // Edges measured since the last reset
+    uint32_t last;            // Latest interrupt
+    uint32_t max;             // Worst interrupt
+    uint32_t mean;            // Average over all measured edges
+} PWMCaptureCycles;
+
 /**
  * @brief Initialize PWM input capture
  */
@@ -20,6 +79,81 @@ void PWM_Capture_Init(void);
  */
 void PWM_Capture_ProcessEvent(TIM_HandleTypeDef *htim);
 
+/**
+ * @brief TIM1 capture/compare interrupt handler
+ * Called from TIM1_CC_IRQHandler in place of HAL_TIM_IRQHandler
+ */
+void PWM_Capture_IRQHandler(void);
+
+/**
+ * @brief Process capture timer overflow events
+ * This function is called from the TIM1 update interrupt handler
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void PWM_Capture_ProcessOverflow(TIM_HandleTypeDef *htim);
+
+/**
+ * @brief Enable or disable capture auto-ranging
+ * Disabling returns the capture timer to the default range.
+ * @param enable 1 to enable, 0 to disable
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Capture_SetAutoRange(uint8_t enable);
+
+/**
+ * @brief Get the active capture range of a channel
+ * @param channel Channel index (0-2)
+ * @return Range index in the low byte, log2 of the input capture prescaler in the high byte
+ */
+uint16_t PWM_Capture_GetRange(uint8_t channel);
+
+/**
+ * @brief Set the input filter, edge polarity and prescaler of a channel
+ * Applied immediately without interrupting the other channels.
+ * @param channel Channel index (0-2)
+ * @param config New configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Capture_SetConfig(uint8_t channel, const PWMCaptureConfig* config);
+
+/**
+ * @brief Get the input configuration of a channel
+ * @param channel Channel index (0-2)
+ * @param config Destination for the configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Capture_GetConfig(uint8_t channel, PWMCaptureConfig* config);
+
+/**
+ * @brief Get a consistent copy of the latest capture of a channel
+ * Safe to call from the main loop while the capture interrupt is active.
+ * @param channel Channel index (0-2)
+ * @param snapshot Destination for the copy
+ * @return 1 if at least one capture has been published, 0 otherwise
+ */
+uint8_t PWM_Capture_GetSnapshot(uint8_t channel, PWMCaptureSnapshot* snapshot);
+
+/**
+ * @brief Get the latest capture of a channel if it has not been consumed yet
+ * @param channel Channel index (0-2)
+ * @param snapshot Destination for the copy
+ * @return 1 if a new capture was returned, 0 otherwise
+ */
+uint8_t PWM_Capture_ConsumeSnapshot(uint8_t channel, PWMCaptureSnapshot* snapshot);
+
+#if PWM_CAPTURE_CYCLE_COUNT
+/**
+ * @brief Get the cycle cost of the capture interrupt
+ * @param cycles Destination for the counters
+ */
+void PWM_Capture_GetCycles(PWMCaptureCycles* cycles);
+
+/**
+ * @brief Reset the capture interrupt cycle counters
+ */
+void PWM_Capture_ResetCycles(void);
+#endif
+
 /**
  * @brief Start PWM input capture on all channels
  */
@@ -0,0 +1,72 @@
+/**
+ * @file pwm_history.h
+ * @brief PWM capture history ring buffer for Wiseled_LBR HIL
+ *
+ * Every PWM input channel keeps the last PWM_HISTORY_DEPTH captures as
+ * (period, pulse width) pairs. Periods are rising-edge to rising-edge
+ * deltas, so edge timestamps are reconstructed on the host by summing
+ * periods; no absolute timestamps need to be stored.
+ *
+ * Entries are in ticks of the capture range active when they were
+ * recorded. An entry with period 0 marks a range change and carries the
+ * new range index in its pulse width field.
+ */
+
+#ifndef PWM_HISTORY_H
+#define PWM_HISTORY_H
+
+#include "main.h"
+
+#define PWM_HISTORY_DEPTH  1024   // Captures kept per channel (4 bytes each)
+
+// One captured PWM cycle, in capture timer ticks (little endian on the wire)
+typedef struct __attribute__((packed)) {
+    uint16_t period;          // Rising edge to rising edge
+    uint16_t pulse_width;     // Rising edge to falling edge
+} PWMHistoryEntry;
+
+// Bulk download header, followed by 'count' entries from oldest to newest
+typedef struct __attribute__((packed)) {
+    uint16_t count;           // Entries that follow
+    uint16_t dropped;         // Captures discarded while the ring was frozen
+} PWMHistoryHeader;
+
+/**
+ * @brief Clear the history of all channels
+ */
+void PWM_History_Init(void);
+
+/**
+ * @brief Clear the history of one channel
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_History_Clear(uint8_t channel);
+
+/**
+ * @brief Append one completed capture to a channel's history
+ * This function is called from the TIM1 input capture interrupt
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param pulse_width Pulse width in timer ticks
+ * @param period Period in timer ticks
+ */
+void PWM_History_Add(uint8_t channel, uint16_t pulse_width, uint16_t period);
+
+/**
+ * @brief Record a capture range change in a channel's history
+ * This function is called from TIM1 interrupt context
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param range New capture range index
+ */
+void PWM_History_AddRangeMarker(uint8_t channel, uint8_t range);
+
+/**
+ * @brief Send the history of a channel as one bulk response
+ * The ring is frozen while it is being transmitted.
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param request Request being answered
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_History_Send(uint8_t channel, const HILMessage* request);
+
+#endif /* PWM_HISTORY_H */
@@ -0,0 +1,51 @@
+/**
+ * @file pwm_phase.h
+ * @brief Cross-channel PWM phase and overlap measurement for Wiseled_LBR HIL
+ *
+ * All light inputs are captured on TIM1, so their rising edges share one
+ * timebase. The offset of another channel's rising edge within the period
+ * of a reference channel gives the phase stagger of the DUT outputs, and
+ * the on-time intersection over one period shows where they overlap.
+ */
+
+#ifndef PWM_PHASE_H
+#define PWM_PHASE_H
+
+#include "main.h"
+#include "pwm_capture.h"
+
+// Pair flags
+#define PWM_PHASE_FLAG_VALID            0x01  // Both channels have comparable captures
+#define PWM_PHASE_FLAG_PERIOD_MISMATCH  0x02  // Periods differ by more than PWM_PHASE_PERIOD_TOLERANCE
+#define PWM_PHASE_FLAG_NO_OVERLAP_DATA  0x04  // A channel captures period only, overlap not measured
+
+#define PWM_PHASE_PERIOD_TOLERANCE  1   // Allowed period difference in percent
+
+// Offset and overlap of one channel relative to the reference (little endian on the wire)
+typedef struct __attribute__((packed)) {
+    uint8_t  channel;         // Compared channel index (0 to PWM_CAPTURE_CHANNELS-1)
+    uint8_t  flags;           // PWM_PHASE_FLAG_* bits
+    uint16_t offset_ticks;    // Rising edge offset after the reference rising edge (0 to period-1)
+    uint16_t phase;           // Offset in 0.1 degree units of the reference period (0-3599)
+    uint16_t overlap_ticks;   // On-time shared with the reference per period
+    uint16_t overlap;         // Overlap in 0.01 % units of the reference period
+} PWMPhasePair;
+
+// Phase report of one reference channel
+typedef struct __attribute__((packed)) {
+    uint8_t  reference;       // Reference channel index (0 to PWM_CAPTURE_CHANNELS-1)
+    uint8_t  range;           // Active capture range
+    uint16_t period;          // Reference period in capture timer ticks
+    uint16_t pulse_width;     // Reference pulse width in capture timer ticks
+    PWMPhasePair pair[PWM_CAPTURE_CHANNELS - 1];  // The other channels in ascending order
+} PWMPhaseReport;
+
+/**
+ * @brief Measure the phase of the other channels against a reference channel
+ * @param reference Reference channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param report Destination for the report
+ * @return 1 if the reference channel has a usable capture, 0 otherwise
+ */
+uint8_t PWM_Phase_Measure(uint8_t reference, PWMPhaseReport* report);
+
+#endif /* PWM_PHASE_H */
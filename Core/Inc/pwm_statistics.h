@@ -0,0 +1,71 @@
+/**
+ * @file pwm_statistics.h
+ * @brief On-device PWM capture statistics for Wiseled_LBR HIL
+ *
+ * Each PWM input channel feeds completed captures into a Welford
+ * accumulator (O(1) per edge, fixed memory). Once the configured number
+ * of samples has been collected the min/max/mean/standard deviation of
+ * duty cycle and period are published as a summary and a new window
+ * starts, so the host needs a single GET per test step.
+ */
+
+#ifndef PWM_STATISTICS_H
+#define PWM_STATISTICS_H
+
+#include "main.h"
+
+#define PWM_STATS_DEFAULT_WINDOW  100   // Samples per window after reset
+
+// Summary of one completed window as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint16_t count;           // Samples in the window
+    uint16_t window;          // Configured window length
+    uint16_t duty_min;        // Duty cycle in 0.01 % units (0-10000)
+    uint16_t duty_max;
+    uint16_t duty_mean;
+    uint16_t duty_std;
+    uint32_t period_min;      // Period in capture timer ticks of the active range
+    uint32_t period_max;
+    uint32_t period_mean;
+    uint32_t period_std;
+} PWMStatsSummary;
+
+/**
+ * @brief Reset all accumulators to the default window
+ */
+void PWM_Statistics_Init(void);
+
+/**
+ * @brief Set the window length of a channel and restart its accumulator
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param window Number of samples per window (1-65535)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Statistics_SetWindow(uint8_t channel, uint16_t window);
+
+/**
+ * @brief Discard the samples of a channel's current window
+ * This function is called from TIM1 interrupt context when the capture
+ * range changes, since samples of different ranges must not be mixed.
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ */
+void PWM_Statistics_Restart(uint8_t channel);
+
+/**
+ * @brief Add one completed capture to a channel's accumulator
+ * This function is called from the TIM1 input capture interrupt
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param pulse_width Pulse width in timer ticks
+ * @param period Period in timer ticks
+ */
+void PWM_Statistics_AddSample(uint8_t channel, uint32_t pulse_width, uint32_t period);
+
+/**
+ * @brief Get the summary of the last completed window
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param summary Destination for a consistent copy of the summary
+ * @return 1 if a window has completed, 0 otherwise
+ */
+uint8_t PWM_Statistics_GetSummary(uint8_t channel, PWMStatsSummary* summary);
+
+#endif /* PWM_STATISTICS_H */
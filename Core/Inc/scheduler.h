@@ -0,0 +1,92 @@
+/**
+ * @file scheduler.h
+ * @brief Fixed-rate cooperative task scheduler
+ *
+ * Tasks are added to one of three rate slots (10 kHz, 1 kHz, 100 Hz)
+ * and run to completion in the main loop. TIM14 releases the slots: its
+ * interrupt only counts releases and signals the main loop, which then
+ * runs the released slots fastest first. A release that is still
+ * waiting when the next release of the same slot comes is skipped and
+ * counted as an overrun, so a slot never runs in bursts to catch up.
+ * Each task run is measured with the DWT cycle counter.
+ *
+ * The timer period follows the fastest slot in use, so an empty 10 kHz
+ * slot costs no interrupts.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "main.h"
+
+#define SCHEDULER_SLOTS      3
+#define SCHEDULER_MAX_TASKS  8
+#define SCHEDULER_BASE_US    100    // Period of the fastest slot
+
+// Rate slots
+#define SCHEDULER_SLOT_10KHZ  0
+#define SCHEDULER_SLOT_1KHZ   1
+#define SCHEDULER_SLOT_100HZ  2
+
+// Run-time accounting of one task (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  slot;                // SCHEDULER_SLOT_*
+    uint8_t  reserved[3];
+    uint32_t runs;
+    uint32_t last_cycles;         // Cycles of the latest run
+    uint32_t max_cycles;          // Cycles of the longest run
+    uint64_t total_cycles;
+} SchedulerTaskStatus;
+
+// Scheduler state as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  tasks;               // Number of tasks added
+    uint8_t  reserved[3];
+    uint32_t releases[SCHEDULER_SLOTS];   // Releases per slot
+    uint32_t overruns[SCHEDULER_SLOTS];   // Releases skipped per slot
+    SchedulerTaskStatus task[SCHEDULER_MAX_TASKS];
+} SchedulerStatus;
+
+/**
+ * @brief Remove all tasks and stop the timer
+ */
+void Scheduler_Init(void);
+
+/**
+ * @brief Add a task to a rate slot, tasks of a slot run in the order added
+ * Call this before Scheduler_Start.
+ * @param slot SCHEDULER_SLOT_*
+ * @param run Task function, runs to completion in the main loop
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Scheduler_AddTask(uint8_t slot, void (*run)(void));
+
+/**
+ * @brief Start releasing the slots that have tasks
+ */
+void Scheduler_Start(void);
+
+/**
+ * @brief Run the tasks of all released slots
+ * Call this in the main loop on EVENT_LOOP_SCHEDULER.
+ */
+void Scheduler_Run(void);
+
+/**
+ * @brief Get the scheduler state
+ * @param status Destination for the state
+ */
+void Scheduler_GetStatus(SchedulerStatus* status);
+
+/**
+ * @brief Reset the run-time accounting and overrun counters
+ */
+void Scheduler_ResetStats(void);
+
+/**
+ * @brief Release the slots that are due
+ * This function is called from the TIM14 interrupt
+ */
+void Scheduler_IRQHandler(void);
+
+#endif /* SCHEDULER_H */
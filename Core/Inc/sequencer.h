@@ -0,0 +1,110 @@
+/**
+ * @file sequencer.h
+ * @brief Time-scheduled stimulus sequencer for Wiseled_LBR HIL
+ *
+ * A scenario is a list of timed SET steps uploaded into RAM. Once
+ * started, TIM5 (32-bit, 1 MHz) counts microseconds from the start and
+ * its compare channel 1 interrupts at the timestamp of the next step,
+ * so steps apply without host round trips. Steps with the same
+ * timestamp apply back to back in one interrupt. A step applied more
+ * than SEQUENCER_LATE_US after its timestamp is counted as late.
+ *
+ * Supported steps (light and function as in HILMessage):
+ *   '1'-'3' 'C' / 'T'  Set current / temperature, as SET C / SET T
+ *   '1'-'3' 'Y'        Stage a value, as SET Y
+ *   'S'     'Y'        Commit (1) or discard (0) the staged values
+ * A step on an output owned by the plant model, a waveform or a ramp is
+ * skipped and counted as rejected.
+ *
+ * Scenario steps stage into their own set (ANALOG_STAGE_SEQUENCER),
+ * separate from the host's SET Y values: a scenario commit or discard
+ * never touches values staged by the host and vice versa. The set is
+ * cleared at each start. A host commit runs with the TIM5 interrupt
+ * disabled, so a scenario commit cannot interleave with it.
+ */
+
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+#include "main.h"
+
+#define SEQUENCER_MAX_STEPS  4096   // 32 KB of steps
+#define SEQUENCER_LATE_US    10     // Lateness above which a step counts as late
+
+// Sequencer states
+#define SEQUENCER_STATE_IDLE     0
+#define SEQUENCER_STATE_RUNNING  1
+#define SEQUENCER_STATE_DONE     2  // All steps applied
+
+// One step (little endian)
+typedef struct __attribute__((packed)) {
+    uint32_t time_us;             // Time after the start, non-decreasing through the scenario
+    char     light;               // '1'-'3' or 'S'
+    char     function;            // SIGNAL_CURRENT, SIGNAL_TEMPERATURE or SIGNAL_SYNC
+    uint16_t value;
+} SequencerStep;
+
+// Upload header, followed by SequencerStep entries
+typedef struct __attribute__((packed)) {
+    uint16_t length;              // Total scenario length in steps
+    uint16_t offset;              // Index of the first step in this upload
+} SequencerHeader;
+
+// Sequencer status as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  state;               // SEQUENCER_STATE_*
+    uint8_t  reserved;
+    uint16_t length;              // Scenario length in steps
+    uint16_t position;            // Index of the next step
+    uint16_t applied;             // Steps applied
+    uint16_t rejected;            // Steps skipped because their output was owned or the value invalid
+    uint16_t late;                // Steps applied more than SEQUENCER_LATE_US late
+    uint16_t first_late;          // Index of the first late step, 0xFFFF if none
+    uint16_t reserved2;
+    uint32_t max_late_us;         // Largest lateness of any step
+    uint32_t elapsed_us;          // Time since the start, frozen when done
+} SequencerStatus;
+
+/**
+ * @brief Reset the sequencer to idle with an empty scenario
+ */
+void Sequencer_Init(void);
+
+/**
+ * @brief Load (part of) the scenario from an upload payload
+ * @param payload SequencerHeader followed by steps
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise (also while running)
+ */
+uint8_t Sequencer_Load(const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Start the scenario from its first step at time 0
+ * @return 1 if successful, 0 if running, empty or not in time order
+ */
+uint8_t Sequencer_Start(void);
+
+/**
+ * @brief Stop the scenario, outputs keep their present values
+ */
+void Sequencer_Stop(void);
+
+/**
+ * @brief Get the sequencer status
+ * @param status Destination for the status
+ */
+void Sequencer_GetStatus(SequencerStatus* status);
+
+/**
+ * @brief Apply all due steps and schedule the next one
+ * This function is called from the TIM5 interrupt
+ */
+void Sequencer_IRQHandler(void);
+
+/**
+ * @brief Send the completion event of a finished scenario
+ * Call this in the main loop, events share the UART with responses.
+ */
+void Sequencer_ProcessEvents(void);
+
+#endif /* SEQUENCER_H */
@@ -38,18 +38,39 @@ extern TIM_HandleTypeDef htim2;
 
 extern TIM_HandleTypeDef htim3;
 
-/* USER CODE BEGIN Private defines */
+extern TIM_HandleTypeDef htim4;
+
+extern TIM_HandleTypeDef htim5;
+
+extern TIM_HandleTypeDef htim6;
+
+extern TIM_HandleTypeDef htim7;
 
+extern TIM_HandleTypeDef htim8;
+
+extern TIM_HandleTypeDef htim14;
+
+/* USER CODE BEGIN Private defines */
+// Users of the shared 1 kHz TIM4 tick
+#define TIM4_TICK_PLANT  0x01
+#define TIM4_TICK_RAMP   0x02
+#define TIM4_TICK_FAULT  0x04
 /* USER CODE END Private defines */
 
 void MX_TIM1_Init(void);
 void MX_TIM2_Init(void);
 void MX_TIM3_Init(void);
+void MX_TIM4_Init(void);
+void MX_TIM5_Init(void);
+void MX_TIM6_Init(void);
+void MX_TIM7_Init(void);
+void MX_TIM8_Init(void);
+void MX_TIM14_Init(void);
 
 void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
 
 /* USER CODE BEGIN Prototypes */
-
+void TIM4_Tick_Request(uint32_t user, uint8_t enable);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -0,0 +1,108 @@
+/**
+ * @file waveform.h
+ * @brief DMA-fed arbitrary waveform playback on the analog outputs
+ *
+ * A player streams a RAM table of output codes into the CCR register
+ * of one current or temperature output, or into the DAC holding
+ * register when the output is routed to the DAC. TIM6 (player 0) and TIM7
+ * (player 1) pace the samples and request a DMA transfer on every
+ * update event, so playback needs no CPU per sample.
+ *
+ * Modes:
+ *   Loop      - the table repeats until stopped (circular DMA)
+ *   One-shot  - the table plays once and the last sample is held
+ *   Ping-pong - the table is split into two halves played alternately
+ *               (DMA double buffer); the half not being played can be
+ *               reloaded while running, for streaming long profiles
+ */
+
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include "main.h"
+
+#define WAVEFORM_PLAYERS         2
+#define WAVEFORM_MAX_SAMPLES     1024   // Per player
+#define WAVEFORM_MIN_PERIOD_US   2      // Shortest sample period
+
+// Playback modes
+#define WAVEFORM_MODE_LOOP       0
+#define WAVEFORM_MODE_ONE_SHOT   1
+#define WAVEFORM_MODE_PING_PONG  2
+
+// Player states
+#define WAVEFORM_STATE_IDLE      0
+#define WAVEFORM_STATE_PLAYING   1
+#define WAVEFORM_STATE_DONE      2      // One-shot finished, last sample held
+#define WAVEFORM_STATE_ERROR     3      // DMA transfer error
+
+// Upload header, followed by uint16_t output codes (little endian): compare
+// values (0-1023), or DAC codes (0-4095) for an output routed to the DAC.
+// A table must be reloaded after the output changes backend.
+typedef struct __attribute__((packed)) {
+    uint8_t  player;              // Player index (0-1)
+    uint8_t  light;               // Target light index (0-2)
+    uint8_t  output;              // ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+    uint8_t  mode;                // WAVEFORM_MODE_*
+    uint16_t sample_period_us;    // Time per sample in microseconds
+    uint16_t length;              // Total table length in samples (even for ping-pong)
+    uint16_t offset;              // Table index of the first sample in this upload
+} WaveformHeader;
+
+// Player status as sent over the protocol (little endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  state;               // WAVEFORM_STATE_*
+    uint8_t  light;
+    uint8_t  output;
+    uint8_t  mode;
+    uint16_t length;              // Table length in samples
+    uint16_t position;            // Next sample index
+    uint8_t  active_half;         // Ping-pong: half being played (0-1)
+    uint8_t  reserved;
+    uint32_t passes;              // Completed table passes, or halves in ping-pong mode
+} WaveformStatus;
+
+/**
+ * @brief Reset all players to idle with empty tables
+ */
+void Waveform_Init(void);
+
+/**
+ * @brief Load (part of) a player table from an upload payload
+ * An idle player takes the configuration of the header. A playing
+ * ping-pong player accepts samples for the half that is not being played.
+ * @param payload WaveformHeader followed by samples
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Waveform_Load(const uint8_t* payload, uint16_t length);
+
+/**
+ * @brief Start playback of a loaded player
+ * @param index Player index (0-1)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Waveform_Start(uint8_t index);
+
+/**
+ * @brief Stop a player, holding the current sample on its output
+ * @param index Player index (0-1)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Waveform_Stop(uint8_t index);
+
+/**
+ * @brief Check whether a playing player drives an output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if driven, 0 otherwise
+ */
+uint8_t Waveform_IsDriving(uint8_t light_index, uint8_t output);
+
+/**
+ * @brief Get the status of all players
+ * @param status Destination array of WAVEFORM_PLAYERS entries
+ */
+void Waveform_GetStatus(WaveformStatus* status);
+
+#endif /* WAVEFORM_H */
@@ -0,0 +1,175 @@
+/**
+ * @file analog_calibration.c
+ * @brief Per-output calibration of the analog simulation outputs
+ */
+
+#include "analog_calibration.h"
+#include "analog_simulation.h"
+#include <string.h>
+
+#define SLOPE_FRACTION_BITS  16       // Segment slopes in 16.16 fixed point
+#define SLOPE_LIMIT          32767    // Largest slope that fits the fixed point format
+
+// Table of one output with precomputed segments
+typedef struct {
+    uint8_t  count;                                       // 0 when uncalibrated
+    uint16_t nominal[ANALOG_CALIBRATION_MAX_POINTS];
+    uint16_t compare[ANALOG_CALIBRATION_MAX_POINTS];
+    int32_t  slope[ANALOG_CALIBRATION_MAX_POINTS - 1];    // Compare per nominal step, 16.16
+} CalibrationTable;
+
+static CalibrationTable tables[3][2];
+
+/**
+ * @brief Clear all tables, every output maps 1:1
+ */
+void Analog_Calibration_Init(void) {
+    memset(tables, 0, sizeof(tables));
+}
+
+/**
+ * @brief Load the table of one output from an upload payload
+ * @param light_index Light index (0-2)
+ * @param payload AnalogCalibrationHeader followed by the points
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Calibration_Load(uint8_t light_index, const uint8_t* payload, uint16_t length) {
+    AnalogCalibrationHeader header;
+    AnalogCalibrationPoint point[ANALOG_CALIBRATION_MAX_POINTS];
+    CalibrationTable table;
+
+    if (light_index > 2 || payload == NULL || length < sizeof(header)) {
+        return 0;
+    }
+
+    memcpy(&header, payload, sizeof(header));
+
+    if (header.output > ANALOG_OUTPUT_TEMPERATURE || header.count < 2 ||
+        header.count > ANALOG_CALIBRATION_MAX_POINTS ||
+        length != sizeof(header) + header.count * sizeof(AnalogCalibrationPoint)) {
+        return 0;
+    }
+
+    memcpy(point, payload + sizeof(header), header.count * sizeof(AnalogCalibrationPoint));
+
+    // Validate the points and precompute the segments before replacing the table
+    memset(&table, 0, sizeof(table));
+    table.count = header.count;
+
+    for (uint8_t i = 0; i < header.count; i++) {
+        if (point[i].compare > ANALOG_FINE_MAX || (i > 0 && point[i].nominal <= point[i - 1].nominal)) {
+            return 0;
+        }
+
+        table.nominal[i] = point[i].nominal;
+        table.compare[i] = point[i].compare;
+
+        if (i > 0) {
+            int64_t rise = (int64_t)(point[i].compare - point[i - 1].compare) << SLOPE_FRACTION_BITS;
+            int32_t run = point[i].nominal - point[i - 1].nominal;
+
+            // Rounded, so each segment ends on its point instead of one step short
+            int64_t slope = (rise + ((rise < 0) ? -run / 2 : run / 2)) / run;
+
+            if (slope > ((int64_t)SLOPE_LIMIT << SLOPE_FRACTION_BITS) ||
+                slope < -((int64_t)SLOPE_LIMIT << SLOPE_FRACTION_BITS)) {
+                return 0;
+            }
+            table.slope[i - 1] = (int32_t)slope;
+        }
+    }
+
+    // Ramps and the plant model apply tables from the TIM4 tick, sequencer steps from TIM5
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    HAL_NVIC_DisableIRQ(TIM5_IRQn);
+    tables[light_index][header.output] = table;
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Remove the table of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Calibration_Clear(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    HAL_NVIC_DisableIRQ(TIM5_IRQn);
+    tables[light_index][output].count = 0;
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Map a nominal value to the calibrated compare value
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param nominal Nominal value in fine steps
+ * @return Compare value in fine steps (0-ANALOG_FINE_MAX)
+ */
+uint16_t Analog_Calibration_Apply(uint8_t light_index, uint8_t output, uint16_t nominal) {
+    const CalibrationTable* table = &tables[light_index][output];
+    uint8_t segment = 0;
+    int32_t compare;
+
+    if (table->count == 0) {
+        return (nominal > ANALOG_FINE_MAX) ? ANALOG_FINE_MAX : nominal;
+    }
+
+    // Last segment whose start is at or below the value, the first one below the table
+    while (segment < table->count - 2 && nominal >= table->nominal[segment + 1]) {
+        segment++;
+    }
+
+    compare = table->compare[segment] +
+              (int32_t)(((int64_t)((int32_t)nominal - table->nominal[segment]) * table->slope[segment] +
+                         (1 << (SLOPE_FRACTION_BITS - 1))) >> SLOPE_FRACTION_BITS);
+
+    if (compare < 0) {
+        return 0;
+    }
+    if (compare > ANALOG_FINE_MAX) {
+        return ANALOG_FINE_MAX;
+    }
+    return (uint16_t)compare;
+}
+
+/**
+ * @brief Copy the table of one output in upload format
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param buffer Destination for the header and up to ANALOG_CALIBRATION_MAX_POINTS points
+ * @param size Size of the buffer in bytes
+ * @return Number of bytes written, 0 if invalid
+ */
+uint16_t Analog_Calibration_Get(uint8_t light_index, uint8_t output, uint8_t* buffer, uint16_t size) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE || buffer == NULL) {
+        return 0;
+    }
+
+    const CalibrationTable* table = &tables[light_index][output];
+    AnalogCalibrationHeader header = {output, table->count};
+    uint16_t length = sizeof(header) + table->count * sizeof(AnalogCalibrationPoint);
+
+    if (size < length) {
+        return 0;
+    }
+
+    memcpy(buffer, &header, sizeof(header));
+    for (uint8_t i = 0; i < table->count; i++) {
+        AnalogCalibrationPoint point = {table->nominal[i], table->compare[i]};
+        memcpy(buffer + sizeof(header) + i * sizeof(point), &point, sizeof(point));
+    }
+
+    return length;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file analog_dac.c
+ * @brief On-chip DAC backend for the analog simulation outputs
+ */
+
+#include "analog_dac.h"
+
+// Holding registers and enable bits, indexed by channel
+static volatile uint32_t* const dac_registers[ANALOG_DAC_CHANNELS] = {
+    &DAC->DHR12R1,
+    &DAC->DHR12R2,
+};
+
+static const uint32_t dac_enable_bits[ANALOG_DAC_CHANNELS] = {
+    DAC_CR_EN1,
+    DAC_CR_EN2,
+};
+
+/**
+ * @brief Configure the DAC pins and switch both channels off
+ */
+void Analog_DAC_Init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_DAC_CLK_ENABLE();
+
+    /**DAC GPIO Configuration
+    PA4     ------> DAC_OUT1
+    PA5     ------> DAC_OUT2
+    */
+    GPIO_InitStruct.Pin = GPIO_PIN_4|GPIO_PIN_5;
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    // Output buffers on, no trigger: the holding register loads the output directly
+    DAC->CR = 0;
+    DAC->DHR12R1 = 0;
+    DAC->DHR12R2 = 0;
+}
+
+/**
+ * @brief Switch one DAC channel on (buffered output) or off (high impedance)
+ * @param channel DAC channel index (0-1)
+ * @param enable 1 to enable, 0 to disable
+ */
+void Analog_DAC_Enable(uint8_t channel, uint8_t enable) {
+    if (channel >= ANALOG_DAC_CHANNELS) {
+        return;
+    }
+
+    if (enable) {
+        DAC->CR |= dac_enable_bits[channel];
+    } else {
+        DAC->CR &= ~dac_enable_bits[channel];
+    }
+}
+
+/**
+ * @brief Write one DAC channel
+ * @param channel DAC channel index (0-1)
+ * @param code Output code (0-ANALOG_DAC_MAX)
+ */
+void Analog_DAC_Write(uint8_t channel, uint16_t code) {
+    *dac_registers[channel] = code;
+}
+
+/**
+ * @brief Get the 12-bit right-aligned holding register of a DAC channel
+ * @param channel DAC channel index (0-1)
+ * @return Pointer to the DHR12Rx register, or NULL if invalid
+ */
+volatile uint32_t* Analog_DAC_GetRegister(uint8_t channel) {
+    if (channel >= ANALOG_DAC_CHANNELS) {
+        return NULL;
+    }
+
+    return dac_registers[channel];
+}
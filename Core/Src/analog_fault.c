@@ -0,0 +1,342 @@
+/**
+ * @file analog_fault.c
+ * @brief Sensor and wiring fault profiles on the analog simulation outputs
+ */
+
+#include "analog_fault.h"
+#include "analog_simulation.h"
+#include "waveform.h"
+#include "hil_comm_protocol.h"
+#include "event_loop.h"
+#include <string.h>
+
+// Slot with its run-time state
+typedef struct {
+    AnalogFaultProfile profile;
+    uint8_t state;                // ANALOG_FAULT_SLOT_*
+    uint16_t stuck_value;         // Setpoint captured when a stuck fault starts
+} FaultSlot;
+
+static FaultSlot slots[ANALOG_FAULT_SLOTS];
+static volatile uint8_t running = 0;
+static volatile uint8_t done_event = 0;   // Completion not yet reported
+static volatile uint32_t elapsed_ms = 0;
+
+// Drive applied to each output, to write only changes
+static uint8_t drive_modes[3][2];
+static int32_t drive_values[3][2];
+static uint8_t active_types[3][2];
+
+/**
+ * @brief Apply a drive to an output if it differs from the present one
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param mode ANALOG_FAULT_DRIVE_*
+ * @param value Forced level or offset in fine steps
+ */
+static void set_drive(uint8_t light_index, uint8_t output, uint8_t mode, int32_t value) {
+    if (drive_modes[light_index][output] == mode && drive_values[light_index][output] == value) {
+        return;
+    }
+
+    drive_modes[light_index][output] = mode;
+    drive_values[light_index][output] = value;
+    Analog_SetFaultDrive(light_index, output, mode, value);
+}
+
+/**
+ * @brief Advance the slot states to the timeline position and apply the drives
+ * The highest active slot of an output decides its drive.
+ */
+static void evaluate(void) {
+    uint8_t modes[3][2];
+    int32_t values[3][2];
+    uint8_t pending = 0;
+    uint32_t now = elapsed_ms;
+
+    memset(modes, ANALOG_FAULT_DRIVE_NONE, sizeof(modes));
+    memset(values, 0, sizeof(values));
+    memset(active_types, ANALOG_FAULT_NONE, sizeof(active_types));
+
+    for (uint8_t i = 0; i < ANALOG_FAULT_SLOTS; i++) {
+        FaultSlot* slot = &slots[i];
+        const AnalogFaultProfile* profile = &slot->profile;
+        uint8_t light_index = profile->light;
+        uint8_t output = profile->output;
+        uint32_t t;
+
+        if (slot->state == ANALOG_FAULT_SLOT_EMPTY || slot->state == ANALOG_FAULT_SLOT_DONE) {
+            continue;
+        }
+
+        if (now < profile->start_ms) {
+            pending = 1;
+            continue;
+        }
+
+        t = now - profile->start_ms;
+        if (profile->duration_ms != 0 && t >= profile->duration_ms) {
+            slot->state = ANALOG_FAULT_SLOT_DONE;
+            continue;
+        }
+
+        if (slot->state == ANALOG_FAULT_SLOT_PENDING) {
+            slot->state = ANALOG_FAULT_SLOT_ACTIVE;
+            slot->stuck_value = Analog_GetOutputFine(light_index, output);
+        }
+        pending = 1;
+
+        active_types[light_index][output] = profile->type;
+        values[light_index][output] = 0;
+
+        switch (profile->type) {
+            case ANALOG_FAULT_OPEN:
+                modes[light_index][output] = ANALOG_FAULT_DRIVE_OPEN;
+                break;
+
+            case ANALOG_FAULT_SHORT:
+                modes[light_index][output] = ANALOG_FAULT_DRIVE_FORCE;
+                break;
+
+            case ANALOG_FAULT_STUCK:
+                modes[light_index][output] = ANALOG_FAULT_DRIVE_FORCE;
+                values[light_index][output] = slot->stuck_value;
+                break;
+
+            case ANALOG_FAULT_DRIFT:
+                modes[light_index][output] = ANALOG_FAULT_DRIVE_OFFSET;
+                values[light_index][output] = (int32_t)(((int64_t)profile->rate * t) / ANALOG_FAULT_TICK_HZ);
+                break;
+
+            default:
+                // Dropout: open at the start of each period
+                modes[light_index][output] = ((t % profile->period_ms) < profile->width_ms)
+                                             ? ANALOG_FAULT_DRIVE_OPEN : ANALOG_FAULT_DRIVE_NONE;
+                break;
+        }
+    }
+
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            set_drive(i, output, modes[i][output], values[i][output]);
+        }
+    }
+
+    // All faults over: release the tick and report
+    if (!pending) {
+        running = 0;
+        done_event = 1;
+        Event_Loop_Signal(EVENT_LOOP_FAULT);
+        TIM4_Tick_Request(TIM4_TICK_FAULT, 0);
+    }
+}
+
+/**
+ * @brief Empty all slots and stop the timeline
+ */
+void Analog_Fault_Init(void) {
+    running = 0;
+    done_event = 0;
+    elapsed_ms = 0;
+    memset(slots, 0, sizeof(slots));
+    memset(drive_modes, ANALOG_FAULT_DRIVE_NONE, sizeof(drive_modes));
+    memset(drive_values, 0, sizeof(drive_values));
+    memset(active_types, ANALOG_FAULT_NONE, sizeof(active_types));
+}
+
+/**
+ * @brief Load one fault profile into its slot
+ * @param payload AnalogFaultProfile structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise (also while the timeline runs)
+ */
+uint8_t Analog_Fault_Load(const uint8_t* payload, uint16_t length) {
+    AnalogFaultProfile profile;
+
+    if (payload == NULL || length != sizeof(profile) || running) {
+        return 0;
+    }
+
+    memcpy(&profile, payload, sizeof(profile));
+
+    if (profile.slot >= ANALOG_FAULT_SLOTS || profile.type > ANALOG_FAULT_DROPOUT) {
+        return 0;
+    }
+
+    if (profile.type == ANALOG_FAULT_NONE) {
+        memset(&slots[profile.slot], 0, sizeof(FaultSlot));
+        return 1;
+    }
+
+    if (profile.light > 2 || profile.output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    if (profile.type == ANALOG_FAULT_DROPOUT &&
+        (profile.period_ms == 0 || profile.width_ms == 0 || profile.width_ms > profile.period_ms)) {
+        return 0;
+    }
+
+    profile.reserved = 0;
+    slots[profile.slot].profile = profile;
+    slots[profile.slot].state = ANALOG_FAULT_SLOT_PENDING;
+    slots[profile.slot].stuck_value = 0;
+
+    return 1;
+}
+
+/**
+ * @brief Start the fault timeline at 0
+ * Faults at 0 apply before this function returns.
+ * @return 1 if successful, 0 if running or a target output plays a waveform
+ */
+uint8_t Analog_Fault_Start(void) {
+    uint8_t loaded = 0;
+
+    if (running) {
+        return 0;
+    }
+
+    // A waveform rewrites its output by DMA, a fault drive would not hold
+    for (uint8_t i = 0; i < ANALOG_FAULT_SLOTS; i++) {
+        if (slots[i].state == ANALOG_FAULT_SLOT_EMPTY) {
+            continue;
+        }
+        if (Waveform_IsDriving(slots[i].profile.light, slots[i].profile.output)) {
+            return 0;
+        }
+        loaded = 1;
+    }
+
+    if (!loaded) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    for (uint8_t i = 0; i < ANALOG_FAULT_SLOTS; i++) {
+        if (slots[i].state != ANALOG_FAULT_SLOT_EMPTY) {
+            slots[i].state = ANALOG_FAULT_SLOT_PENDING;
+        }
+    }
+    elapsed_ms = 0;
+    done_event = 0;
+    running = 1;
+    evaluate();
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    if (running) {
+        TIM4_Tick_Request(TIM4_TICK_FAULT, 1);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Stop the fault timeline, all lines return to healthy
+ */
+void Analog_Fault_Stop(void) {
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    running = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            set_drive(i, output, ANALOG_FAULT_DRIVE_NONE, 0);
+        }
+    }
+    memset(active_types, ANALOG_FAULT_NONE, sizeof(active_types));
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    TIM4_Tick_Request(TIM4_TICK_FAULT, 0);
+}
+
+/**
+ * @brief Check whether a slot of the running timeline targets an output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if targeted, 0 otherwise
+ */
+uint8_t Analog_Fault_IsTargeted(uint8_t light_index, uint8_t output) {
+    if (!running) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < ANALOG_FAULT_SLOTS; i++) {
+        if ((slots[i].state == ANALOG_FAULT_SLOT_PENDING || slots[i].state == ANALOG_FAULT_SLOT_ACTIVE) &&
+            slots[i].profile.light == light_index && slots[i].profile.output == output) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the fault type applied to an output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return ANALOG_FAULT_* of the applied profile, ANALOG_FAULT_NONE if healthy
+ */
+uint8_t Analog_Fault_GetActive(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return ANALOG_FAULT_NONE;
+    }
+
+    return active_types[light_index][output];
+}
+
+/**
+ * @brief Get the fault engine state
+ * @param status Destination for the state
+ */
+void Analog_Fault_GetStatus(AnalogFaultStatus* status) {
+    if (status == NULL) {
+        return;
+    }
+
+    memset(status, 0, sizeof(*status));
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    status->running = running;
+    status->elapsed_ms = elapsed_ms;
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            if (active_types[i][output] != ANALOG_FAULT_NONE) {
+                status->active_mask |= 1 << (i * 2 + output);
+            }
+        }
+    }
+    for (uint8_t i = 0; i < ANALOG_FAULT_SLOTS; i++) {
+        status->slot[i].state = slots[i].state;
+        status->slot[i].type = slots[i].profile.type;
+        status->slot[i].light = slots[i].profile.light;
+        status->slot[i].output = slots[i].profile.output;
+        status->slot[i].start_ms = slots[i].profile.start_ms;
+        status->slot[i].duration_ms = slots[i].profile.duration_ms;
+    }
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+}
+
+/**
+ * @brief Advance the fault timeline by one millisecond
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void Analog_Fault_Tick(TIM_HandleTypeDef *htim) {
+    if (htim->Instance != TIM4 || !running) {
+        return;
+    }
+
+    elapsed_ms++;
+    evaluate();
+}
+
+/**
+ * @brief Send the completion event of a finished timeline
+ * The event value is the elapsed time in milliseconds, saturated to 16 bits.
+ */
+void Analog_Fault_ProcessEvents(void) {
+    if (!done_event) {
+        return;
+    }
+
+    done_event = 0;
+    HIL_SendEvent('S', SIGNAL_FAULT, (elapsed_ms > 0xFFFF) ? 0xFFFF : (uint16_t)elapsed_ms);
+}
@@ -0,0 +1,178 @@
+/**
+ * @file analog_noise.c
+ * @brief Pseudo-random noise on the analog simulation outputs
+ */
+
+#include "analog_noise.h"
+#include "analog_simulation.h"
+#include <math.h>
+#include <string.h>
+
+#define DEFAULT_SEED     0x2545F491u
+#define ALPHA_BITS       24          // Filter coefficient in 8.24 fixed point
+#define STATE_BITS       8           // Filter state in fine steps, 24.8 fixed point
+#define GAUSSIAN_MEAN    510         // Mean of the sum of four uniform bytes
+#define GAUSSIAN_SIGMA   147.80f     // Its standard deviation, sqrt(4 * (256^2 - 1) / 12)
+#define PI               3.14159265f
+
+// Generator and filter of one output
+typedef struct {
+    AnalogNoiseConfig config;
+    uint32_t state;               // xorshift32 state
+    int32_t  scale;               // Source sample to fine steps, 16.16, including the filter gain
+    int32_t  alpha;               // Low-pass coefficient, 0 for white noise
+    int32_t  filtered;            // Low-pass output
+} NoiseChannel;
+
+static NoiseChannel noise[3][2];
+static volatile uint8_t noise_mask = 0;   // Bit (light * 2 + output) per noisy output
+static uint32_t sample_rate = 1;
+
+/**
+ * @brief Derive scale and filter coefficient from the configuration and sample rate
+ * @param channel Channel to update
+ */
+static void update_filter(NoiseChannel* channel) {
+    float alpha = 0.0f;
+    float gain = 1.0f;
+    float unit;
+
+    if (channel->config.bandwidth_hz > 0) {
+        alpha = 1.0f - expf(-2.0f * PI * channel->config.bandwidth_hz / sample_rate);
+
+        // Keep the variance: a first-order low-pass passes alpha / (2 - alpha) of it
+        if (alpha < 0.999f) {
+            gain = sqrtf((2.0f - alpha) / alpha);
+        } else {
+            alpha = 0.0f;
+        }
+    }
+
+    unit = (channel->config.distribution == ANALOG_NOISE_GAUSSIAN) ? GAUSSIAN_SIGMA : 32768.0f;
+
+    channel->alpha = (int32_t)(alpha * (1 << ALPHA_BITS));
+    if (alpha > 0.0f && channel->alpha == 0) {
+        channel->alpha = 1;
+    }
+    channel->scale = (int32_t)(channel->config.amplitude * gain * 65536.0f / unit);
+}
+
+/**
+ * @brief Switch noise off on all outputs
+ * @param sample_rate_hz Sample rate (PWM carrier frequency)
+ */
+void Analog_Noise_Init(uint32_t sample_rate_hz) {
+    noise_mask = 0;
+    memset(noise, 0, sizeof(noise));
+    sample_rate = sample_rate_hz ? sample_rate_hz : 1;
+}
+
+/**
+ * @brief Configure the noise of one output and restart its generator from the seed
+ * @param light_index Light index (0-2)
+ * @param config Noise configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Noise_Configure(uint8_t light_index, const AnalogNoiseConfig* config) {
+    NoiseChannel channel;
+
+    if (light_index > 2 || config == NULL || config->output > ANALOG_OUTPUT_TEMPERATURE ||
+        config->distribution > ANALOG_NOISE_GAUSSIAN || config->amplitude > ANALOG_NOISE_MAX_AMPLITUDE) {
+        return 0;
+    }
+
+    memset(&channel, 0, sizeof(channel));
+    channel.config = *config;
+    channel.config.reserved = 0;
+    channel.state = config->seed ? config->seed : DEFAULT_SEED;
+    update_filter(&channel);
+
+    uint8_t bit = 1 << (light_index * 2 + config->output);
+
+    // The update interrupt draws the samples
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+    noise[light_index][config->output] = channel;
+    if (config->distribution == ANALOG_NOISE_OFF) {
+        noise_mask &= ~bit;
+    } else {
+        noise_mask |= bit;
+    }
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Get the noise configuration of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param config Destination for the configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_Noise_Get(uint8_t light_index, uint8_t output, AnalogNoiseConfig* config) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE || config == NULL) {
+        return 0;
+    }
+
+    *config = noise[light_index][output].config;
+    config->output = output;
+
+    return 1;
+}
+
+/**
+ * @brief Get the outputs with noise
+ * @return Bit (light_index * 2 + output) per noisy output
+ */
+uint8_t Analog_Noise_GetMask(void) {
+    return noise_mask;
+}
+
+/**
+ * @brief Recompute the filters for a new sample rate
+ * @param sample_rate_hz Sample rate (PWM carrier frequency)
+ */
+void Analog_Noise_SetSampleRate(uint32_t sample_rate_hz) {
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+    sample_rate = sample_rate_hz ? sample_rate_hz : 1;
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            update_filter(&noise[i][output]);
+        }
+    }
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+/**
+ * @brief Draw the next noise sample of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return Noise in fine steps
+ */
+int32_t Analog_Noise_Sample(uint8_t light_index, uint8_t output) {
+    NoiseChannel* channel = &noise[light_index][output];
+    uint32_t x = channel->state;
+    int32_t sample;
+    int32_t value;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    channel->state = x;
+
+    if (channel->config.distribution == ANALOG_NOISE_GAUSSIAN) {
+        sample = (int32_t)((x & 0xFF) + ((x >> 8) & 0xFF) + ((x >> 16) & 0xFF) + (x >> 24)) - GAUSSIAN_MEAN;
+    } else {
+        sample = (int32_t)(x >> 16) - 32768;
+    }
+
+    value = (int32_t)(((int64_t)sample * channel->scale) >> 16);
+
+    if (channel->alpha == 0) {
+        return value;
+    }
+
+    channel->filtered += (int32_t)((((int64_t)value * (1 << STATE_BITS) - channel->filtered) * channel->alpha) >>
+                                   ALPHA_BITS);
+    return channel->filtered >> STATE_BITS;
+}
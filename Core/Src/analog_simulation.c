@@ -4,16 +4,115 @@
  */
 
 #include "analog_simulation.h"
+#include "analog_calibration.h"
+#include "analog_dac.h"
+#include "analog_noise.h"
+#include "ntc_emulation.h"
+#include "hil_comm_protocol.h"
+#include "event_loop.h"
+#include <string.h>
 
 // Private constants
-#define CURRENT_MAX_INPUT      330     // 33.0 Amps
-#define TEMPERATURE_MAX_VALUE  330     // 330.0°C in tenths of a degree
-#define CURRENT_MAX_PWM        1023    // 10-bit PWM resolution
+#define CURRENT_MAX_INPUT      ANALOG_CURRENT_FULL_SCALE      // 33.0 Amps
+#define TEMPERATURE_MAX_VALUE  ANALOG_TEMPERATURE_FULL_SCALE  // 330.0°C in tenths of a degree
+#define CURRENT_MAX_PWM        ANALOG_PWM_MAX                 // 10-bit PWM resolution
+
+#define RAMP_FRACTION_BITS     16    // Ramp values are nominal compare values in 16.16 fixed point
+#define FINE_ONE               (1 << ANALOG_FINE_BITS)
+#define TIMER_CLOCK_HZ         84000000    // APB1 timer clock of TIM2 and TIM3
+#define COMMIT_GUARD_CYCLES    64          // Core cycles to release both timers in Analog_CommitStaged
 
 // Store current PWM values
 static uint16_t current_pwm_values[3] = {0, 0, 0};
 static uint16_t temperature_pwm_values[3] = {0, 0, 0};
 
+// Compare registers, indexed [light][output]
+static volatile uint32_t* const compare_registers[3][2] = {
+    {&TIM2->CCR1, &TIM3->CCR1},
+    {&TIM2->CCR3, &TIM3->CCR2},
+    {&TIM2->CCR4, &TIM3->CCR3},
+};
+
+// Requested output values before calibration, in fine steps
+static uint16_t nominal_values[3][2];
+
+// Output values in 1/FINE_ONE compare steps, and the sigma-delta state of dithered outputs
+static volatile uint16_t fine_values[3][2];
+static uint16_t dither_error[3][2];
+static volatile uint8_t dither_mask = 0;   // Bit (light * 2 + output) per dithered output
+
+// Outputs routed to the DAC channel of their output type instead of the PWM
+static volatile uint8_t dac_mask = 0;      // Bit (light * 2 + output) per DAC output
+
+// Output pins, indexed [light][output], switched to input for an open line
+static GPIO_TypeDef* const output_ports[3][2] = {
+    {GPIOA, GPIOC},
+    {GPIOB, GPIOC},
+    {GPIOB, GPIOC},
+};
+static const uint8_t output_pins[3][2] = {
+    {0, 6},
+    {10, 7},
+    {11, 8},
+};
+
+// Fault drive of each output, set by the fault engine
+static uint8_t fault_modes[3][2];          // ANALOG_FAULT_DRIVE_*
+static int32_t fault_values[3][2];         // Forced level or offset in fine steps
+static volatile uint8_t fault_mask = 0;    // Bit (light * 2 + output) per output with a fault drive
+
+// Linear ramp of one output
+typedef struct {
+    volatile uint8_t active;
+    uint8_t  flags;
+    uint16_t target;              // Target in C/T units
+    int32_t  value;               // Present nominal value, 16.16 fixed point
+    int32_t  step;                // Increment per tick, 16.16 fixed point
+    int32_t  end;                 // Target nominal value, 16.16 fixed point
+    volatile uint32_t remaining;  // Ticks left
+} AnalogRamp;
+
+// Values waiting for Analog_CommitStaged, one set per ANALOG_STAGE_*
+static uint16_t staged_fine_values[ANALOG_STAGE_SETS][3][2];
+static uint8_t staged_mask[ANALOG_STAGE_SETS];  // Bit (light * 2 + output) per staged value
+static uint32_t commit_guard = 2;          // Counts before the update in which a commit waits for it
+
+static AnalogRamp ramps[3][2];
+static volatile uint8_t ramp_events = 0;   // Bit (light * 2 + output) per finished ramp to notify
+
+/**
+ * @brief PWM carrier frequency, the rate of the update interrupt
+ * @param prescaler Timer prescaler
+ * @return Carrier frequency in Hz
+ */
+static uint32_t carrier_hz(uint32_t prescaler) {
+    return TIMER_CLOCK_HZ / (prescaler + 1) / (ANALOG_PWM_MAX + 1);
+}
+
+/**
+ * @brief Counts that span at least COMMIT_GUARD_CYCLES at a prescaler
+ * @param prescaler Timer prescaler
+ * @return Counts, at least 2
+ */
+static uint32_t guard_counts(uint32_t prescaler) {
+    uint32_t cycles_per_count = (SystemCoreClock / TIMER_CLOCK_HZ) * (prescaler + 1);
+    uint32_t counts = (COMMIT_GUARD_CYCLES + cycles_per_count - 1) / cycles_per_count;
+
+    return (counts < 2) ? 2 : counts;
+}
+
+/**
+ * @brief Run the update interrupt only while an output dithers or has noise
+ * Call with the TIM2 interrupt disabled.
+ */
+static void update_period_interrupt(void) {
+    if (dither_mask | Analog_Noise_GetMask()) {
+        __HAL_TIM_ENABLE_IT(&htim2, TIM_IT_UPDATE);
+    } else {
+        __HAL_TIM_DISABLE_IT(&htim2, TIM_IT_UPDATE);
+    }
+}
+
 /**
  * @brief Initialize analog simulation components
  */
@@ -24,6 +123,25 @@ void Analog_Simulation_Init(void) {
         temperature_pwm_values[i] = 0;
     }
 
+    memset(ramps, 0, sizeof(ramps));
+    ramp_events = 0;
+    memset(staged_mask, 0, sizeof(staged_mask));
+
+    Analog_Calibration_Init();
+    NTC_Emulation_Init();
+    Analog_DAC_Init();
+    dac_mask = 0;
+    Analog_Noise_Init(carrier_hz(htim2.Init.Prescaler));
+    commit_guard = guard_counts(htim2.Init.Prescaler);
+    fault_mask = 0;
+    memset(fault_modes, 0, sizeof(fault_modes));
+
+    Analog_SetDither(0, 0);
+    Analog_SetDither(1, 0);
+    Analog_SetDither(2, 0);
+    memset((void*)fine_values, 0, sizeof(fine_values));
+    memset(nominal_values, 0, sizeof(nominal_values));
+
     // Set initial PWM values to 0
     __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, 0); // Light 1 Current
     __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_3, 0); // Light 2 Current
@@ -47,6 +165,13 @@ void Analog_Simulation_Start(void) {
     HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_1); // Light 1 Temperature
     HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_2); // Light 2 Temperature
     HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_3); // Light 3 Temperature
+
+    // Start the DAC channels that have an output routed to them
+    for (uint8_t output = 0; output < ANALOG_DAC_CHANNELS; output++) {
+        if (dac_mask & (0x15 << output)) {
+            Analog_DAC_Enable(output, 1);
+        }
+    }
 }
 
 /**
@@ -62,6 +187,140 @@ void Analog_Simulation_Stop(void) {
     HAL_TIM_PWM_Stop(&htim3, TIM_CHANNEL_1); // Light 1 Temperature
     HAL_TIM_PWM_Stop(&htim3, TIM_CHANNEL_2); // Light 2 Temperature
     HAL_TIM_PWM_Stop(&htim3, TIM_CHANNEL_3); // Light 3 Temperature
+
+    // Stop the DAC channels
+    Analog_DAC_Enable(ANALOG_OUTPUT_CURRENT, 0);
+    Analog_DAC_Enable(ANALOG_OUTPUT_TEMPERATURE, 0);
+}
+
+/**
+ * @brief Convert fine compare steps to a DAC code
+ * @param fine_value Compare value in fine steps (0-ANALOG_FINE_MAX)
+ * @return DAC code (0-ANALOG_DAC_MAX)
+ */
+static uint16_t fine_to_dac(uint16_t fine_value) {
+    return ((uint32_t)fine_value * ANALOG_DAC_MAX + ANALOG_FINE_MAX / 2) / ANALOG_FINE_MAX;
+}
+
+/**
+ * @brief Apply the fault drive of an output to its value
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param fine_value Healthy value in fine steps
+ * @return Value on the faulty line in fine steps (0-ANALOG_FINE_MAX)
+ */
+static uint16_t apply_fault(uint8_t light_index, uint8_t output, int32_t fine_value) {
+    switch (fault_modes[light_index][output]) {
+        case ANALOG_FAULT_DRIVE_FORCE:
+            fine_value = fault_values[light_index][output];
+            break;
+
+        case ANALOG_FAULT_DRIVE_OFFSET:
+            fine_value += fault_values[light_index][output];
+            break;
+
+        default:
+            break;
+    }
+
+    if (fine_value < 0) {
+        return 0;
+    }
+    if (fine_value > ANALOG_FINE_MAX) {
+        return ANALOG_FINE_MAX;
+    }
+    return (uint16_t)fine_value;
+}
+
+/**
+ * @brief Disconnect or reconnect the line of an output
+ * A PWM pin switches between input (high impedance) and its timer
+ * function, a DAC channel between disabled and enabled.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param open 1 to disconnect, 0 to reconnect
+ */
+static void set_line_open(uint8_t light_index, uint8_t output, uint8_t open) {
+    GPIO_TypeDef* port = output_ports[light_index][output];
+    uint32_t shift = output_pins[light_index][output] * 2;
+
+    if (dac_mask & (1 << (light_index * 2 + output))) {
+        Analog_DAC_Enable(output, !open);
+        return;
+    }
+
+    // MODER: 00 input, 10 alternate function
+    port->MODER = (port->MODER & ~(3UL << shift)) | ((open ? 0UL : 2UL) << shift);
+}
+
+/**
+ * @brief Write one output in fine compare steps
+ * The compare register gets the rounded value at once; on a dithered output
+ * the update interrupt then spreads the fraction over the following periods.
+ * A DAC output gets the value at 12-bit resolution instead.
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param fine_value Compare value in fine steps (0-ANALOG_FINE_MAX)
+ */
+static void write_output(uint8_t light_index, uint8_t output, uint16_t fine_value) {
+    uint16_t pwm_value = (fine_value + FINE_ONE / 2) >> ANALOG_FINE_BITS;
+    uint8_t bit = 1 << (light_index * 2 + output);
+    uint32_t primask;
+
+    // Store PWM value
+    if (output == ANALOG_OUTPUT_CURRENT) {
+        current_pwm_values[light_index] = pwm_value;
+    } else {
+        temperature_pwm_values[light_index] = pwm_value;
+    }
+
+    // The fault tick rewrites the line from fine_values; masked so it cannot
+    // land between the fault test and the store and be overwritten by a
+    // healthy value
+    primask = __get_PRIMASK();
+    __disable_irq();
+    fine_values[light_index][output] = fine_value;
+
+    // A fault drive replaces the setpoint on the line, readback keeps the setpoint
+    if (fault_mask & bit) {
+        fine_value = apply_fault(light_index, output, fine_value);
+        pwm_value = (fine_value + FINE_ONE / 2) >> ANALOG_FINE_BITS;
+    }
+
+    if (dac_mask & bit) {
+        Analog_DAC_Write(output, fine_to_dac(fine_value));
+    } else {
+        *compare_registers[light_index][output] = pwm_value;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Write one output from a nominal value through its sensor model and calibration table
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param nominal Nominal value in fine steps (0-ANALOG_FINE_MAX)
+ */
+static void write_nominal(uint8_t light_index, uint8_t output, uint16_t nominal) {
+    uint16_t level = nominal;
+
+    nominal_values[light_index][output] = nominal;
+
+    if (output == ANALOG_OUTPUT_TEMPERATURE) {
+        level = NTC_Emulation_Apply(light_index, nominal);
+    }
+
+    write_output(light_index, output, Analog_Calibration_Apply(light_index, output, level));
+}
+
+/**
+ * @brief Scale an input value to fine compare steps
+ * @param value Input value (0-full_scale)
+ * @param full_scale Input value at ANALOG_FINE_MAX
+ * @return Compare value in fine steps
+ */
+static uint16_t scale_to_fine(uint16_t value, uint32_t full_scale) {
+    return ((uint32_t)value * ANALOG_FINE_MAX) / full_scale;
 }
 
 /**
@@ -76,23 +335,28 @@ uint8_t Analog_SetCurrentSimulation(uint8_t light_index, uint16_t input_value) {
         return 0;
     }
 
-    // Scale input to PWM range
+    // Scale input to PWM range, in fine steps so dithered outputs keep the extra resolution
     // Example: 330 (33.0A) → 1023, 165 (16.5A) → 512
-    uint32_t pwm_value = (input_value * CURRENT_MAX_PWM) / (CURRENT_MAX_INPUT);
+    write_nominal(light_index, ANALOG_OUTPUT_CURRENT, scale_to_fine(input_value, CURRENT_MAX_INPUT));
 
-    // Set PWM for specific channel
-    switch (light_index) {
-        case 0: // Light 1
-            __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, pwm_value);
-            break;
-        case 1: // Light 2
-            __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_3, pwm_value);
-            break;
-        case 2: // Light 3
-            __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, pwm_value);
-            break;
+    return 1;
+}
+
+/**
+ * @brief Set the current output compare value of a specific light directly
+ * @param light_index Light index (0-2)
+ * @param pwm_value PWM compare value (0-1023)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetCurrentPWM(uint8_t light_index, uint16_t pwm_value) {
+    if (light_index > 2 || pwm_value > CURRENT_MAX_PWM) {
+        return 0;
     }
 
+    // Raw compare values bypass calibration
+    nominal_values[light_index][ANALOG_OUTPUT_CURRENT] = pwm_value << ANALOG_FINE_BITS;
+    write_output(light_index, ANALOG_OUTPUT_CURRENT, pwm_value << ANALOG_FINE_BITS);
+
     return 1;
 }
 
@@ -121,31 +385,28 @@ uint8_t Analog_SetTemperatureSimulation(uint8_t light_index, uint16_t temperatur
         return 0;
     }
 
-    // Scale temperature value to PWM value (0-1023)
+    // Scale temperature value to PWM value (0-1023), in fine steps
     // 0°C = 0, 330.0°C = 1023
-    uint32_t pwm_value = (temperature_value * CURRENT_MAX_PWM) / TEMPERATURE_MAX_VALUE;
+    write_nominal(light_index, ANALOG_OUTPUT_TEMPERATURE, scale_to_fine(temperature_value, TEMPERATURE_MAX_VALUE));
 
-    // Store PWM value
-    temperature_pwm_values[light_index] = pwm_value;
-
-    // Set PWM value for the corresponding timer channel
-    switch (light_index) {
-        case 0: // Light 1
-            __HAL_TIM_SET_COMPARE(&htim3, TIM_CHANNEL_1, pwm_value);
-            break;
-
-        case 1: // Light 2
-            __HAL_TIM_SET_COMPARE(&htim3, TIM_CHANNEL_2, pwm_value);
-            break;
-
-        case 2: // Light 3
-            __HAL_TIM_SET_COMPARE(&htim3, TIM_CHANNEL_3, pwm_value);
-            break;
+    return 1;
+}
 
-        default:
-            return 0;
+/**
+ * @brief Set the temperature output compare value of a specific light directly
+ * @param light_index Light index (0-2)
+ * @param pwm_value PWM compare value (0-1023)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetTemperaturePWM(uint8_t light_index, uint16_t pwm_value) {
+    if (light_index > 2 || pwm_value > CURRENT_MAX_PWM) {
+        return 0;
     }
 
+    // Raw compare values bypass calibration
+    nominal_values[light_index][ANALOG_OUTPUT_TEMPERATURE] = pwm_value << ANALOG_FINE_BITS;
+    write_output(light_index, ANALOG_OUTPUT_TEMPERATURE, pwm_value << ANALOG_FINE_BITS);
+
     return 1;
 }
 
@@ -161,3 +422,724 @@ uint16_t Analog_GetTemperaturePWM(uint8_t light_index) {
 
     return temperature_pwm_values[light_index];
 }
+
+/**
+ * @brief Set one output in fine compare steps
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param fine_value Nominal value in fine steps (0-ANALOG_FINE_MAX), calibrated on the way out
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetOutputFine(uint8_t light_index, uint8_t output, uint16_t fine_value) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE || fine_value > ANALOG_FINE_MAX) {
+        return 0;
+    }
+
+    write_nominal(light_index, output, fine_value);
+
+    return 1;
+}
+
+/**
+ * @brief Rewrite one output from its last nominal value
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_RefreshOutput(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    write_nominal(light_index, output, nominal_values[light_index][output]);
+
+    return 1;
+}
+
+/**
+ * @brief Set one output directly in the code of its backend
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param code Compare value (0-1023), or DAC code (0-4095) on a DAC output
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetOutputCode(uint8_t light_index, uint8_t output, uint16_t code) {
+    uint16_t fine_value;
+
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE || code > Analog_GetOutputMax(light_index, output)) {
+        return 0;
+    }
+
+    if (Analog_IsOnDAC(light_index, output)) {
+        // Exact round trip: the fine value maps back to the same DAC code
+        fine_value = ((uint32_t)code * ANALOG_FINE_MAX + ANALOG_DAC_MAX / 2) / ANALOG_DAC_MAX;
+    } else {
+        fine_value = code << ANALOG_FINE_BITS;
+    }
+
+    // Raw codes bypass calibration, as Analog_SetCurrentPWM / Analog_SetTemperaturePWM
+    nominal_values[light_index][output] = fine_value;
+    write_output(light_index, output, fine_value);
+
+    return 1;
+}
+
+/**
+ * @brief Get the largest code of an output's backend
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return ANALOG_DAC_MAX on a DAC output, ANALOG_PWM_MAX otherwise
+ */
+uint16_t Analog_GetOutputMax(uint8_t light_index, uint8_t output) {
+    return Analog_IsOnDAC(light_index, output) ? ANALOG_DAC_MAX : ANALOG_PWM_MAX;
+}
+
+/**
+ * @brief Get the register that sets an analog output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return Pointer to the CCR register, or the DAC holding register on a DAC output, NULL if invalid
+ */
+volatile uint32_t* Analog_GetCompareRegister(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return NULL;
+    }
+
+    if (Analog_IsOnDAC(light_index, output)) {
+        return Analog_DAC_GetRegister(output);
+    }
+    return compare_registers[light_index][output];
+}
+
+/**
+ * @brief Route the outputs of a light to the DAC or back to the PWM
+ * @param light_index Light index (0-2)
+ * @param mask Bit (1 << ANALOG_OUTPUT_*) per output to drive from the DAC
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetBackend(uint8_t light_index, uint8_t mask) {
+    if (light_index > 2 || mask > 3) {
+        return 0;
+    }
+
+    uint8_t shift = light_index * 2;
+    uint8_t others = dac_mask & ~(3 << shift);
+
+    for (uint8_t output = 0; output < 2; output++) {
+        if (!(mask & (1 << output))) {
+            continue;
+        }
+
+        // One DAC channel per output type, and the DAC needs no dither
+        if ((others & (0x15 << output)) || Analog_IsDithered(light_index, output) ||
+            (fault_mask & (1 << (shift + output)))) {
+            return 0;
+        }
+    }
+
+    // Ramps and the plant model write the outputs from the TIM4 tick
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    uint8_t previous = (dac_mask >> shift) & 3;
+    dac_mask = others | (mask << shift);
+
+    for (uint8_t output = 0; output < 2; output++) {
+        uint8_t bit = 1 << output;
+
+        if (mask & bit) {
+            // Park the unused PWM output low and move the present value to the DAC
+            *compare_registers[light_index][output] = 0;
+            write_output(light_index, output, fine_values[light_index][output]);
+            Analog_DAC_Enable(output, 1);
+        } else if (previous & bit) {
+            Analog_DAC_Enable(output, 0);
+            Analog_DAC_Write(output, 0);
+            write_output(light_index, output, fine_values[light_index][output]);
+        }
+    }
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Get the outputs of a light that are driven from the DAC
+ * @param light_index Light index (0-2)
+ * @return Bit (1 << ANALOG_OUTPUT_*) per DAC output
+ */
+uint8_t Analog_GetBackend(uint8_t light_index) {
+    if (light_index > 2) {
+        return 0;
+    }
+
+    return (dac_mask >> (light_index * 2)) & 3;
+}
+
+/**
+ * @brief Check whether an output is driven from the DAC
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if on the DAC, 0 otherwise
+ */
+uint8_t Analog_IsOnDAC(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    return (dac_mask >> (light_index * 2 + output)) & 1;
+}
+
+/**
+ * @brief Set the fault drive of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param mode ANALOG_FAULT_DRIVE_*
+ * @param value Forced level or offset in fine steps
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetFaultDrive(uint8_t light_index, uint8_t output, uint8_t mode, int32_t value) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE || mode > ANALOG_FAULT_DRIVE_OPEN) {
+        return 0;
+    }
+
+    uint8_t bit = 1 << (light_index * 2 + output);
+    uint8_t was_open = (fault_mask & bit) && fault_modes[light_index][output] == ANALOG_FAULT_DRIVE_OPEN;
+    uint32_t primask;
+
+    // The update interrupt applies the drive to dithered and noisy outputs.
+    // This runs in the TIM4 tick too, so mask briefly instead of enabling
+    // TIM2 inside a main loop section that holds it disabled
+    primask = __get_PRIMASK();
+    __disable_irq();
+    fault_modes[light_index][output] = mode;
+    fault_values[light_index][output] = value;
+    if (mode == ANALOG_FAULT_DRIVE_NONE) {
+        fault_mask &= ~bit;
+    } else {
+        fault_mask |= bit;
+    }
+    __set_PRIMASK(primask);
+
+    if (was_open != (mode == ANALOG_FAULT_DRIVE_OPEN)) {
+        set_line_open(light_index, output, mode == ANALOG_FAULT_DRIVE_OPEN);
+    }
+
+    write_output(light_index, output, fine_values[light_index][output]);
+
+    return 1;
+}
+
+/**
+ * @brief Get the present setpoint of one output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return Value in fine steps, without noise and fault drive
+ */
+uint16_t Analog_GetOutputFine(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    return fine_values[light_index][output];
+}
+
+/**
+ * @brief Enable sigma-delta dithering on the outputs of a light
+ * @param light_index Light index (0-2)
+ * @param mask Bit (1 << ANALOG_OUTPUT_*) per output to dither
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetDither(uint8_t light_index, uint8_t mask) {
+    uint8_t shift = light_index * 2;
+
+    // DAC outputs have the full resolution without dither
+    if (light_index > 2 || mask > 3 || (mask & (dac_mask >> shift))) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+    dither_error[light_index][0] = 0;
+    dither_error[light_index][1] = 0;
+    dither_mask = (dither_mask & ~(3 << shift)) | (mask << shift);
+    update_period_interrupt();
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+
+    // Outputs leaving dither mode settle on the rounded value
+    for (uint8_t output = 0; output < 2; output++) {
+        if (!(mask & (1 << output)) && !Analog_HasNoise(light_index, output)) {
+            write_output(light_index, output, fine_values[light_index][output]);
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Get the dithered outputs of a light
+ * @param light_index Light index (0-2)
+ * @return Bit (1 << ANALOG_OUTPUT_*) per dithered output
+ */
+uint8_t Analog_GetDither(uint8_t light_index) {
+    if (light_index > 2) {
+        return 0;
+    }
+
+    return (dither_mask >> (light_index * 2)) & 3;
+}
+
+/**
+ * @brief Check whether an output is dithered
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if dithered, 0 otherwise
+ */
+uint8_t Analog_IsDithered(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    return (dither_mask >> (light_index * 2 + output)) & 1;
+}
+
+/**
+ * @brief Set the PWM carrier prescaler of all analog outputs
+ * @param prescaler Timer prescaler (0-ANALOG_CARRIER_PRESCALER_MAX)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetCarrier(uint8_t prescaler) {
+    if (prescaler > ANALOG_CARRIER_PRESCALER_MAX) {
+        return 0;
+    }
+
+    // The old prescaler counts until the update event, so the commit guard
+    // covers the faster of both
+    commit_guard = guard_counts((htim2.Instance->PSC < prescaler) ? htim2.Instance->PSC : prescaler);
+
+    // Both prescalers are preloaded and switch on the common update event
+    __HAL_TIM_SET_PRESCALER(&htim2, prescaler);
+    __HAL_TIM_SET_PRESCALER(&htim3, prescaler);
+
+    // Noise is sampled at the carrier rate
+    Analog_Noise_SetSampleRate(carrier_hz(prescaler));
+
+    return 1;
+}
+
+/**
+ * @brief Configure the noise of one output from an upload payload
+ * @param light_index Light index (0-2)
+ * @param payload AnalogNoiseConfig structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_SetNoise(uint8_t light_index, const uint8_t* payload, uint16_t length) {
+    AnalogNoiseConfig config;
+
+    if (payload == NULL || length != sizeof(config)) {
+        return 0;
+    }
+
+    memcpy(&config, payload, sizeof(config));
+
+    if (!Analog_Noise_Configure(light_index, &config)) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM2_IRQn);
+    update_period_interrupt();
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+
+    // An output without noise settles on its setpoint
+    if (config.distribution == ANALOG_NOISE_OFF && !Analog_IsDithered(light_index, config.output)) {
+        write_output(light_index, config.output, fine_values[light_index][config.output]);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Switch the noise of one output off
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_ClearNoise(uint8_t light_index, uint8_t output) {
+    AnalogNoiseConfig config = {0};
+
+    config.output = output;
+    config.distribution = ANALOG_NOISE_OFF;
+
+    return Analog_SetNoise(light_index, (const uint8_t*)&config, sizeof(config));
+}
+
+/**
+ * @brief Check whether an output has noise
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if noisy, 0 otherwise
+ */
+uint8_t Analog_HasNoise(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    return (Analog_Noise_GetMask() >> (light_index * 2 + output)) & 1;
+}
+
+/**
+ * @brief Get the PWM carrier prescaler of the analog outputs
+ * @return Timer prescaler
+ */
+uint8_t Analog_GetCarrier(void) {
+    return htim2.Instance->PSC;
+}
+
+/**
+ * @brief Per-period update of all dithered and noisy outputs
+ * Noisy outputs get their next noise sample added to the fine value,
+ * then the fault drive of the output applies. Dithered outputs then get the integer compare value plus one step
+ * whenever the accumulated fraction overflows, so the average over
+ * FINE_ONE periods equals the fine value. Compare values are preloaded
+ * and apply from the next period on TIM2 and its slave TIM3 alike.
+ */
+void Analog_UpdateIRQHandler(void) {
+    uint8_t dither;
+    uint8_t noisy;
+
+    htim2.Instance->SR = ~TIM_SR_UIF;
+    dither = dither_mask;
+    noisy = Analog_Noise_GetMask();
+
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            uint8_t bit = 1 << (i * 2 + output);
+            int32_t fine_value;
+            uint16_t pwm_value;
+
+            if (!((dither | noisy) & bit)) {
+                continue;
+            }
+
+            fine_value = fine_values[i][output];
+
+            if (noisy & bit) {
+                fine_value += Analog_Noise_Sample(i, output);
+                if (fine_value < 0) {
+                    fine_value = 0;
+                } else if (fine_value > ANALOG_FINE_MAX) {
+                    fine_value = ANALOG_FINE_MAX;
+                }
+            }
+
+            if (fault_mask & bit) {
+                fine_value = apply_fault(i, output, fine_value);
+            }
+
+            if (dac_mask & bit) {
+                Analog_DAC_Write(output, fine_to_dac(fine_value));
+                continue;
+            }
+
+            if (dither & bit) {
+                uint16_t error = dither_error[i][output] + (fine_value & (FINE_ONE - 1));
+
+                pwm_value = fine_value >> ANALOG_FINE_BITS;
+                if (error >= FINE_ONE) {
+                    error -= FINE_ONE;
+                    pwm_value++;
+                }
+                dither_error[i][output] = error;
+            } else {
+                pwm_value = (fine_value + FINE_ONE / 2) >> ANALOG_FINE_BITS;
+            }
+
+            *compare_registers[i][output] = pwm_value;
+        }
+    }
+}
+
+/**
+ * @brief Stage a new value for one output without applying it
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @param value Value in the units of Analog_SetCurrentSimulation / Analog_SetTemperatureSimulation
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_StageSimulation(uint8_t set, uint8_t light_index, uint8_t output, uint16_t value) {
+    uint32_t full_scale = (output == ANALOG_OUTPUT_CURRENT) ? CURRENT_MAX_INPUT : TEMPERATURE_MAX_VALUE;
+
+    if (set >= ANALOG_STAGE_SETS || light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE || value > full_scale) {
+        return 0;
+    }
+
+    staged_fine_values[set][light_index][output] = scale_to_fine(value, full_scale);
+    staged_mask[set] |= 1 << (light_index * 2 + output);
+
+    return 1;
+}
+
+/**
+ * @brief Get the outputs with a staged value
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ * @return Bit (light_index * 2 + output) per staged output
+ */
+uint8_t Analog_GetStagedMask(uint8_t set) {
+    return (set < ANALOG_STAGE_SETS) ? staged_mask[set] : 0;
+}
+
+/**
+ * @brief Apply all staged values of one set in the same PWM period
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ */
+void Analog_CommitStaged(uint8_t set) {
+    uint32_t primask;
+
+    if (set >= ANALOG_STAGE_SETS || staged_mask[set] == 0) {
+        return;
+    }
+
+    // Hold the preload transfer on both timers while the compare registers are written
+    htim2.Instance->CR1 |= TIM_CR1_UDIS;
+    htim3.Instance->CR1 |= TIM_CR1_UDIS;
+
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            if (staged_mask[set] & (1 << (i * 2 + output))) {
+                write_nominal(i, output, staged_fine_values[set][i][output]);
+            }
+        }
+    }
+    staged_mask[set] = 0;
+
+    // Release both timers at least COMMIT_GUARD_CYCLES before the next common
+    // update, so it does not fall between them at any carrier prescaler
+    primask = __get_PRIMASK();
+    __disable_irq();
+    while (htim2.Instance->CNT >= htim2.Instance->ARR - commit_guard) {
+    }
+    htim2.Instance->CR1 &= ~TIM_CR1_UDIS;
+    htim3.Instance->CR1 &= ~TIM_CR1_UDIS;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Drop all staged values of one set
+ * @param set ANALOG_STAGE_HOST or ANALOG_STAGE_SEQUENCER
+ */
+void Analog_DiscardStaged(uint8_t set) {
+    if (set < ANALOG_STAGE_SETS) {
+        staged_mask[set] = 0;
+    }
+}
+
+/**
+ * @brief Release the ramp tick once no ramp is active
+ */
+static void update_ramp_tick(void) {
+    for (uint8_t i = 0; i < 3; i++) {
+        if (ramps[i][0].active || ramps[i][1].active) {
+            TIM4_Tick_Request(TIM4_TICK_RAMP, 1);
+            return;
+        }
+    }
+
+    TIM4_Tick_Request(TIM4_TICK_RAMP, 0);
+}
+
+/**
+ * @brief Start a linear ramp of one output from its present value
+ * @param light_index Light index (0-2)
+ * @param payload AnalogRampCommand structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_StartRamp(uint8_t light_index, const uint8_t* payload, uint16_t length) {
+    AnalogRampCommand cmd;
+
+    if (light_index > 2 || payload == NULL || length != sizeof(AnalogRampCommand)) {
+        return 0;
+    }
+
+    memcpy(&cmd, payload, sizeof(cmd));
+
+    uint32_t full_scale = (cmd.output == ANALOG_OUTPUT_CURRENT) ? CURRENT_MAX_INPUT : TEMPERATURE_MAX_VALUE;
+
+    if (cmd.output > ANALOG_OUTPUT_TEMPERATURE ||
+        (cmd.flags & ~(ANALOG_RAMP_FLAG_SLOPE | ANALOG_RAMP_FLAG_NOTIFY)) ||
+        cmd.target > full_scale || ((cmd.flags & ANALOG_RAMP_FLAG_SLOPE) && cmd.time == 0)) {
+        return 0;
+    }
+
+    AnalogRamp* ramp = &ramps[light_index][cmd.output];
+    int32_t end = (int32_t)scale_to_fine(cmd.target, full_scale) << (RAMP_FRACTION_BITS - ANALOG_FINE_BITS);
+    uint64_t ticks;
+
+    // The tick must not step a half-updated ramp
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+
+    int32_t start = ramp->active ? ramp->value :
+                    (int32_t)nominal_values[light_index][cmd.output] << (RAMP_FRACTION_BITS - ANALOG_FINE_BITS);
+    uint32_t distance = (end > start) ? (uint32_t)(end - start) : (uint32_t)(start - end);
+
+    if (cmd.flags & ANALOG_RAMP_FLAG_SLOPE) {
+        // Slope in 0.001 units/s as a compare step per tick, the last step lands exactly
+        uint64_t rate = ((uint64_t)cmd.time * CURRENT_MAX_PWM << RAMP_FRACTION_BITS) /
+                        ((uint64_t)full_scale * 1000 * ANALOG_RAMP_TICK_HZ);
+        if (rate == 0) {
+            rate = 1;
+        }
+        ticks = (distance + rate - 1) / rate;
+    } else {
+        ticks = ((uint64_t)cmd.time * ANALOG_RAMP_TICK_HZ) / 1000;
+    }
+
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    if (ticks > UINT32_MAX) {
+        ticks = UINT32_MAX;
+    }
+
+    ramp->flags = cmd.flags;
+    ramp->target = cmd.target;
+    ramp->value = start;
+    ramp->end = end;
+    ramp->step = (int32_t)(((int64_t)end - start) / (int64_t)ticks);
+    ramp->remaining = (uint32_t)ticks;
+    ramp->active = 1;
+    ramp_events &= ~(1 << (light_index * 2 + cmd.output));
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    update_ramp_tick();
+
+    return 1;
+}
+
+/**
+ * @brief Stop the ramp of one output, holding its present value
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_StopRamp(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    ramps[light_index][output].active = 0;
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    update_ramp_tick();
+
+    return 1;
+}
+
+/**
+ * @brief Check whether an output is ramping
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if ramping, 0 otherwise
+ */
+uint8_t Analog_IsRamping(uint8_t light_index, uint8_t output) {
+    if (light_index > 2 || output > ANALOG_OUTPUT_TEMPERATURE) {
+        return 0;
+    }
+
+    return ramps[light_index][output].active;
+}
+
+/**
+ * @brief Get the ramp state of both outputs of a light
+ * @param light_index Light index (0-2)
+ * @param status Destination array indexed by ANALOG_OUTPUT_*
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Analog_GetRampStatus(uint8_t light_index, AnalogRampStatus* status) {
+    if (light_index > 2 || status == NULL) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    for (uint8_t output = 0; output < 2; output++) {
+        const AnalogRamp* ramp = &ramps[light_index][output];
+
+        status[output].active = ramp->active;
+        status[output].flags = ramp->flags;
+        status[output].target = ramp->target;
+        status[output].pwm_value = (output == ANALOG_OUTPUT_CURRENT) ? current_pwm_values[light_index] :
+                                   temperature_pwm_values[light_index];
+        status[output].reserved = 0;
+        status[output].remaining_ms = ramp->active ?
+            (uint32_t)(((uint64_t)ramp->remaining * 1000) / ANALOG_RAMP_TICK_HZ) : 0;
+    }
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Advance all active ramps by one step
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void Analog_RampTick(TIM_HandleTypeDef *htim) {
+    uint8_t finished = 0;
+
+    if (htim->Instance != TIM4) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            AnalogRamp* ramp = &ramps[i][output];
+
+            if (!ramp->active) {
+                continue;
+            }
+
+            if (--ramp->remaining == 0) {
+                // Land exactly on the target, free of accumulated rounding
+                ramp->value = ramp->end;
+                ramp->active = 0;
+                finished = 1;
+                if (ramp->flags & ANALOG_RAMP_FLAG_NOTIFY) {
+                    ramp_events |= 1 << (i * 2 + output);
+                    Event_Loop_Signal(EVENT_LOOP_RAMP);
+                }
+            } else {
+                ramp->value += ramp->step;
+            }
+
+            write_nominal(i, output, (uint16_t)((ramp->value + (1 << (RAMP_FRACTION_BITS - ANALOG_FINE_BITS - 1))) >>
+                                               (RAMP_FRACTION_BITS - ANALOG_FINE_BITS)));
+        }
+    }
+
+    if (finished) {
+        update_ramp_tick();
+    }
+}
+
+/**
+ * @brief Send the completion events of finished ramps
+ */
+void Analog_ProcessRampEvents(void) {
+    uint8_t events;
+
+    if (ramp_events == 0) {
+        return;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    events = ramp_events;
+    ramp_events = 0;
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t output = 0; output < 2; output++) {
+            if (events & (1 << (i * 2 + output))) {
+                HIL_SendEvent('1' + i, SIGNAL_RAMP, output);
+            }
+        }
+    }
+}
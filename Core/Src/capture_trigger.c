@@ -0,0 +1,239 @@
+/**
+ * @file capture_trigger.c
+ * @brief Triggered PWM capture with pre/post-trigger window
+ */
+
+#include "capture_trigger.h"
+#include "pwm_history.h"
+#include "pwm_capture.h"
+#include <string.h>
+
+#define DUTY_TRIGGER_SCALER 10000   // Duty cycle compared in 0.01 % units
+
+static struct {
+    volatile uint8_t state;       // TriggerState
+    uint8_t  light;
+    uint8_t  has_config;
+    TriggerConfig config;
+    uint16_t size;                // pre_count + 1 + post_count
+    uint16_t head;                // Next slot to write
+    uint16_t count;               // Valid entries
+    uint16_t remaining;           // Post-trigger cycles still to record
+    uint16_t trigger_pos;         // Slot of the triggering cycle
+    uint8_t  primed;              // A previous cycle is available for comparison
+    uint16_t last_duty;
+    uint16_t last_period;
+    volatile uint8_t command_fired;
+} trigger;
+
+static PWMHistoryEntry window[TRIGGER_BUFFER_DEPTH];
+
+/**
+ * @brief Restart recording with the current configuration
+ * Must not run concurrently with the capture interrupt.
+ */
+static void restart(void) {
+    trigger.size = trigger.config.pre_count + 1 + trigger.config.post_count;
+    trigger.head = 0;
+    trigger.count = 0;
+    trigger.remaining = 0;
+    trigger.trigger_pos = 0;
+    trigger.primed = 0;
+    trigger.command_fired = 0;
+    trigger.state = TRIGGER_STATE_ARMED;
+}
+
+/**
+ * @brief Evaluate the armed condition against the newest cycle
+ * @param duty Duty cycle in 0.01 % units
+ * @param period Period in timer ticks
+ * @return 1 if the trigger fires, 0 otherwise
+ */
+static uint8_t condition_met(uint16_t duty, uint16_t period) {
+    uint16_t threshold = trigger.config.threshold;
+
+    switch (trigger.config.condition) {
+        case TRIGGER_DUTY_ABOVE:
+            return trigger.primed && trigger.last_duty < threshold && duty >= threshold;
+
+        case TRIGGER_DUTY_BELOW:
+            return trigger.primed && trigger.last_duty > threshold && duty <= threshold;
+
+        case TRIGGER_PERIOD_CHANGE:
+            {
+                uint32_t change = (period > trigger.last_period) ?
+                                  (period - trigger.last_period) : (trigger.last_period - period);
+                return trigger.primed &&
+                       change * DUTY_TRIGGER_SCALER > (uint32_t)threshold * trigger.last_period;
+            }
+
+        case TRIGGER_SET_COMMAND:
+            return trigger.command_fired;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Reset the trigger engine to idle
+ */
+void Capture_Trigger_Init(void) {
+    trigger.state = TRIGGER_STATE_IDLE;
+    trigger.has_config = 0;
+    trigger.light = 0;
+}
+
+/**
+ * @brief Configure and arm the trigger on one light
+ * @param light_index Light index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param config Trigger configuration
+ * @param length Size of the configuration in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Capture_Trigger_Configure(uint8_t light_index, const void* config, uint16_t length) {
+    TriggerConfig new_config;
+
+    if (light_index >= PWM_CAPTURE_CHANNELS || config == NULL || length != sizeof(TriggerConfig)) {
+        return 0;
+    }
+
+    memcpy(&new_config, config, sizeof(new_config));
+
+    if (new_config.condition < TRIGGER_DUTY_ABOVE || new_config.condition > TRIGGER_SET_COMMAND ||
+        (uint32_t)new_config.pre_count + 1 + new_config.post_count > TRIGGER_BUFFER_DEPTH) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+    trigger.config = new_config;
+    trigger.light = light_index;
+    trigger.has_config = 1;
+    restart();
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Re-arm the last configuration or disarm the trigger
+ * @param light_index Light index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param arm 1 to re-arm, 0 to disarm
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Capture_Trigger_Arm(uint8_t light_index, uint8_t arm) {
+    if (light_index >= PWM_CAPTURE_CHANNELS || arm > 1) {
+        return 0;
+    }
+
+    if (!arm) {
+        trigger.state = TRIGGER_STATE_IDLE;
+        return 1;
+    }
+
+    if (!trigger.has_config) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+    trigger.light = light_index;
+    restart();
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Record one completed capture
+ * This function is called from the TIM1 input capture interrupt
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param pulse_width Pulse width in timer ticks
+ * @param period Period in timer ticks
+ */
+void Capture_Trigger_AddSample(uint8_t channel, uint16_t pulse_width, uint16_t period) {
+    uint8_t state = trigger.state;
+
+    if ((state != TRIGGER_STATE_ARMED && state != TRIGGER_STATE_TRIGGERED) ||
+        channel != trigger.light || period == 0) {
+        return;
+    }
+
+    uint32_t duty = ((uint32_t)pulse_width * DUTY_TRIGGER_SCALER) / period;
+    if (duty > DUTY_TRIGGER_SCALER) {
+        duty = DUTY_TRIGGER_SCALER;
+    }
+
+    uint16_t slot = trigger.head;
+    window[slot].period = period;
+    window[slot].pulse_width = pulse_width;
+    trigger.head = (slot + 1) % trigger.size;
+    if (trigger.count < trigger.size) {
+        trigger.count++;
+    }
+
+    if (state == TRIGGER_STATE_ARMED) {
+        if (condition_met((uint16_t)duty, period)) {
+            trigger.trigger_pos = slot;
+            trigger.remaining = trigger.config.post_count;
+            trigger.state = (trigger.remaining == 0) ? TRIGGER_STATE_DONE : TRIGGER_STATE_TRIGGERED;
+        }
+    } else if (--trigger.remaining == 0) {
+        // Post-trigger window complete, freeze until read out or re-armed
+        trigger.state = TRIGGER_STATE_DONE;
+    }
+
+    trigger.last_duty = (uint16_t)duty;
+    trigger.last_period = period;
+    trigger.primed = 1;
+}
+
+/**
+ * @brief Fire a TRIGGER_SET_COMMAND trigger
+ * Called from the main loop after a SET command changed an output.
+ */
+void Capture_Trigger_NotifyCommand(void) {
+    if (trigger.state == TRIGGER_STATE_ARMED && trigger.config.condition == TRIGGER_SET_COMMAND) {
+        // The next completed cycle becomes the triggering cycle
+        trigger.command_fired = 1;
+    }
+}
+
+/**
+ * @brief Send the trigger state and frozen window as one bulk response
+ * @param light_index Light index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param request Request being answered
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Capture_Trigger_Send(uint8_t light_index, const HILMessage* request) {
+    TriggerReadoutHeader header = {0};
+
+    if (light_index >= PWM_CAPTURE_CHANNELS) {
+        return 0;
+    }
+
+    header.state = trigger.state;
+    header.light = trigger.light;
+
+    // Entries are only sent once the window is frozen
+    if (header.state != TRIGGER_STATE_DONE || light_index != trigger.light) {
+        HIL_SendBulkResponse(request, &header, sizeof(header));
+        return 1;
+    }
+
+    uint16_t start = (trigger.head + trigger.size - trigger.count) % trigger.size;
+    uint16_t first = trigger.count;
+    if (start + first > trigger.size) {
+        first = trigger.size - start;
+    }
+
+    header.count = trigger.count;
+    header.trigger_index = (trigger.trigger_pos + trigger.size - start) % trigger.size;
+
+    HIL_BeginBulkResponse(request, sizeof(header) + header.count * sizeof(PWMHistoryEntry));
+    HIL_WriteBulkResponse(&header, sizeof(header));
+    HIL_WriteBulkResponse(&window[start], first * sizeof(PWMHistoryEntry));
+    HIL_WriteBulkResponse(&window[0], (header.count - first) * sizeof(PWMHistoryEntry));
+    HIL_EndBulkResponse();
+
+    return 1;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file event_loop.c
+ * @brief Event flags and sleep for the main loop
+ */
+
+#include "event_loop.h"
+#include "profiler.h"
+
+static volatile uint32_t pending = 0;
+static uint32_t window_start = 0;         // CYCCNT at the start of the window
+static uint32_t idle_cycles = 0;          // Cycles asleep in the window
+static volatile uint16_t idle_permille = 0;
+
+/**
+ * @brief Close the measurement window once it spans one second
+ */
+static void update_idle(void) {
+    uint32_t elapsed = DWT->CYCCNT - window_start;
+
+    if (elapsed < SystemCoreClock) {
+        return;
+    }
+
+    idle_permille = (uint16_t)(((uint64_t)idle_cycles * EVENT_LOOP_IDLE_FULL) / elapsed);
+    window_start += elapsed;
+    idle_cycles = 0;
+}
+
+/**
+ * @brief Clear all flags and start the idle measurement
+ */
+void Event_Loop_Init(void) {
+    pending = 0;
+    idle_cycles = 0;
+    idle_permille = 0;
+
+    // Keep the debugger attached while the core sleeps
+    HAL_DBGMCU_EnableDBGSleepMode();
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    window_start = DWT->CYCCNT;
+}
+
+/**
+ * @brief Signal events to the main loop, safe from any interrupt
+ * @param events EVENT_LOOP_* flags
+ */
+void Event_Loop_Signal(uint32_t events) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    pending |= events;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Sleep until at least one event is pending and take all pending events
+ * Flags are checked with interrupts masked; WFI still wakes on a pending
+ * interrupt, which then runs once the mask is lifted. A flag set between
+ * the check and the sleep therefore cannot be missed.
+ * @return EVENT_LOOP_* flags
+ */
+uint32_t Event_Loop_Wait(void) {
+    uint32_t events;
+    uint32_t start;
+    uint32_t slept;
+
+    for (;;) {
+        update_idle();
+#if PROFILER
+        Profiler_Update();
+#endif
+
+        __disable_irq();
+        if (pending) {
+            events = pending;
+            pending = 0;
+            __enable_irq();
+            return events;
+        }
+
+        start = DWT->CYCCNT;
+        __WFI();
+        slept = DWT->CYCCNT - start;
+        idle_cycles += slept;
+#if PROFILER
+        Profiler_Add(PROFILER_IDLE, slept);
+#endif
+        __enable_irq();
+    }
+}
+
+/**
+ * @brief Get the idle share of the last complete measurement window
+ * @return Idle time in per mille (0-EVENT_LOOP_IDLE_FULL)
+ */
+uint16_t Event_Loop_GetIdle(void) {
+    return idle_permille;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file freq_counter.c
+ * @brief Gated frequency counter for high-frequency DUT outputs
+ */
+
+#include "freq_counter.h"
+#include "pwm_capture.h"
+#include "tim.h"
+
+static struct {
+    volatile uint8_t active;
+    uint8_t  light_index;
+    uint16_t gate_ms;
+    uint8_t  primed;          // First tick only latches the counter
+    uint16_t last_count;      // TIM1 counter at the previous tick
+    uint32_t edges;           // Edges counted in the current gate
+    uint16_t ticks;           // Ticks elapsed in the current gate
+} counter;
+
+static volatile uint32_t latched_count;   // TIM1->CNT copied by DMA at every TIM8 update
+static FreqCounterResult last_result;
+static volatile uint32_t result_sequence = 0;   // Incremented after every completed gate
+
+/**
+ * @brief Gate DMA transfer complete
+ * @param hdma Pointer to the DMA_HandleTypeDef structure
+ */
+static void gate_latched(DMA_HandleTypeDef* hdma) {
+    Freq_Counter_GateTick((uint16_t)latched_count);
+}
+
+/**
+ * @brief Initialize the frequency counter state
+ */
+void Freq_Counter_Init(void) {
+    counter.active = 0;
+    counter.primed = 0;
+    result_sequence = 0;
+}
+
+/**
+ * @brief Switch TIM1 to counter mode on one light
+ * @param light_index Light index (0-1)
+ * @param gate_ms Gate time in milliseconds (1-FREQ_COUNTER_MAX_GATE_MS)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Freq_Counter_Start(uint8_t light_index, uint16_t gate_ms) {
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+
+    if (light_index > 1 || gate_ms == 0 || gate_ms > FREQ_COUNTER_MAX_GATE_MS) {
+        return 0;
+    }
+
+    if (counter.active) {
+        Freq_Counter_Stop();
+    }
+
+    PWM_Capture_Stop();
+
+    // Free-running 16-bit counter clocked by the light input
+    htim1.Init.Prescaler = 0;
+    htim1.Init.Period = 0xFFFF;
+    if (HAL_TIM_Base_Init(&htim1) != HAL_OK) {
+        return 0;
+    }
+
+    sClockSourceConfig.ClockSource = (light_index == 0) ? TIM_CLOCKSOURCE_TI1 : TIM_CLOCKSOURCE_TI2;
+    sClockSourceConfig.ClockPolarity = TIM_CLOCKPOLARITY_RISING;
+    sClockSourceConfig.ClockPrescaler = TIM_CLOCKPRESCALER_DIV1;
+    sClockSourceConfig.ClockFilter = 0;   // No filter, so MHz inputs are not suppressed
+    if (HAL_TIM_ConfigClockSource(&htim1, &sClockSourceConfig) != HAL_OK) {
+        return 0;
+    }
+
+    counter.light_index = light_index;
+    counter.gate_ms = gate_ms;
+    counter.primed = 0;
+    counter.edges = 0;
+    counter.ticks = 0;
+    result_sequence = 0;
+    counter.active = 1;
+
+    HAL_TIM_Base_Start(&htim1);
+
+    // Each TIM8 update copies the TIM1 counter, the interrupt follows the copy
+    DMA_HandleTypeDef* hdma = htim8.hdma[TIM_DMA_ID_UPDATE];
+    hdma->XferCpltCallback = gate_latched;
+    hdma->XferHalfCpltCallback = NULL;
+    if (HAL_DMA_Start_IT(hdma, (uint32_t)&TIM1->CNT, (uint32_t)&latched_count, 1) != HAL_OK) {
+        HAL_TIM_Base_Stop(&htim1);
+        counter.active = 0;
+        return 0;
+    }
+
+    __HAL_TIM_SET_COUNTER(&htim8, 0);
+    __HAL_TIM_CLEAR_FLAG(&htim8, TIM_FLAG_UPDATE);
+    __HAL_TIM_ENABLE_DMA(&htim8, TIM_DMA_UPDATE);
+    HAL_TIM_Base_Start(&htim8);
+
+    return 1;
+}
+
+/**
+ * @brief Leave counter mode and resume PWM capture on all lights
+ */
+void Freq_Counter_Stop(void) {
+    if (!counter.active) {
+        return;
+    }
+
+    HAL_TIM_Base_Stop(&htim8);
+    __HAL_TIM_DISABLE_DMA(&htim8, TIM_DMA_UPDATE);
+    HAL_DMA_Abort(htim8.hdma[TIM_DMA_ID_UPDATE]);
+    HAL_TIM_Base_Stop(&htim1);
+    counter.active = 0;
+
+    // Restore the capture configuration of TIM1
+    MX_TIM1_Init();
+    PWM_Capture_Init();
+    PWM_Capture_Start();
+}
+
+/**
+ * @brief Check whether counter mode is active
+ * @return 1 if TIM1 is in counter mode, 0 otherwise
+ */
+uint8_t Freq_Counter_IsActive(void) {
+    return counter.active;
+}
+
+/**
+ * @brief Process a gate timer tick
+ * This function is called from the gate DMA transfer complete interrupt
+ * @param count TIM1 counter latched by the DMA at the tick
+ */
+void Freq_Counter_GateTick(uint16_t count) {
+    if (!counter.active) {
+        return;
+    }
+
+    if (!counter.primed) {
+        // Gate windows start on a tick boundary
+        counter.primed = 1;
+        counter.last_count = count;
+        return;
+    }
+
+    // 16-bit wrap is harmless as long as fewer than 65536 edges arrive per tick
+    counter.edges += (uint16_t)(count - counter.last_count);
+    counter.last_count = count;
+
+    if (++counter.ticks >= counter.gate_ms) {
+        result_sequence++;
+        __DMB();
+        last_result.edges = counter.edges;
+        last_result.gate_ms = counter.gate_ms;
+        last_result.frequency_hz = (uint32_t)(((uint64_t)counter.edges * 1000 + counter.gate_ms / 2) / counter.gate_ms);
+        __DMB();
+        result_sequence++;
+
+        counter.edges = 0;
+        counter.ticks = 0;
+    }
+}
+
+/**
+ * @brief Get the result of the last completed gate
+ * @param light_index Light index (0-2)
+ * @param result Destination for a consistent copy of the result
+ * @return 1 if a gate has completed on this light, 0 otherwise
+ */
+uint8_t Freq_Counter_GetResult(uint8_t light_index, FreqCounterResult* result) {
+    uint32_t start;
+
+    if (!counter.active || light_index != counter.light_index || result == NULL) {
+        return 0;
+    }
+
+    // Retry if the gate tick published while copying
+    do {
+        start = result_sequence;
+        __DMB();
+        *result = last_result;
+        __DMB();
+    } while ((start & 1) || start != result_sequence);
+
+    return (start != 0);
+}
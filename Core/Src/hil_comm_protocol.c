@@ -6,6 +6,24 @@
 #include "hil_comm_protocol.h"
 #include "main.h"
 #include "usart.h"
+#include "analog_simulation.h"
+#include "analog_calibration.h"
+#include "ntc_emulation.h"
+#include "analog_noise.h"
+#include "pwm_statistics.h"
+#include "pwm_history.h"
+#include "pwm_capture.h"
+#include "freq_counter.h"
+#include "capture_trigger.h"
+#include "pwm_phase.h"
+#include "plant_model.h"
+#include "waveform.h"
+#include "sequencer.h"
+#include "analog_fault.h"
+#include "event_loop.h"
+#include "scheduler.h"
+#include "isr_timing.h"
+#include "profiler.h"
 #include <string.h>
 
 // Global UART handle (defined in main.c)
@@ -30,19 +48,67 @@ static UARTRingBuffer uart_rx_buffer = {0};
 typedef enum {
     WAIT_START_MARKER,
     RECEIVING_MESSAGE,
+    RECEIVING_PAYLOAD,
+    DISCARDING_PAYLOAD,
     MESSAGE_COMPLETE
 } UARTRxState;
 
+// Upload payload buffer: payload, payload XOR and end marker
+static uint8_t upload_buffer[HIL_UPLOAD_MAX_SIZE + 2];
+static volatile uint8_t upload_pending = 0;   // Set by the RX interrupt, cleared once the main loop processed the upload
+
+// Running checksum of the bulk response currently being sent
+static uint8_t bulk_checksum = 0;
+
 static struct {
     UARTRxState state;
     HILMessage current_message;
     uint8_t bytes_received;
     uint8_t* rx_ptr;
+    uint32_t payload_received;
+    uint32_t payload_expected;
+    uint32_t last_byte_tick;      // HAL tick of the latest received byte
 } uart_rx_context = {
     .state = WAIT_START_MARKER,
     .bytes_received = 0
 };
 
+/**
+ * Check whether the plant model, a waveform or a ramp owns an analog output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if owned, 0 if host setpoints are accepted
+ */
+static uint8_t output_owned(uint8_t light_index, uint8_t output) {
+    return Plant_Model_IsEnabled(light_index) || Waveform_IsDriving(light_index, output) ||
+           Analog_IsRamping(light_index, output);
+}
+
+/**
+ * Apply a changed output mapping to a static output; waveforms keep their raw samples
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ */
+static void refresh_output(uint8_t light_index, uint8_t output) {
+    if (!Waveform_IsDriving(light_index, output)) {
+        Analog_RefreshOutput(light_index, output);
+    }
+}
+
+/**
+ * Check whether a waveform or ramp drives an analog output of a light
+ * @param light_index Light index (0-2)
+ * @return 1 if an output is busy, 0 otherwise
+ */
+static uint8_t outputs_busy(uint8_t light_index) {
+    for (uint8_t output = ANALOG_OUTPUT_CURRENT; output <= ANALOG_OUTPUT_TEMPERATURE; output++) {
+        if (Waveform_IsDriving(light_index, output) || Analog_IsRamping(light_index, output)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void HIL_ProcessSetCommand(const HILMessage* msg) {
     HILMessage response = {0};
 
@@ -68,8 +134,9 @@ void HIL_ProcessSetCommand(const HILMessage* msg) {
                 break;
 
             case SIGNAL_CURRENT:
-                // Set current simulation value
-                if (Analog_SetCurrentSimulation(light_index, msg->value)) {
+                // Set current simulation value (owned by the plant model, a waveform or a ramp while they run)
+                if (!output_owned(light_index, ANALOG_OUTPUT_CURRENT) && Analog_SetCurrentSimulation(light_index, msg->value)) {
+                    Capture_Trigger_NotifyCommand();
                     response.cmd = RESPONSE_OK;
                 } else {
                     response.cmd = RESPONSE_ERROR;
@@ -77,8 +144,283 @@ void HIL_ProcessSetCommand(const HILMessage* msg) {
                 break;
 
             case SIGNAL_TEMPERATURE:
-                // Set temperature simulation value
-                if (Analog_SetTemperatureSimulation(light_index, msg->value)) {
+                // Set temperature simulation value (owned by the plant model, a waveform or a ramp while they run)
+                if (!output_owned(light_index, ANALOG_OUTPUT_TEMPERATURE) && Analog_SetTemperatureSimulation(light_index, msg->value)) {
+                    Capture_Trigger_NotifyCommand();
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_PWM_STATS:
+                // Set statistics window length and restart the window
+                if (PWM_Statistics_SetWindow(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_PWM_RANGE:
+                // Enable or disable capture auto-ranging (shared by all channels)
+                if (!Freq_Counter_IsActive() && PWM_Capture_SetAutoRange(msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_CAPTURE_CFG:
+                // Reconfigure one capture input, see PWM_CAPTURE_CONFIG_* for the value layout
+                {
+                    PWMCaptureConfig config;
+                    uint16_t known = PWM_CAPTURE_CONFIG_FILTER_MASK | PWM_CAPTURE_CONFIG_ACTIVE_LOW |
+                                     PWM_CAPTURE_CONFIG_PRESCALER_MASK;
+
+                    config.filter = msg->value & PWM_CAPTURE_CONFIG_FILTER_MASK;
+                    config.active_low = (msg->value & PWM_CAPTURE_CONFIG_ACTIVE_LOW) ? 1 : 0;
+                    config.prescaler = (msg->value & PWM_CAPTURE_CONFIG_PRESCALER_MASK) >> PWM_CAPTURE_CONFIG_PRESCALER_POS;
+
+                    if (!(msg->value & ~known) && PWM_Capture_SetConfig(light_index, &config)) {
+                        response.cmd = RESPONSE_OK;
+                    } else {
+                        response.cmd = RESPONSE_ERROR;
+                    }
+                }
+                break;
+
+            case SIGNAL_PLANT:
+                // Enable (1) or disable (0) the plant model of this light, unless a waveform or ramp drives it
+                if ((msg->value == 0 || !outputs_busy(light_index)) && Plant_Model_Enable(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_SYNC:
+                // Stage a value for a synchronized update: bit 15 selects temperature, bits 0-14 hold the value
+                {
+                    uint8_t output = (msg->value & 0x8000) ? ANALOG_OUTPUT_TEMPERATURE : ANALOG_OUTPUT_CURRENT;
+
+                    if (!output_owned(light_index, output) &&
+                        Analog_StageSimulation(ANALOG_STAGE_HOST, light_index, output, msg->value & 0x7FFF)) {
+                        response.cmd = RESPONSE_OK;
+                    } else {
+                        response.cmd = RESPONSE_ERROR;
+                    }
+                }
+                break;
+
+            case SIGNAL_DITHER:
+                // Dither the outputs in the mask: bit 0 current, bit 1 temperature (not while a waveform plays)
+                if ((!(msg->value & (1 << ANALOG_OUTPUT_CURRENT)) || !Waveform_IsDriving(light_index, ANALOG_OUTPUT_CURRENT)) &&
+                    (!(msg->value & (1 << ANALOG_OUTPUT_TEMPERATURE)) || !Waveform_IsDriving(light_index, ANALOG_OUTPUT_TEMPERATURE)) &&
+                    msg->value <= 0xFF && Analog_SetDither(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_NOISE:
+                // Switch the noise of output 0 (current) or 1 (temperature) off
+                if (msg->value <= 0xFF && Analog_ClearNoise(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_DAC:
+                // Drive the outputs in the mask from the DAC: bit 0 current, bit 1 temperature (not while a waveform plays)
+                if (!Waveform_IsDriving(light_index, ANALOG_OUTPUT_CURRENT) &&
+                    !Waveform_IsDriving(light_index, ANALOG_OUTPUT_TEMPERATURE) &&
+                    msg->value <= 0xFF && Analog_SetBackend(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_CALIBRATION:
+                // Remove the calibration table of output 0 (current) or 1 (temperature)
+                if (msg->value <= 0xFF && Analog_Calibration_Clear(light_index, msg->value)) {
+                    refresh_output(light_index, msg->value);
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_NTC:
+                // Return the temperature output to the linear model
+                if (NTC_Emulation_Clear(light_index)) {
+                    refresh_output(light_index, ANALOG_OUTPUT_TEMPERATURE);
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_RAMP:
+                // Stop the ramp of output 0 (current) or 1 (temperature), holding its present value
+                if (Analog_StopRamp(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_FREQUENCY:
+                // Enter counter mode with the given gate time, or return to capture
+                if (msg->value == 0) {
+                    Freq_Counter_Stop();
+                    response.cmd = RESPONSE_OK;
+                } else if (Freq_Counter_Start(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_TRIGGER:
+                // Re-arm (1) or disarm (0) the capture trigger
+                if (Capture_Trigger_Arm(light_index, msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_PWM_HISTORY:
+                // Clear capture history
+                if (PWM_History_Clear(light_index)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            default:
+                response.cmd = RESPONSE_ERROR;
+                break;
+        }
+    } else if (msg->light == 'S') {
+        switch (msg->function) {
+            case SIGNAL_ISR_CYCLES:
+                // Restart capture interrupt cycle (0) or interrupt timing (1) measurement
+#if PWM_CAPTURE_CYCLE_COUNT
+                if (msg->value == 0) {
+                    PWM_Capture_ResetCycles();
+                    response.cmd = RESPONSE_OK;
+                    break;
+                }
+#endif
+#if ISR_TIMING
+                if (msg->value == 1) {
+                    ISR_Timing_Reset();
+                    response.cmd = RESPONSE_OK;
+                    break;
+                }
+#endif
+                response.cmd = RESPONSE_ERROR;
+                break;
+
+            case SIGNAL_SYNC:
+                // Commit (1) all staged values in one PWM period, or discard (0) them
+                if (msg->value == 1) {
+                    uint8_t staged = Analog_GetStagedMask(ANALOG_STAGE_HOST);
+                    uint8_t owned = 0;
+
+                    // An output may have been taken over since it was staged
+                    for (uint8_t i = 0; i < 6; i++) {
+                        if ((staged & (1 << i)) && output_owned(i / 2, i % 2)) {
+                            owned = 1;
+                        }
+                    }
+
+                    if (!owned) {
+                        // A sequencer commit must not release the timers halfway through this one
+                        HAL_NVIC_DisableIRQ(TIM5_IRQn);
+                        Analog_CommitStaged(ANALOG_STAGE_HOST);
+                        HAL_NVIC_EnableIRQ(TIM5_IRQn);
+                        Capture_Trigger_NotifyCommand();
+                        response.cmd = RESPONSE_OK;
+                    } else {
+                        response.cmd = RESPONSE_ERROR;
+                    }
+                } else if (msg->value == 0) {
+                    Analog_DiscardStaged(ANALOG_STAGE_HOST);
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_DITHER:
+                // Set the analog carrier prescaler, 84 MHz / (value + 1) / 1024
+                if (msg->value <= 0xFF && Analog_SetCarrier(msg->value)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_WAVEFORM:
+                // Value is (player << 8) | action, action 1 starts and 0 stops playback
+                {
+                    uint8_t player = msg->value >> 8;
+                    uint8_t action = msg->value & 0xFF;
+                    uint8_t ok = 0;
+
+                    if (action == 1) {
+                        ok = Waveform_Start(player);
+                    } else if (action == 0) {
+                        ok = Waveform_Stop(player);
+                    }
+
+                    response.cmd = ok ? RESPONSE_OK : RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_SEQUENCER:
+                // Start (1) the uploaded scenario at time 0, or stop (0) it
+                if (msg->value == 1 && Sequencer_Start()) {
+                    response.cmd = RESPONSE_OK;
+                } else if (msg->value == 0) {
+                    Sequencer_Stop();
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_SCHEDULER:
+                // Restart periodic task accounting
+                Scheduler_ResetStats();
+                response.cmd = RESPONSE_OK;
+                break;
+
+#if PROFILER
+            case SIGNAL_LOAD:
+                // Start a new cycle profile window
+                if (msg->value == 1) {
+                    Profiler_Reset();
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+#endif
+
+            case SIGNAL_FAULT:
+                // Start (1) the fault timeline at time 0, or stop (0) it and heal all lines
+                if (msg->value == 1 && Analog_Fault_Start()) {
+                    response.cmd = RESPONSE_OK;
+                } else if (msg->value == 0) {
+                    Analog_Fault_Stop();
                     response.cmd = RESPONSE_OK;
                 } else {
                     response.cmd = RESPONSE_ERROR;
@@ -100,6 +442,147 @@ void HIL_ProcessSetCommand(const HILMessage* msg) {
     HIL_SendResponse(response.cmd, &response);
 }
 
+void HIL_ProcessUploadCommand(const HILMessage* msg) {
+    HILMessage response = {0};
+    uint16_t length = msg->value;
+    uint8_t payload_checksum = 0;
+
+    // Set response start and end markers
+    response.start = HIL_START_MARKER;
+    response.end = HIL_END_MARKER;
+    response.light = msg->light;
+    response.function = msg->function;
+
+    // Validate header before touching the payload buffer
+    if (!HIL_ValidateChecksum(msg) || length > HIL_UPLOAD_MAX_SIZE) {
+        upload_pending = 0;
+        HIL_SendResponse(RESPONSE_ERROR, &response);
+        return;
+    }
+
+    // Validate payload
+    for (uint16_t i = 0; i < length; i++) {
+        payload_checksum ^= upload_buffer[i];
+    }
+
+    if (upload_buffer[length] != payload_checksum || upload_buffer[length + 1] != HIL_END_MARKER) {
+        upload_pending = 0;
+        HIL_SendResponse(RESPONSE_ERROR, &response);
+        return;
+    }
+
+    // Process upload based on light and function
+    uint8_t light_index = msg->light - '1'; // Convert char to 0-based index
+
+    if (light_index < 3) {
+        switch (msg->function) {
+            case SIGNAL_CALIBRATION:
+                // Load the calibration table of one output (the payload names the output)
+                if (Analog_Calibration_Load(light_index, upload_buffer, length)) {
+                    refresh_output(light_index, ((const AnalogCalibrationHeader*)upload_buffer)->output);
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_NTC:
+                // Select the sensor model of the temperature output
+                if (NTC_Emulation_Configure(light_index, upload_buffer, length)) {
+                    refresh_output(light_index, ANALOG_OUTPUT_TEMPERATURE);
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_NOISE:
+                // Configure the noise of one output (not while a waveform plays on it)
+                if (length >= 1 && !Waveform_IsDriving(light_index, upload_buffer[0]) &&
+                    Analog_SetNoise(light_index, upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_RAMP:
+                // Ramp one output from its present value (the payload names the output)
+                if (!Plant_Model_IsEnabled(light_index) && length == sizeof(AnalogRampCommand) &&
+                    !Waveform_IsDriving(light_index, ((const AnalogRampCommand*)upload_buffer)->output) &&
+                    Analog_StartRamp(light_index, upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_PLANT:
+                // Load plant model parameters
+                if (Plant_Model_Configure(light_index, upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_TRIGGER:
+                // Configure and arm the capture trigger
+                if (Capture_Trigger_Configure(light_index, upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            default:
+                response.cmd = RESPONSE_ERROR;
+                break;
+        }
+    } else if (msg->light == 'S') {
+        switch (msg->function) {
+            case SIGNAL_WAVEFORM:
+                // Load waveform samples, the header selects player and target output
+                if (Waveform_Load(upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_SEQUENCER:
+                // Load scenario steps, the header gives the scenario length and the first index
+                if (Sequencer_Load(upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_FAULT:
+                // Load one fault profile, the payload names its slot
+                if (Analog_Fault_Load(upload_buffer, length)) {
+                    response.cmd = RESPONSE_OK;
+                } else {
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            default:
+                response.cmd = RESPONSE_ERROR;
+                break;
+        }
+    } else {
+        response.cmd = RESPONSE_ERROR;
+    }
+
+    // Release the buffer for the next upload
+    upload_pending = 0;
+
+    // Send response
+    HIL_SendResponse(response.cmd, &response);
+}
+
 void HIL_ProcessGetCommand(const HILMessage* msg) {
     HILMessage response = {0};
 
@@ -121,17 +604,17 @@ void HIL_ProcessGetCommand(const HILMessage* msg) {
         switch (msg->function) {
             case SIGNAL_PWM_INPUT:
                 // Retrieve PWM capture data for specific light
-                if (pwm_capture[light_index].capture_complete) {
-                    response.cmd = msg->light;
-                    response.function = SIGNAL_PWM_INPUT;
-
-                    // Return duty cycle (0-100 range)
-                    response.value = pwm_capture[light_index].duty_cycle;
+                {
+                    PWMCaptureSnapshot snapshot;
+                    if (PWM_Capture_ConsumeSnapshot(light_index, &snapshot)) {
+                        response.cmd = msg->light;
+                        response.function = SIGNAL_PWM_INPUT;
 
-                    // Clear capture complete flag
-                    pwm_capture[light_index].capture_complete = 0;
-                } else {
-                    response.cmd = RESPONSE_ERROR;
+                        // Return duty cycle (0-100 range)
+                        response.value = snapshot.duty_cycle;
+                    } else {
+                        response.cmd = RESPONSE_ERROR;
+                    }
                 }
                 break;
 
@@ -163,6 +646,279 @@ void HIL_ProcessGetCommand(const HILMessage* msg) {
                 }
                 break;
 
+            case SIGNAL_PWM_STATS:
+                // Return the last completed statistics window as a bulk response
+                {
+                    PWMStatsSummary summary;
+                    if (PWM_Statistics_GetSummary(light_index, &summary)) {
+                        HIL_SendBulkResponse(msg, &summary, sizeof(summary));
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_PWM_STATUS:
+                // Return capture status flags
+                {
+                    PWMCaptureSnapshot snapshot;
+                    PWM_Capture_GetSnapshot(light_index, &snapshot);
+                    response.light = msg->light;
+                    response.function = SIGNAL_PWM_STATUS;
+                    response.value = snapshot.capture_flags;
+                }
+                break;
+
+            case SIGNAL_PWM_RANGE:
+                // Return the active capture range
+                response.light = msg->light;
+                response.function = SIGNAL_PWM_RANGE;
+                response.value = PWM_Capture_GetRange(light_index);
+                break;
+
+            case SIGNAL_FREQUENCY:
+                // Return the last completed gate as a bulk response
+                {
+                    FreqCounterResult result;
+                    if (Freq_Counter_GetResult(light_index, &result)) {
+                        HIL_SendBulkResponse(msg, &result, sizeof(result));
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_CAPTURE_CFG:
+                // Return the capture input configuration as a packed value
+                {
+                    PWMCaptureConfig config;
+                    if (PWM_Capture_GetConfig(light_index, &config)) {
+                        response.light = msg->light;
+                        response.function = SIGNAL_CAPTURE_CFG;
+                        response.value = config.filter |
+                                         (config.active_low ? PWM_CAPTURE_CONFIG_ACTIVE_LOW : 0) |
+                                         ((uint16_t)config.prescaler << PWM_CAPTURE_CONFIG_PRESCALER_POS);
+                    } else {
+                        response.cmd = RESPONSE_ERROR;
+                    }
+                }
+                break;
+
+            case SIGNAL_PLANT:
+                // Return the plant model state as a bulk response
+                {
+                    PlantState state;
+                    if (Plant_Model_GetState(light_index, &state)) {
+                        HIL_SendBulkResponse(msg, &state, sizeof(state));
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_DITHER:
+                // Return the dithered outputs: bit 0 current, bit 1 temperature
+                response.light = msg->light;
+                response.function = SIGNAL_DITHER;
+                response.value = Analog_GetDither(light_index);
+                break;
+
+            case SIGNAL_NOISE:
+                // Return the noise configuration of output 0 (current) or 1 (temperature) as a bulk response
+                {
+                    AnalogNoiseConfig config;
+                    if (msg->value <= 0xFF && Analog_Noise_Get(light_index, msg->value, &config)) {
+                        HIL_SendBulkResponse(msg, &config, sizeof(config));
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_DAC:
+                // Return the outputs driven from the DAC: bit 0 current, bit 1 temperature
+                response.light = msg->light;
+                response.function = SIGNAL_DAC;
+                response.value = Analog_GetBackend(light_index);
+                break;
+
+            case SIGNAL_FAULT:
+                // Return the applied fault types: low byte current, high byte temperature
+                response.light = msg->light;
+                response.function = SIGNAL_FAULT;
+                response.value = Analog_Fault_GetActive(light_index, ANALOG_OUTPUT_CURRENT) |
+                                 (Analog_Fault_GetActive(light_index, ANALOG_OUTPUT_TEMPERATURE) << 8);
+                break;
+
+            case SIGNAL_CALIBRATION:
+                // Return the calibration table of output 0 (current) or 1 (temperature) as a bulk response
+                {
+                    uint8_t table[sizeof(AnalogCalibrationHeader) +
+                                  ANALOG_CALIBRATION_MAX_POINTS * sizeof(AnalogCalibrationPoint)];
+                    uint16_t length = (msg->value <= 0xFF) ?
+                                      Analog_Calibration_Get(light_index, msg->value, table, sizeof(table)) : 0;
+
+                    if (length) {
+                        HIL_SendBulkResponse(msg, table, length);
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_NTC:
+                // Return the sensor model header and its evaluated output table as a bulk response
+                {
+                    NTCHeader header;
+                    uint16_t table[NTC_TABLE_SIZE];
+
+                    if (NTC_Emulation_Get(light_index, &header, table)) {
+                        HIL_BeginBulkResponse(msg, sizeof(header) + sizeof(table));
+                        HIL_WriteBulkResponse(&header, sizeof(header));
+                        HIL_WriteBulkResponse(table, sizeof(table));
+                        HIL_EndBulkResponse();
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_RAMP:
+                // Return the ramp state of the current and temperature outputs as a bulk response
+                {
+                    AnalogRampStatus status[2];
+                    if (Analog_GetRampStatus(light_index, status)) {
+                        HIL_SendBulkResponse(msg, status, sizeof(status));
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_PWM_PHASE:
+                // Return offsets and overlap of the other lights as a bulk response
+                {
+                    PWMPhaseReport report;
+                    if (PWM_Phase_Measure(light_index, &report)) {
+                        HIL_SendBulkResponse(msg, &report, sizeof(report));
+                        return;
+                    }
+                    response.cmd = RESPONSE_ERROR;
+                }
+                break;
+
+            case SIGNAL_TRIGGER:
+                // Return trigger state and the frozen window as a bulk response
+                if (Capture_Trigger_Send(light_index, msg)) {
+                    return;
+                }
+                response.cmd = RESPONSE_ERROR;
+                break;
+
+            case SIGNAL_PWM_HISTORY:
+                // Download capture history as a bulk response
+                if (PWM_History_Send(light_index, msg)) {
+                    return;
+                }
+                response.cmd = RESPONSE_ERROR;
+                break;
+
+            default:
+                response.cmd = RESPONSE_ERROR;
+                break;
+        }
+    } else if (msg->light == 'S') {
+        switch (msg->function) {
+            case SIGNAL_ISR_CYCLES:
+                // Return capture interrupt cycle counters (0) or the interrupt timing report (1) as a bulk response
+#if PWM_CAPTURE_CYCLE_COUNT
+                if (msg->value == 0) {
+                    PWMCaptureCycles cycles;
+                    PWM_Capture_GetCycles(&cycles);
+                    HIL_SendBulkResponse(msg, &cycles, sizeof(cycles));
+                    return;
+                }
+#endif
+#if ISR_TIMING
+                if (msg->value == 1) {
+                    IsrTimingReport report;
+                    ISR_Timing_GetReport(&report);
+                    HIL_SendBulkResponse(msg, &report, sizeof(report));
+                    return;
+                }
+#endif
+                response.cmd = RESPONSE_ERROR;
+                break;
+
+            case SIGNAL_SYNC:
+                // Return the staged outputs, bit (light index * 2 + output)
+                response.light = msg->light;
+                response.function = SIGNAL_SYNC;
+                response.value = Analog_GetStagedMask(ANALOG_STAGE_HOST);
+                break;
+
+            case SIGNAL_DITHER:
+                // Return the analog carrier prescaler
+                response.light = msg->light;
+                response.function = SIGNAL_DITHER;
+                response.value = Analog_GetCarrier();
+                break;
+
+            case SIGNAL_WAVEFORM:
+                // Return the status of all waveform players as a bulk response
+                {
+                    WaveformStatus status[WAVEFORM_PLAYERS];
+                    Waveform_GetStatus(status);
+                    HIL_SendBulkResponse(msg, status, sizeof(status));
+                    return;
+                }
+
+            case SIGNAL_SEQUENCER:
+                // Return the sequencer status as a bulk response
+                {
+                    SequencerStatus status;
+                    Sequencer_GetStatus(&status);
+                    HIL_SendBulkResponse(msg, &status, sizeof(status));
+                    return;
+                }
+
+            case SIGNAL_FAULT:
+                // Return the fault timeline and slot states as a bulk response
+                {
+                    AnalogFaultStatus status;
+                    Analog_Fault_GetStatus(&status);
+                    HIL_SendBulkResponse(msg, &status, sizeof(status));
+                    return;
+                }
+
+            case SIGNAL_LOAD:
+                // Return the idle share of the last second in per mille (0) or the cycle profile (1) as a bulk response
+                if (msg->value == 0) {
+                    response.light = msg->light;
+                    response.function = SIGNAL_LOAD;
+                    response.value = Event_Loop_GetIdle();
+                    break;
+                }
+#if PROFILER
+                if (msg->value == 1) {
+                    ProfilerReport report;
+                    Profiler_GetReport(&report);
+                    HIL_SendBulkResponse(msg, &report, sizeof(report));
+                    return;
+                }
+#endif
+                response.cmd = RESPONSE_ERROR;
+                break;
+
+            case SIGNAL_SCHEDULER:
+                // Return the periodic task accounting as a bulk response
+                {
+                    SchedulerStatus status;
+                    Scheduler_GetStatus(&status);
+                    HIL_SendBulkResponse(msg, &status, sizeof(status));
+                    return;
+                }
+
             default:
                 response.cmd = RESPONSE_ERROR;
                 break;
@@ -222,6 +978,8 @@ static uint8_t add_to_buffer(const HILMessage* msg) {
     uart_rx_buffer.tail = (tail + 1) % UART_RX_BUFFER_SIZE;
     uart_rx_buffer.count++;
 
+    Event_Loop_Signal(EVENT_LOOP_HIL);
+
     return 1;
 }
 
@@ -237,8 +995,32 @@ static void process_received_message() {
         return;
     }
 
+    // Upload header just completed: receive the payload before queueing
+    if (uart_rx_context.current_message.cmd == CMD_UPLOAD &&
+        uart_rx_context.state == MESSAGE_COMPLETE) {
+        uart_rx_context.payload_received = 0;
+        uart_rx_context.payload_expected = (uint32_t)uart_rx_context.current_message.value + 2;
+
+        if (upload_pending || uart_rx_context.current_message.value > HIL_UPLOAD_MAX_SIZE) {
+            // Previous upload not processed yet or payload too large: skip the
+            // payload so its bytes are not parsed as frames
+            uart_rx_context.state = DISCARDING_PAYLOAD;
+            HIL_SendResponse(RESPONSE_ERROR, NULL);
+            return;
+        }
+
+        uart_rx_context.state = RECEIVING_PAYLOAD;
+        return;
+    }
+
     // Add to processing buffer
     if (!add_to_buffer(&uart_rx_context.current_message)) {
+        if (uart_rx_context.current_message.cmd == CMD_UPLOAD) {
+            // Drop the upload so the payload buffer is not held forever
+            upload_pending = 0;
+            uart_rx_context.state = MESSAGE_COMPLETE;
+        }
+
         // Buffer full, send error
         HIL_SendResponse(RESPONSE_ERROR, NULL);
         return;
@@ -279,6 +1061,110 @@ void HIL_SendResponse(HILResponseStatus status, const HILMessage* original_msg)
     HAL_UART_Transmit(&huart3, (uint8_t*)&response, sizeof(HILMessage), 100);
 }
 
+/**
+ * Send an unsolicited event message, only from the main loop
+ * @param light Light channel the event belongs to
+ * @param function Signal type that raised the event
+ * @param value Event specific value
+ */
+void HIL_SendEvent(char light, char function, uint16_t value) {
+    HILMessage event = {0};
+
+    event.light = light;
+    event.function = function;
+    event.value = value;
+
+    HIL_SendResponse(RESPONSE_EVENT, &event);
+}
+
+/**
+ * Send a complete bulk response from a single buffer
+ * @param request Request being answered (light and function are echoed)
+ * @param payload Payload bytes
+ * @param length Payload length in bytes
+ */
+void HIL_SendBulkResponse(const HILMessage* request, const void* payload, uint16_t length) {
+    HIL_BeginBulkResponse(request, length);
+    HIL_WriteBulkResponse(payload, length);
+    HIL_EndBulkResponse();
+}
+
+/**
+ * Start a bulk response whose payload is sent in several pieces
+ * @param request Request being answered (light and function are echoed)
+ * @param length Total payload length in bytes
+ */
+void HIL_BeginBulkResponse(const HILMessage* request, uint16_t length) {
+    HILMessage header = {0};
+
+    header.light = request->light;
+    header.function = request->function;
+    header.value = length;
+
+    bulk_checksum = 0;
+
+    // Header is a regular OK response carrying the payload length
+    HIL_SendResponse(RESPONSE_OK, &header);
+}
+
+/**
+ * Send the next piece of a bulk response payload
+ * @param data Payload bytes
+ * @param length Number of bytes
+ */
+void HIL_WriteBulkResponse(const void* data, uint16_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    if (length == 0) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < length; i++) {
+        bulk_checksum ^= bytes[i];
+    }
+
+    HAL_UART_Transmit(&huart3, (uint8_t*)bytes, length, 100 + length);
+}
+
+/**
+ * Finish a bulk response by sending the payload checksum and end marker
+ */
+void HIL_EndBulkResponse(void) {
+    uint8_t trailer[2] = {bulk_checksum, HIL_END_MARKER};
+
+    HAL_UART_Transmit(&huart3, trailer, sizeof(trailer), 100);
+}
+
+#if PROFILER
+/**
+ * Add the cycles of one handled command to its profile entry
+ * @param cmd Command type
+ * @param cycles Core cycles spent handling it
+ */
+static void profile_command(uint8_t cmd, uint32_t cycles) {
+    switch (cmd) {
+        case CMD_GET:
+            Profiler_Add(PROFILER_GET, cycles);
+            break;
+
+        case CMD_SET:
+            Profiler_Add(PROFILER_SET, cycles);
+            break;
+
+        case CMD_PING:
+            Profiler_Add(PROFILER_PING, cycles);
+            break;
+
+        case CMD_UPLOAD:
+            Profiler_Add(PROFILER_UPLOAD, cycles);
+            break;
+
+        default:
+            break;
+    }
+}
+#endif
+
 /**
  * Process messages from the reception buffer
  * Call this in the main loop or a low-priority task
@@ -305,6 +1191,10 @@ void HIL_ProcessReceivedMessages(void) {
         uart_rx_buffer.head = (uart_rx_buffer.head + 1) % UART_RX_BUFFER_SIZE;
         uart_rx_buffer.count--;
 
+#if PROFILER
+        uint32_t start = DWT->CYCCNT;
+#endif
+
         // Process message based on command type
         switch (msg.cmd) {
             case CMD_GET:
@@ -319,10 +1209,18 @@ void HIL_ProcessReceivedMessages(void) {
                 HIL_ProcessPingCommand(&msg);
                 break;
 
+            case CMD_UPLOAD:
+                HIL_ProcessUploadCommand(&msg);
+                break;
+
             default:
                 HIL_SendResponse(RESPONSE_ERROR, &msg);
                 break;
         }
+
+#if PROFILER
+        profile_command(msg.cmd, DWT->CYCCNT - start);
+#endif
     }
 }
 
@@ -333,6 +1231,7 @@ void HIL_ProcessReceivedMessages(void) {
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
     if (huart == &huart3) {
         rx_byte = huart->Instance->DR;  // Read directly from data register
+        uart_rx_context.last_byte_tick = HAL_GetTick();
 
         switch (uart_rx_context.state) {
             case WAIT_START_MARKER:
@@ -354,6 +1253,24 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
                 }
                 break;
 
+            case RECEIVING_PAYLOAD:
+                upload_buffer[uart_rx_context.payload_received++] = rx_byte;
+
+                if (uart_rx_context.payload_received == uart_rx_context.payload_expected) {
+                    // Payload, checksum and end marker received; main loop owns the buffer now
+                    upload_pending = 1;
+                    process_received_message();
+                }
+                break;
+
+            case DISCARDING_PAYLOAD:
+                // Rejected upload: drop payload, checksum and end marker
+                if (++uart_rx_context.payload_received == uart_rx_context.payload_expected) {
+                    uart_rx_context.state = WAIT_START_MARKER;
+                    uart_rx_context.bytes_received = 0;
+                }
+                break;
+
             case MESSAGE_COMPLETE:
                 uart_rx_context.state = WAIT_START_MARKER;
                 uart_rx_context.bytes_received = 0;
@@ -398,6 +1315,26 @@ void HIL_ProcessPingCommand(const HILMessage* msg) {
     HIL_SendResponse(RESPONSE_OK, &response);
 }
 
+/**
+ * Drop a partially received frame after HIL_RX_TIMEOUT_MS without bytes
+ * A lost byte would otherwise shift every later frame. An upload payload
+ * is only handed over once complete, so dropping it frees nothing else;
+ * this also ends skipping a rejected payload that was cut short.
+ */
+void HIL_CheckReceiveTimeout(void) {
+    if (uart_rx_context.state == WAIT_START_MARKER) {
+        return;
+    }
+
+    HAL_NVIC_DisableIRQ(USART3_IRQn);
+    if (uart_rx_context.state != WAIT_START_MARKER &&
+        HAL_GetTick() - uart_rx_context.last_byte_tick >= HIL_RX_TIMEOUT_MS) {
+        uart_rx_context.state = WAIT_START_MARKER;
+        uart_rx_context.bytes_received = 0;
+    }
+    HAL_NVIC_EnableIRQ(USART3_IRQn);
+}
+
 /**
  * Start UART reception in interrupt mode
  */
@@ -0,0 +1,153 @@
+/**
+ * @file isr_timing.c
+ * @brief Worst-case entry latency and execution time per interrupt
+ */
+
+#include "isr_timing.h"
+#include "profiler.h"
+#include <string.h>
+
+#if ISR_TIMING
+
+// Vector of each instrumented interrupt, for the priority in the report
+static const IRQn_Type isr_vectors[ISR_TIMING_COUNT] = {
+    TIM1_CC_IRQn,
+    TIM1_UP_TIM10_IRQn,
+    USART3_IRQn,
+    TIM2_IRQn,
+    TIM4_IRQn,
+    TIM5_IRQn,
+    DMA2_Stream1_IRQn,
+    TIM8_TRG_COM_TIM14_IRQn,
+    DMA1_Stream1_IRQn,
+    SysTick_IRQn,
+};
+
+// Interrupts whose hardware timestamps the event
+static const uint8_t isr_flags[ISR_TIMING_COUNT] = {
+    ISR_TIMING_FLAG_LATENCY,    // Captured value
+    ISR_TIMING_FLAG_LATENCY,    // Counter since update
+    0,
+    ISR_TIMING_FLAG_LATENCY,
+    ISR_TIMING_FLAG_LATENCY,
+    0,                          // Steps fired late by software would mask it, see the sequencer status
+    ISR_TIMING_FLAG_LATENCY,
+    ISR_TIMING_FLAG_LATENCY,
+    0,
+    ISR_TIMING_FLAG_LATENCY,    // SysTick down counter
+};
+
+typedef struct {
+    volatile uint32_t count;
+    volatile uint32_t max_latency;
+    volatile uint32_t max_cycles;
+} IsrRecord;
+
+static IsrRecord records[ISR_TIMING_COUNT];
+
+// Core cycles per timer clock cycle on each APB bus
+static uint32_t apb1_ratio = 0;
+static uint32_t apb2_ratio = 0;
+
+/**
+ * @brief Get the core cycles per timer clock cycle of one APB bus
+ * Timers run at twice the bus clock when the bus is divided.
+ * @param pclk Bus clock
+ * @param divided Non-zero if the bus prescaler divides
+ * @return Core cycles per timer clock cycle
+ */
+static uint32_t timer_ratio(uint32_t pclk, uint32_t divided) {
+    uint32_t timer_clock = divided ? pclk * 2 : pclk;
+
+    return timer_clock ? SystemCoreClock / timer_clock : 0;
+}
+
+/**
+ * @brief Enable the cycle counter and clear all records
+ */
+void ISR_Timing_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    apb1_ratio = timer_ratio(HAL_RCC_GetPCLK1Freq(), RCC->CFGR & RCC_CFGR_PPRE1_2);
+    apb2_ratio = timer_ratio(HAL_RCC_GetPCLK2Freq(), RCC->CFGR & RCC_CFGR_PPRE2_2);
+
+    ISR_Timing_Reset();
+}
+
+/**
+ * @brief Clear all records
+ * Each record is cleared with interrupts masked, so a concurrent update
+ * cannot carry an old maximum over.
+ */
+void ISR_Timing_Reset(void) {
+    for (uint8_t i = 0; i < ISR_TIMING_COUNT; i++) {
+        uint32_t primask = __get_PRIMASK();
+
+        __disable_irq();
+        records[i].count = 0;
+        records[i].max_latency = 0;
+        records[i].max_cycles = 0;
+        __set_PRIMASK(primask);
+    }
+}
+
+/**
+ * @brief Get the records of all interrupts
+ * Fields are read one by one without masking interrupts, so a record may
+ * already include an interrupt that the next field does not.
+ * @param report Destination for the report
+ */
+void ISR_Timing_GetReport(IsrTimingReport* report) {
+    if (report == NULL) {
+        return;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->core_hz = SystemCoreClock;
+
+    for (uint8_t i = 0; i < ISR_TIMING_COUNT; i++) {
+        report->isr[i].priority = (uint8_t)NVIC_GetPriority(isr_vectors[i]);
+        report->isr[i].flags = isr_flags[i];
+        report->isr[i].count = records[i].count;
+        report->isr[i].max_latency = records[i].max_latency;
+        report->isr[i].max_cycles = records[i].max_cycles;
+    }
+}
+
+/**
+ * @brief Convert timer ticks to core cycles
+ * @param tim Timer instance
+ * @param ticks Ticks at the present prescaler
+ * @return Core cycles
+ */
+uint32_t ISR_Timing_TimerCycles(const TIM_TypeDef* tim, uint32_t ticks) {
+    uint32_t ratio = ((uint32_t)tim >= APB2PERIPH_BASE) ? apb2_ratio : apb1_ratio;
+
+    return ticks * (tim->PSC + 1) * ratio;
+}
+
+/**
+ * @brief Record one interrupt
+ * @param isr ISR_TIMING_*
+ * @param latency Entry latency in core cycles, 0 if not measured
+ * @param start DWT->CYCCNT at entry
+ */
+void ISR_Timing_Record(uint8_t isr, uint32_t latency, uint32_t start) {
+    uint32_t cycles = DWT->CYCCNT - start;
+    IsrRecord* record = &records[isr];
+
+    record->count++;
+    if (latency > record->max_latency) {
+        record->max_latency = latency;
+    }
+    if (cycles > record->max_cycles) {
+        record->max_cycles = cycles;
+    }
+
+#if PROFILER
+    Profiler_Add(isr, cycles);
+#endif
+}
+
+#endif /* ISR_TIMING */
@@ -18,6 +18,7 @@
 /* USER CODE END Header */
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "dma.h"
 #include "tim.h"
 #include "usart.h"
 #include "usb_otg.h"
@@ -26,6 +27,16 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "pwm_capture.h"
+#include "analog_simulation.h"
+#include "freq_counter.h"
+#include "plant_model.h"
+#include "waveform.h"
+#include "sequencer.h"
+#include "analog_fault.h"
+#include "event_loop.h"
+#include "scheduler.h"
+#include "isr_timing.h"
+#include "profiler.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -92,21 +103,60 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART3_UART_Init();
   MX_USB_OTG_FS_PCD_Init();
   MX_TIM1_Init();
   MX_TIM2_Init();
   MX_TIM3_Init();
+  MX_TIM4_Init();
+  MX_TIM5_Init();
+  MX_TIM6_Init();
+  MX_TIM7_Init();
+  MX_TIM8_Init();
+  MX_TIM14_Init();
   /* USER CODE BEGIN 2 */
 
   HAL_UART_Transmit(&huart3, (uint8_t*)"Wiseled_LBR HIL System Initialized\r\n", 36, 100);
 
+  // Initialize main loop events before any interrupt can signal one
+  Event_Loop_Init();
+
+#if ISR_TIMING
+  // Start interrupt latency and execution time records
+  ISR_Timing_Init();
+#endif
+
+#if PROFILER
+  // Start the cycle profile window
+  Profiler_Init();
+#endif
+
   // Initialize PWM capture
   PWM_Capture_Init();
 
+  // Initialize frequency counter (idle until requested)
+  Freq_Counter_Init();
+
   // Initialize analog simulation
   Analog_Simulation_Init();
 
+  // Initialize plant model (disabled until requested)
+  Plant_Model_Init();
+
+  // Initialize waveform players (idle until requested)
+  Waveform_Init();
+
+  // Initialize stimulus sequencer (idle until requested)
+  Sequencer_Init();
+
+  // Initialize fault profiles (idle until requested)
+  Analog_Fault_Init();
+
+  // Initialize periodic tasks
+  Scheduler_Init();
+  Scheduler_AddTask(SCHEDULER_SLOT_100HZ, HIL_CheckReceiveTimeout);
+
   // Start PWM input capture
   PWM_Capture_Start();
 
@@ -116,6 +166,9 @@ int main(void)
   // Start UART reception in interrupt mode
   HIL_StartUARTReception();
 
+  // Start periodic tasks
+  Scheduler_Start();
+
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -126,8 +179,49 @@ int main(void)
 
     /* USER CODE BEGIN 3 */
 
+    // Sleep until an interrupt leaves work
+    uint32_t events = Event_Loop_Wait();
+
     // Process any received HIL messages
-    HIL_ProcessReceivedMessages();
+    if (events & EVENT_LOOP_HIL) {
+      HIL_ProcessReceivedMessages();
+    }
+
+#if PROFILER
+    uint32_t start = DWT->CYCCNT;
+#endif
+
+    // Report finished ramps
+    if (events & EVENT_LOOP_RAMP) {
+      Analog_ProcessRampEvents();
+    }
+
+    // Report finished scenarios
+    if (events & EVENT_LOOP_SEQUENCER) {
+      Sequencer_ProcessEvents();
+    }
+
+    // Report finished fault timelines
+    if (events & EVENT_LOOP_FAULT) {
+      Analog_Fault_ProcessEvents();
+    }
+
+#if PROFILER
+    if (events & (EVENT_LOOP_RAMP | EVENT_LOOP_SEQUENCER | EVENT_LOOP_FAULT)) {
+      Profiler_Add(PROFILER_EVENTS, DWT->CYCCNT - start);
+    }
+#endif
+
+    // Run released periodic tasks
+    if (events & EVENT_LOOP_SCHEDULER) {
+#if PROFILER
+      start = DWT->CYCCNT;
+      Scheduler_Run();
+      Profiler_Add(PROFILER_SCHEDULER, DWT->CYCCNT - start);
+#else
+      Scheduler_Run();
+#endif
+    }
   }
   /* USER CODE END 3 */
 }
@@ -184,6 +278,20 @@ void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
     // Delegate to the PWM_Capture module
     PWM_Capture_ProcessEvent(htim);
 }
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+    // Capture timer overflow drives edge-loss detection
+    PWM_Capture_ProcessOverflow(htim);
+
+    // Plant model tick
+    Plant_Model_Tick(htim);
+
+    // Analog ramp tick
+    Analog_RampTick(htim);
+
+    // Fault timeline tick
+    Analog_Fault_Tick(htim);
+}
 /* USER CODE END 4 */
 
 /**
@@ -0,0 +1,273 @@
+/**
+ * @file ntc_emulation.c
+ * @brief NTC thermistor divider emulation for the temperature outputs
+ */
+
+#include "ntc_emulation.h"
+#include <math.h>
+#include <string.h>
+
+#define KELVIN_OFFSET   273.15f
+#define T25_KELVIN      298.15f
+#define TABLE_STEP      (1 << NTC_TABLE_SHIFT)
+
+// Sensor model of one temperature output
+typedef struct {
+    NTCHeader header;
+    uint16_t  table[NTC_TABLE_SIZE];   // Output level per table step, nominal fine steps
+} NTCChannel;
+
+static NTCChannel ntc[3];
+
+/**
+ * @brief Temperature of a table entry
+ * @param index Table index
+ * @return Temperature in °C (C/T SET units)
+ */
+static float entry_temperature(uint16_t index) {
+    return ((float)index * TABLE_STEP * ANALOG_TEMPERATURE_FULL_SCALE) / ANALOG_FINE_MAX;
+}
+
+/**
+ * @brief Convert a voltage to an output level
+ * @param millivolts Output voltage in mV
+ * @return Output level in nominal fine steps, clamped to the output range
+ */
+static uint16_t level_from_mv(float millivolts) {
+    float level = millivolts * ANALOG_FINE_MAX / NTC_FULL_SCALE_MV;
+
+    if (level <= 0.0f) {
+        return 0;
+    }
+    if (level >= ANALOG_FINE_MAX) {
+        return ANALOG_FINE_MAX;
+    }
+    return (uint16_t)(level + 0.5f);
+}
+
+/**
+ * @brief Divider output voltage for a thermistor resistance
+ * @param header Divider description
+ * @param r_ntc Thermistor resistance in ohms
+ * @return Output voltage in mV
+ */
+static float divider_mv(const NTCHeader* header, float r_ntc) {
+    float r_fixed = (float)header->fixed_ohm;
+
+    if (header->topology == NTC_TOPOLOGY_LOW_SIDE) {
+        return header->supply_mv * r_ntc / (r_ntc + r_fixed);
+    }
+    return header->supply_mv * r_fixed / (r_ntc + r_fixed);
+}
+
+/**
+ * @brief Thermistor resistance from the Steinhart-Hart equation solved for R
+ * @param p Coefficients
+ * @param t_kelvin Temperature in K
+ * @return Resistance in ohms
+ */
+static float steinhart_hart_resistance(const NTCSteinhartHartParams* p, float t_kelvin) {
+    float x = (p->a - 1.0f / t_kelvin) / p->c;
+    float y = sqrtf(powf(p->b / (3.0f * p->c), 3.0f) + x * x / 4.0f);
+
+    return expf(cbrtf(y - x / 2.0f) - cbrtf(y + x / 2.0f));
+}
+
+/**
+ * @brief Set all temperature outputs to the linear model
+ */
+void NTC_Emulation_Init(void) {
+    memset(ntc, 0, sizeof(ntc));
+}
+
+/**
+ * @brief Select and evaluate the sensor model of a temperature output
+ * @param light_index Light index (0-2)
+ * @param payload NTCHeader followed by the model parameters
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t NTC_Emulation_Configure(uint8_t light_index, const uint8_t* payload, uint16_t length) {
+    NTCChannel channel;
+    const uint8_t* params;
+    uint16_t params_length;
+
+    if (light_index > 2 || payload == NULL || length < sizeof(NTCHeader)) {
+        return 0;
+    }
+
+    memcpy(&channel.header, payload, sizeof(NTCHeader));
+    params = payload + sizeof(NTCHeader);
+    params_length = length - sizeof(NTCHeader);
+
+    const NTCHeader* header = &channel.header;
+
+    if (header->topology > NTC_TOPOLOGY_HIGH_SIDE ||
+        ((header->model == NTC_MODEL_BETA || header->model == NTC_MODEL_STEINHART_HART) &&
+         (header->supply_mv == 0 || header->fixed_ohm == 0))) {
+        return 0;
+    }
+
+    switch (header->model) {
+        case NTC_MODEL_LINEAR:
+            if (params_length != 0) {
+                return 0;
+            }
+            return NTC_Emulation_Clear(light_index);
+
+        case NTC_MODEL_BETA:
+            {
+                NTCBetaParams p;
+
+                if (params_length != sizeof(p)) {
+                    return 0;
+                }
+                memcpy(&p, params, sizeof(p));
+                if (!(p.r25_ohm > 0.0f) || !(p.beta > 0.0f)) {
+                    return 0;
+                }
+
+                for (uint16_t i = 0; i < NTC_TABLE_SIZE; i++) {
+                    float t_kelvin = entry_temperature(i) + KELVIN_OFFSET;
+                    float r_ntc = p.r25_ohm * expf(p.beta * (1.0f / t_kelvin - 1.0f / T25_KELVIN));
+                    channel.table[i] = level_from_mv(divider_mv(header, r_ntc));
+                }
+            }
+            break;
+
+        case NTC_MODEL_STEINHART_HART:
+            {
+                NTCSteinhartHartParams p;
+
+                if (params_length != sizeof(p)) {
+                    return 0;
+                }
+                memcpy(&p, params, sizeof(p));
+                if (!(p.b > 0.0f) || !(p.c > 0.0f)) {
+                    return 0;
+                }
+
+                for (uint16_t i = 0; i < NTC_TABLE_SIZE; i++) {
+                    float r_ntc = steinhart_hart_resistance(&p, entry_temperature(i) + KELVIN_OFFSET);
+                    if (!(r_ntc > 0.0f) || isinf(r_ntc)) {
+                        return 0;
+                    }
+                    channel.table[i] = level_from_mv(divider_mv(header, r_ntc));
+                }
+            }
+            break;
+
+        case NTC_MODEL_CURVE:
+            {
+                NTCCurvePoint point[NTC_CURVE_MAX_POINTS];
+                uint8_t count = (params_length >= 2) ? params[0] : 0;
+                uint8_t segment = 0;
+
+                if (count < 2 || count > NTC_CURVE_MAX_POINTS ||
+                    params_length != 2 + count * sizeof(NTCCurvePoint)) {
+                    return 0;
+                }
+                memcpy(point, params + 2, count * sizeof(NTCCurvePoint));
+
+                for (uint8_t i = 1; i < count; i++) {
+                    if (point[i].temperature <= point[i - 1].temperature) {
+                        return 0;
+                    }
+                }
+
+                // Resample onto the table, holding the end voltages outside the curve
+                for (uint16_t i = 0; i < NTC_TABLE_SIZE; i++) {
+                    float t = entry_temperature(i);
+                    float mv;
+
+                    while (segment < count - 2 && t >= point[segment + 1].temperature) {
+                        segment++;
+                    }
+
+                    if (t <= point[0].temperature) {
+                        mv = point[0].millivolts;
+                    } else if (t >= point[count - 1].temperature) {
+                        mv = point[count - 1].millivolts;
+                    } else {
+                        const NTCCurvePoint* a = &point[segment];
+                        const NTCCurvePoint* b = &point[segment + 1];
+                        mv = a->millivolts + ((float)b->millivolts - a->millivolts) *
+                                             (t - a->temperature) / (b->temperature - a->temperature);
+                    }
+                    channel.table[i] = level_from_mv(mv);
+                }
+            }
+            break;
+
+        default:
+            return 0;
+    }
+
+    // Ramps and the plant model apply the table from the TIM4 tick, sequencer steps from TIM5
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    HAL_NVIC_DisableIRQ(TIM5_IRQn);
+    ntc[light_index] = channel;
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Return a temperature output to the linear model
+ * @param light_index Light index (0-2)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t NTC_Emulation_Clear(uint8_t light_index) {
+    if (light_index > 2) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    HAL_NVIC_DisableIRQ(TIM5_IRQn);
+    ntc[light_index].header.model = NTC_MODEL_LINEAR;
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Map a nominal temperature to the nominal output level of the sensor model
+ * @param light_index Light index (0-2)
+ * @param nominal Temperature in nominal fine steps (linear scale)
+ * @return Output level in nominal fine steps (0-ANALOG_FINE_MAX)
+ */
+uint16_t NTC_Emulation_Apply(uint8_t light_index, uint16_t nominal) {
+    const NTCChannel* channel = &ntc[light_index];
+
+    if (channel->header.model == NTC_MODEL_LINEAR) {
+        return nominal;
+    }
+
+    uint16_t index = nominal >> NTC_TABLE_SHIFT;
+    int32_t a = channel->table[index];
+    int32_t b = channel->table[index + 1];
+
+    return (uint16_t)(a + (((b - a) * (int32_t)(nominal & (TABLE_STEP - 1))) >> NTC_TABLE_SHIFT));
+}
+
+/**
+ * @brief Get the model header and evaluated table of a temperature output
+ * @param light_index Light index (0-2)
+ * @param header Destination for the header
+ * @param table Destination for NTC_TABLE_SIZE output levels, or NULL
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t NTC_Emulation_Get(uint8_t light_index, NTCHeader* header, uint16_t* table) {
+    if (light_index > 2 || header == NULL) {
+        return 0;
+    }
+
+    *header = ntc[light_index].header;
+    if (table != NULL) {
+        memcpy(table, ntc[light_index].table, sizeof(ntc[light_index].table));
+    }
+
+    return 1;
+}
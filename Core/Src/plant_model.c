@@ -0,0 +1,261 @@
+/**
+ * @file plant_model.c
+ * @brief On-device closed-loop plant model for Wiseled_LBR HIL
+ */
+
+#include "plant_model.h"
+#include "tim.h"
+#include "analog_simulation.h"
+#include "pwm_capture.h"
+#include "hil_comm_protocol.h"
+#include <string.h>
+
+#define PLANT_DT_MS  (1000.0f / PLANT_MODEL_TICK_HZ)
+
+// Working state of one light
+typedef struct {
+    PlantParams params;
+    uint8_t  enabled;
+    float    gain_a;            // Current at 100 % duty in A
+    float    heat_w_per_a;      // Heat per ampere: forward voltage times heat fraction
+    float    ambient_c;
+    float    rth_k_per_w;
+    float    alpha;             // Euler step weight dt / tau, at most 1
+    float    duty;              // 0-1
+    float    current_a;
+    float    power_w;
+    float    temperature_c;
+    uint32_t steps;
+} PlantChannel;
+
+static PlantChannel plant[3];
+
+// Defaults: 10 A at full duty into a 3 V load, 70 % heat, 5 K/W, 5 s time constant
+static const PlantParams default_params = {
+    .current_gain = 100,
+    .forward_voltage = 3000,
+    .heat_fraction = 700,
+    .ambient = 250,
+    .thermal_resistance = 500,
+    .time_constant = 5000,
+};
+
+/**
+ * @brief Derive the float coefficients of a light from its parameters
+ * @param ch Pointer to the light state
+ */
+static void load_coefficients(PlantChannel* ch) {
+    const PlantParams* p = &ch->params;
+    float alpha = PLANT_DT_MS / (float)p->time_constant;
+
+    ch->gain_a = p->current_gain / 10.0f;
+    ch->heat_w_per_a = (p->forward_voltage / 1000.0f) * (p->heat_fraction / 1000.0f);
+    ch->ambient_c = p->ambient / 10.0f;
+    ch->rth_k_per_w = p->thermal_resistance / 100.0f;
+    ch->alpha = (alpha > 1.0f) ? 1.0f : alpha;
+
+    ch->temperature_c = ch->ambient_c;
+    ch->current_a = 0.0f;
+    ch->power_w = 0.0f;
+    ch->duty = 0.0f;
+    ch->steps = 0;
+}
+
+/**
+ * @brief Advance the model of one light by one tick
+ * Current follows duty through the gain; temperature relaxes towards
+ * ambient + P * Rth with the RC time constant (forward Euler).
+ * @param ch Pointer to the light state
+ * @param duty Captured duty cycle (0-1)
+ */
+static void plant_step(PlantChannel* ch, float duty) {
+    float target;
+
+    ch->duty = duty;
+    ch->current_a = ch->gain_a * duty;
+    ch->power_w = ch->heat_w_per_a * ch->current_a;
+
+    target = ch->ambient_c + ch->power_w * ch->rth_k_per_w;
+    ch->temperature_c += (target - ch->temperature_c) * ch->alpha;
+    ch->steps++;
+}
+
+/**
+ * @brief Get the duty cycle of the latest capture of a light
+ * @param light_index Light index (0-2)
+ * @return Duty cycle (0-1)
+ */
+static float captured_duty(uint8_t light_index) {
+    PWMCaptureSnapshot snapshot;
+
+    if (!PWM_Capture_GetSnapshot(light_index, &snapshot)) {
+        return 0.0f;
+    }
+
+    // Static lines and period-only captures only carry the duty_cycle field
+    if ((snapshot.capture_flags & (PWM_CAPTURE_FLAG_STATIC | PWM_CAPTURE_FLAG_PERIOD_ONLY)) ||
+        snapshot.period == 0) {
+        return snapshot.duty_cycle / 100.0f;
+    }
+
+    float duty = (float)snapshot.pulse_width / (float)snapshot.period;
+    return (duty > 1.0f) ? 1.0f : duty;
+}
+
+/**
+ * @brief Write the modelled current and temperature of a light to its outputs
+ * @param light_index Light index (0-2)
+ * @param ch Pointer to the light state
+ */
+static void write_outputs(uint8_t light_index, const PlantChannel* ch) {
+    float current = ch->current_a * 10.0f;          // 0.1 A units
+    float temperature = ch->temperature_c;          // Full scale in degrees
+
+    if (current > ANALOG_CURRENT_FULL_SCALE) current = ANALOG_CURRENT_FULL_SCALE;
+    if (temperature > ANALOG_TEMPERATURE_FULL_SCALE) temperature = ANALOG_TEMPERATURE_FULL_SCALE;
+    if (temperature < 0.0f) temperature = 0.0f;
+
+    // Fine steps keep the model resolution on dithered outputs
+    Analog_SetOutputFine(light_index, ANALOG_OUTPUT_CURRENT,
+                         (uint16_t)(current * ANALOG_FINE_MAX / ANALOG_CURRENT_FULL_SCALE + 0.5f));
+    Analog_SetOutputFine(light_index, ANALOG_OUTPUT_TEMPERATURE,
+                         (uint16_t)(temperature * ANALOG_FINE_MAX / ANALOG_TEMPERATURE_FULL_SCALE + 0.5f));
+}
+
+/**
+ * @brief Start or stop the model tick depending on the enabled lights
+ */
+static void update_tick(void) {
+    uint8_t any = plant[0].enabled | plant[1].enabled | plant[2].enabled;
+
+    TIM4_Tick_Request(TIM4_TICK_PLANT, any);
+}
+
+/**
+ * @brief Reset all lights to the default parameters with the model disabled
+ */
+void Plant_Model_Init(void) {
+    for (int i = 0; i < 3; i++) {
+        plant[i].params = default_params;
+        plant[i].enabled = 0;
+        load_coefficients(&plant[i]);
+    }
+}
+
+/**
+ * @brief Load the parameters of a light from an upload payload
+ * @param light_index Light index (0-2)
+ * @param payload PlantParams structure
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Plant_Model_Configure(uint8_t light_index, const uint8_t* payload, uint16_t length) {
+    PlantParams params;
+
+    if (light_index > 2 || payload == NULL || length != sizeof(PlantParams)) {
+        return 0;
+    }
+
+    memcpy(&params, payload, sizeof(params));
+
+    if (params.current_gain > ANALOG_CURRENT_FULL_SCALE || params.heat_fraction > 1000 ||
+        params.ambient > ANALOG_TEMPERATURE_FULL_SCALE * 10 || params.time_constant == 0) {
+        return 0;
+    }
+
+    // The tick must not step a half-updated model
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    plant[light_index].params = params;
+    load_coefficients(&plant[light_index]);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Enable or disable the model of a light
+ * @param light_index Light index (0-2)
+ * @param enable 1 to enable, 0 to disable
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Plant_Model_Enable(uint8_t light_index, uint8_t enable) {
+    if (light_index > 2 || enable > 1) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    if (enable && !plant[light_index].enabled) {
+        // Start from thermal equilibrium with ambient
+        load_coefficients(&plant[light_index]);
+    }
+    plant[light_index].enabled = enable;
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    update_tick();
+
+    return 1;
+}
+
+/**
+ * @brief Check whether the model drives the outputs of a light
+ * @param light_index Light index (0-2)
+ * @return 1 if enabled, 0 otherwise
+ */
+uint8_t Plant_Model_IsEnabled(uint8_t light_index) {
+    if (light_index > 2) {
+        return 0;
+    }
+
+    return plant[light_index].enabled;
+}
+
+/**
+ * @brief Step all enabled models
+ * Runs at the capture interrupt priority or below, so the capture seqlock
+ * writer is never preempted by this reader.
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void Plant_Model_Tick(TIM_HandleTypeDef *htim) {
+    if (htim->Instance != TIM4) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < 3; i++) {
+        if (!plant[i].enabled) {
+            continue;
+        }
+
+        plant_step(&plant[i], captured_duty(i));
+        write_outputs(i, &plant[i]);
+    }
+}
+
+/**
+ * @brief Get the model state of a light
+ * @param light_index Light index (0-2)
+ * @param state Destination for the state
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Plant_Model_GetState(uint8_t light_index, PlantState* state) {
+    if (light_index > 2 || state == NULL) {
+        return 0;
+    }
+
+    const PlantChannel* ch = &plant[light_index];
+    float temperature;
+
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
+    state->enabled = ch->enabled;
+    state->reserved = 0;
+    state->duty = (uint16_t)(ch->duty * 10000.0f + 0.5f);
+    state->current = (uint16_t)(ch->current_a * 10.0f + 0.5f);
+    temperature = ch->temperature_c * 10.0f;
+    if (temperature < 0.0f) temperature = 0.0f;
+    if (temperature > 65535.0f) temperature = 65535.0f;
+    state->temperature = (uint16_t)(temperature + 0.5f);
+    state->power_mw = (uint32_t)(ch->power_w * 1000.0f + 0.5f);
+    state->steps = ch->steps;
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+
+    return 1;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file profiler.c
+ * @brief Cycle profile of interrupts, command handlers and idle time
+ */
+
+#include "profiler.h"
+#include <string.h>
+
+#if PROFILER
+
+typedef struct {
+    uint32_t count;
+    uint64_t cycles;
+} ProfilerCounter;
+
+static ProfilerCounter counters[PROFILER_ENTRIES];
+static uint64_t elapsed_cycles = 0;
+static uint32_t last_cyccnt = 0;
+
+/**
+ * @brief Enable the cycle counter and start a new profile window
+ */
+void Profiler_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    Profiler_Reset();
+}
+
+/**
+ * @brief Clear all entries and start a new profile window
+ * Each entry is cleared with interrupts masked, interrupt entries are
+ * updated from their handlers.
+ */
+void Profiler_Reset(void) {
+    for (uint8_t i = 0; i < PROFILER_ENTRIES; i++) {
+        uint32_t primask = __get_PRIMASK();
+
+        __disable_irq();
+        counters[i].count = 0;
+        counters[i].cycles = 0;
+        __set_PRIMASK(primask);
+    }
+
+    elapsed_cycles = 0;
+    last_cyccnt = DWT->CYCCNT;
+}
+
+/**
+ * @brief Extend the profile window to the present cycle count
+ */
+void Profiler_Update(void) {
+    uint32_t now = DWT->CYCCNT;
+
+    elapsed_cycles += now - last_cyccnt;
+    last_cyccnt = now;
+}
+
+/**
+ * @brief Add one run to an entry
+ * @param entry PROFILER_* or ISR_TIMING_*
+ * @param cycles Core cycles of the run
+ */
+void Profiler_Add(uint8_t entry, uint32_t cycles) {
+    counters[entry].count++;
+    counters[entry].cycles += cycles;
+}
+
+/**
+ * @brief Get the profile of the present window
+ * Each entry is copied with interrupts masked, so its 64-bit sum is
+ * never torn by an interrupt updating it.
+ * @param report Destination for the profile
+ */
+void Profiler_GetReport(ProfilerReport* report) {
+    if (report == NULL) {
+        return;
+    }
+
+    memset(report, 0, sizeof(*report));
+
+    Profiler_Update();
+    report->core_hz = SystemCoreClock;
+    report->elapsed_cycles = elapsed_cycles;
+
+    for (uint8_t i = 0; i < PROFILER_ENTRIES; i++) {
+        uint32_t primask = __get_PRIMASK();
+
+        __disable_irq();
+        report->entry[i].count = counters[i].count;
+        report->entry[i].cycles = counters[i].cycles;
+        __set_PRIMASK(primask);
+    }
+}
+
+#endif /* PROFILER */
@@ -6,200 +6,829 @@
 #include "pwm_capture.h"
 #include "tim.h"
 #include "hil_comm_protocol.h"
+#include "pwm_statistics.h"
+#include "pwm_history.h"
+#include "capture_trigger.h"
+#include "isr_timing.h"
 
 // Global array to store capture data for each channel (defined in main.c before move)
-PWMCaptureData pwm_capture[3] = {0};
-
-// Private variables
-static uint32_t rising_edge[3] = {0, 0, 0};
-static uint32_t falling_edge[3] = {0, 0, 0};
-static uint8_t capture_state[3] = {0, 0, 0}; // 0: waiting for rising, 1: waiting for falling
+PWMCaptureData pwm_capture[PWM_CAPTURE_CHANNELS] = {0};
+
+// Working state of one capture channel
+typedef struct {
+    uint32_t rising_edge;       // Counter value of the last leading edge (falling for active-low inputs)
+    uint32_t rise_time;         // Last leading edge on the shared timebase
+    uint32_t prev_rise_time;    // Leading edge of the previous cycle on the shared timebase
+    uint16_t edge_overflows;    // Timer overflows since the last edge
+    uint8_t  capture_state;     // 0: waiting for rising, 1: waiting for falling
+    uint8_t  resync;            // 1: next cycle only re-establishes the period reference
+    uint8_t  icpsc_shift;       // log2 of the input capture prescaler, >0 selects period-only capture
+    uint8_t  static_confirmed;  // 1: static line confirmed in the slowest range
+} PWMCaptureChannelState;
+
+// Hardware of one capture channel; the table index is the channel index
+typedef struct {
+    TIM_HandleTypeDef* htim;
+    uint32_t channel;               // TIM_CHANNEL_x
+    HAL_TIM_ActiveChannel active;   // htim->Channel value reported by the HAL for this input
+    uint32_t cc_flag;               // TIM_FLAG_CCx, also the CCxIE bit in DIER
+    volatile uint32_t* ccr;         // Capture register
+    volatile uint32_t* ccmr;        // Capture mode register holding the input filter
+    uint32_t filter_pos;            // Bit position of ICxF in ccmr
+    uint32_t ccer_enable;           // CCxE capture enable bit
+    uint32_t ccer_polarity;         // CCxP | CCxNP edge selection bits
+    uint32_t ccer_falling;          // CCER bits selecting the falling edge
+    GPIO_TypeDef* port;             // Input pin, sampled when the line is static
+    uint16_t pin;
+} PWMCaptureChannel;
+
+// Capture inputs, ordered by timer channel so the CCxIF bit position selects the entry
+static const PWMCaptureChannel capture_table[PWM_CAPTURE_CHANNELS] = {
+    {&htim1, TIM_CHANNEL_1, HAL_TIM_ACTIVE_CHANNEL_1, TIM_FLAG_CC1, &TIM1->CCR1,
+     &TIM1->CCMR1, TIM_CCMR1_IC1F_Pos, TIM_CCER_CC1E,
+     TIM_CCER_CC1P | TIM_CCER_CC1NP, TIM_CCER_CC1P, GPIOE, GPIO_PIN_9},
+    {&htim1, TIM_CHANNEL_2, HAL_TIM_ACTIVE_CHANNEL_2, TIM_FLAG_CC2, &TIM1->CCR2,
+     &TIM1->CCMR1, TIM_CCMR1_IC2F_Pos, TIM_CCER_CC2E,
+     TIM_CCER_CC2P | TIM_CCER_CC2NP, TIM_CCER_CC2P, GPIOE, GPIO_PIN_11},
+    {&htim1, TIM_CHANNEL_3, HAL_TIM_ACTIVE_CHANNEL_3, TIM_FLAG_CC3, &TIM1->CCR3,
+     &TIM1->CCMR2, TIM_CCMR2_IC3F_Pos, TIM_CCER_CC3E,
+     TIM_CCER_CC3P | TIM_CCER_CC3NP, TIM_CCER_CC3P, GPIOE, GPIO_PIN_13},
+};
+
+// Capture/compare interrupt flags of all table entries
+#define CAPTURE_CC_FLAGS  (TIM_FLAG_CC1 | TIM_FLAG_CC2 | TIM_FLAG_CC3)
+
+static PWMCaptureChannelState channel_state[PWM_CAPTURE_CHANNELS];
+
+// Runtime input configuration, kept across PWM_Capture_Init so it survives TIM1 re-initialization
+static PWMCaptureConfig channel_config[PWM_CAPTURE_CHANNELS] = {
+    {PWM_CAPTURE_DEFAULT_FILTER, 0, 0},
+    {PWM_CAPTURE_DEFAULT_FILTER, 0, 0},
+    {PWM_CAPTURE_DEFAULT_FILTER, 0, 0},
+};
+static uint8_t capture_running = 0;           // 1 while TIM1 is configured for input capture
+static volatile uint32_t timebase_overflows = 0; // Capture timer wraps, extends captures to a shared 32-bit timebase
+static uint8_t timebase_epoch = 0;            // Incremented whenever the timebase restarts or changes tick length
+
+// Auto-ranging state
+static uint8_t autorange_enabled = 0;
+static uint8_t capture_range = PWM_RANGE_DEFAULT;
+static int8_t range_votes = 0;                // Consecutive overflow evaluations asking for a faster (+) or slower (-) range
+
+// Capture timer prescaler of each range, slowest first (TIM1 clock is 168 MHz)
+static const uint16_t range_prescaler[PWM_RANGE_COUNT] = {839, 83, 7, 0};
+static const uint32_t icpsc_values[4] = {TIM_ICPSC_DIV1, TIM_ICPSC_DIV2, TIM_ICPSC_DIV4, TIM_ICPSC_DIV8};
+
+// Records published to the main loop, one seqlock per channel
+typedef struct {
+    volatile uint32_t sequence;     // Odd while the interrupt is writing the record
+    PWMCaptureSnapshot record;
+} PWMCapturePublished;
+
+static PWMCapturePublished published[PWM_CAPTURE_CHANNELS];
+static uint32_t consumed_sequence[PWM_CAPTURE_CHANNELS];   // Last sequence returned by PWM_Capture_ConsumeSnapshot
+
+#if PWM_CAPTURE_CYCLE_COUNT
+// DWT cycle accounting of the capture interrupt
+static volatile uint32_t isr_edges = 0;
+static volatile uint32_t isr_last = 0;
+static volatile uint32_t isr_max = 0;
+static volatile uint64_t isr_total = 0;
+#endif
+
+static void apply_channel_config(uint8_t channel);
 
 #define DUTY_CYCLE_SCALER 100
+#define EDGE_TIMEOUT_PERIODS 3    // Expected periods without edges before a line is reported static
+
+// Auto-ranging thresholds in percent of the timer wrap period
+#define RANGE_DOWN_PERCENT   85   // Switch to a slower range above this
+#define RANGE_UP_PERCENT     60   // Switch to a faster range if the period stays below this afterwards
+#define RANGE_VOTES          4    // Consecutive evaluations required before switching
+#define ICPSC_MAX_TICKS      2000 // Periods shorter than this use the input capture prescaler in the fastest range
+
+/**
+ * @brief Select the edge a capture channel triggers on
+ * Register-level equivalent of __HAL_TIM_SET_CAPTUREPOLARITY without the
+ * per-channel dispatch, as it runs on every edge. Active-low inputs start
+ * their on-time with the falling edge.
+ * @param channel Channel index
+ * @param trailing 0 for the edge starting the on-time, 1 for the edge ending it
+ */
+static inline void set_capture_edge(uint8_t channel, uint8_t trailing) {
+    const PWMCaptureChannel* desc = &capture_table[channel];
+    TIM_TypeDef* tim = desc->htim->Instance;
+    uint8_t falling = trailing ^ channel_config[channel].active_low;
+
+    tim->CCER = (tim->CCER & ~desc->ccer_polarity) | (falling ? desc->ccer_falling : 0);
+}
+
+/**
+ * @brief Publish the working capture data of a channel to readers
+ * Seqlock writer: the sequence is odd while the record is being written,
+ * so readers can detect and retry torn copies without masking interrupts.
+ * Called from TIM1 interrupt context only.
+ * @param channel Channel index (0-2)
+ */
+static void publish_capture(uint8_t channel) {
+    PWMCapturePublished* pub = &published[channel];
+
+    pub->sequence++;
+    __DMB();
+    pub->record.pulse_width = pwm_capture[channel].pulse_width;
+    pub->record.period = pwm_capture[channel].period;
+    pub->record.duty_cycle = pwm_capture[channel].duty_cycle;
+    pub->record.capture_flags = pwm_capture[channel].capture_flags;
+    pub->record.rise_time = channel_state[channel].rise_time;
+    pub->record.timebase_epoch = timebase_epoch;
+    __DMB();
+    pub->sequence++;
+}
 
 /**
  * @brief Initialize PWM input capture
  */
 void PWM_Capture_Init(void) {
     // Reset all capture data
-    for(int i = 0; i < 3; i++) {
+    for(int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
         pwm_capture[i].current_capture = 0;
         pwm_capture[i].last_capture = 0;
         pwm_capture[i].pulse_width = 0;
         pwm_capture[i].period = 0;
         pwm_capture[i].duty_cycle = 0;
         pwm_capture[i].capture_complete = 0;
-
-        rising_edge[i] = 0;
-        falling_edge[i] = 0;
-        capture_state[i] = 0;
+        pwm_capture[i].capture_flags = 0;
+
+        published[i].sequence = 0;
+        consumed_sequence[i] = 0;
+
+        channel_state[i].rising_edge = 0;
+        channel_state[i].capture_state = 0;
+        channel_state[i].edge_overflows = 0;
+        channel_state[i].resync = 0;
+        channel_state[i].icpsc_shift = 0;
+        channel_state[i].static_confirmed = 0;
+        channel_state[i].rise_time = 0;
+        channel_state[i].prev_rise_time = 0;
     }
+
+    timebase_overflows = 0;
+    timebase_epoch++;
+    autorange_enabled = 0;
+    capture_range = PWM_RANGE_DEFAULT;
+    range_votes = 0;
+
+#if PWM_CAPTURE_CYCLE_COUNT
+    // Enable the DWT cycle counter for interrupt cost measurement
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    isr_edges = 0;
+    isr_last = 0;
+    isr_max = 0;
+    isr_total = 0;
+#endif
+
+    // Reset capture statistics, history and trigger
+    PWM_Statistics_Init();
+    PWM_History_Init();
+    Capture_Trigger_Init();
 }
 
 /**
  * @brief Start PWM input capture on all channels
  */
 void PWM_Capture_Start(void) {
-    // Start PWM input capture interrupt for TIM1
-    HAL_TIM_IC_Start_IT(&htim1, TIM_CHANNEL_1);
-    HAL_TIM_IC_Start_IT(&htim1, TIM_CHANNEL_2);
-    HAL_TIM_IC_Start_IT(&htim1, TIM_CHANNEL_3);
+    // Start PWM input capture interrupt for every table entry
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        apply_channel_config(i);
+        HAL_TIM_IC_Start_IT(capture_table[i].htim, capture_table[i].channel);
+    }
+
+    capture_running = 1;
+
+    // Update interrupt drives edge-loss detection
+    __HAL_TIM_CLEAR_FLAG(&htim1, TIM_FLAG_UPDATE);
+    __HAL_TIM_ENABLE_IT(&htim1, TIM_IT_UPDATE);
 }
 
 /**
  * @brief Stop PWM input capture on all channels
  */
 void PWM_Capture_Stop(void) {
-    // Stop PWM input capture interrupt for TIM1
-    HAL_TIM_IC_Stop_IT(&htim1, TIM_CHANNEL_1);
-    HAL_TIM_IC_Stop_IT(&htim1, TIM_CHANNEL_2);
-    HAL_TIM_IC_Stop_IT(&htim1, TIM_CHANNEL_3);
+    // Stop PWM input capture interrupt for every table entry
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        HAL_TIM_IC_Stop_IT(capture_table[i].htim, capture_table[i].channel);
+    }
+
+    capture_running = 0;
+
+    __HAL_TIM_DISABLE_IT(&htim1, TIM_IT_UPDATE);
 }
 
 /**
- * @brief Process PWM input capture events
- * This function is the implementation of what was HAL_TIM_IC_CaptureCallback in main.c
+ * @brief Extend a captured counter value to the shared 32-bit timebase
+ * All channels capture on TIM1, so extended values of different channels
+ * can be compared directly. Differences stay exact across the 32-bit wrap.
  * @param htim Pointer to the TIM_HandleTypeDef structure
+ * @param capture_value Captured counter value
+ * @return Timestamp in timer ticks of the active range
  */
-void PWM_Capture_ProcessEvent(TIM_HandleTypeDef *htim) {
-    // Ensure this is TIM1 input capture
-    if (htim->Instance == TIM1) {
-        // Process channel 1
-        if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1) {
-            uint32_t capture_value = HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_1);
-
-            if (capture_state[0] == 0) { // Rising edge
-                rising_edge[0] = capture_value;
-                capture_state[0] = 1;
-
-                // Configure for falling edge
-                __HAL_TIM_SET_CAPTUREPOLARITY(htim, TIM_CHANNEL_1, TIM_INPUTCHANNELPOLARITY_FALLING);
-            } else { // Falling edge
-                falling_edge[0] = capture_value;
-                capture_state[0] = 0;
-
-                // Calculate pulse width
-                if (falling_edge[0] >= rising_edge[0]) {
-                    pwm_capture[0].pulse_width = falling_edge[0] - rising_edge[0];
-                } else {
-                    // Handle timer overflow
-                    pwm_capture[0].pulse_width = ((htim->Init.Period + 1) - rising_edge[0]) + falling_edge[0];
-                }
+static uint32_t extend_timestamp(TIM_HandleTypeDef *htim, uint32_t capture_value) {
+    uint32_t wrap = htim->Init.Period + 1;
+    uint32_t overflows = timebase_overflows;
 
-                // Calculate period (will be updated on next rising edge)
-                if (pwm_capture[0].last_capture <= rising_edge[0]) {
-                    pwm_capture[0].period = rising_edge[0] - pwm_capture[0].last_capture;
-                } else {
-                    // Handle timer overflow
-                    pwm_capture[0].period = ((htim->Init.Period + 1) - pwm_capture[0].last_capture) + rising_edge[0];
-                }
+    // A wrap whose update interrupt is still pending belongs to captures taken after it
+    if (__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) && capture_value < wrap / 2) {
+        overflows++;
+    }
 
-                // Store current rising edge for next period calculation
-                pwm_capture[0].last_capture = rising_edge[0];
+    return overflows * wrap + capture_value;
+}
 
-                // Calculate duty cycle (0-1000 range)
-                if (pwm_capture[0].period > 0) {
-                    pwm_capture[0].duty_cycle = (pwm_capture[0].pulse_width * DUTY_CYCLE_SCALER) / pwm_capture[0].period;
-                }
+/**
+ * @brief Limit a tick count to the 16-bit capture fields
+ * A saturated period is above every range's wrap, so auto-ranging moves to a slower range.
+ * @param ticks Tick count
+ * @return Tick count, at most 0xFFFF
+ */
+static inline uint16_t saturate_ticks(uint32_t ticks) {
+    return (ticks > 0xFFFF) ? 0xFFFF : (uint16_t)ticks;
+}
+
+/**
+ * @brief Measure the period of a channel whose input capture prescaler is active
+ * Only rising edges are captured, so the duty cycle keeps its last value.
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ * @param channel Channel index (0-2)
+ * @param capture_value Captured counter value
+ */
+static void capture_period_only(TIM_HandleTypeDef *htim, uint8_t channel, uint32_t capture_value) {
+    PWMCaptureChannelState* st = &channel_state[channel];
+
+    st->prev_rise_time = st->rise_time;
+    st->rise_time = extend_timestamp(htim, capture_value);
+
+    if (st->resync) {
+        st->resync = 0;
+        pwm_capture[channel].last_capture = capture_value;
+        return;
+    }
+
+    // Timestamp difference, exact even if the prescaled span covers several counter wraps
+    uint32_t delta = st->rise_time - st->prev_rise_time;
+
+    // Average over the prescaled edges
+    pwm_capture[channel].period = saturate_ticks((delta + (1U << (st->icpsc_shift - 1))) >> st->icpsc_shift);
+    pwm_capture[channel].last_capture = capture_value;
+    pwm_capture[channel].capture_complete = 1;
+    pwm_capture[channel].capture_flags = PWM_CAPTURE_FLAG_PERIOD_ONLY;
+    publish_capture(channel);
+}
 
-                // Mark capture as complete
-                pwm_capture[0].capture_complete = 1;
+/**
+ * @brief Set the input capture prescaler of a channel
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ * @param channel Channel index (0-2)
+ * @param shift log2 of the prescaler (0-3)
+ */
+static void set_icpsc(TIM_HandleTypeDef *htim, uint8_t channel, uint8_t shift) {
+    channel_state[channel].icpsc_shift = shift;
+    channel_state[channel].resync = 1;
+    channel_state[channel].capture_state = 0;
+
+    __HAL_TIM_SET_ICPRESCALER(htim, capture_table[channel].channel, icpsc_values[shift]);
+    set_capture_edge(channel, 0);
+}
+
+/**
+ * @brief Load the runtime input configuration of a channel into TIM1
+ * Only this channel's capture is paused while its filter and prescaler
+ * change; the other channels keep running.
+ * @param channel Channel index
+ */
+static void apply_channel_config(uint8_t channel) {
+    const PWMCaptureChannel* desc = &capture_table[channel];
+    const PWMCaptureConfig* cfg = &channel_config[channel];
+    TIM_TypeDef* tim = desc->htim->Instance;
+    uint32_t enabled = tim->CCER & desc->ccer_enable;
+
+    tim->CCER &= ~desc->ccer_enable;
+    *desc->ccmr = (*desc->ccmr & ~(0xFUL << desc->filter_pos)) | ((uint32_t)cfg->filter << desc->filter_pos);
+    set_icpsc(desc->htim, channel, cfg->prescaler);
+    tim->CCER |= enabled;
+}
+
+/**
+ * @brief Switch the capture timer to another range
+ * Measurements in flight are discarded and stored periods are rescaled.
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ * @param range New range index
+ */
+static void switch_range(TIM_HandleTypeDef *htim, uint8_t range) {
+    uint32_t old_div = range_prescaler[capture_range] + 1;
+    uint32_t new_div = range_prescaler[range] + 1;
 
-                // Configure for next rising edge
-                __HAL_TIM_SET_CAPTUREPOLARITY(htim, TIM_CHANNEL_1, TIM_INPUTCHANNELPOLARITY_RISING);
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        uint32_t period = (pwm_capture[i].period * old_div) / new_div;
+        uint32_t pulse_width = (pwm_capture[i].pulse_width * old_div) / new_div;
+
+        pwm_capture[i].period = (period > 0xFFFF) ? 0xFFFF : period;
+        pwm_capture[i].pulse_width = (pulse_width > 0xFFFF) ? 0xFFFF : pulse_width;
+
+        // Automatic input capture prescaling is only used in the fastest range
+        set_icpsc(htim, i, channel_config[i].prescaler);
+
+        // Statistics and history samples are in timer ticks of one range
+        PWM_Statistics_Restart(i);
+        PWM_History_AddRangeMarker(i, range);
+    }
+
+    capture_range = range;
+    range_votes = 0;
+
+    // Timestamps taken before the counter restart cannot be compared with later ones
+    timebase_epoch++;
+
+    // Load the new prescaler immediately and restart the counter
+    htim->Init.Prescaler = range_prescaler[range];
+    __HAL_TIM_SET_PRESCALER(htim, range_prescaler[range]);
+    htim->Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+}
+
+/**
+ * @brief Pick the best capture range for the measured periods
+ * Called once per capture timer overflow while auto-ranging is enabled.
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+static void evaluate_range(TIM_HandleTypeDef *htim) {
+    uint32_t wrap = htim->Init.Period + 1;
+    uint32_t slowest = 0;
+    uint8_t measured = 0;
+    uint8_t probe_slower = 0;
+
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        if (pwm_capture[i].capture_flags & PWM_CAPTURE_FLAG_STATIC) {
+            // A line that stops toggling may also be a signal slower than this range
+            if (capture_range == 0) {
+                channel_state[i].static_confirmed = 1;
+            }
+            if (!channel_state[i].static_confirmed) {
+                probe_slower = 1;
             }
+            continue;
         }
 
-        // Process channel 2 (similar logic)
-        if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2) {
-            uint32_t capture_value = HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_2);
-
-            if (capture_state[1] == 0) { // Rising edge
-                rising_edge[1] = capture_value;
-                capture_state[1] = 1;
-
-                // Configure for falling edge
-                __HAL_TIM_SET_CAPTUREPOLARITY(htim, TIM_CHANNEL_2, TIM_INPUTCHANNELPOLARITY_FALLING);
-            } else { // Falling edge
-                falling_edge[1] = capture_value;
-                capture_state[1] = 0;
-
-                // Calculate pulse width
-                if (falling_edge[1] >= rising_edge[1]) {
-                    pwm_capture[1].pulse_width = falling_edge[1] - rising_edge[1];
-                } else {
-                    // Handle timer overflow
-                    pwm_capture[1].pulse_width = ((htim->Init.Period + 1) - rising_edge[1]) + falling_edge[1];
-                }
+        channel_state[i].static_confirmed = 0;
 
-                // Calculate period (will be updated on next rising edge)
-                if (pwm_capture[1].last_capture <= rising_edge[1]) {
-                    pwm_capture[1].period = rising_edge[1] - pwm_capture[1].last_capture;
-                } else {
-                    // Handle timer overflow
-                    pwm_capture[1].period = ((htim->Init.Period + 1) - pwm_capture[1].last_capture) + rising_edge[1];
-                }
+        if (!pwm_capture[i].capture_complete) {
+            continue;
+        }
+        measured = 1;
 
-                // Store current rising edge for next period calculation
-                pwm_capture[1].last_capture = rising_edge[1];
+        // Periods measured with the input capture prescaler span several cycles
+        uint32_t span = (uint32_t)pwm_capture[i].period << channel_state[i].icpsc_shift;
+        if (span > slowest) {
+            slowest = span;
+        }
+    }
 
-                // Calculate duty cycle (0-1000 range)
-                if (pwm_capture[1].period > 0) {
-                    pwm_capture[1].duty_cycle = (pwm_capture[1].pulse_width * DUTY_CYCLE_SCALER) / pwm_capture[1].period;
-                }
+    if (probe_slower && capture_range > 0) {
+        switch_range(htim, capture_range - 1);
+        return;
+    }
 
-                // Mark capture as complete
-                pwm_capture[1].capture_complete = 1;
+    // A zero period is a signal faster than one tick and still asks for a faster range
+    if (!measured) {
+        range_votes = 0;
+        return;
+    }
+
+    // 64-bit products: a prescaled span times the range ratio overflows 32 bits
+    if (capture_range > 0 && (uint64_t)slowest * 100 > (uint64_t)wrap * RANGE_DOWN_PERCENT) {
+        range_votes = (range_votes > 0) ? -1 : range_votes - 1;
+    } else if (capture_range < PWM_RANGE_COUNT - 1 &&
+               (uint64_t)slowest * (range_prescaler[capture_range] + 1) * 100 <
+               (uint64_t)wrap * (range_prescaler[capture_range + 1] + 1) * RANGE_UP_PERCENT) {
+        range_votes = (range_votes < 0) ? 1 : range_votes + 1;
+    } else {
+        range_votes = 0;
+    }
+
+    if (range_votes <= -RANGE_VOTES) {
+        switch_range(htim, capture_range - 1);
+        return;
+    }
+    if (range_votes >= RANGE_VOTES) {
+        switch_range(htim, capture_range + 1);
+        return;
+    }
 
-                // Configure for next rising edge
-                __HAL_TIM_SET_CAPTUREPOLARITY(htim, TIM_CHANNEL_2, TIM_INPUTCHANNELPOLARITY_RISING);
+    // In the fastest range, trade duty measurement for fewer interrupts on very short periods
+    if (capture_range == PWM_RANGE_COUNT - 1) {
+        for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+            // A prescaler set over the protocol is left alone
+            if ((pwm_capture[i].capture_flags & PWM_CAPTURE_FLAG_STATIC) || channel_config[i].prescaler) {
+                continue;
             }
-        }
 
-        // Process channel 3 (similar logic)
-        if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_3) {
-            uint32_t capture_value = HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_3);
-
-            if (capture_state[2] == 0) { // Rising edge
-                rising_edge[2] = capture_value;
-                capture_state[2] = 1;
-
-                // Configure for falling edge
-                __HAL_TIM_SET_CAPTUREPOLARITY(htim, TIM_CHANNEL_3, TIM_INPUTCHANNELPOLARITY_FALLING);
-            } else { // Falling edge
-                falling_edge[2] = capture_value;
-                capture_state[2] = 0;
-
-                // Calculate pulse width
-                if (falling_edge[2] >= rising_edge[2]) {
-                    pwm_capture[2].pulse_width = falling_edge[2] - rising_edge[2];
-                } else {
-                    // Handle timer overflow
-                    pwm_capture[2].pulse_width = ((htim->Init.Period + 1) - rising_edge[2]) + falling_edge[2];
-                }
+            uint32_t period = pwm_capture[i].period;
+            uint8_t shift = 0;
 
-                // Calculate period (will be updated on next rising edge)
-                if (pwm_capture[2].last_capture <= rising_edge[2]) {
-                    pwm_capture[2].period = rising_edge[2] - pwm_capture[2].last_capture;
-                } else {
-                    // Handle timer overflow
-                    pwm_capture[2].period = ((htim->Init.Period + 1) - pwm_capture[2].last_capture) + rising_edge[2];
+            if (period > 0 && period < ICPSC_MAX_TICKS) {
+                // Largest prescaler whose span still fits well inside the wrap period
+                while (shift < 3 && (period << (shift + 1)) * 100 < wrap * RANGE_UP_PERCENT) {
+                    shift++;
                 }
+            } else if (channel_state[i].icpsc_shift && period < (ICPSC_MAX_TICKS * 3) / 2) {
+                // Hysteresis before returning to full duty measurement
+                shift = channel_state[i].icpsc_shift;
+            }
 
-                // Store current rising edge for next period calculation
-                pwm_capture[2].last_capture = rising_edge[2];
+            if (shift != channel_state[i].icpsc_shift) {
+                set_icpsc(htim, i, shift);
+            }
+        }
+    }
+}
 
-                // Calculate duty cycle (0-1000 range)
-                if (pwm_capture[2].period > 0) {
-                    pwm_capture[2].duty_cycle = (pwm_capture[2].pulse_width * DUTY_CYCLE_SCALER) / pwm_capture[2].period;
-                }
+/**
+ * @brief Process one captured edge of a channel
+ * Shared by the register-level interrupt handler and the HAL callback path.
+ * @param channel Channel index
+ * @param capture_value Captured counter value
+ */
+static void process_edge(uint8_t channel, uint32_t capture_value) {
+    const PWMCaptureChannel* desc = &capture_table[channel];
+    PWMCaptureChannelState* st = &channel_state[channel];
+    PWMCaptureData* cap = &pwm_capture[channel];
+    TIM_HandleTypeDef* htim = desc->htim;
 
-                // Mark capture as complete
-                pwm_capture[2].capture_complete = 1;
+    st->edge_overflows = 0;
 
-                // Configure for next rising edge
-                __HAL_TIM_SET_CAPTUREPOLARITY(htim, TIM_CHANNEL_3, TIM_INPUTCHANNELPOLARITY_RISING);
-            }
+    if (st->icpsc_shift) {
+        capture_period_only(htim, channel, capture_value);
+        return;
+    }
+
+    if (st->capture_state == 0) { // Rising edge
+        st->rising_edge = capture_value;
+        st->prev_rise_time = st->rise_time;
+        st->rise_time = extend_timestamp(htim, capture_value);
+        st->capture_state = 1;
+
+        // Configure for falling edge
+        set_capture_edge(channel, 1);
+        return;
+    }
+
+    // Falling edge
+    st->capture_state = 0;
+
+    // Configure for next rising edge
+    set_capture_edge(channel, 0);
+
+    if (st->resync) {
+        // First cycle after a static line only re-establishes the period reference
+        st->resync = 0;
+        cap->last_capture = st->rising_edge;
+        return;
+    }
+
+    // Pulse width and period from timestamps, exact across any number of counter wraps
+    cap->pulse_width = saturate_ticks(extend_timestamp(htim, capture_value) - st->rise_time);
+    cap->period = saturate_ticks(st->rise_time - st->prev_rise_time);
+
+    // Store current rising edge for next period calculation
+    cap->last_capture = st->rising_edge;
+
+    // Calculate duty cycle (0-100 range)
+    if (cap->period > 0) {
+        cap->duty_cycle = (cap->pulse_width * DUTY_CYCLE_SCALER) / cap->period;
+    }
+
+    // Mark capture as complete
+    cap->capture_complete = 1;
+    cap->capture_flags = 0;
+    publish_capture(channel);
+
+    // Feed the on-device statistics window, history and trigger
+    PWM_Statistics_AddSample(channel, cap->pulse_width, cap->period);
+    PWM_History_Add(channel, cap->pulse_width, cap->period);
+    Capture_Trigger_AddSample(channel, cap->pulse_width, cap->period);
+}
+
+/**
+ * @brief Process PWM input capture events
+ * This function is the implementation of what was HAL_TIM_IC_CaptureCallback in main.c.
+ * It is only reached through HAL_TIM_IRQHandler, i.e. when a capture flag is
+ * serviced by the TIM1 update interrupt or PWM_CAPTURE_HAL_DISPATCH is set.
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void PWM_Capture_ProcessEvent(TIM_HandleTypeDef *htim) {
+    if (htim->Instance != TIM1 || htim->Channel == HAL_TIM_ACTIVE_CHANNEL_CLEARED) {
+        return;
+    }
+
+    // Active channel flags are one bit per timer channel, as is the table order
+    uint8_t channel = __CLZ(__RBIT((uint32_t)htim->Channel));
+
+    if (channel >= PWM_CAPTURE_CHANNELS || capture_table[channel].htim != htim) {
+        return;
+    }
+
+    process_edge(channel, *capture_table[channel].ccr);
+}
+
+/**
+ * @brief TIM1 capture/compare interrupt handler
+ * Services the capture flags directly from the status register, replacing
+ * the generic HAL_TIM_IRQHandler dispatch on the capture path.
+ */
+void PWM_Capture_IRQHandler(void) {
+#if PWM_CAPTURE_CYCLE_COUNT || ISR_TIMING
+    uint32_t start = DWT->CYCCNT;
+#endif
+#if PWM_CAPTURE_CYCLE_COUNT
+    uint32_t edges = 0;
+#endif
+#if ISR_TIMING
+    uint32_t latency = 0;       // Ticks from the oldest serviced edge to its service
+#endif
+
+#if PWM_CAPTURE_HAL_DISPATCH
+    // Reference path for cycle comparisons
+    uint32_t pending = htim1.Instance->SR & htim1.Instance->DIER & CAPTURE_CC_FLAGS;
+#if PWM_CAPTURE_CYCLE_COUNT
+    edges = __builtin_popcount(pending);
+#endif
+    HAL_TIM_IRQHandler(&htim1);
+#else
+    TIM_TypeDef* tim = htim1.Instance;
+    uint32_t pending = tim->SR & tim->DIER & CAPTURE_CC_FLAGS;
+
+    while (pending) {
+        // CCxIF is bit x of SR, table entry x-1
+        uint32_t bit = __CLZ(__RBIT(pending));
+        uint32_t flag = 1UL << bit;
+        const PWMCaptureChannel* desc = &capture_table[bit - 1];
+
+        pending &= ~flag;
+
+        // Reading CCRx clears CCxIF, an edge arriving afterwards raises the interrupt again
+        uint32_t captured = *desc->ccr;
+#if ISR_TIMING
+        uint32_t now = tim->CNT;
+        uint32_t waited = (now >= captured) ? now - captured : now + tim->ARR + 1 - captured;
+
+        if (waited > latency) {
+            latency = waited;
         }
+#endif
+        process_edge(bit - 1, captured);
+#if PWM_CAPTURE_CYCLE_COUNT
+        edges++;
+#endif
+    }
+#endif
+
+#if ISR_TIMING
+    // The HAL dispatch path reads the captured values itself, its latency is not measured
+    ISR_Timing_Record(ISR_TIMING_CAPTURE, ISR_Timing_TimerCycles(htim1.Instance, latency), start);
+#endif
+
+#if PWM_CAPTURE_CYCLE_COUNT
+    if (edges) {
+        uint32_t cycles = (DWT->CYCCNT - start) / edges;
+
+        isr_last = cycles;
+        if (cycles > isr_max) {
+            isr_max = cycles;
+        }
+        isr_total += cycles * edges;
+        isr_edges += edges;
+    }
+#endif
+}
+
+/**
+ * @brief Process capture timer overflow events
+ * Detects inputs that stopped toggling (0 % or 100 % duty) and reports
+ * the sampled pin level as a static duty cycle.
+ * @param htim Pointer to the TIM_HandleTypeDef structure
+ */
+void PWM_Capture_ProcessOverflow(TIM_HandleTypeDef *htim) {
+    if (htim->Instance != TIM1) {
+        return;
+    }
+
+    uint32_t timer_period = htim->Init.Period + 1;
+
+    timebase_overflows++;
+
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        if (channel_state[i].edge_overflows < 0xFFFF) {
+            channel_state[i].edge_overflows++;
+        }
+
+        // At least one full timer period must have elapsed without an edge
+        if (channel_state[i].edge_overflows < 2) {
+            continue;
+        }
+
+        // Prescaled captures see only every 2^shift-th edge
+        uint32_t expected = pwm_capture[i].period ? ((uint32_t)pwm_capture[i].period << channel_state[i].icpsc_shift) : timer_period;
+        if ((uint32_t)(channel_state[i].edge_overflows - 1) * timer_period < expected * EDGE_TIMEOUT_PERIODS) {
+            continue;
+        }
+
+        // Line is stuck: report the pin level as 0 % or 100 % duty
+        uint8_t level_high = (HAL_GPIO_ReadPin(capture_table[i].port, capture_table[i].pin) == GPIO_PIN_SET);
+        uint8_t level_active = level_high ^ channel_config[i].active_low;
+
+        pwm_capture[i].duty_cycle = level_active ? DUTY_CYCLE_SCALER : 0;
+        pwm_capture[i].capture_flags = PWM_CAPTURE_FLAG_STATIC |
+                                       (level_high ? PWM_CAPTURE_FLAG_LEVEL_HIGH : 0);
+        pwm_capture[i].capture_complete = 1;
+        publish_capture(i);
+
+        if (!channel_state[i].resync) {
+            // Restart edge detection from a leading edge once the line toggles again
+            channel_state[i].resync = 1;
+            channel_state[i].capture_state = 0;
+            set_capture_edge(i, 0);
+        }
+    }
+
+    if (autorange_enabled) {
+        evaluate_range(htim);
+    }
+}
+
+/**
+ * @brief Enable or disable capture auto-ranging
+ * Disabling returns the capture timer to the default range.
+ * @param enable 1 to enable, 0 to disable
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Capture_SetAutoRange(uint8_t enable) {
+    if (enable > 1) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM1_UP_TIM10_IRQn);
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+
+    autorange_enabled = enable;
+    if (!enable && capture_range != PWM_RANGE_DEFAULT) {
+        switch_range(&htim1, PWM_RANGE_DEFAULT);
+    }
+
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+    HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Get the active capture range of a channel
+ * @param channel Channel index (0-2)
+ * @return Range index in the low byte, log2 of the input capture prescaler in the high byte
+ */
+uint16_t PWM_Capture_GetRange(uint8_t channel) {
+    if (channel >= PWM_CAPTURE_CHANNELS) {
+        return 0xFFFF;
+    }
+
+    return ((uint16_t)channel_state[channel].icpsc_shift << 8) | capture_range;
+}
+
+/**
+ * @brief Set the input filter, edge polarity and prescaler of a channel
+ * @param channel Channel index (0-2)
+ * @param config New configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Capture_SetConfig(uint8_t channel, const PWMCaptureConfig* config) {
+    if (channel >= PWM_CAPTURE_CHANNELS || config == NULL ||
+        config->filter > PWM_CAPTURE_FILTER_MAX || config->active_low > 1 || config->prescaler > 3) {
+        return 0;
+    }
+
+    HAL_NVIC_DisableIRQ(TIM1_UP_TIM10_IRQn);
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+
+    channel_config[channel] = *config;
+
+    // In counter mode the configuration is applied when capture restarts
+    if (capture_running) {
+        apply_channel_config(channel);
+        PWM_Statistics_Restart(channel);
     }
+
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+    HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Get the input configuration of a channel
+ * @param channel Channel index (0-2)
+ * @param config Destination for the configuration
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Capture_GetConfig(uint8_t channel, PWMCaptureConfig* config) {
+    if (channel >= PWM_CAPTURE_CHANNELS || config == NULL) {
+        return 0;
+    }
+
+    *config = channel_config[channel];
+
+    return 1;
+}
+
+/**
+ * @brief Get a consistent copy of the latest capture of a channel
+ * @param channel Channel index (0-2)
+ * @param snapshot Destination for the copy
+ * @return 1 if at least one capture has been published, 0 otherwise
+ */
+uint8_t PWM_Capture_GetSnapshot(uint8_t channel, PWMCaptureSnapshot* snapshot) {
+    if (channel >= PWM_CAPTURE_CHANNELS || snapshot == NULL) {
+        return 0;
+    }
+
+    PWMCapturePublished* pub = &published[channel];
+    uint32_t start;
+
+    // Seqlock reader: retry if the interrupt wrote the record during the copy
+    do {
+        start = pub->sequence;
+        __DMB();
+        *snapshot = pub->record;
+        __DMB();
+    } while ((start & 1) || start != pub->sequence);
+
+    snapshot->sequence = start >> 1;
+
+    return (start != 0);
+}
+
+/**
+ * @brief Get the latest capture of a channel if it has not been consumed yet
+ * Replaces polling and clearing capture_complete, which raced with the
+ * capture interrupt and could lose completions.
+ * @param channel Channel index (0-2)
+ * @param snapshot Destination for the copy
+ * @return 1 if a new capture was returned, 0 otherwise
+ */
+uint8_t PWM_Capture_ConsumeSnapshot(uint8_t channel, PWMCaptureSnapshot* snapshot) {
+    if (!PWM_Capture_GetSnapshot(channel, snapshot)) {
+        return 0;
+    }
+
+    if (snapshot->sequence == consumed_sequence[channel]) {
+        return 0;
+    }
+
+    consumed_sequence[channel] = snapshot->sequence;
+
+    return 1;
+}
+
+#if PWM_CAPTURE_CYCLE_COUNT
+/**
+ * @brief Get the cycle cost of the capture interrupt
+ * @param cycles Destination for the counters
+ */
+void PWM_Capture_GetCycles(PWMCaptureCycles* cycles) {
+    if (cycles == NULL) {
+        return;
+    }
+
+    // Keep the 64-bit total and edge count consistent
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+    HAL_NVIC_DisableIRQ(TIM1_UP_TIM10_IRQn);
+    cycles->edges = isr_edges;
+    cycles->last = isr_last;
+    cycles->max = isr_max;
+    cycles->mean = isr_edges ? (uint32_t)(isr_total / isr_edges) : 0;
+    HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+}
+
+/**
+ * @brief Reset the capture interrupt cycle counters
+ */
+void PWM_Capture_ResetCycles(void) {
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+    HAL_NVIC_DisableIRQ(TIM1_UP_TIM10_IRQn);
+    isr_edges = 0;
+    isr_last = 0;
+    isr_max = 0;
+    isr_total = 0;
+    HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
 }
+#endif
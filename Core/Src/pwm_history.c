@@ -0,0 +1,169 @@
+/**
+ * @file pwm_history.c
+ * @brief PWM capture history ring buffer for Wiseled_LBR HIL
+ */
+
+#include "pwm_history.h"
+#include "pwm_capture.h"
+
+typedef struct {
+    PWMHistoryEntry entry[PWM_HISTORY_DEPTH];
+    volatile uint16_t head;       // Next slot to write
+    volatile uint16_t count;      // Valid entries
+    volatile uint16_t dropped;    // Captures lost while frozen
+    volatile uint8_t  frozen;     // Set while the ring is being downloaded
+    uint8_t marker_pending;       // Range changed while frozen, marker not written yet
+    uint8_t marker_range;         // Range of the pending marker
+} PWMHistoryRing;
+
+static PWMHistoryRing history[PWM_CAPTURE_CHANNELS];
+
+/**
+ * @brief Clear the history of all channels
+ */
+void PWM_History_Init(void) {
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        history[i].head = 0;
+        history[i].count = 0;
+        history[i].dropped = 0;
+        history[i].frozen = 0;
+        history[i].marker_pending = 0;
+    }
+}
+
+/**
+ * @brief Clear the history of one channel
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_History_Clear(uint8_t channel) {
+    if (channel >= PWM_CAPTURE_CHANNELS) {
+        return 0;
+    }
+
+    // Freeze so the capture interrupt does not write while the indices are reset
+    history[channel].frozen = 1;
+    history[channel].head = 0;
+    history[channel].count = 0;
+    history[channel].dropped = 0;
+    history[channel].frozen = 0;
+
+    return 1;
+}
+
+/**
+ * @brief Write one entry into an unfrozen ring
+ * @param ring Ring to write
+ * @param pulse_width Pulse width in timer ticks, or range of a marker
+ * @param period Period in timer ticks, 0 for a marker
+ */
+static void ring_write(PWMHistoryRing* ring, uint16_t pulse_width, uint16_t period) {
+    uint16_t head = ring->head;
+
+    ring->entry[head].period = period;
+    ring->entry[head].pulse_width = pulse_width;
+    ring->head = (head + 1) % PWM_HISTORY_DEPTH;
+
+    if (ring->count < PWM_HISTORY_DEPTH) {
+        ring->count++;
+    }
+}
+
+/**
+ * @brief Append one completed capture to a channel's history
+ * This function is called from the TIM1 input capture interrupt
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param pulse_width Pulse width in timer ticks
+ * @param period Period in timer ticks
+ */
+void PWM_History_Add(uint8_t channel, uint16_t pulse_width, uint16_t period) {
+    if (channel >= PWM_CAPTURE_CHANNELS) {
+        return;
+    }
+
+    PWMHistoryRing* ring = &history[channel];
+
+    if (ring->frozen) {
+        if (ring->dropped < 0xFFFF) {
+            ring->dropped++;
+        }
+        return;
+    }
+
+    // A range change during a download still precedes the captures taken at it
+    if (ring->marker_pending) {
+        ring->marker_pending = 0;
+        ring_write(ring, ring->marker_range, 0);
+    }
+
+    ring_write(ring, pulse_width, period);
+}
+
+/**
+ * @brief Record a capture range change in a channel's history
+ * This function is called from TIM1 interrupt context. While the ring is
+ * frozen the marker is held back and written before the next capture,
+ * so later entries are never decoded at the wrong tick scale.
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param range New capture range index
+ */
+void PWM_History_AddRangeMarker(uint8_t channel, uint8_t range) {
+    if (channel >= PWM_CAPTURE_CHANNELS) {
+        return;
+    }
+
+    PWMHistoryRing* ring = &history[channel];
+
+    if (ring->frozen) {
+        ring->marker_range = range;
+        ring->marker_pending = 1;
+        return;
+    }
+
+    // A zero period never occurs in a real capture
+    ring->marker_pending = 0;
+    ring_write(ring, range, 0);
+}
+
+/**
+ * @brief Send the history of a channel as one bulk response
+ * The ring is frozen while it is being transmitted.
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param request Request being answered
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_History_Send(uint8_t channel, const HILMessage* request) {
+    if (channel >= PWM_CAPTURE_CHANNELS) {
+        return 0;
+    }
+
+    PWMHistoryRing* ring = &history[channel];
+    PWMHistoryHeader header;
+
+    ring->frozen = 1;
+
+    // Captures dropped during this download are reported by the next one
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+    header.dropped = ring->dropped;
+    ring->dropped = 0;
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+
+    header.count = ring->count;
+
+    // Oldest entry sits at head once the ring has wrapped
+    uint16_t start = (ring->head + PWM_HISTORY_DEPTH - header.count) % PWM_HISTORY_DEPTH;
+    uint16_t first = header.count;
+    if (start + first > PWM_HISTORY_DEPTH) {
+        first = PWM_HISTORY_DEPTH - start;
+    }
+
+    HIL_BeginBulkResponse(request, sizeof(header) + header.count * sizeof(PWMHistoryEntry));
+    HIL_WriteBulkResponse(&header, sizeof(header));
+    HIL_WriteBulkResponse(&ring->entry[start], first * sizeof(PWMHistoryEntry));
+    HIL_WriteBulkResponse(&ring->entry[0], (header.count - first) * sizeof(PWMHistoryEntry));
+    HIL_EndBulkResponse();
+
+    ring->frozen = 0;
+
+    return 1;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file pwm_phase.c
+ * @brief Cross-channel PWM phase and overlap measurement for Wiseled_LBR HIL
+ */
+
+#include "pwm_phase.h"
+#include "pwm_capture.h"
+#include "hil_comm_protocol.h"
+#include <string.h>
+
+#define PHASE_DEGREE_SCALER   3600    // Phase reported in 0.1 degree units
+#define OVERLAP_SCALER        10000   // Overlap reported in 0.01 % units
+
+/**
+ * @brief Length of the intersection of two on-times on one period circle
+ * @param width_a On-time of the reference, starting at 0
+ * @param offset Start of the other on-time (0 to period-1)
+ * @param width_b On-time of the other channel
+ * @param period Period length
+ * @return Overlapping ticks per period
+ */
+static uint32_t circular_overlap(uint32_t width_a, uint32_t offset, uint32_t width_b, uint32_t period) {
+    uint32_t end_b = offset + width_b;
+    uint32_t overlap = 0;
+
+    // Part of the other on-time inside this period
+    if (width_a > offset) {
+        overlap += ((end_b < width_a) ? end_b : width_a) - offset;
+    }
+
+    // Part that wraps into the start of the next period
+    if (end_b > period) {
+        uint32_t wrapped = end_b - period;
+        overlap += (wrapped < width_a) ? wrapped : width_a;
+    }
+
+    return (overlap > width_a) ? width_a : overlap;
+}
+
+/**
+ * @brief Measure the phase of the other channels against a reference channel
+ * @param reference Reference channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param report Destination for the report
+ * @return 1 if the reference channel has a usable capture, 0 otherwise
+ */
+uint8_t PWM_Phase_Measure(uint8_t reference, PWMPhaseReport* report) {
+    if (reference >= PWM_CAPTURE_CHANNELS || report == NULL) {
+        return 0;
+    }
+
+    PWMCaptureSnapshot ref;
+
+    if (!PWM_Capture_GetSnapshot(reference, &ref) ||
+        (ref.capture_flags & PWM_CAPTURE_FLAG_STATIC) || ref.period == 0) {
+        return 0;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->reference = reference;
+    report->range = PWM_Capture_GetRange(reference) & 0xFF;
+    report->period = ref.period;
+    report->pulse_width = ref.pulse_width;
+
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        if (i == reference) {
+            continue;
+        }
+
+        PWMPhasePair* pair = &report->pair[n++];
+        PWMCaptureSnapshot other;
+
+        pair->channel = i;
+
+        if (!PWM_Capture_GetSnapshot(i, &other) ||
+            (other.capture_flags & PWM_CAPTURE_FLAG_STATIC) ||
+            other.timebase_epoch != ref.timebase_epoch) {
+            continue;
+        }
+
+        uint32_t period = ref.period;
+        uint32_t diff = (other.period > period) ? other.period - period : period - other.period;
+
+        pair->flags = PWM_PHASE_FLAG_VALID;
+        if (diff * 100 > period * PWM_PHASE_PERIOD_TOLERANCE) {
+            pair->flags |= PWM_PHASE_FLAG_PERIOD_MISMATCH;
+        }
+
+        // Signed difference is exact across the 32-bit timestamp wrap, reduce it into one period
+        int32_t delta = (int32_t)(other.rise_time - ref.rise_time);
+        int32_t offset = delta % (int32_t)period;
+        if (offset < 0) {
+            offset += period;
+        }
+
+        pair->offset_ticks = offset;
+        pair->phase = ((uint32_t)offset * PHASE_DEGREE_SCALER) / period;
+
+        if ((ref.capture_flags | other.capture_flags) & PWM_CAPTURE_FLAG_PERIOD_ONLY) {
+            pair->flags |= PWM_PHASE_FLAG_NO_OVERLAP_DATA;
+            continue;
+        }
+
+        uint32_t overlap = circular_overlap(ref.pulse_width, offset, other.pulse_width, period);
+        pair->overlap_ticks = overlap;
+        pair->overlap = (overlap * OVERLAP_SCALER) / period;
+    }
+
+    return 1;
+}
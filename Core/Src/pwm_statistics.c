@@ -0,0 +1,197 @@
+/**
+ * @file pwm_statistics.c
+ * @brief On-device PWM capture statistics for Wiseled_LBR HIL
+ */
+
+#include "pwm_statistics.h"
+#include "pwm_capture.h"
+#include <math.h>
+
+#define DUTY_STATS_SCALER 10000.0f  // Duty cycle reported in 0.01 % units
+
+// Running Welford state for one channel
+typedef struct {
+    uint16_t window;
+    uint16_t count;
+    float    duty_mean;
+    float    duty_m2;
+    float    duty_min;
+    float    duty_max;
+    float    period_mean;
+    float    period_m2;
+    uint32_t period_min;
+    uint32_t period_max;
+} PWMStatsAccumulator;
+
+// Completed windows are double buffered so the main loop never reads a half-written summary
+typedef struct {
+    PWMStatsSummary summary[2];
+    volatile uint8_t active;        // Index of the buffer readers should use
+    volatile uint32_t published;    // Incremented after every completed window
+} PWMStatsResult;
+
+static PWMStatsAccumulator accumulator[PWM_CAPTURE_CHANNELS];
+static PWMStatsResult result[PWM_CAPTURE_CHANNELS];
+
+/**
+ * @brief Restart the accumulator of a channel keeping its window length
+ * @param acc Pointer to the accumulator
+ */
+static void reset_accumulator(PWMStatsAccumulator* acc) {
+    acc->count = 0;
+    acc->duty_mean = 0.0f;
+    acc->duty_m2 = 0.0f;
+    acc->duty_min = DUTY_STATS_SCALER;
+    acc->duty_max = 0.0f;
+    acc->period_mean = 0.0f;
+    acc->period_m2 = 0.0f;
+    acc->period_min = 0xFFFFFFFF;
+    acc->period_max = 0;
+}
+
+/**
+ * @brief Publish the accumulator of a channel as its latest summary
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ */
+static void publish_summary(uint8_t channel) {
+    PWMStatsAccumulator* acc = &accumulator[channel];
+    PWMStatsResult* res = &result[channel];
+    PWMStatsSummary* out = &res->summary[res->active ^ 1];
+    float n = (float)acc->count;
+
+    out->count = acc->count;
+    out->window = acc->window;
+    out->duty_min = (uint16_t)(acc->duty_min + 0.5f);
+    out->duty_max = (uint16_t)(acc->duty_max + 0.5f);
+    out->duty_mean = (uint16_t)(acc->duty_mean + 0.5f);
+    out->duty_std = (uint16_t)(sqrtf(acc->duty_m2 / n) + 0.5f);
+    out->period_min = acc->period_min;
+    out->period_max = acc->period_max;
+    out->period_mean = (uint32_t)(acc->period_mean + 0.5f);
+    out->period_std = (uint32_t)(sqrtf(acc->period_m2 / n) + 0.5f);
+
+    // The summary must be complete before readers are switched to it
+    __DMB();
+    res->active ^= 1;
+    res->published++;
+}
+
+/**
+ * @brief Reset all accumulators to the default window
+ */
+void PWM_Statistics_Init(void) {
+    for (int i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+        accumulator[i].window = PWM_STATS_DEFAULT_WINDOW;
+        reset_accumulator(&accumulator[i]);
+
+        result[i].active = 0;
+        result[i].published = 0;
+    }
+}
+
+/**
+ * @brief Set the window length of a channel and restart its accumulator
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param window Number of samples per window (1-65535)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t PWM_Statistics_SetWindow(uint8_t channel, uint16_t window) {
+    if (channel >= PWM_CAPTURE_CHANNELS || window == 0) {
+        return 0;
+    }
+
+    // Stop the capture interrupts from updating a half-reset accumulator
+    HAL_NVIC_DisableIRQ(TIM1_CC_IRQn);
+    HAL_NVIC_DisableIRQ(TIM1_UP_TIM10_IRQn);
+    accumulator[channel].window = window;
+    reset_accumulator(&accumulator[channel]);
+    result[channel].published = 0;
+    HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+    HAL_NVIC_EnableIRQ(TIM1_CC_IRQn);
+
+    return 1;
+}
+
+/**
+ * @brief Discard the samples of a channel's current window
+ * This function is called from TIM1 interrupt context when the capture
+ * range changes, since samples of different ranges must not be mixed.
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ */
+void PWM_Statistics_Restart(uint8_t channel) {
+    if (channel >= PWM_CAPTURE_CHANNELS) {
+        return;
+    }
+
+    reset_accumulator(&accumulator[channel]);
+}
+
+/**
+ * @brief Add one completed capture to a channel's accumulator
+ * This function is called from the TIM1 input capture interrupt
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param pulse_width Pulse width in timer ticks
+ * @param period Period in timer ticks
+ */
+void PWM_Statistics_AddSample(uint8_t channel, uint32_t pulse_width, uint32_t period) {
+    if (channel >= PWM_CAPTURE_CHANNELS || period == 0) {
+        return;
+    }
+
+    PWMStatsAccumulator* acc = &accumulator[channel];
+    float duty = ((float)pulse_width * DUTY_STATS_SCALER) / (float)period;
+    float delta;
+
+    if (duty > DUTY_STATS_SCALER) {
+        duty = DUTY_STATS_SCALER;
+    }
+
+    acc->count++;
+
+    // Welford update for duty cycle
+    delta = duty - acc->duty_mean;
+    acc->duty_mean += delta / (float)acc->count;
+    acc->duty_m2 += delta * (duty - acc->duty_mean);
+    if (duty < acc->duty_min) acc->duty_min = duty;
+    if (duty > acc->duty_max) acc->duty_max = duty;
+
+    // Welford update for period
+    delta = (float)period - acc->period_mean;
+    acc->period_mean += delta / (float)acc->count;
+    acc->period_m2 += delta * ((float)period - acc->period_mean);
+    if (period < acc->period_min) acc->period_min = period;
+    if (period > acc->period_max) acc->period_max = period;
+
+    if (acc->count >= acc->window) {
+        publish_summary(channel);
+        reset_accumulator(acc);
+    }
+}
+
+/**
+ * @brief Get the summary of the last completed window
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param summary Destination for a consistent copy of the summary
+ * @return 1 if a window has completed, 0 otherwise
+ */
+uint8_t PWM_Statistics_GetSummary(uint8_t channel, PWMStatsSummary* summary) {
+    if (channel >= PWM_CAPTURE_CHANNELS || summary == NULL) {
+        return 0;
+    }
+
+    PWMStatsResult* res = &result[channel];
+    uint32_t published;
+
+    // Retry if the interrupt published a new window while copying
+    do {
+        published = res->published;
+        if (published == 0) {
+            return 0;
+        }
+        __DMB();
+        *summary = res->summary[res->active];
+        __DMB();
+    } while (published != res->published);
+
+    return 1;
+}
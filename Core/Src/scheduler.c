@@ -0,0 +1,203 @@
+/**
+ * @file scheduler.c
+ * @brief Fixed-rate cooperative task scheduler
+ */
+
+#include "scheduler.h"
+#include "tim.h"
+#include "event_loop.h"
+#include <string.h>
+
+// Period of each slot in SCHEDULER_BASE_US units
+static const uint16_t slot_dividers[SCHEDULER_SLOTS] = {1, 10, 100};
+
+// One task
+typedef struct {
+    void (*run)(void);
+    uint8_t  slot;
+    uint32_t runs;
+    uint32_t last_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+} SchedulerTask;
+
+static SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+static uint8_t task_count = 0;
+static uint8_t slot_mask = 0;                         // Slots with tasks
+
+// Release counting in timer ticks
+static uint16_t tick_dividers[SCHEDULER_SLOTS];       // Slot period in timer ticks
+static uint16_t countdown[SCHEDULER_SLOTS];           // Ticks to the next release
+static volatile uint32_t released[SCHEDULER_SLOTS];   // Written by the interrupt only
+static uint32_t handled[SCHEDULER_SLOTS];             // Releases taken by the main loop
+static uint32_t overruns[SCHEDULER_SLOTS];
+
+/**
+ * @brief Remove all tasks and stop the timer
+ */
+void Scheduler_Init(void) {
+    HAL_TIM_Base_Stop_IT(&htim14);
+
+    memset(tasks, 0, sizeof(tasks));
+    task_count = 0;
+    slot_mask = 0;
+    memset(countdown, 0, sizeof(countdown));
+    memset((void*)released, 0, sizeof(released));
+    memset(handled, 0, sizeof(handled));
+    memset(overruns, 0, sizeof(overruns));
+
+    // Enable the DWT cycle counter for run-time accounting
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Add a task to a rate slot, tasks of a slot run in the order added
+ * @param slot SCHEDULER_SLOT_*
+ * @param run Task function, runs to completion in the main loop
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Scheduler_AddTask(uint8_t slot, void (*run)(void)) {
+    if (slot >= SCHEDULER_SLOTS || run == NULL || task_count >= SCHEDULER_MAX_TASKS) {
+        return 0;
+    }
+
+    tasks[task_count].run = run;
+    tasks[task_count].slot = slot;
+    task_count++;
+    slot_mask |= 1 << slot;
+
+    return 1;
+}
+
+/**
+ * @brief Start releasing the slots that have tasks
+ * The timer ticks at the rate of the fastest slot in use.
+ */
+void Scheduler_Start(void) {
+    uint16_t base = 0;
+
+    for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+        if (slot_mask & (1 << slot)) {
+            base = slot_dividers[slot];
+            break;
+        }
+    }
+
+    if (base == 0) {
+        return;
+    }
+
+    for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+        tick_dividers[slot] = slot_dividers[slot] / base;
+        countdown[slot] = tick_dividers[slot];
+    }
+
+    __HAL_TIM_SET_AUTORELOAD(&htim14, (uint32_t)SCHEDULER_BASE_US * base - 1);
+    __HAL_TIM_SET_COUNTER(&htim14, 0);
+    HAL_TIM_Base_Start_IT(&htim14);
+}
+
+/**
+ * @brief Run the tasks of all released slots
+ * A slot released more than once since its last run has missed the
+ * earlier releases; they are counted as overruns and not run.
+ */
+void Scheduler_Run(void) {
+    for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+        uint32_t release = released[slot];
+
+        if (release == handled[slot]) {
+            continue;
+        }
+
+        overruns[slot] += release - handled[slot] - 1;
+        handled[slot] = release;
+
+        for (uint8_t i = 0; i < task_count; i++) {
+            SchedulerTask* task = &tasks[i];
+            uint32_t start;
+            uint32_t cycles;
+
+            if (task->slot != slot) {
+                continue;
+            }
+
+            start = DWT->CYCCNT;
+            task->run();
+            cycles = DWT->CYCCNT - start;
+
+            task->runs++;
+            task->last_cycles = cycles;
+            task->total_cycles += cycles;
+            if (cycles > task->max_cycles) {
+                task->max_cycles = cycles;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Get the scheduler state
+ * @param status Destination for the state
+ */
+void Scheduler_GetStatus(SchedulerStatus* status) {
+    if (status == NULL) {
+        return;
+    }
+
+    memset(status, 0, sizeof(*status));
+
+    status->tasks = task_count;
+    for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+        status->releases[slot] = released[slot];
+        status->overruns[slot] = overruns[slot];
+    }
+    for (uint8_t i = 0; i < task_count; i++) {
+        status->task[i].slot = tasks[i].slot;
+        status->task[i].runs = tasks[i].runs;
+        status->task[i].last_cycles = tasks[i].last_cycles;
+        status->task[i].max_cycles = tasks[i].max_cycles;
+        status->task[i].total_cycles = tasks[i].total_cycles;
+    }
+}
+
+/**
+ * @brief Reset the run-time accounting and overrun counters
+ * Release counts keep running, they pace the slots.
+ */
+void Scheduler_ResetStats(void) {
+    memset(overruns, 0, sizeof(overruns));
+    for (uint8_t i = 0; i < task_count; i++) {
+        tasks[i].runs = 0;
+        tasks[i].last_cycles = 0;
+        tasks[i].max_cycles = 0;
+        tasks[i].total_cycles = 0;
+    }
+}
+
+/**
+ * @brief Release the slots that are due
+ * Only the update interrupt is enabled.
+ */
+void Scheduler_IRQHandler(void) {
+    uint8_t due = 0;
+
+    htim14.Instance->SR = ~TIM_SR_UIF;
+
+    for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+        if (!(slot_mask & (1 << slot))) {
+            continue;
+        }
+
+        if (--countdown[slot] == 0) {
+            countdown[slot] = tick_dividers[slot];
+            released[slot]++;
+            due = 1;
+        }
+    }
+
+    if (due) {
+        Event_Loop_Signal(EVENT_LOOP_SCHEDULER);
+    }
+}
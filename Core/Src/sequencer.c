@@ -0,0 +1,333 @@
+/**
+ * @file sequencer.c
+ * @brief Time-scheduled stimulus sequencer for Wiseled_LBR HIL
+ */
+
+#include "sequencer.h"
+#include "tim.h"
+#include "analog_simulation.h"
+#include "capture_trigger.h"
+#include "plant_model.h"
+#include "waveform.h"
+#include "hil_comm_protocol.h"
+#include "event_loop.h"
+#include <string.h>
+
+// Working state
+typedef struct {
+    volatile uint8_t  state;
+    volatile uint8_t  done_event;     // Completion not yet reported
+    uint16_t length;
+    volatile uint16_t position;
+    uint16_t applied;
+    uint16_t rejected;
+    uint16_t late;
+    uint16_t first_late;
+    uint32_t max_late_us;
+    uint32_t end_us;                  // Elapsed time at completion
+} SequencerState;
+
+static SequencerState sequencer;
+static SequencerStep steps[SEQUENCER_MAX_STEPS];
+
+/**
+ * @brief Check whether the plant model, a waveform or a ramp owns an analog output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if owned, 0 otherwise
+ */
+static uint8_t output_owned(uint8_t light_index, uint8_t output) {
+    return Plant_Model_IsEnabled(light_index) || Waveform_IsDriving(light_index, output) ||
+           Analog_IsRamping(light_index, output);
+}
+
+/**
+ * @brief Check a step before it is stored
+ * @param step Step to check
+ * @return 1 if the step can be applied, 0 otherwise
+ */
+static uint8_t step_valid(const SequencerStep* step) {
+    uint8_t light_index = step->light - '1';
+
+    if (step->light == 'S') {
+        return step->function == SIGNAL_SYNC && step->value <= 1;
+    }
+    if (light_index > 2) {
+        return 0;
+    }
+
+    switch (step->function) {
+        case SIGNAL_CURRENT:
+            return step->value <= ANALOG_CURRENT_FULL_SCALE;
+
+        case SIGNAL_TEMPERATURE:
+            return step->value <= ANALOG_TEMPERATURE_FULL_SCALE;
+
+        case SIGNAL_SYNC:
+            return (step->value & 0x7FFF) <= ((step->value & 0x8000) ? ANALOG_TEMPERATURE_FULL_SCALE
+                                                                       : ANALOG_CURRENT_FULL_SCALE);
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Apply one step
+ * @param step Step to apply
+ * @return 1 if applied, 0 if its output was owned
+ */
+static uint8_t apply_step(const SequencerStep* step) {
+    uint8_t light_index = step->light - '1';
+    uint8_t output;
+
+    if (step->light == 'S') {
+        uint8_t staged = Analog_GetStagedMask(ANALOG_STAGE_SEQUENCER);
+
+        if (step->value == 0) {
+            Analog_DiscardStaged(ANALOG_STAGE_SEQUENCER);
+            return 1;
+        }
+
+        // An output may have been taken over since it was staged
+        for (uint8_t i = 0; i < 6; i++) {
+            if ((staged & (1 << i)) && output_owned(i / 2, i % 2)) {
+                return 0;
+            }
+        }
+        Analog_CommitStaged(ANALOG_STAGE_SEQUENCER);
+        Capture_Trigger_NotifyCommand();
+        return 1;
+    }
+
+    switch (step->function) {
+        case SIGNAL_CURRENT:
+            if (output_owned(light_index, ANALOG_OUTPUT_CURRENT) ||
+                !Analog_SetCurrentSimulation(light_index, step->value)) {
+                return 0;
+            }
+            Capture_Trigger_NotifyCommand();
+            return 1;
+
+        case SIGNAL_TEMPERATURE:
+            if (output_owned(light_index, ANALOG_OUTPUT_TEMPERATURE) ||
+                !Analog_SetTemperatureSimulation(light_index, step->value)) {
+                return 0;
+            }
+            Capture_Trigger_NotifyCommand();
+            return 1;
+
+        default:
+            output = (step->value & 0x8000) ? ANALOG_OUTPUT_TEMPERATURE : ANALOG_OUTPUT_CURRENT;
+            return !output_owned(light_index, output) &&
+                   Analog_StageSimulation(ANALOG_STAGE_SEQUENCER, light_index, output, step->value & 0x7FFF);
+    }
+}
+
+/**
+ * @brief Stop the timebase and its compare interrupt
+ */
+static void halt_timer(void) {
+    __HAL_TIM_DISABLE_IT(&htim5, TIM_IT_CC1);
+    __HAL_TIM_DISABLE(&htim5);
+}
+
+/**
+ * @brief Reset the sequencer to idle with an empty scenario
+ */
+void Sequencer_Init(void) {
+    halt_timer();
+    memset(&sequencer, 0, sizeof(sequencer));
+    sequencer.first_late = 0xFFFF;
+}
+
+/**
+ * @brief Load (part of) the scenario from an upload payload
+ * @param payload SequencerHeader followed by steps
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise (also while running)
+ */
+uint8_t Sequencer_Load(const uint8_t* payload, uint16_t length) {
+    SequencerHeader header;
+    uint16_t count;
+
+    if (payload == NULL || length < sizeof(header) || sequencer.state == SEQUENCER_STATE_RUNNING ||
+        (length - sizeof(header)) % sizeof(SequencerStep)) {
+        return 0;
+    }
+
+    memcpy(&header, payload, sizeof(header));
+    count = (length - sizeof(header)) / sizeof(SequencerStep);
+
+    if (header.length == 0 || header.length > SEQUENCER_MAX_STEPS ||
+        (uint32_t)header.offset + count > header.length) {
+        return 0;
+    }
+
+    // Validate all steps before touching the scenario
+    for (uint16_t i = 0; i < count; i++) {
+        SequencerStep step;
+
+        memcpy(&step, payload + sizeof(header) + i * sizeof(step), sizeof(step));
+        if (!step_valid(&step)) {
+            return 0;
+        }
+    }
+
+    memcpy(&steps[header.offset], payload + sizeof(header), count * sizeof(SequencerStep));
+    sequencer.length = header.length;
+    sequencer.state = SEQUENCER_STATE_IDLE;
+
+    return 1;
+}
+
+/**
+ * @brief Start the scenario from its first step at time 0
+ * @return 1 if successful, 0 if running, empty or not in time order
+ */
+uint8_t Sequencer_Start(void) {
+    if (sequencer.state == SEQUENCER_STATE_RUNNING || sequencer.length == 0) {
+        return 0;
+    }
+
+    for (uint16_t i = 1; i < sequencer.length; i++) {
+        if (steps[i].time_us < steps[i - 1].time_us) {
+            return 0;
+        }
+    }
+
+    sequencer.position = 0;
+    sequencer.applied = 0;
+    sequencer.rejected = 0;
+    sequencer.late = 0;
+    sequencer.first_late = 0xFFFF;
+    sequencer.max_late_us = 0;
+    sequencer.end_us = 0;
+    sequencer.done_event = 0;
+    sequencer.state = SEQUENCER_STATE_RUNNING;
+
+    // Values staged by an earlier run are not part of this one
+    Analog_DiscardStaged(ANALOG_STAGE_SEQUENCER);
+
+    // Count from 0 and interrupt at the first step; a step at time 0 fires at once
+    __HAL_TIM_SET_COUNTER(&htim5, 0);
+    __HAL_TIM_SET_COMPARE(&htim5, TIM_CHANNEL_1, steps[0].time_us);
+    __HAL_TIM_CLEAR_FLAG(&htim5, TIM_FLAG_CC1);
+    __HAL_TIM_ENABLE_IT(&htim5, TIM_IT_CC1);
+    __HAL_TIM_ENABLE(&htim5);
+    if (steps[0].time_us == 0) {
+        htim5.Instance->EGR = TIM_EGR_CC1G;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Stop the scenario, outputs keep their present values
+ */
+void Sequencer_Stop(void) {
+    HAL_NVIC_DisableIRQ(TIM5_IRQn);
+    halt_timer();
+    if (sequencer.state == SEQUENCER_STATE_RUNNING) {
+        sequencer.end_us = __HAL_TIM_GET_COUNTER(&htim5);
+        sequencer.state = SEQUENCER_STATE_IDLE;
+    }
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+}
+
+/**
+ * @brief Get the sequencer status
+ * @param status Destination for the status
+ */
+void Sequencer_GetStatus(SequencerStatus* status) {
+    if (status == NULL) {
+        return;
+    }
+
+    memset(status, 0, sizeof(*status));
+
+    HAL_NVIC_DisableIRQ(TIM5_IRQn);
+    status->state = sequencer.state;
+    status->length = sequencer.length;
+    status->position = sequencer.position;
+    status->applied = sequencer.applied;
+    status->rejected = sequencer.rejected;
+    status->late = sequencer.late;
+    status->first_late = sequencer.first_late;
+    status->max_late_us = sequencer.max_late_us;
+    status->elapsed_us = (sequencer.state == SEQUENCER_STATE_RUNNING) ? __HAL_TIM_GET_COUNTER(&htim5)
+                                                                       : sequencer.end_us;
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+}
+
+/**
+ * @brief Apply all due steps and schedule the next one
+ * Only the CC1 interrupt is enabled. TIM5 counts microseconds since the
+ * start, so a step is due once the counter has reached its timestamp.
+ */
+void Sequencer_IRQHandler(void) {
+    uint16_t position;
+    uint32_t now;
+
+    htim5.Instance->SR = ~TIM_SR_CC1IF;
+
+    if (sequencer.state != SEQUENCER_STATE_RUNNING) {
+        return;
+    }
+
+    position = sequencer.position;
+    now = htim5.Instance->CNT;
+
+    while (position < sequencer.length && now >= steps[position].time_us) {
+        uint32_t late_us = now - steps[position].time_us;
+
+        if (late_us > SEQUENCER_LATE_US) {
+            if (sequencer.late == 0) {
+                sequencer.first_late = position;
+            }
+            sequencer.late++;
+        }
+        if (late_us > sequencer.max_late_us) {
+            sequencer.max_late_us = late_us;
+        }
+
+        if (apply_step(&steps[position])) {
+            sequencer.applied++;
+        } else {
+            sequencer.rejected++;
+        }
+
+        position++;
+        now = htim5.Instance->CNT;
+    }
+
+    sequencer.position = position;
+
+    if (position >= sequencer.length) {
+        halt_timer();
+        sequencer.end_us = now;
+        sequencer.state = SEQUENCER_STATE_DONE;
+        sequencer.done_event = 1;
+        Event_Loop_Signal(EVENT_LOOP_SEQUENCER);
+        return;
+    }
+
+    // If the counter passed the new compare value while it was written, fire by software
+    htim5.Instance->CCR1 = steps[position].time_us;
+    if (htim5.Instance->CNT >= steps[position].time_us) {
+        htim5.Instance->EGR = TIM_EGR_CC1G;
+    }
+}
+
+/**
+ * @brief Send the completion event of a finished scenario
+ * The event value is the number of late steps.
+ */
+void Sequencer_ProcessEvents(void) {
+    if (!sequencer.done_event) {
+        return;
+    }
+
+    sequencer.done_event = 0;
+    HIL_SendEvent('S', SIGNAL_SEQUENCER, sequencer.late);
+}
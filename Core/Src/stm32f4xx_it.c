@@ -23,6 +23,10 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "pwm_capture.h"
+#include "analog_simulation.h"
+#include "sequencer.h"
+#include "scheduler.h"
+#include "isr_timing.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -56,7 +60,11 @@
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
+extern DMA_HandleTypeDef hdma_tim6_up;
+extern DMA_HandleTypeDef hdma_tim7_up;
+extern DMA_HandleTypeDef hdma_tim8_up;
 extern TIM_HandleTypeDef htim1;
+extern TIM_HandleTypeDef htim4;
 extern UART_HandleTypeDef huart3;
 /* USER CODE BEGIN EV */
 
@@ -185,11 +193,16 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
-
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t isr_latency = SysTick->LOAD - SysTick->VAL;
+#endif
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_SYSTICK, isr_latency, isr_start);
+#endif
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -200,31 +213,194 @@ void SysTick_Handler(void)
 /* please refer to the startup file (startup_stm32f4xx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles DMA1 stream1 global interrupt.
+  */
+void DMA1_Stream1_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream1_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+#endif
+  /* USER CODE END DMA1_Stream1_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_tim6_up);
+  /* USER CODE BEGIN DMA1_Stream1_IRQn 1 */
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_WAVEFORM, 0, isr_start);
+#endif
+  /* USER CODE END DMA1_Stream1_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream4 global interrupt.
+  */
+void DMA1_Stream4_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream4_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+#endif
+  /* USER CODE END DMA1_Stream4_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_tim7_up);
+  /* USER CODE BEGIN DMA1_Stream4_IRQn 1 */
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_WAVEFORM, 0, isr_start);
+#endif
+  /* USER CODE END DMA1_Stream4_IRQn 1 */
+}
+
+/**
+  * @brief This function handles TIM1 update interrupt and TIM10 global interrupt.
+  */
+void TIM1_UP_TIM10_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t isr_latency = ISR_Timing_TimerCycles(TIM1, TIM1->CNT);
+#endif
+  /* USER CODE END TIM1_UP_TIM10_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim1);
+  /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 1 */
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_OVERFLOW, isr_latency, isr_start);
+#endif
+  /* USER CODE END TIM1_UP_TIM10_IRQn 1 */
+}
+
 /**
   * @brief This function handles TIM1 capture compare interrupt.
   */
 void TIM1_CC_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM1_CC_IRQn 0 */
-
+  // Capture flags are serviced at register level by the capture module
+  // ("Call HAL handler" is unticked for this vector in the .ioc)
+  PWM_Capture_IRQHandler();
   /* USER CODE END TIM1_CC_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim1);
   /* USER CODE BEGIN TIM1_CC_IRQn 1 */
 
   /* USER CODE END TIM1_CC_IRQn 1 */
 }
 
+/**
+  * @brief This function handles TIM2 global interrupt.
+  */
+void TIM2_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM2_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t isr_latency = ISR_Timing_TimerCycles(TIM2, TIM2->CNT);
+#endif
+  // Only the update interrupt is enabled, it runs output dither and noise at carrier rate
+  // ("Call HAL handler" is unticked for this vector in the .ioc)
+  Analog_UpdateIRQHandler();
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_OUTPUT, isr_latency, isr_start);
+#endif
+  /* USER CODE END TIM2_IRQn 0 */
+  /* USER CODE BEGIN TIM2_IRQn 1 */
+
+  /* USER CODE END TIM2_IRQn 1 */
+}
+
+/**
+  * @brief This function handles TIM4 global interrupt.
+  */
+void TIM4_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM4_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t isr_latency = ISR_Timing_TimerCycles(TIM4, TIM4->CNT);
+#endif
+  /* USER CODE END TIM4_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim4);
+  /* USER CODE BEGIN TIM4_IRQn 1 */
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_TICK, isr_latency, isr_start);
+#endif
+  /* USER CODE END TIM4_IRQn 1 */
+}
+
+/**
+  * @brief This function handles TIM5 global interrupt.
+  */
+void TIM5_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM5_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+#endif
+  // Only the CC1 interrupt is enabled, it applies the due sequencer steps
+  // ("Call HAL handler" is unticked for this vector in the .ioc)
+  Sequencer_IRQHandler();
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_SEQUENCER, 0, isr_start);
+#endif
+  /* USER CODE END TIM5_IRQn 0 */
+  /* USER CODE BEGIN TIM5_IRQn 1 */
+
+  /* USER CODE END TIM5_IRQn 1 */
+}
+
+/**
+  * @brief This function handles TIM8 trigger and commutation interrupts and TIM14 global interrupt.
+  */
+void TIM8_TRG_COM_TIM14_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM8_TRG_COM_TIM14_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t isr_latency = ISR_Timing_TimerCycles(TIM14, TIM14->CNT);
+#endif
+  // Only the TIM14 update interrupt is enabled, it releases the scheduler slots
+  // ("Call HAL handler" is unticked for this vector in the .ioc)
+  Scheduler_IRQHandler();
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_SCHEDULER, isr_latency, isr_start);
+#endif
+  /* USER CODE END TIM8_TRG_COM_TIM14_IRQn 0 */
+  /* USER CODE BEGIN TIM8_TRG_COM_TIM14_IRQn 1 */
+
+  /* USER CODE END TIM8_TRG_COM_TIM14_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA2 stream1 global interrupt.
+  */
+void DMA2_Stream1_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream1_IRQn 0 */
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t isr_latency = ISR_Timing_TimerCycles(TIM8, TIM8->CNT);
+#endif
+  /* USER CODE END DMA2_Stream1_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_tim8_up);
+  /* USER CODE BEGIN DMA2_Stream1_IRQn 1 */
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_GATE, isr_latency, isr_start);
+#endif
+  /* USER CODE END DMA2_Stream1_IRQn 1 */
+}
+
 /**
   * @brief This function handles USART3 global interrupt.
   */
 void USART3_IRQHandler(void)
 {
   /* USER CODE BEGIN USART3_IRQn 0 */
-
+#if ISR_TIMING
+  uint32_t isr_start = DWT->CYCCNT;
+#endif
   /* USER CODE END USART3_IRQn 0 */
   HAL_UART_IRQHandler(&huart3);
   /* USER CODE BEGIN USART3_IRQn 1 */
-
+#if ISR_TIMING
+  ISR_Timing_Record(ISR_TIMING_UART, 0, isr_start);
+#endif
   /* USER CODE END USART3_IRQn 1 */
 }
 
@@ -0,0 +1,331 @@
+/**
+ * @file waveform.c
+ * @brief DMA-fed arbitrary waveform playback on the analog outputs
+ */
+
+#include "waveform.h"
+#include "tim.h"
+#include "analog_simulation.h"
+#include "plant_model.h"
+#include "analog_fault.h"
+#include <string.h>
+
+// Fixed resources of one player
+typedef struct {
+    TIM_HandleTypeDef* htim;      // Sample pacing timer, 1 MHz tick
+    IRQn_Type dma_irq;            // Interrupt of the update DMA stream
+} WaveformResource;
+
+// Working state of one player
+typedef struct {
+    volatile uint8_t state;
+    uint8_t  light;
+    uint8_t  output;
+    uint8_t  mode;
+    uint16_t period_us;
+    uint16_t length;
+    uint16_t code_max;            // Output code range the table was loaded for
+    volatile uint32_t passes;
+    volatile uint32_t* ccr;       // Destination compare or DAC register while playing
+} WaveformPlayer;
+
+static const WaveformResource player_resource[WAVEFORM_PLAYERS] = {
+    {&htim6, DMA1_Stream1_IRQn},
+    {&htim7, DMA1_Stream4_IRQn},
+};
+
+static WaveformPlayer player[WAVEFORM_PLAYERS];
+
+// Word samples: the DMA writes the full 32-bit CCR, TIM2 would mirror a halfword write
+static uint32_t samples[WAVEFORM_PLAYERS][WAVEFORM_MAX_SAMPLES];
+
+/**
+ * @brief Find the player that owns a DMA stream
+ * @param hdma Pointer to the DMA_HandleTypeDef structure
+ * @return Player index, or WAVEFORM_PLAYERS if unknown
+ */
+static uint8_t player_of(DMA_HandleTypeDef* hdma) {
+    for (uint8_t i = 0; i < WAVEFORM_PLAYERS; i++) {
+        if (player_resource[i].htim->hdma[TIM_DMA_ID_UPDATE] == hdma) {
+            return i;
+        }
+    }
+    return WAVEFORM_PLAYERS;
+}
+
+/**
+ * @brief Stop the pacing timer so no further DMA requests are issued
+ * @param index Player index
+ */
+static void halt_timer(uint8_t index) {
+    TIM_HandleTypeDef* htim = player_resource[index].htim;
+
+    __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_UPDATE);
+    __HAL_TIM_DISABLE(htim);
+}
+
+/**
+ * @brief Store the compare value left on the output so readback and later setpoints agree
+ * @param index Player index
+ */
+static void hold_output(uint8_t index) {
+    WaveformPlayer* p = &player[index];
+
+    Analog_SetOutputCode(p->light, p->output, (uint16_t)*p->ccr);
+}
+
+/**
+ * @brief DMA transfer complete: one table pass, or the first ping-pong half
+ * @param hdma Pointer to the DMA_HandleTypeDef structure
+ */
+static void transfer_complete(DMA_HandleTypeDef* hdma) {
+    uint8_t index = player_of(hdma);
+
+    if (index >= WAVEFORM_PLAYERS) {
+        return;
+    }
+
+    player[index].passes++;
+
+    if (player[index].mode == WAVEFORM_MODE_ONE_SHOT) {
+        // The last sample stays in the compare register
+        halt_timer(index);
+        hold_output(index);
+        player[index].state = WAVEFORM_STATE_DONE;
+    }
+}
+
+/**
+ * @brief DMA transfer error: stop the player and keep the current output
+ * @param hdma Pointer to the DMA_HandleTypeDef structure
+ */
+static void transfer_error(DMA_HandleTypeDef* hdma) {
+    uint8_t index = player_of(hdma);
+
+    if (index >= WAVEFORM_PLAYERS) {
+        return;
+    }
+
+    halt_timer(index);
+    hold_output(index);
+    player[index].state = WAVEFORM_STATE_ERROR;
+}
+
+/**
+ * @brief Reset all players to idle with empty tables
+ */
+void Waveform_Init(void) {
+    memset(player, 0, sizeof(player));
+    memset(samples, 0, sizeof(samples));
+}
+
+/**
+ * @brief Load (part of) a player table from an upload payload
+ * @param payload WaveformHeader followed by samples
+ * @param length Payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Waveform_Load(const uint8_t* payload, uint16_t length) {
+    WaveformHeader header;
+    uint16_t count;
+
+    if (payload == NULL || length < sizeof(header) || ((length - sizeof(header)) & 1)) {
+        return 0;
+    }
+
+    memcpy(&header, payload, sizeof(header));
+    count = (length - sizeof(header)) / 2;
+
+    if (header.player >= WAVEFORM_PLAYERS || header.light > 2 ||
+        header.output > ANALOG_OUTPUT_TEMPERATURE || header.mode > WAVEFORM_MODE_PING_PONG ||
+        header.sample_period_us < WAVEFORM_MIN_PERIOD_US ||
+        header.length == 0 || header.length > WAVEFORM_MAX_SAMPLES ||
+        (header.mode == WAVEFORM_MODE_PING_PONG && (header.length & 1)) ||
+        (uint32_t)header.offset + count > header.length) {
+        return 0;
+    }
+
+    WaveformPlayer* p = &player[header.player];
+    const uint8_t* src = payload + sizeof(header);
+    uint16_t code_max = Analog_GetOutputMax(header.light, header.output);
+
+    if (p->state == WAVEFORM_STATE_PLAYING) {
+        // Streaming is only possible into the idle half of a running ping-pong table
+        if (p->mode != WAVEFORM_MODE_PING_PONG || header.mode != p->mode ||
+            header.light != p->light || header.output != p->output ||
+            header.length != p->length || header.sample_period_us != p->period_us) {
+            return 0;
+        }
+
+        DMA_HandleTypeDef* hdma = player_resource[header.player].htim->hdma[TIM_DMA_ID_UPDATE];
+        uint16_t half = p->length / 2;
+        uint16_t idle_start = (hdma->Instance->CR & DMA_SxCR_CT) ? 0 : half;
+
+        if (header.offset < idle_start || header.offset + count > idle_start + half) {
+            return 0;
+        }
+    }
+
+    // Validate all samples before touching the table
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t value = src[2 * i] | (src[2 * i + 1] << 8);
+        if (value > code_max) {
+            return 0;
+        }
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        samples[header.player][header.offset + i] = src[2 * i] | (src[2 * i + 1] << 8);
+    }
+
+    if (p->state != WAVEFORM_STATE_PLAYING) {
+        p->light = header.light;
+        p->output = header.output;
+        p->mode = header.mode;
+        p->period_us = header.sample_period_us;
+        p->length = header.length;
+        p->code_max = code_max;
+        p->state = WAVEFORM_STATE_IDLE;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Start playback of a loaded player
+ * @param index Player index (0-1)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Waveform_Start(uint8_t index) {
+    if (index >= WAVEFORM_PLAYERS) {
+        return 0;
+    }
+
+    WaveformPlayer* p = &player[index];
+    TIM_HandleTypeDef* htim = player_resource[index].htim;
+    DMA_HandleTypeDef* hdma = htim->hdma[TIM_DMA_ID_UPDATE];
+    HAL_StatusTypeDef status;
+
+    if (p->state == WAVEFORM_STATE_PLAYING || p->length == 0 ||
+        Plant_Model_IsEnabled(p->light) || Waveform_IsDriving(p->light, p->output) ||
+        Analog_IsRamping(p->light, p->output) || Analog_IsDithered(p->light, p->output) ||
+        Analog_HasNoise(p->light, p->output) || Analog_Fault_IsTargeted(p->light, p->output) ||
+        Analog_GetOutputMax(p->light, p->output) != p->code_max) {
+        return 0;
+    }
+
+    p->ccr = Analog_GetCompareRegister(p->light, p->output);
+    p->passes = 0;
+
+    // One-shot stops on the transfer complete, the other modes wrap in hardware
+    hdma->Init.Mode = (p->mode == WAVEFORM_MODE_ONE_SHOT) ? DMA_NORMAL : DMA_CIRCULAR;
+    if (HAL_DMA_Init(hdma) != HAL_OK) {
+        return 0;
+    }
+
+    hdma->XferCpltCallback = transfer_complete;
+    hdma->XferM1CpltCallback = transfer_complete;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferM1HalfCpltCallback = NULL;
+    hdma->XferErrorCallback = transfer_error;
+
+    if (p->mode == WAVEFORM_MODE_PING_PONG) {
+        uint16_t half = p->length / 2;
+        status = HAL_DMAEx_MultiBufferStart_IT(hdma, (uint32_t)&samples[index][0], (uint32_t)p->ccr,
+                                               (uint32_t)&samples[index][half], half);
+    } else {
+        status = HAL_DMA_Start_IT(hdma, (uint32_t)&samples[index][0], (uint32_t)p->ccr, p->length);
+    }
+
+    if (status != HAL_OK) {
+        return 0;
+    }
+
+    p->state = WAVEFORM_STATE_PLAYING;
+
+    // Reload the sample period without issuing a DMA request, then pace
+    __HAL_TIM_SET_AUTORELOAD(htim, p->period_us - 1);
+    htim->Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+    __HAL_TIM_ENABLE_DMA(htim, TIM_DMA_UPDATE);
+    __HAL_TIM_ENABLE(htim);
+
+    return 1;
+}
+
+/**
+ * @brief Stop a player, holding the current sample on its output
+ * @param index Player index (0-1)
+ * @return 1 if successful, 0 otherwise
+ */
+uint8_t Waveform_Stop(uint8_t index) {
+    if (index >= WAVEFORM_PLAYERS) {
+        return 0;
+    }
+
+    WaveformPlayer* p = &player[index];
+
+    HAL_NVIC_DisableIRQ(player_resource[index].dma_irq);
+    if (p->state == WAVEFORM_STATE_PLAYING) {
+        halt_timer(index);
+        HAL_DMA_Abort(player_resource[index].htim->hdma[TIM_DMA_ID_UPDATE]);
+        hold_output(index);
+    }
+    p->state = WAVEFORM_STATE_IDLE;
+    HAL_NVIC_EnableIRQ(player_resource[index].dma_irq);
+
+    return 1;
+}
+
+/**
+ * @brief Check whether a playing player drives an output
+ * @param light_index Light index (0-2)
+ * @param output ANALOG_OUTPUT_CURRENT or ANALOG_OUTPUT_TEMPERATURE
+ * @return 1 if driven, 0 otherwise
+ */
+uint8_t Waveform_IsDriving(uint8_t light_index, uint8_t output) {
+    for (uint8_t i = 0; i < WAVEFORM_PLAYERS; i++) {
+        if (player[i].state == WAVEFORM_STATE_PLAYING &&
+            player[i].light == light_index && player[i].output == output) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Get the status of all players
+ * @param status Destination array of WAVEFORM_PLAYERS entries
+ */
+void Waveform_GetStatus(WaveformStatus* status) {
+    if (status == NULL) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < WAVEFORM_PLAYERS; i++) {
+        const WaveformPlayer* p = &player[i];
+        DMA_Stream_TypeDef* stream = player_resource[i].htim->hdma[TIM_DMA_ID_UPDATE]->Instance;
+        WaveformStatus* s = &status[i];
+
+        memset(s, 0, sizeof(*s));
+        s->state = p->state;
+        s->light = p->light;
+        s->output = p->output;
+        s->mode = p->mode;
+        s->length = p->length;
+        s->passes = p->passes;
+
+        if (p->state != WAVEFORM_STATE_PLAYING) {
+            continue;
+        }
+
+        // NDTR counts the samples left in the current buffer
+        if (p->mode == WAVEFORM_MODE_PING_PONG) {
+            uint16_t half = p->length / 2;
+            s->active_half = (stream->CR & DMA_SxCR_CT) ? 1 : 0;
+            s->position = s->active_half * half + (half - stream->NDTR);
+        } else {
+            s->position = p->length - stream->NDTR;
+        }
+    }
+}
@@ -0,0 +1,206 @@
+/**
+ * @file capture_sim.c
+ * @brief Event-driven model of TIM1 input capture for the host tests
+ */
+
+#include "capture_sim.h"
+#include "pwm_capture.h"
+#include "tim.h"
+
+typedef struct {
+    uint64_t period;          // Signal period in clocks, 0 for a static line
+    uint64_t high;            // High time in clocks
+    uint64_t high_step;       // High time added per cycle of the pattern
+    uint32_t high_steps;      // Cycles in the high time pattern, 0 for a fixed high time
+    uint32_t cycle;           // Cycles completed since the signal was set
+    uint64_t next_rise;       // Time of the next rising edge
+    uint8_t  level;           // Current line level
+    uint8_t  icpsc;           // ICPSC field seen at the last edge
+    uint32_t psc_count;       // Qualifying edges counted by the input prescaler
+} SimChannel;
+
+static SimChannel sim_channel[PWM_CAPTURE_CHANNELS];
+static uint64_t now;
+static uint64_t origin;                 // Time the counter last restarted at 0
+static uint64_t wraps;                  // Counter wraps since origin
+static uint32_t range_switches;
+
+static const uint16_t pin_of[PWM_CAPTURE_CHANNELS] = {GPIO_PIN_9, GPIO_PIN_11, GPIO_PIN_13};
+
+static uint32_t tick_clocks(void) {
+    return TIM1->PSC + 1;
+}
+
+static uint32_t wrap_ticks(void) {
+    return TIM1->ARR + 1;
+}
+
+static uint64_t next_wrap(void) {
+    return origin + (wraps + 1) * wrap_ticks() * tick_clocks();
+}
+
+static uint64_t high_time(const SimChannel* ch) {
+    return ch->high_steps ? ch->high + (ch->cycle % ch->high_steps) * ch->high_step : ch->high;
+}
+
+static uint64_t next_edge(const SimChannel* ch) {
+    if (ch->period == 0) {
+        return UINT64_MAX;
+    }
+    return ch->level ? ch->next_rise + high_time(ch) : ch->next_rise;
+}
+
+/**
+ * @brief ICPSC field of a channel as written by the firmware
+ */
+static uint8_t channel_icpsc(uint8_t channel) {
+    uint32_t ccmr = (channel < 2) ? TIM1->CCMR1 : TIM1->CCMR2;
+    uint32_t shift = (channel == 1) ? 8 : 0;
+    return (uint8_t)((ccmr >> (shift + 2)) & 3);
+}
+
+/**
+ * @brief Apply a software update event: reload the prescaler, restart the counter
+ */
+static void check_update_generation(void) {
+    if (TIM1->EGR & TIM_EGR_UG) {
+        TIM1->EGR = 0;
+        origin = now;
+        wraps = 0;
+        TIM1->CNT = 0;
+        range_switches++;
+    }
+}
+
+static void set_pin(uint8_t channel, uint8_t level) {
+    if (level) {
+        GPIOE->IDR |= pin_of[channel];
+    } else {
+        GPIOE->IDR &= ~(uint32_t)pin_of[channel];
+    }
+}
+
+static void counter_wrap(void) {
+    now = next_wrap();
+    wraps++;
+    TIM1->CNT = 0;
+
+    // HAL_TIM_IRQHandler clears UIF before the period elapsed callback
+    if (TIM1->DIER & TIM_DIER_UIE) {
+        PWM_Capture_ProcessOverflow(&htim1);
+    }
+    check_update_generation();
+}
+
+static void channel_edge(uint8_t channel) {
+    SimChannel* ch = &sim_channel[channel];
+    uint8_t rising = !ch->level;
+
+    now = next_edge(ch);
+    ch->level = rising;
+    if (!rising) {
+        ch->next_rise += ch->period;
+        ch->cycle++;
+    }
+    set_pin(channel, ch->level);
+
+    uint32_t enable = TIM_CCER_CC1E << (4 * channel);
+    uint32_t falling = TIM_CCER_CC1P << (4 * channel);
+    if (!(TIM1->CCER & enable) || rising == !!(TIM1->CCER & falling)) {
+        return;
+    }
+
+    // The input prescaler restarts when its ratio changes
+    uint8_t icpsc = channel_icpsc(channel);
+    if (icpsc != ch->icpsc) {
+        ch->icpsc = icpsc;
+        ch->psc_count = 0;
+    }
+    if (ch->psc_count++ % (1U << icpsc) != 0) {
+        return;
+    }
+
+    uint32_t flag = TIM_SR_CC1IF << channel;
+    TIM1->CNT = (uint32_t)(((now - origin) / tick_clocks()) % wrap_ticks());
+    *(&TIM1->CCR1 + channel) = TIM1->CNT;
+    TIM1->SR |= flag;
+    if (TIM1->DIER & flag) {
+        PWM_Capture_IRQHandler();
+        // Reading CCRx clears CCxIF
+        TIM1->SR &= ~flag;
+    }
+    check_update_generation();
+}
+
+void Capture_Sim_Init(void) {
+    Stub_HAL_Reset();
+    memset(sim_channel, 0, sizeof(sim_channel));
+    now = 0;
+    origin = 0;
+    wraps = 0;
+    range_switches = 0;
+
+    // MX_TIM1_Init
+    htim1.Init.Prescaler = 83;
+    htim1.Init.Period = 9999;
+    HAL_TIM_Base_Init(&htim1);
+
+    PWM_Capture_Init();
+    PWM_Capture_Start();
+}
+
+void Capture_Sim_SetSignal(uint8_t channel, uint64_t period_clocks, uint64_t high_clocks, uint8_t level) {
+    SimChannel* ch = &sim_channel[channel];
+
+    ch->period = period_clocks;
+    ch->high = high_clocks;
+    ch->high_steps = 0;
+    ch->cycle = 0;
+    ch->level = period_clocks ? 0 : level;
+    ch->next_rise = now + 1;
+    set_pin(channel, ch->level);
+}
+
+void Capture_Sim_SetHighPattern(uint8_t channel, uint64_t step_clocks, uint32_t steps) {
+    sim_channel[channel].high_step = step_clocks;
+    sim_channel[channel].high_steps = steps;
+}
+
+void Capture_Sim_Run(uint64_t clocks) {
+    uint64_t end = now + clocks;
+
+    for (;;) {
+        uint64_t wrap_at = next_wrap();
+        uint8_t edge_channel = 0;
+        uint64_t edge_at = UINT64_MAX;
+
+        for (uint8_t i = 0; i < PWM_CAPTURE_CHANNELS; i++) {
+            uint64_t t = next_edge(&sim_channel[i]);
+            if (t < edge_at) {
+                edge_at = t;
+                edge_channel = i;
+            }
+        }
+
+        if (wrap_at > end && edge_at > end) {
+            break;
+        }
+
+        // A wrap coinciding with an edge is counted first, the capture then reads 0
+        if (wrap_at <= edge_at) {
+            counter_wrap();
+        } else {
+            channel_edge(edge_channel);
+        }
+    }
+
+    now = end;
+}
+
+uint64_t Capture_Sim_Now(void) {
+    return now;
+}
+
+uint32_t Capture_Sim_RangeSwitches(void) {
+    return range_switches;
+}
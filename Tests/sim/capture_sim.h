@@ -0,0 +1,59 @@
+/**
+ * @file capture_sim.h
+ * @brief Event-driven model of TIM1 input capture for the host tests
+ *
+ * Time advances in 168 MHz TIM1 clock cycles from edge to edge. The
+ * counter follows the prescaler and auto-reload the firmware programs,
+ * each channel captures on the edge and ICPSC division selected in CCER
+ * and CCMR, and the capture and update interrupts call straight into the
+ * capture module.
+ */
+
+#ifndef CAPTURE_SIM_H
+#define CAPTURE_SIM_H
+
+#include "main.h"
+
+#define CAPTURE_SIM_CLOCK_HZ  168000000ULL
+
+/**
+ * @brief Reset the model, configure TIM1 as tim.c does and start capture
+ * Capture is initialized and started with auto-ranging off.
+ */
+void Capture_Sim_Init(void);
+
+/**
+ * @brief Drive a channel with a PWM signal
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param period_clocks Period in TIM1 clock cycles, 0 holds the line at 'level'
+ * @param high_clocks High time in TIM1 clock cycles
+ * @param level Static level when period_clocks is 0
+ */
+void Capture_Sim_SetSignal(uint8_t channel, uint64_t period_clocks, uint64_t high_clocks, uint8_t level);
+
+/**
+ * @brief Vary the high time of a channel from cycle to cycle
+ * Cycle k of the signal is high for high_clocks + (k % steps) * step_clocks.
+ * @param channel Channel index (0 to PWM_CAPTURE_CHANNELS-1)
+ * @param step_clocks High time added per cycle
+ * @param steps Cycles before the pattern repeats, 0 for a fixed high time
+ */
+void Capture_Sim_SetHighPattern(uint8_t channel, uint64_t step_clocks, uint32_t steps);
+
+/**
+ * @brief Run the model for a span of time
+ * @param clocks Duration in TIM1 clock cycles
+ */
+void Capture_Sim_Run(uint64_t clocks);
+
+/**
+ * @brief Current simulated time in TIM1 clock cycles
+ */
+uint64_t Capture_Sim_Now(void);
+
+/**
+ * @brief Number of capture range switches seen so far
+ */
+uint32_t Capture_Sim_RangeSwitches(void);
+
+#endif /* CAPTURE_SIM_H */
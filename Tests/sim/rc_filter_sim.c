@@ -0,0 +1,66 @@
+/**
+ * @file rc_filter_sim.c
+ * @brief Model of a PWM output pin driving a buffered RC low-pass filter
+ */
+
+#include "rc_filter_sim.h"
+#include <math.h>
+
+void RC_Filter_Sim_Init(RcFilterSim* sim, uint8_t stages, double tau_s, double level) {
+    sim->stages = stages;
+    sim->tau_s = tau_s;
+    for (uint8_t i = 0; i < RC_FILTER_SIM_MAX_STAGES; i++) {
+        sim->level[i] = level;
+    }
+    RC_Filter_Sim_ResetStats(sim);
+}
+
+/**
+ * @brief Hold the pin at one level for a number of counts
+ * Each stage follows its exact response to an input held over one count.
+ */
+static void run_counts(RcFilterSim* sim, double input, uint32_t counts, double decay) {
+    for (uint32_t n = 0; n < counts; n++) {
+        double stage_input = input;
+
+        for (uint8_t i = 0; i < sim->stages; i++) {
+            sim->level[i] = stage_input + (sim->level[i] - stage_input) * decay;
+            stage_input = sim->level[i];
+        }
+
+        if (stage_input < sim->min) {
+            sim->min = stage_input;
+        }
+        if (stage_input > sim->max) {
+            sim->max = stage_input;
+        }
+        sim->sum += stage_input;
+        sim->samples++;
+    }
+}
+
+void RC_Filter_Sim_Period(RcFilterSim* sim, uint32_t compare, uint32_t arr, double count_s) {
+    double decay = exp(-count_s / sim->tau_s);
+
+    if (compare > arr + 1) {
+        compare = arr + 1;
+    }
+
+    run_counts(sim, arr + 1, compare, decay);
+    run_counts(sim, 0.0, arr + 1 - compare, decay);
+}
+
+void RC_Filter_Sim_ResetStats(RcFilterSim* sim) {
+    sim->min = INFINITY;
+    sim->max = -INFINITY;
+    sim->sum = 0.0;
+    sim->samples = 0;
+}
+
+double RC_Filter_Sim_Mean(const RcFilterSim* sim) {
+    return sim->samples ? sim->sum / sim->samples : 0.0;
+}
+
+double RC_Filter_Sim_Ripple(const RcFilterSim* sim) {
+    return sim->samples ? sim->max - sim->min : 0.0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file rc_filter_sim.h
+ * @brief Model of a PWM output pin driving a buffered RC low-pass filter
+ *
+ * The pin is high for 'compare' of the ARR + 1 counts of each period
+ * (PWM mode 1, up-counting) and the filter is a cascade of identical
+ * first-order stages that do not load each other. Time advances one
+ * timer count at a time with the exact step response of each stage, so
+ * the mean output over whole periods equals the mean duty exactly.
+ *
+ * The output is in compare steps: full duty reads ARR + 1.
+ */
+
+#ifndef RC_FILTER_SIM_H
+#define RC_FILTER_SIM_H
+
+#include <stdint.h>
+
+#define RC_FILTER_SIM_MAX_STAGES  4
+
+typedef struct {
+    uint8_t stages;
+    double  tau_s;                          // Time constant of each stage
+    double  level[RC_FILTER_SIM_MAX_STAGES];
+    double  min;                            // Output extremes and sum since the last reset
+    double  max;
+    double  sum;
+    uint64_t samples;
+} RcFilterSim;
+
+/**
+ * @brief Set up a filter that has settled at a level
+ * @param sim Filter
+ * @param stages Number of stages (1-RC_FILTER_SIM_MAX_STAGES)
+ * @param tau_s Time constant of each stage in seconds
+ * @param level Initial output of every stage in compare steps
+ */
+void RC_Filter_Sim_Init(RcFilterSim* sim, uint8_t stages, double tau_s, double level);
+
+/**
+ * @brief Run one PWM period through the filter
+ * @param sim Filter
+ * @param compare Compare value of the period
+ * @param arr Auto-reload value of the timer
+ * @param count_s Duration of one timer count in seconds
+ */
+void RC_Filter_Sim_Period(RcFilterSim* sim, uint32_t compare, uint32_t arr, double count_s);
+
+/**
+ * @brief Restart the output statistics
+ * @param sim Filter
+ */
+void RC_Filter_Sim_ResetStats(RcFilterSim* sim);
+
+/**
+ * @brief Mean output since the last statistics reset
+ * @param sim Filter
+ * @return Mean in compare steps
+ */
+double RC_Filter_Sim_Mean(const RcFilterSim* sim);
+
+/**
+ * @brief Peak-to-peak ripple since the last statistics reset
+ * @param sim Filter
+ * @return Ripple in compare steps
+ */
+double RC_Filter_Sim_Ripple(const RcFilterSim* sim);
+
+#endif /* RC_FILTER_SIM_H */
@@ -0,0 +1,58 @@
+/**
+ * @file waveform_gen.c
+ * @brief Host-side generator of waveform tables and their upload payloads
+ */
+
+#include "waveform_gen.h"
+#include <math.h>
+
+static uint16_t clamp_code(float value, uint16_t code_max) {
+    if (value < 0.0f) {
+        return 0;
+    }
+    if (value > code_max) {
+        return code_max;
+    }
+    return (uint16_t)(value + 0.5f);
+}
+
+void Waveform_Gen_Ramp(uint16_t* table, uint16_t length, uint16_t from, uint16_t to) {
+    for (uint16_t i = 0; i < length; i++) {
+        table[i] = clamp_code(from + ((float)to - from) * i / (length - 1), 0xFFFF);
+    }
+}
+
+void Waveform_Gen_Sine(uint16_t* table, uint16_t length, uint16_t offset, uint16_t amplitude, uint16_t code_max) {
+    for (uint16_t i = 0; i < length; i++) {
+        table[i] = clamp_code(offset + amplitude * sinf(2.0f * (float)M_PI * i / length), code_max);
+    }
+}
+
+void Waveform_Gen_Surge(uint16_t* table, uint16_t length, uint16_t base, uint16_t peak, uint16_t rise, float decay) {
+    for (uint16_t i = 0; i < length; i++) {
+        float value;
+
+        if (i < rise) {
+            value = base + ((float)peak - base) * (i + 1) / rise;
+        } else {
+            value = base + ((float)peak - base) * expf(-(float)(i + 1 - rise) / decay);
+        }
+        table[i] = clamp_code(value, 0xFFFF);
+    }
+}
+
+uint16_t Waveform_Gen_Payload(uint8_t* payload, const WaveformHeader* header, const uint16_t* table,
+                              uint16_t offset, uint16_t count) {
+    WaveformHeader chunk = *header;
+
+    chunk.offset = offset;
+    memcpy(payload, &chunk, sizeof(chunk));
+
+    uint8_t* dst = payload + sizeof(chunk);
+    for (uint16_t i = 0; i < count; i++) {
+        dst[2 * i] = (uint8_t)table[offset + i];
+        dst[2 * i + 1] = (uint8_t)(table[offset + i] >> 8);
+    }
+
+    return (uint16_t)(sizeof(chunk) + 2 * count);
+}
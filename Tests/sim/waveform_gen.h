@@ -0,0 +1,60 @@
+/**
+ * @file waveform_gen.h
+ * @brief Host-side generator of waveform tables and their upload payloads
+ *
+ * Builds ramp, sine and surge tables in output codes and splits a table
+ * into CMD_UPLOAD payloads (WaveformHeader followed by little endian
+ * samples) that fit HIL_UPLOAD_MAX_SIZE.
+ */
+
+#ifndef WAVEFORM_GEN_H
+#define WAVEFORM_GEN_H
+
+#include "waveform.h"
+
+// Samples that fit one upload after the header
+#define WAVEFORM_GEN_CHUNK  ((HIL_UPLOAD_MAX_SIZE - sizeof(WaveformHeader)) / 2)
+
+/**
+ * @brief Linear ramp including both end points
+ * @param table Destination
+ * @param length Samples (at least 2)
+ * @param from First code
+ * @param to Last code
+ */
+void Waveform_Gen_Ramp(uint16_t* table, uint16_t length, uint16_t from, uint16_t to);
+
+/**
+ * @brief One full sine period, clamped to the code range
+ * @param table Destination
+ * @param length Samples
+ * @param offset Mid code
+ * @param amplitude Peak deviation from the mid code
+ * @param code_max Largest valid code
+ */
+void Waveform_Gen_Sine(uint16_t* table, uint16_t length, uint16_t offset, uint16_t amplitude, uint16_t code_max);
+
+/**
+ * @brief Surge: linear rise from base to peak, then exponential decay back to base
+ * @param table Destination
+ * @param length Samples
+ * @param base Code before and after the surge
+ * @param peak Code at the end of the rise
+ * @param rise Samples of the rise (at least 1)
+ * @param decay Decay time constant in samples
+ */
+void Waveform_Gen_Surge(uint16_t* table, uint16_t length, uint16_t base, uint16_t peak, uint16_t rise, float decay);
+
+/**
+ * @brief Build the upload payload of one chunk of a table
+ * @param payload Destination of at least HIL_UPLOAD_MAX_SIZE bytes
+ * @param header Player configuration; its offset is replaced by 'offset'
+ * @param table Complete table
+ * @param offset Index of the first sample of the chunk
+ * @param count Samples in the chunk (at most WAVEFORM_GEN_CHUNK)
+ * @return Payload length in bytes
+ */
+uint16_t Waveform_Gen_Payload(uint8_t* payload, const WaveformHeader* header, const uint16_t* table,
+                              uint16_t offset, uint16_t count);
+
+#endif /* WAVEFORM_GEN_H */
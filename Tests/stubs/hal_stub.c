@@ -0,0 +1,306 @@
+/**
+ * @file hal_stub.c
+ * @brief Host stand-in for the HAL calls, peripherals and CubeMX handles
+ */
+
+#include "main.h"
+#include "tim.h"
+
+DWT_Type stub_dwt;
+CoreDebug_Type stub_core_debug;
+TIM_TypeDef stub_tim[15];
+DMA_Stream_TypeDef stub_dma_stream[2][8];
+DAC_TypeDef stub_dac;
+GPIO_TypeDef stub_gpio[5];
+
+uint32_t SystemCoreClock = 168000000;
+uint32_t stub_primask;
+void (*stub_barrier_hook)(void);
+void (*stub_wfi_hook)(void);
+void (*stub_unmask_hook)(void);
+uint8_t stub_nvic_enabled[STUB_IRQ_COUNT];
+
+// Handles generated in tim.c
+TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim3;
+TIM_HandleTypeDef htim4;
+TIM_HandleTypeDef htim5;
+TIM_HandleTypeDef htim6;
+TIM_HandleTypeDef htim7;
+TIM_HandleTypeDef htim8;
+TIM_HandleTypeDef htim14;
+DMA_HandleTypeDef hdma_tim6_up;
+DMA_HandleTypeDef hdma_tim7_up;
+DMA_HandleTypeDef hdma_tim8_up;
+
+static uint8_t in_barrier_hook;
+static uint8_t in_unmask_hook;
+static uint32_t tim4_tick_users;
+
+/**
+ * @brief Return all stub peripherals, hooks and handles to their reset state
+ */
+void Stub_HAL_Reset(void) {
+    memset(&stub_dwt, 0, sizeof(stub_dwt));
+    memset(&stub_core_debug, 0, sizeof(stub_core_debug));
+    memset(stub_tim, 0, sizeof(stub_tim));
+    memset(stub_dma_stream, 0, sizeof(stub_dma_stream));
+    memset(&stub_dac, 0, sizeof(stub_dac));
+    memset(stub_gpio, 0, sizeof(stub_gpio));
+    memset(stub_nvic_enabled, 0, sizeof(stub_nvic_enabled));
+    SystemCoreClock = 168000000;
+    stub_primask = 0;
+    stub_barrier_hook = NULL;
+    stub_wfi_hook = NULL;
+    stub_unmask_hook = NULL;
+    in_barrier_hook = 0;
+    in_unmask_hook = 0;
+    tim4_tick_users = 0;
+
+    TIM_HandleTypeDef* handles[15] = {
+        NULL, &htim1, &htim2, &htim3, &htim4, &htim5, &htim6, &htim7, &htim8,
+        NULL, NULL, NULL, NULL, NULL, &htim14,
+    };
+    for (int i = 0; i < 15; i++) {
+        if (handles[i] != NULL) {
+            memset(handles[i], 0, sizeof(*handles[i]));
+            handles[i]->Instance = &stub_tim[i];
+            stub_tim[i].ARR = 0xFFFF;
+        }
+    }
+    stub_tim[2].ARR = 0xFFFFFFFF;
+    stub_tim[5].ARR = 0xFFFFFFFF;
+
+    // DMA links made by the MSP code
+    memset(&hdma_tim6_up, 0, sizeof(hdma_tim6_up));
+    memset(&hdma_tim7_up, 0, sizeof(hdma_tim7_up));
+    memset(&hdma_tim8_up, 0, sizeof(hdma_tim8_up));
+    hdma_tim6_up.Instance = DMA1_Stream1;
+    hdma_tim7_up.Instance = DMA1_Stream4;
+    hdma_tim8_up.Instance = DMA2_Stream1;
+    htim6.hdma[TIM_DMA_ID_UPDATE] = &hdma_tim6_up;
+    htim7.hdma[TIM_DMA_ID_UPDATE] = &hdma_tim7_up;
+    htim8.hdma[TIM_DMA_ID_UPDATE] = &hdma_tim8_up;
+    hdma_tim6_up.Parent = &htim6;
+    hdma_tim7_up.Parent = &htim7;
+    hdma_tim8_up.Parent = &htim8;
+
+    // Stream configuration of MX_TIMx_MspInit
+    hdma_tim6_up.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_tim6_up.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_tim6_up.Init.Mode = DMA_CIRCULAR;
+    hdma_tim7_up.Init = hdma_tim6_up.Init;
+    hdma_tim8_up.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_tim8_up.Init.MemInc = DMA_MINC_DISABLE;
+    hdma_tim8_up.Init.Mode = DMA_CIRCULAR;
+}
+
+/**
+ * @brief Memory barrier, the point where a test lets an interrupt preempt
+ */
+void stub_barrier(void) {
+    if (stub_barrier_hook != NULL && stub_primask == 0 && !in_barrier_hook) {
+        in_barrier_hook = 1;
+        stub_barrier_hook();
+        in_barrier_hook = 0;
+    }
+}
+
+/**
+ * @brief Write PRIMASK, clearing it runs the unmask hook
+ * @param value New PRIMASK value
+ */
+void stub_set_primask(uint32_t value) {
+    stub_primask = value;
+    if (value == 0 && stub_unmask_hook != NULL && !in_unmask_hook) {
+        in_unmask_hook = 1;
+        stub_unmask_hook();
+        in_unmask_hook = 0;
+    }
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    stub_nvic_enabled[IRQn + STUB_IRQ_OFFSET] = 1;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+    stub_nvic_enabled[IRQn + STUB_IRQ_OFFSET] = 0;
+}
+
+void HAL_DBGMCU_EnableDBGSleepMode(void) {
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init) {
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim) {
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim) {
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef* htim) {
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim) {
+    __HAL_TIM_ENABLE_IT(htim, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim) {
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_UPDATE);
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef* htim, TIM_ClockConfigTypeDef* sClockSourceConfig) {
+    htim->Instance->SMCR = sClockSourceConfig->ClockSource;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    htim->Instance->CCER |= TIM_CCER_CC1E << Channel;
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    htim->Instance->CCER &= ~(TIM_CCER_CC1E << Channel);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    htim->Instance->CCER |= TIM_CCER_CC1E << Channel;
+    __HAL_TIM_ENABLE_IT(htim, TIM_DIER_CC1IE << (Channel >> 2));
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    htim->Instance->CCER &= ~(TIM_CCER_CC1E << Channel);
+    __HAL_TIM_DISABLE_IT(htim, TIM_DIER_CC1IE << (Channel >> 2));
+    return HAL_OK;
+}
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef* htim) {
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength) {
+    if (hdma->Running) {
+        return HAL_BUSY;
+    }
+    hdma->SrcAddress = SrcAddress;
+    hdma->DstAddress = DstAddress;
+    hdma->SecondAddress = 0;
+    hdma->Length = DataLength;
+    hdma->Instance->NDTR = DataLength;
+    hdma->Instance->CR = DMA_SxCR_EN;
+    hdma->Running = 1;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress,
+                                                uint32_t SecondMemAddress, uint32_t DataLength) {
+    HAL_StatusTypeDef status = HAL_DMA_Start_IT(hdma, SrcAddress, DstAddress, DataLength);
+    if (status == HAL_OK) {
+        hdma->SecondAddress = SecondMemAddress;
+        hdma->Instance->CR |= DMA_SxCR_DBM;
+    }
+    return status;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* hdma) {
+    hdma->Running = 0;
+    hdma->Instance->CR = 0;
+    return HAL_OK;
+}
+
+void Stub_DMA_Request(DMA_HandleTypeDef* hdma) {
+    DMA_Stream_TypeDef* stream = hdma->Instance;
+
+    if (!hdma->Running || stream->NDTR == 0) {
+        return;
+    }
+
+    uint8_t to_periph = (hdma->Init.Direction == DMA_MEMORY_TO_PERIPH);
+    uint8_t second = (stream->CR & DMA_SxCR_DBM) && (stream->CR & DMA_SxCR_CT);
+    uintptr_t memory = second ? hdma->SecondAddress : (to_periph ? hdma->SrcAddress : hdma->DstAddress);
+    uintptr_t periph = to_periph ? hdma->DstAddress : hdma->SrcAddress;
+    uint32_t index = (hdma->Init.MemInc == DMA_MINC_ENABLE) ? hdma->Length - stream->NDTR : 0;
+    volatile uint32_t* mem_word = (volatile uint32_t*)memory + index;
+    volatile uint32_t* periph_word = (volatile uint32_t*)periph;
+
+    if (to_periph) {
+        *periph_word = *mem_word;
+    } else {
+        *mem_word = *periph_word;
+    }
+
+    stream->NDTR--;
+    if (stream->NDTR == hdma->Length / 2 && hdma->XferHalfCpltCallback != NULL) {
+        hdma->XferHalfCpltCallback(hdma);
+    }
+    if (stream->NDTR != 0) {
+        return;
+    }
+
+    if (stream->CR & DMA_SxCR_DBM) {
+        // Double buffer: switch memory and report the buffer just completed
+        stream->NDTR = hdma->Length;
+        stream->CR ^= DMA_SxCR_CT;
+        void (*callback)(DMA_HandleTypeDef*) = second ? hdma->XferM1CpltCallback : hdma->XferCpltCallback;
+        if (callback != NULL) {
+            callback(hdma);
+        }
+        return;
+    }
+
+    if (hdma->Init.Mode == DMA_CIRCULAR) {
+        stream->NDTR = hdma->Length;
+    } else {
+        hdma->Running = 0;
+        stream->CR &= ~DMA_SxCR_EN;
+    }
+    if (hdma->XferCpltCallback != NULL) {
+        hdma->XferCpltCallback(hdma);
+    }
+}
+
+/**
+ * @brief Stand-in for the generated error trap
+ */
+void Error_Handler(void) {
+}
+
+/**
+ * @brief Request or release the shared 1 kHz TIM4 tick, as in tim.c
+ * @param user TIM4_TICK_* bit of the caller
+ * @param enable 1 to request, 0 to release
+ */
+void TIM4_Tick_Request(uint32_t user, uint8_t enable) {
+    uint32_t previous = tim4_tick_users;
+
+    tim4_tick_users = enable ? (previous | user) : (previous & ~user);
+    if (previous == 0 && tim4_tick_users != 0) {
+        HAL_TIM_Base_Start_IT(&htim4);
+    } else if (previous != 0 && tim4_tick_users == 0) {
+        HAL_TIM_Base_Stop_IT(&htim4);
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file hil_stub.c
+ * @brief Host stand-in for the HIL protocol responses
+ *
+ * Bulk responses are collected into one buffer for the test to decode,
+ * events are counted.
+ */
+
+#include "hil_stub.h"
+#include <string.h>
+
+uint8_t  stub_bulk[STUB_BULK_SIZE];
+uint32_t stub_bulk_length;
+uint32_t stub_bulk_announced;
+uint32_t stub_event_count;
+char     stub_last_event;
+void (*stub_bulk_write_hook)(void);
+
+/**
+ * @brief Forget all collected responses
+ */
+void Stub_HIL_Reset(void) {
+    stub_bulk_length = 0;
+    stub_bulk_announced = 0;
+    stub_event_count = 0;
+    stub_last_event = 0;
+    stub_bulk_write_hook = NULL;
+}
+
+void HIL_BeginBulkResponse(const HILMessage* request, uint16_t length) {
+    stub_bulk_length = 0;
+    stub_bulk_announced = length;
+}
+
+void HIL_WriteBulkResponse(const void* data, uint16_t length) {
+    if (stub_bulk_length + length <= STUB_BULK_SIZE) {
+        memcpy(&stub_bulk[stub_bulk_length], data, length);
+    }
+    stub_bulk_length += length;
+
+    // Lets a test run capture interrupts while the payload is being sent
+    if (stub_bulk_write_hook != NULL) {
+        stub_bulk_write_hook();
+    }
+}
+
+void HIL_EndBulkResponse(void) {
+}
+
+void HIL_SendBulkResponse(const HILMessage* request, const void* payload, uint16_t length) {
+    HIL_BeginBulkResponse(request, length);
+    HIL_WriteBulkResponse(payload, length);
+    HIL_EndBulkResponse();
+}
+
+void HIL_SendEvent(char light, char function, uint16_t value) {
+    stub_event_count++;
+    stub_last_event = function;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file hil_stub.h
+ * @brief Host stand-in for the HIL protocol responses
+ */
+
+#ifndef HIL_STUB_H
+#define HIL_STUB_H
+
+#include "main.h"
+
+#define STUB_BULK_SIZE  16384
+
+extern uint8_t  stub_bulk[STUB_BULK_SIZE];
+extern uint32_t stub_bulk_length;       // Bytes written by the last bulk response
+extern uint32_t stub_bulk_announced;    // Length announced by HIL_BeginBulkResponse
+extern uint32_t stub_event_count;
+extern char     stub_last_event;
+extern void (*stub_bulk_write_hook)(void);
+
+/**
+ * @brief Forget all collected responses
+ */
+void Stub_HIL_Reset(void);
+
+#endif /* HIL_STUB_H */
@@ -0,0 +1,439 @@
+/**
+ * @file stm32f4xx_hal.h
+ * @brief Host stand-in for the STM32F4 HAL and CMSIS used by the unit tests
+ *
+ * Found before the real HAL through the test include path, so the firmware
+ * modules compile unchanged on the host. Peripherals are plain structs in
+ * RAM: tests set counters and flags directly and read back what the module
+ * under test wrote. Only the registers, macros and HAL calls the tested
+ * modules use are provided.
+ *
+ * __DMB() and __WFI() call optional test hooks. A hook on __DMB() runs
+ * while PRIMASK is clear, which is how tests let an "interrupt" preempt
+ * the main-loop side of a seqlock at its barriers. A hook on clearing
+ * PRIMASK runs the interrupts that became pending while it was set.
+ */
+
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define __IO    volatile
+#define UNUSED(X)  (void)(X)
+
+typedef enum {
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    RESET = 0U,
+    SET = !RESET
+} FlagStatus;
+
+/* Interrupt numbers -----------------------------------------------------------*/
+typedef enum {
+    SysTick_IRQn                = -1,
+    DMA1_Stream1_IRQn           = 12,
+    DMA1_Stream4_IRQn           = 15,
+    TIM1_UP_TIM10_IRQn          = 25,
+    TIM1_CC_IRQn                = 27,
+    TIM2_IRQn                   = 28,
+    TIM4_IRQn                   = 30,
+    USART3_IRQn                 = 39,
+    TIM8_TRG_COM_TIM14_IRQn     = 45,
+    TIM5_IRQn                   = 50,
+    DMA2_Stream1_IRQn           = 57,
+} IRQn_Type;
+
+#define STUB_IRQ_OFFSET  16
+#define STUB_IRQ_COUNT   (STUB_IRQ_OFFSET + 97)
+
+/* Core registers --------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk        0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk    0x01000000U
+
+extern uint32_t SystemCoreClock;   // 168 MHz after reset, as SystemClock_Config sets it
+
+extern DWT_Type stub_dwt;
+extern CoreDebug_Type stub_core_debug;
+#define DWT        (&stub_dwt)
+#define CoreDebug  (&stub_core_debug)
+
+/* Timers ----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t BDTR;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+    __IO uint32_t OR;
+} TIM_TypeDef;
+
+extern TIM_TypeDef stub_tim[15];
+#define TIM1   (&stub_tim[1])
+#define TIM2   (&stub_tim[2])
+#define TIM3   (&stub_tim[3])
+#define TIM4   (&stub_tim[4])
+#define TIM5   (&stub_tim[5])
+#define TIM6   (&stub_tim[6])
+#define TIM7   (&stub_tim[7])
+#define TIM8   (&stub_tim[8])
+#define TIM14  (&stub_tim[14])
+
+#define TIM_CR1_CEN       0x0001U
+#define TIM_CR1_UDIS      0x0002U
+#define TIM_DIER_UIE      0x0001U
+#define TIM_DIER_CC1IE    0x0002U
+#define TIM_DIER_CC2IE    0x0004U
+#define TIM_DIER_CC3IE    0x0008U
+#define TIM_DIER_CC4IE    0x0010U
+#define TIM_DIER_UDE      0x0100U
+#define TIM_SR_UIF        0x0001U
+#define TIM_SR_CC1IF      0x0002U
+#define TIM_SR_CC2IF      0x0004U
+#define TIM_SR_CC3IF      0x0008U
+#define TIM_SR_CC4IF      0x0010U
+#define TIM_EGR_UG        0x0001U
+#define TIM_EGR_CC1G      0x0002U
+#define TIM_CCER_CC1E     0x0001U
+#define TIM_CCER_CC1P     0x0002U
+#define TIM_CCER_CC1NP    0x0008U
+#define TIM_CCER_CC2E     0x0010U
+#define TIM_CCER_CC2P     0x0020U
+#define TIM_CCER_CC2NP    0x0080U
+#define TIM_CCER_CC3E     0x0100U
+#define TIM_CCER_CC3P     0x0200U
+#define TIM_CCER_CC3NP    0x0800U
+#define TIM_CCMR1_IC1PSC  0x000CU
+#define TIM_CCMR1_IC1F_Pos  4U
+#define TIM_CCMR1_IC2F_Pos  12U
+#define TIM_CCMR2_IC3F_Pos  4U
+
+#define TIM_CHANNEL_1     0x00000000U
+#define TIM_CHANNEL_2     0x00000004U
+#define TIM_CHANNEL_3     0x00000008U
+#define TIM_CHANNEL_4     0x0000000CU
+
+#define TIM_FLAG_UPDATE   TIM_SR_UIF
+#define TIM_FLAG_CC1      TIM_SR_CC1IF
+#define TIM_FLAG_CC2      TIM_SR_CC2IF
+#define TIM_FLAG_CC3      TIM_SR_CC3IF
+#define TIM_IT_UPDATE     TIM_DIER_UIE
+#define TIM_IT_CC1        TIM_DIER_CC1IE
+#define TIM_IT_CC2        TIM_DIER_CC2IE
+#define TIM_IT_CC3        TIM_DIER_CC3IE
+#define TIM_DMA_UPDATE    TIM_DIER_UDE
+#define TIM_DMA_ID_UPDATE 0U
+
+#define TIM_ICPSC_DIV1    0x00000000U
+#define TIM_ICPSC_DIV2    0x00000004U
+#define TIM_ICPSC_DIV4    0x00000008U
+#define TIM_ICPSC_DIV8    0x0000000CU
+
+#define TIM_INPUTCHANNELPOLARITY_RISING    0x00000000U
+#define TIM_INPUTCHANNELPOLARITY_FALLING   TIM_CCER_CC1P
+#define TIM_INPUTCHANNELPOLARITY_BOTHEDGE  (TIM_CCER_CC1P | TIM_CCER_CC1NP)
+
+#define TIM_CLOCKSOURCE_INTERNAL   0x00000000U
+#define TIM_CLOCKSOURCE_TI1        0x00000050U
+#define TIM_CLOCKSOURCE_TI2        0x00000060U
+#define TIM_CLOCKPOLARITY_RISING   0x00000000U
+#define TIM_CLOCKPRESCALER_DIV1    0x00000000U
+
+typedef enum {
+    HAL_TIM_ACTIVE_CHANNEL_1        = 0x01U,
+    HAL_TIM_ACTIVE_CHANNEL_2        = 0x02U,
+    HAL_TIM_ACTIVE_CHANNEL_3        = 0x04U,
+    HAL_TIM_ACTIVE_CHANNEL_4        = 0x08U,
+    HAL_TIM_ACTIVE_CHANNEL_CLEARED  = 0x00U
+} HAL_TIM_ActiveChannel;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+    uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    uint32_t ClockSource;
+    uint32_t ClockPolarity;
+    uint32_t ClockPrescaler;
+    uint32_t ClockFilter;
+} TIM_ClockConfigTypeDef;
+
+struct __DMA_HandleTypeDef;
+
+typedef struct {
+    TIM_TypeDef* Instance;
+    TIM_Base_InitTypeDef Init;
+    HAL_TIM_ActiveChannel Channel;
+    struct __DMA_HandleTypeDef* hdma[7];
+} TIM_HandleTypeDef;
+
+#define __HAL_TIM_ENABLE(__HANDLE__)                 ((__HANDLE__)->Instance->CR1 |= TIM_CR1_CEN)
+#define __HAL_TIM_DISABLE(__HANDLE__)                ((__HANDLE__)->Instance->CR1 &= ~TIM_CR1_CEN)
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __IT__)      ((__HANDLE__)->Instance->DIER |= (__IT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __IT__)     ((__HANDLE__)->Instance->DIER &= ~(__IT__))
+#define __HAL_TIM_ENABLE_DMA(__HANDLE__, __DMA__)    ((__HANDLE__)->Instance->DIER |= (__DMA__))
+#define __HAL_TIM_DISABLE_DMA(__HANDLE__, __DMA__)   ((__HANDLE__)->Instance->DIER &= ~(__DMA__))
+#define __HAL_TIM_GET_FLAG(__HANDLE__, __FLAG__)     (((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__)   ((__HANDLE__)->Instance->SR &= ~(__FLAG__))
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)            ((__HANDLE__)->Instance->CNT)
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __C__)     ((__HANDLE__)->Instance->CNT = (__C__))
+#define __HAL_TIM_SET_PRESCALER(__HANDLE__, __P__)   ((__HANDLE__)->Instance->PSC = (__P__))
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __A__) \
+    do { (__HANDLE__)->Instance->ARR = (__A__); (__HANDLE__)->Init.Period = (__A__); } while (0)
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CH__, __V__) \
+    (*(&(__HANDLE__)->Instance->CCR1 + ((__CH__) >> 2U)) = (__V__))
+#define __HAL_TIM_SET_ICPRESCALER(__HANDLE__, __CH__, __PSC__) \
+    stub_tim_set_icprescaler((__HANDLE__)->Instance, (__CH__), (__PSC__))
+#define __HAL_TIM_SET_CAPTUREPOLARITY(__HANDLE__, __CH__, __POL__) \
+    stub_tim_set_capturepolarity((__HANDLE__)->Instance, (__CH__), (__POL__))
+
+/**
+ * @brief Write the ICxPSC field of a capture channel
+ */
+static inline void stub_tim_set_icprescaler(TIM_TypeDef* tim, uint32_t channel, uint32_t psc) {
+    __IO uint32_t* ccmr = (channel < TIM_CHANNEL_3) ? &tim->CCMR1 : &tim->CCMR2;
+    uint32_t shift = (channel & TIM_CHANNEL_2) ? 8U : 0U;
+    *ccmr = (*ccmr & ~(TIM_CCMR1_IC1PSC << shift)) | (psc << shift);
+}
+
+/**
+ * @brief Write the CCxP/CCxNP bits of a capture channel
+ */
+static inline void stub_tim_set_capturepolarity(TIM_TypeDef* tim, uint32_t channel, uint32_t polarity) {
+    tim->CCER = (tim->CCER & ~((TIM_CCER_CC1P | TIM_CCER_CC1NP) << channel)) | (polarity << channel);
+}
+
+/* DMA -------------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t NDTR;
+    __IO uint32_t PAR;
+    __IO uint32_t M0AR;
+    __IO uint32_t M1AR;
+    __IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+extern DMA_Stream_TypeDef stub_dma_stream[2][8];
+#define DMA1_Stream1  (&stub_dma_stream[0][1])
+#define DMA1_Stream4  (&stub_dma_stream[0][4])
+#define DMA2_Stream1  (&stub_dma_stream[1][1])
+
+#define DMA_SxCR_EN   0x00000001U
+#define DMA_SxCR_DBM  0x00040000U
+#define DMA_SxCR_CT   0x00080000U
+
+#define DMA_PERIPH_TO_MEMORY  0x00000000U
+#define DMA_MEMORY_TO_PERIPH  0x00000040U
+#define DMA_MINC_DISABLE      0x00000000U
+#define DMA_MINC_ENABLE       0x00000400U
+#define DMA_NORMAL            0x00000000U
+#define DMA_CIRCULAR          0x00000100U
+
+typedef struct {
+    uint32_t Channel;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+    uint32_t FIFOMode;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+    DMA_Stream_TypeDef* Instance;
+    DMA_InitTypeDef Init;
+    void* Parent;
+    void (*XferCpltCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (*XferM1CpltCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (*XferM1HalfCpltCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (*XferErrorCallback)(struct __DMA_HandleTypeDef* hdma);
+    uint32_t SrcAddress;          // Stub only: addresses of the running transfer
+    uint32_t DstAddress;
+    uint32_t SecondAddress;
+    uint32_t Length;
+    uint8_t  Running;
+} DMA_HandleTypeDef;
+
+/* DAC -------------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t SWTRIGR;
+    __IO uint32_t DHR12R1;
+    __IO uint32_t DHR12L1;
+    __IO uint32_t DHR8R1;
+    __IO uint32_t DHR12R2;
+    __IO uint32_t DHR12L2;
+    __IO uint32_t DHR8R2;
+    __IO uint32_t DHR12RD;
+    __IO uint32_t DHR12LD;
+    __IO uint32_t DHR8RD;
+    __IO uint32_t DOR1;
+    __IO uint32_t DOR2;
+    __IO uint32_t SR;
+} DAC_TypeDef;
+
+extern DAC_TypeDef stub_dac;
+#define DAC  (&stub_dac)
+
+#define DAC_CR_EN1  0x00000001U
+#define DAC_CR_EN2  0x00010000U
+
+/* GPIO ------------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef stub_gpio[5];
+#define GPIOA  (&stub_gpio[0])
+#define GPIOB  (&stub_gpio[1])
+#define GPIOC  (&stub_gpio[2])
+#define GPIOD  (&stub_gpio[3])
+#define GPIOE  (&stub_gpio[4])
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_PIN_4          ((uint16_t)0x0010)
+#define GPIO_PIN_5          ((uint16_t)0x0020)
+#define GPIO_PIN_9          ((uint16_t)0x0200)
+#define GPIO_PIN_11         ((uint16_t)0x0800)
+#define GPIO_PIN_13         ((uint16_t)0x2000)
+#define GPIO_MODE_ANALOG    0x00000003U
+#define GPIO_NOPULL         0x00000000U
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()  do { } while (0)
+#define __HAL_RCC_DAC_CLK_ENABLE()    do { } while (0)
+
+/* Core intrinsics -------------------------------------------------------------*/
+extern uint32_t stub_primask;
+extern void (*stub_barrier_hook)(void);
+extern void (*stub_wfi_hook)(void);
+extern void (*stub_unmask_hook)(void);
+
+void stub_barrier(void);
+void stub_set_primask(uint32_t value);
+
+#define __disable_irq()     (stub_primask = 1U)
+#define __enable_irq()      stub_set_primask(0U)
+#define __get_PRIMASK()     (stub_primask)
+#define __set_PRIMASK(x)    stub_set_primask(x)
+#define __DMB()             stub_barrier()
+#define __DSB()             stub_barrier()
+#define __ISB()             stub_barrier()
+#define __CLZ(x)            ((uint8_t)((x) ? __builtin_clz(x) : 32))
+#define __RBIT(x)           stub_rbit(x)
+#define __WFI()             do { if (stub_wfi_hook) stub_wfi_hook(); } while (0)
+
+/**
+ * @brief Reverse the bit order of a word
+ */
+static inline uint32_t stub_rbit(uint32_t value) {
+    uint32_t result = 0;
+    for (int i = 0; i < 32; i++) {
+        result = (result << 1) | ((value >> i) & 1U);
+    }
+    return result;
+}
+
+/* HAL calls -------------------------------------------------------------------*/
+extern uint8_t stub_nvic_enabled[STUB_IRQ_COUNT];
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+void HAL_DBGMCU_EnableDBGSleepMode(void);
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef* htim, TIM_ClockConfigTypeDef* sClockSourceConfig);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef* htim, uint32_t Channel);
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef* htim);
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim);
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress,
+                                                uint32_t SecondMemAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* hdma);
+
+/**
+ * @brief Serve one DMA request of a running stream, as a timer update would
+ * Moves one word between the peripheral and memory addresses of the
+ * transfer, reloads circular and double-buffer transfers and calls the
+ * half and complete callbacks. Addresses are only valid in a non-PIE
+ * build, where static data lies below 4 GiB.
+ * @param hdma Pointer to the DMA_HandleTypeDef structure
+ */
+void Stub_DMA_Request(DMA_HandleTypeDef* hdma);
+
+/**
+ * @brief Return all stub peripherals, hooks and handles to their reset state
+ */
+void Stub_HAL_Reset(void);
+
+#endif /* STM32F4XX_HAL_H */
@@ -0,0 +1,173 @@
+/**
+ * @file test_analog_backend.c
+ * @brief Channel-to-backend mapping: DAC channel ownership, dither and fault rejection
+ *
+ * DAC channel 1 serves the current output of one light, channel 2 the
+ * temperature output of one light.
+ */
+
+#include "test_common.h"
+#include "analog_simulation.h"
+#include "analog_dac.h"
+#include "tim.h"
+
+#define CURRENT      (1 << ANALOG_OUTPUT_CURRENT)
+#define TEMPERATURE  (1 << ANALOG_OUTPUT_TEMPERATURE)
+
+void Event_Loop_Signal(uint32_t events) {
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    htim2.Init.Prescaler = 15;
+    htim2.Init.Period = ANALOG_PWM_MAX;
+    htim3.Init = htim2.Init;
+    HAL_TIM_Base_Init(&htim2);
+    HAL_TIM_Base_Init(&htim3);
+    Analog_Simulation_Init();
+}
+
+static void test_default_is_pwm(void) {
+    setup();
+    for (uint8_t light = 0; light < 3; light++) {
+        CHECK_EQ(Analog_GetBackend(light), 0);
+        CHECK_EQ(Analog_GetOutputMax(light, ANALOG_OUTPUT_CURRENT), ANALOG_PWM_MAX);
+    }
+    CHECK(Analog_GetCompareRegister(0, ANALOG_OUTPUT_CURRENT) == &TIM2->CCR1);
+    CHECK(Analog_GetCompareRegister(2, ANALOG_OUTPUT_TEMPERATURE) == &TIM3->CCR3);
+    CHECK(Analog_GetCompareRegister(3, ANALOG_OUTPUT_CURRENT) == NULL);
+    CHECK_EQ(DAC->CR, 0);
+}
+
+static void test_route_moves_value(void) {
+    setup();
+    CHECK_EQ(Analog_SetOutputFine(1, ANALOG_OUTPUT_CURRENT, ANALOG_FINE_MAX / 2), 1);
+    CHECK_EQ(TIM2->CCR3, 512);
+
+    // The PWM parks low and the DAC takes the present value
+    CHECK_EQ(Analog_SetBackend(1, CURRENT), 1);
+    CHECK_EQ(Analog_GetBackend(1), CURRENT);
+    CHECK_EQ(Analog_IsOnDAC(1, ANALOG_OUTPUT_CURRENT), 1);
+    CHECK_EQ(Analog_IsOnDAC(1, ANALOG_OUTPUT_TEMPERATURE), 0);
+    CHECK_EQ(TIM2->CCR3, 0);
+    CHECK(DAC->CR & DAC_CR_EN1);
+    CHECK_EQ(DAC->CR & DAC_CR_EN2, 0);
+    CHECK_EQ(DAC->DHR12R1, 2048);
+    CHECK(Analog_GetCompareRegister(1, ANALOG_OUTPUT_CURRENT) == &DAC->DHR12R1);
+    CHECK_EQ(Analog_GetOutputMax(1, ANALOG_OUTPUT_CURRENT), ANALOG_DAC_MAX);
+
+    // Later writes reach the DAC at 12 bits
+    Analog_SetOutputFine(1, ANALOG_OUTPUT_CURRENT, ANALOG_FINE_MAX);
+    CHECK_EQ(DAC->DHR12R1, ANALOG_DAC_MAX);
+    CHECK_EQ(TIM2->CCR3, 0);
+    CHECK_EQ(Analog_SetOutputCode(1, ANALOG_OUTPUT_CURRENT, ANALOG_DAC_MAX), 1);
+    CHECK_EQ(Analog_SetOutputCode(1, ANALOG_OUTPUT_CURRENT, ANALOG_DAC_MAX + 1), 0);
+    CHECK_EQ(Analog_SetOutputCode(1, ANALOG_OUTPUT_CURRENT, 1234), 1);
+    CHECK_EQ(DAC->DHR12R1, 1234);
+
+    // Back to the PWM: the channel is released and the value returns
+    CHECK_EQ(Analog_SetBackend(1, 0), 1);
+    CHECK_EQ(DAC->CR & DAC_CR_EN1, 0);
+    CHECK_EQ(DAC->DHR12R1, 0);
+    CHECK_NEAR(TIM2->CCR3, 1234.0 * ANALOG_PWM_MAX / ANALOG_DAC_MAX, 0.5);
+    CHECK_EQ(Analog_SetOutputCode(1, ANALOG_OUTPUT_CURRENT, ANALOG_PWM_MAX + 1), 0);
+
+    // Masked against the TIM4 writers, and released again
+    CHECK_EQ(stub_nvic_enabled[TIM4_IRQn + STUB_IRQ_OFFSET], 1);
+}
+
+static void test_channel_conflicts(void) {
+    setup();
+    CHECK_EQ(Analog_SetBackend(0, CURRENT), 1);
+
+    // Channel 1 is taken, channel 2 is free
+    CHECK_EQ(Analog_SetBackend(1, CURRENT), 0);
+    CHECK_EQ(Analog_SetBackend(2, CURRENT), 0);
+    CHECK_EQ(Analog_SetBackend(1, TEMPERATURE), 1);
+    CHECK_EQ(Analog_SetBackend(2, TEMPERATURE), 0);
+    CHECK_EQ(Analog_SetBackend(2, CURRENT | TEMPERATURE), 0);
+
+    // A rejected mask changes nothing, even where one output would fit
+    CHECK_EQ(Analog_SetBackend(1, CURRENT | TEMPERATURE), 0);
+    CHECK_EQ(Analog_GetBackend(0), CURRENT);
+    CHECK_EQ(Analog_GetBackend(1), TEMPERATURE);
+    CHECK_EQ(Analog_GetBackend(2), 0);
+
+    // A light keeps the channels it holds when it sets its mask again
+    CHECK_EQ(Analog_SetBackend(0, CURRENT), 1);
+    CHECK_EQ(Analog_SetBackend(1, TEMPERATURE), 1);
+
+    // Releasing a channel lets another light take it
+    CHECK_EQ(Analog_SetBackend(0, 0), 1);
+    CHECK_EQ(Analog_SetBackend(2, CURRENT), 1);
+    CHECK_EQ(Analog_GetBackend(2), CURRENT);
+    CHECK(DAC->CR & DAC_CR_EN1);
+
+    // Both outputs of one light at once
+    CHECK_EQ(Analog_SetBackend(1, 0), 1);
+    CHECK_EQ(Analog_SetBackend(2, 0), 1);
+    CHECK_EQ(Analog_SetBackend(0, CURRENT | TEMPERATURE), 1);
+    CHECK_EQ(DAC->CR, DAC_CR_EN1 | DAC_CR_EN2);
+
+    CHECK_EQ(Analog_SetBackend(3, 0), 0);
+    CHECK_EQ(Analog_SetBackend(0, 4), 0);
+}
+
+static void test_dither_rejection(void) {
+    setup();
+
+    // A dithered output stays on the PWM, its sibling may move
+    CHECK_EQ(Analog_SetDither(0, CURRENT), 1);
+    CHECK_EQ(Analog_SetBackend(0, CURRENT), 0);
+    CHECK_EQ(Analog_SetBackend(0, CURRENT | TEMPERATURE), 0);
+    CHECK_EQ(Analog_GetBackend(0), 0);
+    CHECK_EQ(Analog_SetBackend(0, TEMPERATURE), 1);
+
+    // And a DAC output cannot be dithered
+    CHECK_EQ(Analog_SetDither(0, CURRENT | TEMPERATURE), 0);
+    CHECK_EQ(Analog_GetDither(0), CURRENT);
+
+    CHECK_EQ(Analog_SetDither(0, 0), 1);
+    CHECK_EQ(Analog_SetBackend(0, CURRENT | TEMPERATURE), 1);
+}
+
+static void test_fault_drive(void) {
+    setup();
+
+    // A faulted output keeps its backend until the fault clears
+    CHECK_EQ(Analog_SetFaultDrive(2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIVE_FORCE, 1000), 1);
+    CHECK_EQ(Analog_SetBackend(2, TEMPERATURE), 0);
+    CHECK_EQ(Analog_SetFaultDrive(2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIVE_NONE, 0), 1);
+    CHECK_EQ(Analog_SetBackend(2, TEMPERATURE), 1);
+
+    // Faults on a DAC output drive the DAC, an open line disables the channel
+    Analog_SetOutputFine(2, ANALOG_OUTPUT_TEMPERATURE, 0);
+    CHECK_EQ(Analog_SetFaultDrive(2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIVE_FORCE, ANALOG_FINE_MAX), 1);
+    CHECK_EQ(DAC->DHR12R2, ANALOG_DAC_MAX);
+    CHECK_EQ(Analog_SetFaultDrive(2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIVE_OPEN, 0), 1);
+    CHECK_EQ(DAC->CR & DAC_CR_EN2, 0);
+    CHECK_EQ(Analog_SetFaultDrive(2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIVE_NONE, 0), 1);
+    CHECK(DAC->CR & DAC_CR_EN2);
+    CHECK_EQ(DAC->DHR12R2, 0);
+}
+
+static void test_start_and_stop(void) {
+    setup();
+    CHECK_EQ(Analog_SetBackend(1, TEMPERATURE), 1);
+    Analog_Simulation_Stop();
+    CHECK_EQ(DAC->CR, 0);
+
+    // Only channels with an output routed to them come back
+    Analog_Simulation_Start();
+    CHECK_EQ(DAC->CR, DAC_CR_EN2);
+}
+
+int main(void) {
+    RUN_TEST(test_default_is_pwm);
+    RUN_TEST(test_route_moves_value);
+    RUN_TEST(test_channel_conflicts);
+    RUN_TEST(test_dither_rejection);
+    RUN_TEST(test_fault_drive);
+    RUN_TEST(test_start_and_stop);
+    return TEST_RESULT();
+}
@@ -0,0 +1,260 @@
+/**
+ * @file test_analog_calibration.c
+ * @brief Calibration tables: load validation, segment selection, extrapolation and clamping
+ */
+
+#include "test_common.h"
+#include "analog_calibration.h"
+#include "analog_simulation.h"
+
+#define PAYLOAD_MAX  (sizeof(AnalogCalibrationHeader) + ANALOG_CALIBRATION_MAX_POINTS * sizeof(AnalogCalibrationPoint))
+
+// Board-like curve: offset at zero, gain errors that differ per segment
+static const AnalogCalibrationPoint curve[] = {
+    {6400, 6900},
+    {16000, 15900},
+    {32000, 32600},
+    {48000, 48300},
+    {60000, 61000},
+};
+#define CURVE_POINTS  ((uint8_t)(sizeof(curve) / sizeof(curve[0])))
+
+static uint16_t build_payload(uint8_t* payload, uint8_t output, const AnalogCalibrationPoint* points, uint8_t count) {
+    AnalogCalibrationHeader header = {output, count};
+
+    memcpy(payload, &header, sizeof(header));
+    memcpy(payload + sizeof(header), points, count * sizeof(AnalogCalibrationPoint));
+    return sizeof(header) + count * sizeof(AnalogCalibrationPoint);
+}
+
+static uint8_t load(uint8_t light, uint8_t output, const AnalogCalibrationPoint* points, uint8_t count) {
+    uint8_t payload[PAYLOAD_MAX];
+    uint16_t length = build_payload(payload, output, points, count);
+
+    return Analog_Calibration_Load(light, payload, length);
+}
+
+/**
+ * @brief Exact interpolation on the segment from point 'a' to point 'b', clamped to the output range
+ */
+static double reference(const AnalogCalibrationPoint* a, const AnalogCalibrationPoint* b, uint16_t nominal) {
+    double value = a->compare + ((double)nominal - a->nominal) * ((double)b->compare - a->compare) /
+                                ((double)b->nominal - a->nominal);
+
+    if (value < 0.0) {
+        return 0.0;
+    }
+    if (value > ANALOG_FINE_MAX) {
+        return ANALOG_FINE_MAX;
+    }
+    return value;
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Analog_Calibration_Init();
+}
+
+static void test_uncalibrated_is_identity(void) {
+    uint8_t buffer[PAYLOAD_MAX];
+    AnalogCalibrationHeader header;
+
+    setup();
+    CHECK_EQ(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, 0), 0);
+    CHECK_EQ(Analog_Calibration_Apply(1, ANALOG_OUTPUT_TEMPERATURE, 12345), 12345);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, ANALOG_FINE_MAX), ANALOG_FINE_MAX);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, 0xFFFF), ANALOG_FINE_MAX);
+
+    // GET reports an empty table
+    CHECK_EQ(Analog_Calibration_Get(0, ANALOG_OUTPUT_CURRENT, buffer, sizeof(buffer)), sizeof(header));
+    memcpy(&header, buffer, sizeof(header));
+    CHECK_EQ(header.output, ANALOG_OUTPUT_CURRENT);
+    CHECK_EQ(header.count, 0);
+}
+
+static void test_load_validation(void) {
+    uint8_t payload[PAYLOAD_MAX + sizeof(AnalogCalibrationPoint)];
+    AnalogCalibrationPoint points[ANALOG_CALIBRATION_MAX_POINTS + 1];
+    uint16_t length;
+
+    setup();
+    length = build_payload(payload, ANALOG_OUTPUT_CURRENT, curve, CURVE_POINTS);
+
+    // Arguments and framing
+    CHECK_EQ(Analog_Calibration_Load(3, payload, length), 0);
+    CHECK_EQ(Analog_Calibration_Load(0, NULL, length), 0);
+    CHECK_EQ(Analog_Calibration_Load(0, payload, 1), 0);
+    CHECK_EQ(Analog_Calibration_Load(0, payload, length - 1), 0);
+    CHECK_EQ(Analog_Calibration_Load(0, payload, length + 1), 0);
+    CHECK_EQ(load(0, 2, curve, CURVE_POINTS), 0);
+
+    // Point count
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, curve, 0), 0);
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, curve, 1), 0);
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, curve, 2), 1);
+    for (uint8_t i = 0; i <= ANALOG_CALIBRATION_MAX_POINTS; i++) {
+        points[i].nominal = i * 4000;
+        points[i].compare = i * 4000;
+    }
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, ANALOG_CALIBRATION_MAX_POINTS), 1);
+    length = build_payload(payload, ANALOG_OUTPUT_CURRENT, points, ANALOG_CALIBRATION_MAX_POINTS + 1);
+    CHECK_EQ(Analog_Calibration_Load(0, payload, length), 0);
+
+    // Nominal values strictly increase
+    memcpy(points, curve, sizeof(curve));
+    points[2].nominal = points[1].nominal;
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, CURVE_POINTS), 0);
+    points[2].nominal = points[1].nominal - 1;
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, CURVE_POINTS), 0);
+
+    // Compare values within the output range
+    memcpy(points, curve, sizeof(curve));
+    points[4].compare = ANALOG_FINE_MAX + 1;
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, CURVE_POINTS), 0);
+    points[4].compare = ANALOG_FINE_MAX;
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, CURVE_POINTS), 1);
+
+    // Slopes up to 32767 compare steps per nominal step, either sign
+    points[0] = (AnalogCalibrationPoint){100, 0};
+    points[1] = (AnalogCalibrationPoint){101, 32767};
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, 2), 1);
+    points[1].compare = 32768;
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, 2), 0);
+    points[0] = (AnalogCalibrationPoint){100, 32768};
+    points[1] = (AnalogCalibrationPoint){101, 0};
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, 2), 0);
+    points[0].compare = 32767;
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, points, 2), 1);
+}
+
+static void test_rejected_load_keeps_table(void) {
+    AnalogCalibrationPoint points[CURVE_POINTS];
+
+    setup();
+    CHECK_EQ(load(1, ANALOG_OUTPUT_TEMPERATURE, curve, CURVE_POINTS), 1);
+
+    // The last point is checked after the table has been half built
+    memcpy(points, curve, sizeof(curve));
+    points[0].compare = 0;
+    points[CURVE_POINTS - 1].nominal = points[CURVE_POINTS - 2].nominal;
+    CHECK_EQ(load(1, ANALOG_OUTPUT_TEMPERATURE, points, CURVE_POINTS), 0);
+    CHECK_EQ(Analog_Calibration_Apply(1, ANALOG_OUTPUT_TEMPERATURE, curve[0].nominal), curve[0].compare);
+
+    // Tables are per light and output
+    CHECK_EQ(Analog_Calibration_Apply(1, ANALOG_OUTPUT_CURRENT, curve[0].nominal), curve[0].nominal);
+    CHECK_EQ(Analog_Calibration_Apply(0, ANALOG_OUTPUT_TEMPERATURE, curve[0].nominal), curve[0].nominal);
+
+    // Masked against the interrupts that apply tables, and released again
+    CHECK_EQ(stub_nvic_enabled[TIM4_IRQn + STUB_IRQ_OFFSET], 1);
+    CHECK_EQ(stub_nvic_enabled[TIM5_IRQn + STUB_IRQ_OFFSET], 1);
+}
+
+static void test_segment_selection(void) {
+    setup();
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, curve, CURVE_POINTS), 1);
+
+    // Every point maps exactly, whichever segment ends there
+    for (uint8_t i = 0; i < CURVE_POINTS; i++) {
+        CHECK_EQ(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, curve[i].nominal), curve[i].compare);
+    }
+
+    // Within a segment the rounded fixed point slope stays within one fine step
+    for (uint8_t s = 0; s + 1 < CURVE_POINTS; s++) {
+        for (uint32_t nominal = curve[s].nominal; nominal < curve[s + 1].nominal; nominal++) {
+            double expected = reference(&curve[s], &curve[s + 1], nominal);
+            uint16_t actual = Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, nominal);
+
+            if (actual < expected - 1.0 || actual > expected + 1.0) {
+                CHECK_NEAR(actual, expected, 1.0);
+                break;
+            }
+        }
+    }
+
+    // One step either side of an inner point uses the segment on that side
+    CHECK_EQ(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, 31999), 32599);
+    CHECK_EQ(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, 32001), 32601);
+}
+
+static void test_extrapolation(void) {
+    setup();
+    CHECK_EQ(load(0, ANALOG_OUTPUT_CURRENT, curve, CURVE_POINTS), 1);
+
+    // Below the table the first segment extends down to zero
+    for (uint16_t nominal = 0; nominal < curve[0].nominal; nominal += 97) {
+        CHECK_NEAR(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, nominal),
+                   reference(&curve[0], &curve[1], nominal), 1.0);
+    }
+    CHECK_EQ(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, 0), 900);
+
+    // Above it the last segment extends up to the end of the range
+    CHECK_NEAR(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, 62000),
+               reference(&curve[3], &curve[4], 62000), 1.0);
+    CHECK_NEAR(Analog_Calibration_Apply(0, ANALOG_OUTPUT_CURRENT, 63000),
+               reference(&curve[3], &curve[4], 63000), 1.0);
+}
+
+static void test_clamping(void) {
+    static const AnalogCalibrationPoint steep[] = {
+        {10000, 2000},
+        {20000, 30000},
+        {40000, 64000},
+    };
+    static const AnalogCalibrationPoint falling[] = {
+        {1000, 60000},
+        {60000, 1000},
+    };
+
+    setup();
+    CHECK_EQ(load(2, ANALOG_OUTPUT_CURRENT, steep, 3), 1);
+
+    // Extrapolation past either end of the output range stops there
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, 9000), 0);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, 0), 0);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, 39000), 62300);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, 41000), ANALOG_FINE_MAX);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_CURRENT, 0xFFFF), ANALOG_FINE_MAX);
+
+    // A falling table clamps at the opposite ends
+    CHECK_EQ(load(2, ANALOG_OUTPUT_TEMPERATURE, falling, 2), 1);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_TEMPERATURE, 0), 61000);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_TEMPERATURE, 30500), 30500);
+    CHECK_EQ(Analog_Calibration_Apply(2, ANALOG_OUTPUT_TEMPERATURE, 62000), 0);
+}
+
+static void test_get_and_clear(void) {
+    uint8_t payload[PAYLOAD_MAX];
+    uint8_t buffer[PAYLOAD_MAX];
+    uint16_t length;
+
+    setup();
+    length = build_payload(payload, ANALOG_OUTPUT_TEMPERATURE, curve, CURVE_POINTS);
+    CHECK_EQ(Analog_Calibration_Load(1, payload, length), 1);
+
+    // GET returns the upload unchanged, if it fits
+    CHECK_EQ(Analog_Calibration_Get(1, ANALOG_OUTPUT_TEMPERATURE, buffer, sizeof(buffer)), length);
+    CHECK(memcmp(buffer, payload, length) == 0);
+    CHECK_EQ(Analog_Calibration_Get(1, ANALOG_OUTPUT_TEMPERATURE, buffer, length - 1), 0);
+    CHECK_EQ(Analog_Calibration_Get(3, ANALOG_OUTPUT_TEMPERATURE, buffer, sizeof(buffer)), 0);
+    CHECK_EQ(Analog_Calibration_Get(1, 2, buffer, sizeof(buffer)), 0);
+    CHECK_EQ(Analog_Calibration_Get(1, ANALOG_OUTPUT_TEMPERATURE, NULL, sizeof(buffer)), 0);
+
+    // Clearing returns the output to 1:1
+    CHECK_EQ(Analog_Calibration_Clear(1, 2), 0);
+    CHECK_EQ(Analog_Calibration_Clear(3, ANALOG_OUTPUT_TEMPERATURE), 0);
+    CHECK_EQ(Analog_Calibration_Clear(1, ANALOG_OUTPUT_TEMPERATURE), 1);
+    CHECK_EQ(Analog_Calibration_Apply(1, ANALOG_OUTPUT_TEMPERATURE, 16000), 16000);
+    CHECK_EQ(Analog_Calibration_Get(1, ANALOG_OUTPUT_TEMPERATURE, buffer, sizeof(buffer)),
+             sizeof(AnalogCalibrationHeader));
+}
+
+int main(void) {
+    RUN_TEST(test_uncalibrated_is_identity);
+    RUN_TEST(test_load_validation);
+    RUN_TEST(test_rejected_load_keeps_table);
+    RUN_TEST(test_segment_selection);
+    RUN_TEST(test_extrapolation);
+    RUN_TEST(test_clamping);
+    RUN_TEST(test_get_and_clear);
+    return TEST_RESULT();
+}
@@ -0,0 +1,233 @@
+/**
+ * @file test_analog_dither.c
+ * @brief Sigma-delta dithered outputs through the RC filter: effective resolution and ripple
+ *
+ * Light 1 current (TIM2 CH1) runs period by period: the update interrupt
+ * runs while it is enabled in DIER, and the compare value of each period
+ * drives a two-stage RC filter of 2.2 ms per stage. Figures are printed
+ * for reference; the checks hold the claims of the dither mode.
+ */
+
+#include "test_common.h"
+#include "analog_simulation.h"
+#include "rc_filter_sim.h"
+#include "tim.h"
+#include <math.h>
+
+#define TIMER_CLOCK_HZ   84000000.0
+#define FILTER_STAGES    2
+#define FILTER_TAU_S     2.2e-3
+#define SETTLE_TAU       16        // Time constants before measuring, from the ideal level
+#define WINDOW_CYCLES    4         // Measured dither cycles of FINE_ONE periods
+#define FINE_ONE         (1 << ANALOG_FINE_BITS)
+
+void Event_Loop_Signal(uint32_t events) {
+}
+
+typedef struct {
+    double mean;      // Compare steps
+    double ripple;    // Compare steps, peak to peak
+} FilteredOutput;
+
+static void setup(uint8_t prescaler) {
+    Stub_HAL_Reset();
+    htim2.Init.Prescaler = 15;
+    htim2.Init.Period = ANALOG_PWM_MAX;
+    htim3.Init = htim2.Init;
+    HAL_TIM_Base_Init(&htim2);
+    HAL_TIM_Base_Init(&htim3);
+    Analog_Simulation_Init();
+    CHECK_EQ(Analog_SetCarrier(prescaler), 1);
+}
+
+/**
+ * @brief Run one period of TIM2: the filter sees the compare value, then the update interrupt preloads the next
+ */
+static void run_period(RcFilterSim* filter) {
+    double count_s = (TIM2->PSC + 1) / TIMER_CLOCK_HZ;
+
+    RC_Filter_Sim_Period(filter, TIM2->CCR1, TIM2->ARR, count_s);
+    if (TIM2->DIER & TIM_IT_UPDATE) {
+        Analog_UpdateIRQHandler();
+    }
+}
+
+/**
+ * @brief Filtered output of light 1 current at a fine value, after settling
+ */
+static FilteredOutput measure(uint8_t prescaler, uint8_t dithered, uint16_t fine_value) {
+    RcFilterSim filter;
+    FilteredOutput result;
+    double period_s = (prescaler + 1) * (ANALOG_PWM_MAX + 1) / TIMER_CLOCK_HZ;
+    uint32_t settle = (uint32_t)ceil(SETTLE_TAU * FILTER_TAU_S / period_s);
+
+    setup(prescaler);
+    CHECK_EQ(Analog_SetDither(0, dithered ? (1 << ANALOG_OUTPUT_CURRENT) : 0), 1);
+    CHECK_EQ(Analog_SetOutputFine(0, ANALOG_OUTPUT_CURRENT, fine_value), 1);
+
+    RC_Filter_Sim_Init(&filter, FILTER_STAGES, FILTER_TAU_S, (double)fine_value / FINE_ONE);
+    for (uint32_t i = 0; i < settle; i++) {
+        run_period(&filter);
+    }
+
+    RC_Filter_Sim_ResetStats(&filter);
+    for (uint32_t i = 0; i < WINDOW_CYCLES * FINE_ONE; i++) {
+        run_period(&filter);
+        CHECK(TIM2->CCR1 <= ANALOG_PWM_MAX);
+    }
+
+    result.mean = RC_Filter_Sim_Mean(&filter);
+    result.ripple = RC_Filter_Sim_Ripple(&filter);
+    return result;
+}
+
+/**
+ * @brief Effective resolution: full scale over the smallest resolved step, blurred by the ripple
+ * The resolved step is a fine step, or twice the worst mean error where the
+ * output misses fine steps.
+ */
+static double effective_bits(double mean_error, double ripple) {
+    double step = 2.0 * mean_error;
+
+    if (step < 1.0 / FINE_ONE) {
+        step = 1.0 / FINE_ONE;
+    }
+    return log2((ANALOG_PWM_MAX + 1) / (step + ripple));
+}
+
+/**
+ * @brief Sweep one compare step in fine steps and return the worst ripple
+ * @param mean_error Worst deviation of the mean from the fine value, in compare steps
+ */
+static double sweep(uint8_t prescaler, uint8_t dithered, uint16_t stride, double* mean_error) {
+    const uint16_t base = 512 << ANALOG_FINE_BITS;
+    double previous = -1.0;
+    double ripple = 0.0;
+
+    *mean_error = 0.0;
+    for (uint16_t fraction = 0; fraction <= FINE_ONE; fraction += stride) {
+        FilteredOutput out = measure(prescaler, dithered, base + fraction);
+        double error = fabs(out.mean - (double)(base + fraction) / FINE_ONE);
+
+        if (error > *mean_error) {
+            *mean_error = error;
+        }
+        if (out.ripple > ripple) {
+            ripple = out.ripple;
+        }
+
+        // Dithered means rise with every fine step, undithered ones never fall
+        if (dithered) {
+            CHECK(out.mean > previous);
+        } else {
+            CHECK(out.mean >= previous);
+        }
+        previous = out.mean;
+    }
+
+    return ripple;
+}
+
+static void test_mean_resolves_fine_steps(void) {
+    double error;
+
+    // Default carrier: every fine step reaches the filtered mean
+    sweep(15, 1, 1, &error);
+    CHECK(error < 0.1 / FINE_ONE);
+
+    // Without dither the mean snaps to the rounded compare value
+    sweep(15, 0, 1, &error);
+    CHECK_NEAR(error, 0.5, 1.0 / FINE_ONE);
+
+    // The fastest carrier keeps the mean
+    sweep(0, 1, 7, &error);
+    CHECK(error < 0.1 / FINE_ONE);
+}
+
+static void test_effective_resolution(void) {
+    static const struct {
+        uint8_t prescaler;
+        uint8_t dithered;
+        double min_bits;
+        double max_bits;
+    } cases[] = {
+        {15, 0, 9.0, 10.5},     // 5.1 kHz, one compare step plus carrier ripple
+        {15, 1, 11.0, 13.0},    // Dither resolves 1/64 step, carrier ripple dominates
+        {0, 0, 9.9, 10.5},      // 82 kHz, still one compare step
+        {0, 1, 14.0, 16.0},     // Fine step and ripple both below 1/32 step
+    };
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        double error;
+        double ripple = sweep(cases[i].prescaler, cases[i].dithered, 7, &error);
+        double bits = effective_bits(error, ripple);
+
+        printf("  PSC %2u %-10s ripple %.5f steps, mean error %.5f steps, %.1f effective bits\n",
+               cases[i].prescaler, cases[i].dithered ? "dithered" : "plain", ripple, error, bits);
+        CHECK(bits >= cases[i].min_bits);
+        CHECK(bits <= cases[i].max_bits);
+    }
+}
+
+static void test_ripple_falls_with_carrier(void) {
+    // Half duty is the worst case of the carrier ripple, and the two poles
+    // take it down by the square of the carrier ratio
+    FilteredOutput slow = measure(15, 0, 512 << ANALOG_FINE_BITS);
+    FilteredOutput fast = measure(0, 0, 512 << ANALOG_FINE_BITS);
+
+    CHECK(slow.ripple < 0.5);
+    CHECK_NEAR(slow.ripple / fast.ripple, 256.0, 16.0);
+
+    // The dither pattern with the longest period, one extra step every 64
+    // periods, stays below a fine step at the fastest carrier
+    FilteredOutput sparse = measure(0, 1, (512 << ANALOG_FINE_BITS) + 1);
+    CHECK(sparse.ripple < 1.0 / FINE_ONE);
+}
+
+static void test_full_scale_ends(void) {
+    FilteredOutput out;
+
+    // The top fine values never ask for a compare value above the period
+    out = measure(15, 1, ANALOG_FINE_MAX - 1);
+    CHECK_NEAR(out.mean, (double)(ANALOG_FINE_MAX - 1) / FINE_ONE, 0.1 / FINE_ONE);
+    out = measure(15, 1, ANALOG_FINE_MAX);
+    CHECK_NEAR(out.mean, ANALOG_PWM_MAX, 0.1 / FINE_ONE);
+
+    // The first fine step above zero
+    out = measure(15, 1, 1);
+    CHECK_NEAR(out.mean, 1.0 / FINE_ONE, 0.1 / FINE_ONE);
+    out = measure(15, 1, 0);
+    CHECK_NEAR(out.mean, 0.0, 1e-9);
+}
+
+static void test_dither_interrupt_and_exit(void) {
+    setup(15);
+
+    // The update interrupt only runs while an output dithers
+    CHECK_EQ(TIM2->DIER & TIM_IT_UPDATE, 0);
+    CHECK_EQ(Analog_SetDither(0, 1 << ANALOG_OUTPUT_CURRENT), 1);
+    CHECK(TIM2->DIER & TIM_IT_UPDATE);
+    CHECK_EQ(Analog_GetDither(0), 1 << ANALOG_OUTPUT_CURRENT);
+
+    // Leaving dither mode settles on the rounded value
+    Analog_SetOutputFine(0, ANALOG_OUTPUT_CURRENT, (100 << ANALOG_FINE_BITS) + 40);
+    for (int i = 0; i < 10; i++) {
+        Analog_UpdateIRQHandler();
+    }
+    CHECK_EQ(Analog_SetDither(0, 0), 1);
+    CHECK_EQ(TIM2->DIER & TIM_IT_UPDATE, 0);
+    CHECK_EQ(TIM2->CCR1, 101);
+
+    CHECK_EQ(Analog_SetDither(3, 1), 0);
+    CHECK_EQ(Analog_SetDither(0, 4), 0);
+    CHECK_EQ(Analog_SetCarrier(ANALOG_CARRIER_PRESCALER_MAX + 1), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_mean_resolves_fine_steps);
+    RUN_TEST(test_effective_resolution);
+    RUN_TEST(test_ripple_falls_with_carrier);
+    RUN_TEST(test_full_scale_ends);
+    RUN_TEST(test_dither_interrupt_and_exit);
+    return TEST_RESULT();
+}
@@ -0,0 +1,382 @@
+/**
+ * @file test_analog_fault.c
+ * @brief Fault timeline on an emulated 1 kHz tick: start, duration, dropout duty, drift and slot precedence
+ *
+ * The timeline advances while the fault user holds the shared TIM4 tick.
+ * The drives it requests are recorded per output, as the analog outputs
+ * would apply them.
+ */
+
+#include "test_common.h"
+#include "analog_fault.h"
+#include "analog_simulation.h"
+#include "hil_comm_protocol.h"
+#include "event_loop.h"
+#include "hil_stub.h"
+#include <string.h>
+
+// Drive of each output, as last requested
+static uint8_t drive_mode[3][2];
+static int32_t drive_value[3][2];
+static uint32_t drive_writes;
+
+static uint16_t output_fine[3][2];
+static uint8_t waveform_driving[3][2];
+static uint32_t loop_events;
+
+uint8_t Analog_SetFaultDrive(uint8_t light_index, uint8_t output, uint8_t mode, int32_t value) {
+    drive_mode[light_index][output] = mode;
+    drive_value[light_index][output] = value;
+    drive_writes++;
+    return 1;
+}
+
+uint16_t Analog_GetOutputFine(uint8_t light_index, uint8_t output) {
+    return output_fine[light_index][output];
+}
+
+uint8_t Waveform_IsDriving(uint8_t light_index, uint8_t output) {
+    return waveform_driving[light_index][output];
+}
+
+void Event_Loop_Signal(uint32_t events) {
+    if (events & EVENT_LOOP_FAULT) {
+        loop_events++;
+    }
+}
+
+static AnalogFaultProfile profile(uint8_t slot, uint8_t light, uint8_t output, uint8_t type,
+                                  uint32_t start_ms, uint32_t duration_ms) {
+    AnalogFaultProfile p;
+
+    memset(&p, 0, sizeof(p));
+    p.slot = slot;
+    p.light = light;
+    p.output = output;
+    p.type = type;
+    p.start_ms = start_ms;
+    p.duration_ms = duration_ms;
+    return p;
+}
+
+static uint8_t load(const AnalogFaultProfile* p) {
+    return Analog_Fault_Load((const uint8_t*)p, sizeof(*p));
+}
+
+static uint8_t tick_running(void) {
+    return (TIM4->CR1 & TIM_CR1_CEN) != 0;
+}
+
+/**
+ * @brief Advance the timeline to a position, one tick at a time, while the tick runs
+ */
+static void run_until(uint32_t time_ms) {
+    AnalogFaultStatus status;
+
+    for (;;) {
+        Analog_Fault_GetStatus(&status);
+        if (!tick_running() || status.elapsed_ms >= time_ms) {
+            return;
+        }
+        Analog_Fault_Tick(&htim4);
+    }
+}
+
+static AnalogFaultStatus status(void) {
+    AnalogFaultStatus s;
+
+    Analog_Fault_GetStatus(&s);
+    return s;
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Stub_HIL_Reset();
+    Analog_Fault_Init();
+    memset(drive_mode, ANALOG_FAULT_DRIVE_NONE, sizeof(drive_mode));
+    memset(drive_value, 0, sizeof(drive_value));
+    memset(output_fine, 0, sizeof(output_fine));
+    memset(waveform_driving, 0, sizeof(waveform_driving));
+    drive_writes = 0;
+    loop_events = 0;
+}
+
+static void test_start_and_duration(void) {
+    AnalogFaultProfile p = profile(0, 0, ANALOG_OUTPUT_CURRENT, ANALOG_FAULT_SHORT, 10, 5);
+
+    setup();
+    output_fine[0][ANALOG_OUTPUT_CURRENT] = 5000;
+    CHECK_EQ(load(&p), 1);
+    CHECK_EQ(Analog_Fault_Start(), 1);
+    CHECK(tick_running());
+    CHECK_EQ(status().slot[0].state, ANALOG_FAULT_SLOT_PENDING);
+    CHECK_EQ(Analog_Fault_IsTargeted(0, ANALOG_OUTPUT_CURRENT), 1);
+    CHECK_EQ(Analog_Fault_IsTargeted(0, ANALOG_OUTPUT_TEMPERATURE), 0);
+
+    // Healthy up to start_ms, then held at 0 for duration_ms ticks
+    run_until(9);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_NONE);
+    CHECK_EQ(drive_writes, 0);
+    run_until(10);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_FORCE);
+    CHECK_EQ(drive_value[0][ANALOG_OUTPUT_CURRENT], 0);
+    CHECK_EQ(Analog_Fault_GetActive(0, ANALOG_OUTPUT_CURRENT), ANALOG_FAULT_SHORT);
+    CHECK_EQ(status().active_mask, 1 << 0);
+    CHECK_EQ(status().slot[0].state, ANALOG_FAULT_SLOT_ACTIVE);
+    run_until(14);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_FORCE);
+    CHECK_EQ(drive_writes, 1);
+
+    // The last fault over: healthy again, the tick released, one event
+    run_until(100);
+    AnalogFaultStatus s = status();
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_NONE);
+    CHECK_EQ(s.elapsed_ms, 15);
+    CHECK_EQ(s.running, 0);
+    CHECK_EQ(s.active_mask, 0);
+    CHECK_EQ(s.slot[0].state, ANALOG_FAULT_SLOT_DONE);
+    CHECK(!tick_running());
+    CHECK_EQ(Analog_Fault_IsTargeted(0, ANALOG_OUTPUT_CURRENT), 0);
+    CHECK_EQ(loop_events, 1);
+    Analog_Fault_ProcessEvents();
+    Analog_Fault_ProcessEvents();
+    CHECK_EQ(stub_event_count, 1);
+    CHECK_EQ(stub_last_event, SIGNAL_FAULT);
+
+    // A restart runs the same timeline again
+    CHECK_EQ(Analog_Fault_Start(), 1);
+    run_until(10);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_FORCE);
+    Analog_Fault_Stop();
+}
+
+static void test_start_at_zero_and_stuck(void) {
+    AnalogFaultProfile open = profile(0, 1, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_OPEN, 0, 0);
+    AnalogFaultProfile stuck = profile(1, 2, ANALOG_OUTPUT_CURRENT, ANALOG_FAULT_STUCK, 5, 0);
+
+    setup();
+    output_fine[2][ANALOG_OUTPUT_CURRENT] = 1000;
+    CHECK_EQ(load(&open), 1);
+    CHECK_EQ(load(&stuck), 1);
+
+    // A fault at 0 applies before the start returns
+    CHECK_EQ(Analog_Fault_Start(), 1);
+    CHECK_EQ(drive_mode[1][ANALOG_OUTPUT_TEMPERATURE], ANALOG_FAULT_DRIVE_OPEN);
+    CHECK_EQ(status().elapsed_ms, 0);
+
+    // Stuck holds the setpoint of the moment it starts
+    run_until(4);
+    output_fine[2][ANALOG_OUTPUT_CURRENT] = 1234;
+    run_until(5);
+    CHECK_EQ(drive_mode[2][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_FORCE);
+    CHECK_EQ(drive_value[2][ANALOG_OUTPUT_CURRENT], 1234);
+    output_fine[2][ANALOG_OUTPUT_CURRENT] = 2000;
+    run_until(500);
+    CHECK_EQ(drive_value[2][ANALOG_OUTPUT_CURRENT], 1234);
+
+    // No duration: active until stopped, and a stop reports nothing
+    CHECK_EQ(status().running, 1);
+    Analog_Fault_Stop();
+    CHECK_EQ(drive_mode[1][ANALOG_OUTPUT_TEMPERATURE], ANALOG_FAULT_DRIVE_NONE);
+    CHECK_EQ(drive_mode[2][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_NONE);
+    CHECK_EQ(Analog_Fault_GetActive(2, ANALOG_OUTPUT_CURRENT), ANALOG_FAULT_NONE);
+    CHECK(!tick_running());
+    Analog_Fault_ProcessEvents();
+    CHECK_EQ(stub_event_count, 0);
+}
+
+static void test_dropout_duty(void) {
+    AnalogFaultProfile p = profile(3, 0, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DROPOUT, 7, 100);
+    uint32_t open_ms = 0;
+
+    setup();
+    p.period_ms = 10;
+    p.width_ms = 3;
+    CHECK_EQ(load(&p), 1);
+    CHECK_EQ(Analog_Fault_Start(), 1);
+
+    // Open for width_ms at the start of every period, counted from start_ms
+    for (uint32_t t = 1; t <= 106; t++) {
+        run_until(t);
+        uint8_t open = drive_mode[0][ANALOG_OUTPUT_TEMPERATURE] == ANALOG_FAULT_DRIVE_OPEN;
+        uint8_t expected = t >= 7 && (t - 7) % 10 < 3;
+
+        CHECK_EQ(open, expected);
+        open_ms += open;
+    }
+    CHECK_EQ(open_ms, 30);
+
+    // One write per edge, the fault type shows between the gaps too
+    CHECK_EQ(drive_writes, 20);
+    run_until(106);
+    CHECK_EQ(Analog_Fault_GetActive(0, ANALOG_OUTPUT_TEMPERATURE), ANALOG_FAULT_DROPOUT);
+    run_until(200);
+    CHECK_EQ(status().elapsed_ms, 107);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_TEMPERATURE], ANALOG_FAULT_DRIVE_NONE);
+}
+
+static void test_drift_rate(void) {
+    AnalogFaultProfile up = profile(0, 0, ANALOG_OUTPUT_CURRENT, ANALOG_FAULT_DRIFT, 100, 2000);
+    AnalogFaultProfile down = profile(1, 1, ANALOG_OUTPUT_CURRENT, ANALOG_FAULT_DRIFT, 0, 0);
+
+    setup();
+    up.rate = 500;
+    down.rate = -300;
+    CHECK_EQ(load(&up), 1);
+    CHECK_EQ(load(&down), 1);
+    CHECK_EQ(Analog_Fault_Start(), 1);
+
+    // The offset grows by rate fine steps per second from start_ms
+    run_until(100);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_OFFSET);
+    CHECK_EQ(drive_value[0][ANALOG_OUTPUT_CURRENT], 0);
+    run_until(104);
+    CHECK_EQ(drive_value[0][ANALOG_OUTPUT_CURRENT], 2);
+    run_until(1100);
+    CHECK_EQ(drive_value[0][ANALOG_OUTPUT_CURRENT], 500);
+    CHECK_EQ(drive_value[1][ANALOG_OUTPUT_CURRENT], -330);
+    run_until(2099);
+    CHECK_EQ(drive_value[0][ANALOG_OUTPUT_CURRENT], 999);
+
+    // Past its duration the offset is gone, the other drift goes on
+    run_until(2100);
+    CHECK_EQ(drive_mode[0][ANALOG_OUTPUT_CURRENT], ANALOG_FAULT_DRIVE_NONE);
+    CHECK_EQ(drive_value[0][ANALOG_OUTPUT_CURRENT], 0);
+    CHECK_EQ(drive_value[1][ANALOG_OUTPUT_CURRENT], -630);
+    CHECK_EQ(status().running, 1);
+    Analog_Fault_Stop();
+}
+
+static void test_slot_precedence(void) {
+    AnalogFaultProfile open = profile(2, 1, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_OPEN, 0, 100);
+    AnalogFaultProfile drift = profile(5, 1, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIFT, 20, 40);
+    AnalogFaultProfile shorted = profile(1, 1, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_SHORT, 40, 40);
+    AnalogFaultProfile other = profile(0, 1, ANALOG_OUTPUT_CURRENT, ANALOG_FAULT_SHORT, 30, 10);
+    AnalogFaultProfile low_drift = profile(3, 2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_DRIFT, 0, 100);
+    AnalogFaultProfile high_short = profile(4, 2, ANALOG_OUTPUT_TEMPERATURE, ANALOG_FAULT_SHORT, 10, 10);
+
+    setup();
+    drift.rate = 1000;
+    low_drift.rate = 1000;
+    CHECK_EQ(load(&open), 1);
+    CHECK_EQ(load(&drift), 1);
+    CHECK_EQ(load(&shorted), 1);
+    CHECK_EQ(load(&other), 1);
+    CHECK_EQ(load(&low_drift), 1);
+    CHECK_EQ(load(&high_short), 1);
+    CHECK_EQ(Analog_Fault_Start(), 1);
+
+    // Where faults overlap on an output, the highest slot applies
+    for (uint32_t t = 0; t <= 100; t++) {
+        uint8_t expected_type;
+        uint8_t expected_mode;
+
+        run_until(t);
+        if (t < 20 || (t >= 60 && t < 100)) {
+            expected_type = ANALOG_FAULT_OPEN;        // Slot 2, over slot 1 from 60
+            expected_mode = ANALOG_FAULT_DRIVE_OPEN;
+        } else if (t < 60) {
+            expected_type = ANALOG_FAULT_DRIFT;       // Slot 5, over slots 1 and 2
+            expected_mode = ANALOG_FAULT_DRIVE_OFFSET;
+        } else {
+            expected_type = ANALOG_FAULT_NONE;
+            expected_mode = ANALOG_FAULT_DRIVE_NONE;
+        }
+        CHECK_EQ(Analog_Fault_GetActive(1, ANALOG_OUTPUT_TEMPERATURE), expected_type);
+        CHECK_EQ(drive_mode[1][ANALOG_OUTPUT_TEMPERATURE], expected_mode);
+        if (expected_mode == ANALOG_FAULT_DRIVE_OFFSET) {
+            CHECK_EQ(drive_value[1][ANALOG_OUTPUT_TEMPERATURE], t - 20);
+        }
+
+        // The sibling output follows its own slot only
+        CHECK_EQ(drive_mode[1][ANALOG_OUTPUT_CURRENT],
+                 (t >= 30 && t < 40) ? ANALOG_FAULT_DRIVE_FORCE : ANALOG_FAULT_DRIVE_NONE);
+
+        // A short over a lower drift holds 0, not the drift offset
+        if (t >= 10 && t < 20) {
+            CHECK_EQ(drive_mode[2][ANALOG_OUTPUT_TEMPERATURE], ANALOG_FAULT_DRIVE_FORCE);
+            CHECK_EQ(drive_value[2][ANALOG_OUTPUT_TEMPERATURE], 0);
+        } else if (t < 100) {
+            CHECK_EQ(drive_value[2][ANALOG_OUTPUT_TEMPERATURE], t);
+        }
+    }
+
+    // Covered slots still run out on their own timing
+    AnalogFaultStatus s = status();
+    CHECK_EQ(s.running, 0);
+    CHECK_EQ(s.elapsed_ms, 100);
+    for (uint8_t i = 0; i < ANALOG_FAULT_SLOTS; i++) {
+        CHECK_EQ(s.slot[i].state, (i < 6) ? ANALOG_FAULT_SLOT_DONE : ANALOG_FAULT_SLOT_EMPTY);
+    }
+}
+
+static void test_load_and_start_rejects(void) {
+    AnalogFaultProfile p = profile(0, 0, ANALOG_OUTPUT_CURRENT, ANALOG_FAULT_OPEN, 10, 10);
+    AnalogFaultProfile bad;
+
+    setup();
+    CHECK_EQ(Analog_Fault_Start(), 0);
+
+    bad = p;
+    bad.slot = ANALOG_FAULT_SLOTS;
+    CHECK_EQ(load(&bad), 0);
+    bad = p;
+    bad.type = ANALOG_FAULT_DROPOUT + 1;
+    CHECK_EQ(load(&bad), 0);
+    bad = p;
+    bad.light = 3;
+    CHECK_EQ(load(&bad), 0);
+    bad = p;
+    bad.output = 2;
+    CHECK_EQ(load(&bad), 0);
+    bad = p;
+    bad.type = ANALOG_FAULT_DROPOUT;
+    bad.period_ms = 10;
+    CHECK_EQ(load(&bad), 0);
+    bad.width_ms = 11;
+    CHECK_EQ(load(&bad), 0);
+    bad.period_ms = 0;
+    bad.width_ms = 0;
+    CHECK_EQ(load(&bad), 0);
+    CHECK_EQ(Analog_Fault_Load((const uint8_t*)&p, sizeof(p) - 1), 0);
+    CHECK_EQ(Analog_Fault_Load(NULL, sizeof(p)), 0);
+    CHECK_EQ(Analog_Fault_Start(), 0);
+
+    // A target output playing a waveform blocks the start
+    CHECK_EQ(load(&p), 1);
+    waveform_driving[0][ANALOG_OUTPUT_CURRENT] = 1;
+    CHECK_EQ(Analog_Fault_Start(), 0);
+    CHECK(!tick_running());
+    waveform_driving[0][ANALOG_OUTPUT_CURRENT] = 0;
+
+    // Running: no load, no restart
+    CHECK_EQ(Analog_Fault_Start(), 1);
+    CHECK_EQ(load(&p), 0);
+    CHECK_EQ(Analog_Fault_Start(), 0);
+    Analog_Fault_Stop();
+
+    // An empty profile clears its slot
+    p.type = ANALOG_FAULT_NONE;
+    CHECK_EQ(load(&p), 1);
+    CHECK_EQ(status().slot[0].state, ANALOG_FAULT_SLOT_EMPTY);
+    CHECK_EQ(Analog_Fault_Start(), 0);
+    CHECK_EQ(Analog_Fault_GetActive(3, 0), ANALOG_FAULT_NONE);
+    Analog_Fault_GetStatus(NULL);
+
+    // Ticks of other timers do not move the timeline
+    p.type = ANALOG_FAULT_OPEN;
+    CHECK_EQ(load(&p), 1);
+    CHECK_EQ(Analog_Fault_Start(), 1);
+    Analog_Fault_Tick(&htim5);
+    CHECK_EQ(status().elapsed_ms, 0);
+}
+
+int main(void) {
+    RUN_TEST(test_start_and_duration);
+    RUN_TEST(test_start_at_zero_and_stuck);
+    RUN_TEST(test_dropout_duty);
+    RUN_TEST(test_drift_rate);
+    RUN_TEST(test_slot_precedence);
+    RUN_TEST(test_load_and_start_rejects);
+    return TEST_RESULT();
+}
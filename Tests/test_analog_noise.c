@@ -0,0 +1,235 @@
+/**
+ * @file test_analog_noise.c
+ * @brief Noise statistics: standard deviation per distribution and variance through the low-pass
+ *
+ * Long runs of one output are reduced to mean, standard deviation and the
+ * lag-one autocorrelation. The sample rate is the default carrier,
+ * 84 MHz / 16 / 1024.
+ */
+
+#include "test_common.h"
+#include "analog_noise.h"
+#include "analog_simulation.h"
+#include <math.h>
+#include <string.h>
+
+#define SAMPLE_RATE_HZ   5127
+#define SAMPLES          (1u << 20)
+
+typedef struct {
+    double mean;
+    double sd;
+    double lag1;         // Autocorrelation of neighbouring samples
+    int32_t min;
+    int32_t max;
+    double within_2sd;   // Fraction of samples within two standard deviations
+} NoiseStats;
+
+static AnalogNoiseConfig config(uint8_t distribution, uint16_t amplitude, uint16_t bandwidth_hz, uint32_t seed) {
+    AnalogNoiseConfig c = {ANALOG_OUTPUT_CURRENT, distribution, amplitude, bandwidth_hz, 0, seed};
+
+    return c;
+}
+
+/**
+ * @brief Draw a run from light 1 current, after the filter has settled
+ */
+static NoiseStats measure(uint32_t samples) {
+    static int32_t run[SAMPLES];
+    NoiseStats s = {0.0, 0.0, 0.0, INT32_MAX, INT32_MIN, 0.0};
+    double sum = 0.0;
+    double square = 0.0;
+    double product = 0.0;
+    uint32_t within = 0;
+
+    for (uint32_t i = 0; i < 20000; i++) {
+        Analog_Noise_Sample(0, ANALOG_OUTPUT_CURRENT);
+    }
+    for (uint32_t i = 0; i < samples; i++) {
+        run[i] = Analog_Noise_Sample(0, ANALOG_OUTPUT_CURRENT);
+        sum += run[i];
+        square += (double)run[i] * run[i];
+        if (i > 0) {
+            product += (double)run[i] * run[i - 1];
+        }
+        if (run[i] < s.min) {
+            s.min = run[i];
+        }
+        if (run[i] > s.max) {
+            s.max = run[i];
+        }
+    }
+
+    s.mean = sum / samples;
+    s.sd = sqrt(square / samples - s.mean * s.mean);
+    s.lag1 = (product / (samples - 1) - s.mean * s.mean) / (s.sd * s.sd);
+    for (uint32_t i = 0; i < samples; i++) {
+        within += fabs(run[i] - s.mean) <= 2.0 * s.sd;
+    }
+    s.within_2sd = (double)within / samples;
+    return s;
+}
+
+static NoiseStats run_config(uint8_t distribution, uint16_t amplitude, uint16_t bandwidth_hz) {
+    AnalogNoiseConfig c = config(distribution, amplitude, bandwidth_hz, 0);
+
+    Analog_Noise_Init(SAMPLE_RATE_HZ);
+    CHECK_EQ(Analog_Noise_Configure(0, &c), 1);
+    return measure(SAMPLES);
+}
+
+static void test_uniform(void) {
+    static const uint16_t amplitudes[] = {64, 1000, ANALOG_NOISE_MAX_AMPLITUDE};
+
+    for (unsigned i = 0; i < sizeof(amplitudes) / sizeof(amplitudes[0]); i++) {
+        uint16_t a = amplitudes[i];
+        NoiseStats s = run_config(ANALOG_NOISE_UNIFORM, a, 0);
+
+        // Flat over +-amplitude: sd of a / sqrt(3), no tails beyond two sd
+        printf("  uniform A %4u: sd %.2f (A/sqrt(3) %.2f), lag1 %.4f\n", a, s.sd, a / sqrt(3.0), s.lag1);
+        CHECK_NEAR(s.sd, a / sqrt(3.0), 0.01 * a / sqrt(3.0));
+        CHECK_NEAR(s.mean, 0.0, 0.01 * a);
+        CHECK(s.min >= -a && s.max <= a);
+        CHECK(s.min <= -a + 1 && s.max >= a - 1);
+        CHECK_NEAR(s.within_2sd, 1.0, 1e-9);
+        CHECK_NEAR(s.lag1, 0.0, 0.01);
+    }
+}
+
+static void test_gaussian(void) {
+    static const uint16_t amplitudes[] = {64, 1000, ANALOG_NOISE_MAX_AMPLITUDE};
+
+    for (unsigned i = 0; i < sizeof(amplitudes) / sizeof(amplitudes[0]); i++) {
+        uint16_t a = amplitudes[i];
+        NoiseStats s = run_config(ANALOG_NOISE_GAUSSIAN, a, 0);
+
+        // Standard deviation of amplitude, bell-shaped: about 95 % within
+        // two sd, tails cut at the range of four bytes (3.45 sd)
+        printf("  gaussian A %4u: sd %.2f, within 2 sd %.4f, range %d..%d\n", a, s.sd, s.within_2sd, s.min, s.max);
+        CHECK_NEAR(s.sd, a, 0.01 * a);
+        CHECK_NEAR(s.mean, 0.0, 0.01 * a);
+        CHECK_NEAR(s.within_2sd, 0.954, 0.01);
+        CHECK(s.min >= -3.46 * a && s.max <= 3.46 * a);
+        CHECK_NEAR(s.lag1, 0.0, 0.01);
+    }
+}
+
+static void test_lowpass_keeps_variance(void) {
+    static const struct {
+        uint8_t distribution;
+        uint16_t amplitude;
+        uint16_t bandwidth_hz;
+    } cases[] = {
+        {ANALOG_NOISE_UNIFORM, 1000, 1000},
+        {ANALOG_NOISE_UNIFORM, 1000, 100},
+        {ANALOG_NOISE_GAUSSIAN, 1000, 1000},
+        {ANALOG_NOISE_GAUSSIAN, 1000, 100},
+        {ANALOG_NOISE_GAUSSIAN, 200, 20},
+        {ANALOG_NOISE_GAUSSIAN, ANALOG_NOISE_MAX_AMPLITUDE, 20},
+    };
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        NoiseStats s = run_config(cases[i].distribution, cases[i].amplitude, cases[i].bandwidth_hz);
+        double white_sd = cases[i].distribution == ANALOG_NOISE_GAUSSIAN ? cases[i].amplitude
+                                                                          : cases[i].amplitude / sqrt(3.0);
+        double pole = exp(-2.0 * M_PI * cases[i].bandwidth_hz / SAMPLE_RATE_HZ);
+
+        // The variance of the white source survives the filter, and the
+        // samples now follow the pole of the low-pass
+        printf("  %-8s A %4u, %4u Hz: sd %.2f (white %.2f), lag1 %.4f (pole %.4f)\n",
+               cases[i].distribution == ANALOG_NOISE_GAUSSIAN ? "gaussian" : "uniform",
+               cases[i].amplitude, cases[i].bandwidth_hz, s.sd, white_sd, s.lag1, pole);
+        CHECK_NEAR(s.sd, white_sd, 0.03 * white_sd);
+        CHECK_NEAR(s.lag1, pole, 0.01);
+        CHECK_NEAR(s.mean, 0.0, 0.05 * white_sd);
+    }
+}
+
+static void test_sample_rate_change(void) {
+    AnalogNoiseConfig c = config(ANALOG_NOISE_GAUSSIAN, 1000, 100, 0);
+    NoiseStats s;
+
+    // A faster carrier moves the pole, the variance stays
+    Analog_Noise_Init(SAMPLE_RATE_HZ);
+    CHECK_EQ(Analog_Noise_Configure(0, &c), 1);
+    Analog_Noise_SetSampleRate(SAMPLE_RATE_HZ * 16);
+    s = measure(SAMPLES);
+    CHECK_NEAR(s.sd, 1000.0, 40.0);
+    CHECK_NEAR(s.lag1, exp(-2.0 * M_PI * 100 / (SAMPLE_RATE_HZ * 16.0)), 0.005);
+
+    // A corner at or above the sample rate leaves white noise
+    c.bandwidth_hz = 60000;
+    Analog_Noise_Init(SAMPLE_RATE_HZ);
+    CHECK_EQ(Analog_Noise_Configure(0, &c), 1);
+    s = measure(SAMPLES / 4);
+    CHECK_NEAR(s.sd, 1000.0, 20.0);
+    CHECK_NEAR(s.lag1, 0.0, 0.01);
+}
+
+static void test_seed_reproduces(void) {
+    AnalogNoiseConfig a = config(ANALOG_NOISE_GAUSSIAN, 500, 200, 1234);
+    AnalogNoiseConfig b = config(ANALOG_NOISE_GAUSSIAN, 500, 200, 0);
+    int32_t first[64];
+    uint32_t differ = 0;
+
+    Analog_Noise_Init(SAMPLE_RATE_HZ);
+    CHECK_EQ(Analog_Noise_Configure(0, &a), 1);
+    for (int i = 0; i < 64; i++) {
+        first[i] = Analog_Noise_Sample(0, ANALOG_OUTPUT_CURRENT);
+    }
+
+    // Configuring again restarts from the seed, on any output
+    a.output = ANALOG_OUTPUT_TEMPERATURE;
+    CHECK_EQ(Analog_Noise_Configure(2, &a), 1);
+    for (int i = 0; i < 64; i++) {
+        CHECK_EQ(Analog_Noise_Sample(2, ANALOG_OUTPUT_TEMPERATURE), first[i]);
+    }
+
+    // Another seed gives another sequence
+    CHECK_EQ(Analog_Noise_Configure(0, &b), 1);
+    for (int i = 0; i < 64; i++) {
+        differ += Analog_Noise_Sample(0, ANALOG_OUTPUT_CURRENT) != first[i];
+    }
+    CHECK(differ > 60);
+}
+
+static void test_configure_and_mask(void) {
+    AnalogNoiseConfig c = config(ANALOG_NOISE_UNIFORM, 100, 0, 7);
+    AnalogNoiseConfig read;
+
+    Analog_Noise_Init(SAMPLE_RATE_HZ);
+    CHECK_EQ(Analog_Noise_GetMask(), 0);
+    CHECK_EQ(Analog_Noise_Configure(1, &c), 1);
+    CHECK_EQ(Analog_Noise_GetMask(), 1 << 2);
+    CHECK_EQ(Analog_Noise_Get(1, ANALOG_OUTPUT_CURRENT, &read), 1);
+    CHECK_EQ(read.amplitude, 100);
+    CHECK_EQ(read.seed, 7);
+
+    c.distribution = ANALOG_NOISE_OFF;
+    CHECK_EQ(Analog_Noise_Configure(1, &c), 1);
+    CHECK_EQ(Analog_Noise_GetMask(), 0);
+
+    c.distribution = ANALOG_NOISE_GAUSSIAN + 1;
+    CHECK_EQ(Analog_Noise_Configure(1, &c), 0);
+    c.distribution = ANALOG_NOISE_UNIFORM;
+    c.amplitude = ANALOG_NOISE_MAX_AMPLITUDE + 1;
+    CHECK_EQ(Analog_Noise_Configure(1, &c), 0);
+    c.amplitude = 100;
+    c.output = 2;
+    CHECK_EQ(Analog_Noise_Configure(1, &c), 0);
+    c.output = ANALOG_OUTPUT_CURRENT;
+    CHECK_EQ(Analog_Noise_Configure(3, &c), 0);
+    CHECK_EQ(Analog_Noise_Configure(0, NULL), 0);
+    CHECK_EQ(Analog_Noise_Get(0, 2, &read), 0);
+    CHECK_EQ(Analog_Noise_GetMask(), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_uniform);
+    RUN_TEST(test_gaussian);
+    RUN_TEST(test_lowpass_keeps_variance);
+    RUN_TEST(test_sample_rate_change);
+    RUN_TEST(test_seed_reproduces);
+    RUN_TEST(test_configure_and_mask);
+    return TEST_RESULT();
+}
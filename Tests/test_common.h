@@ -0,0 +1,52 @@
+/**
+ * @file test_common.h
+ * @brief Minimal assertions for the host unit tests
+ *
+ * Every test is a plain executable; a failed check prints its location
+ * and the test exits non-zero from TEST_RESULT().
+ */
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long a_ = (long long)(actual), e_ = (long long)(expected); \
+        if (a_ != e_) { \
+            printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double a_ = (double)(actual), e_ = (double)(expected); \
+        if (a_ < e_ - (tolerance) || a_ > e_ + (tolerance)) { \
+            printf("%s:%d: %s == %g, expected %g +/- %g\n", __FILE__, __LINE__, #actual, a_, e_, (double)(tolerance)); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) \
+    do { \
+        int before_ = test_failures; \
+        fn(); \
+        printf("%s %s\n", (test_failures == before_) ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+#define TEST_RESULT()  (test_failures ? 1 : 0)
+
+#endif /* TEST_COMMON_H */
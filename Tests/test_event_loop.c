@@ -0,0 +1,279 @@
+/**
+ * @file test_event_loop.c
+ * @brief Event-driven main loop against the former polling loop: command latency and idle share
+ *
+ * DWT->CYCCNT is a virtual 168 MHz clock. Interrupts arrive on schedules
+ * in that clock: the 1 kHz TIM4 tick, which signals nothing here, and
+ * the UART receiver completing a command. WFI sleeps to the next arrival.
+ * An interrupt runs at once while PRIMASK is clear and on unmasking
+ * otherwise, as on the core. The CPU work of each interrupt and command
+ * is a modelled cycle cost, which the emulation charges to the clock.
+ */
+
+#include "test_common.h"
+#include "event_loop.h"
+
+#define US(us)              ((uint32_t)((us) * 168))
+#define WAKE_CYCLES         12          // Exception entry from sleep
+#define TICK_ISR_CYCLES     150         // TIM4 update with no slot released
+#define UART_ISR_CYCLES     600         // Receiver interrupts of one command frame
+#define POLL_CYCLES         250         // One pass of the polling loop with nothing to do
+#define MAX_QUEUED          16
+
+// Periodic interrupt source
+typedef struct {
+    uint32_t period;
+    uint32_t next;              // Arrival of the next interrupt
+    uint32_t cost;
+    uint8_t  command;           // Queues a command and signals EVENT_LOOP_HIL
+} IrqSource;
+
+static IrqSource sources[2];
+static uint32_t command_cycles;
+
+// Commands queued by the receiver, by arrival
+static uint32_t queue[MAX_QUEUED];
+static uint32_t queued;
+
+// Latency from arrival to the start of processing
+static uint32_t latency_max;
+static uint64_t latency_sum;
+static uint32_t commands;
+
+static uint32_t wfi_calls;
+
+static uint32_t now(void) {
+    return DWT->CYCCNT;
+}
+
+static uint8_t reached(uint32_t time) {
+    return (int32_t)(now() - time) >= 0;
+}
+
+/**
+ * @brief Run every interrupt that has arrived, in arrival order
+ * An interrupt arriving during another one runs after it, as at equal priority.
+ */
+static void serve(void) {
+    for (;;) {
+        IrqSource* first = NULL;
+
+        for (unsigned i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+            if (sources[i].period && reached(sources[i].next) &&
+                (first == NULL || (int32_t)(sources[i].next - first->next) < 0)) {
+                first = &sources[i];
+            }
+        }
+        if (first == NULL) {
+            return;
+        }
+
+        uint32_t arrival = first->next;
+        first->next += first->period;
+        DWT->CYCCNT += first->cost;
+        if (first->command) {
+            CHECK(queued < MAX_QUEUED);
+            queue[queued++] = arrival;
+            Event_Loop_Signal(EVENT_LOOP_HIL);
+        }
+    }
+}
+
+/**
+ * @brief Spend CPU time in the main loop, interrupts preempt it
+ */
+static void work(uint32_t cycles) {
+    DWT->CYCCNT += cycles;
+    if (stub_primask == 0) {
+        serve();
+    }
+}
+
+/**
+ * @brief WFI: sleep to the next arrival, unless an interrupt is already pending
+ * Unmasked, arrived interrupts run first and the sleep waits for the next one.
+ */
+static void sleep_to_interrupt(void) {
+    uint32_t next;
+
+    wfi_calls++;
+    if (stub_primask == 0) {
+        serve();
+    }
+
+    next = sources[0].next;
+    for (unsigned i = 1; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        if (sources[i].period && (int32_t)(sources[i].next - next) < 0) {
+            next = sources[i].next;
+        }
+    }
+    if ((int32_t)(next - now()) > 0) {
+        DWT->CYCCNT = next + WAKE_CYCLES;
+    }
+}
+
+/**
+ * @brief The command handler: processes every queued command
+ */
+static void process_commands(void) {
+    while (queued > 0) {
+        uint32_t latency = now() - queue[0];
+
+        latency_sum += latency;
+        if (latency > latency_max) {
+            latency_max = latency;
+        }
+        commands++;
+        memmove(queue, queue + 1, --queued * sizeof(queue[0]));
+        work(command_cycles);
+    }
+}
+
+/**
+ * @brief The loop of main.c, dispatching the received messages
+ */
+static void run_event_loop(uint32_t cycles) {
+    uint32_t end = now() + cycles;
+
+    while (!reached(end)) {
+        uint32_t events = Event_Loop_Wait();
+
+        if (events & EVENT_LOOP_HIL) {
+            process_commands();
+        }
+    }
+}
+
+/**
+ * @brief The former loop: poll the receiver and every event source without pause
+ */
+static void run_polling_loop(uint32_t cycles) {
+    uint32_t end = now() + cycles;
+
+    while (!reached(end)) {
+        process_commands();
+        work(POLL_CYCLES);
+    }
+}
+
+/**
+ * @brief Set up the tick and a command every period_us, each taking work_us
+ */
+static void setup(uint32_t period_us, uint32_t work_us) {
+    Stub_HAL_Reset();
+    memset(sources, 0, sizeof(sources));
+    sources[0] = (IrqSource){US(1000), US(1000), TICK_ISR_CYCLES, 0};
+    sources[1] = (IrqSource){US(period_us), US(period_us) + US(333), UART_ISR_CYCLES, 1};
+    command_cycles = US(work_us);
+    queued = 0;
+    latency_max = 0;
+    latency_sum = 0;
+    commands = 0;
+    wfi_calls = 0;
+    stub_wfi_hook = sleep_to_interrupt;
+    stub_unmask_hook = serve;
+    Event_Loop_Init();
+}
+
+/**
+ * @brief Idle share the load leaves, in per mille
+ */
+static double expected_idle(uint32_t period_us, uint32_t work_us) {
+    double busy = 1000.0 * TICK_ISR_CYCLES + (1e6 / period_us) * (UART_ISR_CYCLES + US(work_us));
+
+    return EVENT_LOOP_IDLE_FULL * (1.0 - busy / SystemCoreClock);
+}
+
+static void test_light_load(void) {
+    uint32_t poll_max;
+    double poll_mean;
+
+    // Bench traffic: a command every 10 ms taking 20 us
+    setup(10000, 20);
+    run_polling_loop(2 * SystemCoreClock);
+    poll_max = latency_max;
+    poll_mean = (double)latency_sum / commands;
+    CHECK_EQ(commands, 199);
+    CHECK_EQ(wfi_calls, 0);
+
+    setup(10000, 20);
+    run_event_loop(2 * SystemCoreClock);
+    CHECK_NEAR(commands, 199, 1);
+
+    printf("  polling: latency mean %.2f us, max %.2f us, idle 0.0 %%\n",
+           poll_mean / 168, poll_max / 168.0);
+    printf("  event loop: latency mean %.2f us, max %.2f us, idle %.1f %% (load leaves %.1f %%)\n",
+           (double)latency_sum / commands / 168, latency_max / 168.0,
+           Event_Loop_GetIdle() / 10.0, expected_idle(10000, 20) / 10.0);
+
+    // Latency stays at the receiver interrupt plus the wake-up from sleep,
+    // no longer than the polling loop took to come round
+    CHECK(latency_max <= UART_ISR_CYCLES + WAKE_CYCLES + TICK_ISR_CYCLES);
+    CHECK(latency_max <= poll_max + WAKE_CYCLES);
+    CHECK((double)latency_sum / commands <= poll_mean + WAKE_CYCLES);
+
+    // And the CPU sleeps for everything the load leaves
+    CHECK_NEAR(Event_Loop_GetIdle(), expected_idle(10000, 20), 2.0);
+    CHECK(Event_Loop_GetIdle() >= 990);
+}
+
+static void test_heavy_load(void) {
+    // A command every 100 us taking 60 us: the idle share follows the load
+    setup(100, 60);
+    run_event_loop(2 * SystemCoreClock);
+    printf("  event loop, heavy: latency max %.2f us, idle %.1f %% (load leaves %.1f %%)\n",
+           latency_max / 168.0, Event_Loop_GetIdle() / 10.0, expected_idle(100, 60) / 10.0);
+    CHECK_NEAR(commands, 19997, 1);
+    CHECK_NEAR(Event_Loop_GetIdle(), expected_idle(100, 60), 2.0);
+
+    // A command may wait for the one before it, never for more
+    CHECK(latency_max <= UART_ISR_CYCLES + WAKE_CYCLES + TICK_ISR_CYCLES + US(60));
+}
+
+static void test_no_lost_wakeup(void) {
+    setup(10000, 20);
+
+    // The command arrives between the flag check and the WFI: the pending
+    // interrupt ends the sleep at once and runs when the mask lifts
+    sources[1].next = now();
+    CHECK_EQ(Event_Loop_Wait(), EVENT_LOOP_HIL);
+    CHECK_EQ(wfi_calls, 1);
+    CHECK_EQ(queued, 1);
+    CHECK_EQ(now(), UART_ISR_CYCLES);
+
+    // Flags already pending return without sleeping
+    Event_Loop_Signal(EVENT_LOOP_RAMP | EVENT_LOOP_FAULT);
+    Event_Loop_Signal(EVENT_LOOP_FAULT);
+    CHECK_EQ(Event_Loop_Wait(), EVENT_LOOP_RAMP | EVENT_LOOP_FAULT);
+    CHECK_EQ(wfi_calls, 1);
+
+    // Ticks without an event sleep on, nine of them up to the next command
+    CHECK_EQ(Event_Loop_Wait(), EVENT_LOOP_HIL);
+    CHECK_EQ(wfi_calls, 1 + 9 + 1);
+    CHECK_EQ(now(), US(10000) + WAKE_CYCLES + TICK_ISR_CYCLES + UART_ISR_CYCLES);
+    CHECK_EQ(stub_primask, 0);
+}
+
+static void test_idle_window(void) {
+    setup(10000, 20);
+
+    // Nothing to report before the first second is complete
+    run_event_loop(SystemCoreClock / 2);
+    CHECK_EQ(Event_Loop_GetIdle(), 0);
+    run_event_loop(SystemCoreClock);
+    CHECK(Event_Loop_GetIdle() > 990);
+
+    // The window follows a change of load
+    sources[1].period = US(200);
+    command_cycles = US(100);
+    run_event_loop(3 * SystemCoreClock);
+    CHECK_NEAR(Event_Loop_GetIdle(), expected_idle(200, 100), 2.0);
+}
+
+int main(void) {
+    RUN_TEST(test_light_load);
+    RUN_TEST(test_heavy_load);
+    RUN_TEST(test_no_lost_wakeup);
+    RUN_TEST(test_idle_window);
+    return TEST_RESULT();
+}
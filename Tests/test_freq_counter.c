@@ -0,0 +1,204 @@
+/**
+ * @file test_freq_counter.c
+ * @brief Gate arithmetic of the frequency counter: 16-bit wrap accumulation and rounding
+ */
+
+#include "test_common.h"
+#include "freq_counter.h"
+#include "pwm_capture.h"
+#include "tim.h"
+
+extern DMA_HandleTypeDef hdma_tim8_up;
+
+// Capture module and TIM1 set-up, replaced by call counters
+static int capture_stops;
+static int capture_starts;
+static int tim1_inits;
+
+void PWM_Capture_Stop(void) { capture_stops++; }
+void PWM_Capture_Start(void) { capture_starts++; }
+void PWM_Capture_Init(void) { }
+void MX_TIM1_Init(void) { tim1_inits++; }
+
+static uint16_t tim1_count;       // Free-running 16-bit counter of the light input
+static uint64_t edge_accumulator; // Input edges x 10^6, keeps the fraction of non-integer rates
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Freq_Counter_Init();
+    capture_stops = 0;
+    capture_starts = 0;
+    tim1_inits = 0;
+    tim1_count = 0;
+    edge_accumulator = 0;
+}
+
+/**
+ * @brief Advance the input by one 1 ms gate tick and latch the counter
+ * @param frequency_mhz Input frequency in millihertz
+ */
+static void tick(uint64_t frequency_mhz) {
+    uint64_t before = edge_accumulator / 1000000;
+
+    edge_accumulator += frequency_mhz;
+    tim1_count += (uint16_t)(edge_accumulator / 1000000 - before);
+    Freq_Counter_GateTick(tim1_count);
+}
+
+static void test_start_configures_counter_mode(void) {
+    setup();
+    CHECK_EQ(Freq_Counter_Start(1, 100), 1);
+    CHECK_EQ(Freq_Counter_IsActive(), 1);
+    CHECK_EQ(capture_stops, 1);
+
+    // TIM1 counts TI2 edges over the full 16 bits, TIM8 updates request the latch
+    CHECK_EQ(TIM1->SMCR, TIM_CLOCKSOURCE_TI2);
+    CHECK_EQ(TIM1->ARR, 0xFFFF);
+    CHECK_EQ(TIM1->PSC, 0);
+    CHECK(TIM1->CR1 & TIM_CR1_CEN);
+    CHECK(TIM8->DIER & TIM_DMA_UPDATE);
+    CHECK(TIM8->CR1 & TIM_CR1_CEN);
+    CHECK_EQ(hdma_tim8_up.Running, 1);
+    CHECK_EQ(hdma_tim8_up.Length, 1);
+    CHECK(hdma_tim8_up.XferCpltCallback != NULL);
+
+    Freq_Counter_Stop();
+    CHECK_EQ(Freq_Counter_IsActive(), 0);
+    CHECK_EQ(hdma_tim8_up.Running, 0);
+    CHECK_EQ(TIM8->DIER & TIM_DMA_UPDATE, 0);
+    CHECK_EQ(tim1_inits, 1);
+    CHECK_EQ(capture_starts, 1);
+}
+
+static void test_start_rejects_invalid(void) {
+    setup();
+    CHECK_EQ(Freq_Counter_Start(2, 100), 0);
+    CHECK_EQ(Freq_Counter_Start(0, 0), 0);
+    CHECK_EQ(Freq_Counter_Start(0, FREQ_COUNTER_MAX_GATE_MS + 1), 0);
+    CHECK_EQ(Freq_Counter_IsActive(), 0);
+    CHECK_EQ(capture_stops, 0);
+}
+
+static void test_first_tick_only_primes(void) {
+    FreqCounterResult result;
+
+    setup();
+    tim1_count = 40000;
+    CHECK_EQ(Freq_Counter_Start(0, 2), 1);
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 0);
+
+    // Edges before the first tick belong to no gate
+    tick(7000000);
+    tick(7000000);
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 0);
+    tick(7000000);
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 1);
+    CHECK_EQ(result.edges, 14);
+    CHECK_EQ(result.gate_ms, 2);
+    CHECK_EQ(result.frequency_hz, 7000);
+
+    // Results belong to the light being counted
+    CHECK_EQ(Freq_Counter_GetResult(1, &result), 0);
+    CHECK_EQ(Freq_Counter_GetResult(0, NULL), 0);
+}
+
+static void test_wrap_accumulation(void) {
+    FreqCounterResult result;
+
+    setup();
+    CHECK_EQ(Freq_Counter_Start(0, 1000), 1);
+    tick(0);
+
+    // 12.345678 MHz wraps the 16-bit counter every 5.3 ticks
+    for (int i = 0; i < 1000; i++) {
+        tick(12345678000ULL);
+    }
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 1);
+    CHECK_EQ(result.edges, 12345678);
+    CHECK_EQ(result.frequency_hz, 12345678);
+
+    // The next gate starts where the last one ended
+    for (int i = 0; i < 1000; i++) {
+        tick(65535000000ULL);
+    }
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 1);
+    CHECK_EQ(result.edges, 65535000);
+    CHECK_EQ(result.frequency_hz, 65535000);
+}
+
+static void test_long_gate_does_not_overflow(void) {
+    FreqCounterResult result;
+
+    setup();
+    CHECK_EQ(Freq_Counter_Start(0, FREQ_COUNTER_MAX_GATE_MS), 1);
+    tick(0);
+    for (int i = 0; i < FREQ_COUNTER_MAX_GATE_MS; i++) {
+        tick(60000000000ULL);
+    }
+
+    // 600 million edges times 1000 exceeds 32 bits before the division
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 1);
+    CHECK_EQ(result.edges, 600000000);
+    CHECK_EQ(result.frequency_hz, 60000000);
+}
+
+static void test_rounding(void) {
+    static const struct {
+        uint16_t gate_ms;
+        uint16_t edges;
+        uint32_t frequency_hz;
+    } cases[] = {
+        {3, 1000, 333333},    // 333333.3 rounds down
+        {3, 2000, 666667},    // 666666.7 rounds up
+        {8, 1, 125},          // Exact
+        {16, 1, 63},          // 62.5 rounds half up
+        {7, 0, 0},
+    };
+    FreqCounterResult result;
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        setup();
+        CHECK_EQ(Freq_Counter_Start(0, cases[i].gate_ms), 1);
+        Freq_Counter_GateTick(100);
+        for (uint16_t t = 1; t < cases[i].gate_ms; t++) {
+            Freq_Counter_GateTick(100);
+        }
+        Freq_Counter_GateTick((uint16_t)(100 + cases[i].edges));
+
+        CHECK_EQ(Freq_Counter_GetResult(0, &result), 1);
+        CHECK_EQ(result.edges, cases[i].edges);
+        CHECK_EQ(result.frequency_hz, cases[i].frequency_hz);
+    }
+}
+
+static void test_restart_discards_gate(void) {
+    FreqCounterResult result;
+
+    setup();
+    CHECK_EQ(Freq_Counter_Start(0, 2), 1);
+    tick(1000000000);
+    tick(1000000000);
+    tick(1000000000);
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 1);
+
+    // A new start stops the running count first and waits for a fresh gate
+    CHECK_EQ(Freq_Counter_Start(1, 2), 1);
+    CHECK_EQ(capture_starts, 1);
+    CHECK_EQ(Freq_Counter_GetResult(1, &result), 0);
+    CHECK_EQ(Freq_Counter_GetResult(0, &result), 0);
+
+    Freq_Counter_Stop();
+    Freq_Counter_GateTick(0);
+    CHECK_EQ(Freq_Counter_GetResult(1, &result), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_start_configures_counter_mode);
+    RUN_TEST(test_start_rejects_invalid);
+    RUN_TEST(test_first_tick_only_primes);
+    RUN_TEST(test_wrap_accumulation);
+    RUN_TEST(test_long_gate_does_not_overflow);
+    RUN_TEST(test_rounding);
+    RUN_TEST(test_restart_discards_gate);
+    return TEST_RESULT();
+}
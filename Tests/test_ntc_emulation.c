@@ -0,0 +1,284 @@
+/**
+ * @file test_ntc_emulation.c
+ * @brief NTC divider models against datasheet R-T points, and curve resampling
+ *
+ * Reference part: Murata NCP18XH103, 10 kOhm at 25 degC, B25/50 = 3380 K,
+ * in a 10 kOhm divider from 3.3 V.
+ */
+
+#include "test_common.h"
+#include "ntc_emulation.h"
+#include <math.h>
+
+#define SUPPLY_MV   3300
+#define FIXED_OHM   10000
+
+// Datasheet resistance table
+static const struct {
+    double celsius;
+    double ohm;
+} datasheet[] = {
+    {0.0, 27219.0},
+    {10.0, 17926.0},
+    {25.0, 10000.0},
+    {40.0, 5834.0},
+    {50.0, 4161.0},
+    {60.0, 3014.0},
+    {75.0, 1925.0},
+    {85.0, 1452.0},
+    {100.0, 974.0},
+};
+#define DATASHEET_POINTS  (sizeof(datasheet) / sizeof(datasheet[0]))
+
+static uint16_t nominal_of(double celsius) {
+    return (uint16_t)lround(celsius * ANALOG_FINE_MAX / ANALOG_TEMPERATURE_FULL_SCALE);
+}
+
+static double mv_of(uint16_t level) {
+    return (double)level * NTC_FULL_SCALE_MV / ANALOG_FINE_MAX;
+}
+
+static double divider(uint8_t topology, double ohm) {
+    return (topology == NTC_TOPOLOGY_LOW_SIDE) ? SUPPLY_MV * ohm / (ohm + FIXED_OHM)
+                                               : SUPPLY_MV * (double)FIXED_OHM / (ohm + FIXED_OHM);
+}
+
+static uint16_t build_header(uint8_t* payload, uint8_t model, uint8_t topology) {
+    NTCHeader header = {model, topology, SUPPLY_MV, FIXED_OHM};
+
+    memcpy(payload, &header, sizeof(header));
+    return sizeof(header);
+}
+
+static uint8_t configure_beta(uint8_t light, uint8_t topology, float r25, float beta) {
+    uint8_t payload[sizeof(NTCHeader) + sizeof(NTCBetaParams)];
+    NTCBetaParams params = {r25, beta};
+    uint16_t length = build_header(payload, NTC_MODEL_BETA, topology);
+
+    memcpy(payload + length, &params, sizeof(params));
+    return NTC_Emulation_Configure(light, payload, length + sizeof(params));
+}
+
+static uint8_t configure_steinhart_hart(uint8_t light, const NTCSteinhartHartParams* params) {
+    uint8_t payload[sizeof(NTCHeader) + sizeof(NTCSteinhartHartParams)];
+    uint16_t length = build_header(payload, NTC_MODEL_STEINHART_HART, NTC_TOPOLOGY_LOW_SIDE);
+
+    memcpy(payload + length, params, sizeof(*params));
+    return NTC_Emulation_Configure(light, payload, length + sizeof(*params));
+}
+
+static uint8_t configure_curve(uint8_t light, const NTCCurvePoint* points, uint8_t count) {
+    uint8_t payload[sizeof(NTCHeader) + 2 + (NTC_CURVE_MAX_POINTS + 1) * sizeof(NTCCurvePoint)];
+    uint16_t length = build_header(payload, NTC_MODEL_CURVE, NTC_TOPOLOGY_LOW_SIDE);
+
+    payload[length++] = count;
+    payload[length++] = 0;
+    memcpy(payload + length, points, count * sizeof(NTCCurvePoint));
+    return NTC_Emulation_Configure(light, payload, length + count * sizeof(NTCCurvePoint));
+}
+
+/**
+ * @brief Fit Steinhart-Hart coefficients through three datasheet points
+ */
+static NTCSteinhartHartParams fit_steinhart_hart(int i1, int i2, int i3) {
+    double l1 = log(datasheet[i1].ohm), l2 = log(datasheet[i2].ohm), l3 = log(datasheet[i3].ohm);
+    double y1 = 1.0 / (datasheet[i1].celsius + 273.15);
+    double y2 = 1.0 / (datasheet[i2].celsius + 273.15);
+    double y3 = 1.0 / (datasheet[i3].celsius + 273.15);
+    double g2 = (y2 - y1) / (l2 - l1);
+    double g3 = (y3 - y1) / (l3 - l1);
+    double c = (g3 - g2) / (l3 - l2) / (l1 + l2 + l3);
+    double b = g2 - c * (l1 * l1 + l1 * l2 + l2 * l2);
+    double a = y1 - (b + l1 * l1 * c) * l1;
+
+    return (NTCSteinhartHartParams){(float)a, (float)b, (float)c};
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    NTC_Emulation_Init();
+}
+
+static void test_linear_by_default(void) {
+    NTCHeader header;
+
+    setup();
+    CHECK_EQ(NTC_Emulation_Apply(0, 0), 0);
+    CHECK_EQ(NTC_Emulation_Apply(1, 12345), 12345);
+    CHECK_EQ(NTC_Emulation_Apply(2, ANALOG_FINE_MAX), ANALOG_FINE_MAX);
+    CHECK_EQ(NTC_Emulation_Get(0, &header, NULL), 1);
+    CHECK_EQ(header.model, NTC_MODEL_LINEAR);
+}
+
+static void test_beta_against_datasheet(void) {
+    setup();
+    CHECK_EQ(configure_beta(0, NTC_TOPOLOGY_LOW_SIDE, 10000.0f, 3380.0f), 1);
+
+    for (unsigned i = 0; i < DATASHEET_POINTS; i++) {
+        double expected = divider(NTC_TOPOLOGY_LOW_SIDE, datasheet[i].ohm);
+        double actual = mv_of(NTC_Emulation_Apply(0, nominal_of(datasheet[i].celsius)));
+
+        // B25/50 pins the model at 25 and 50 degC; away from them Beta
+        // drifts from the real curve by a few percent of resistance
+        if (datasheet[i].celsius == 25.0 || datasheet[i].celsius == 50.0) {
+            CHECK_NEAR(actual, expected, 1.0);
+        } else {
+            CHECK_NEAR(actual, expected, 30.0);
+        }
+    }
+
+    // The same thermistor on the high side mirrors the output
+    CHECK_EQ(configure_beta(1, NTC_TOPOLOGY_HIGH_SIDE, 10000.0f, 3380.0f), 1);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(1, nominal_of(25.0))), SUPPLY_MV / 2.0, 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(1, nominal_of(50.0))), divider(NTC_TOPOLOGY_HIGH_SIDE, 4161.0), 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(80.0))) + mv_of(NTC_Emulation_Apply(1, nominal_of(80.0))),
+               SUPPLY_MV, 1.0);
+}
+
+static void test_steinhart_hart_against_datasheet(void) {
+    // Fitted at 0, 50 and 100 degC, the other points are predictions
+    NTCSteinhartHartParams params = fit_steinhart_hart(0, 4, 8);
+
+    setup();
+    CHECK_EQ(configure_steinhart_hart(0, &params), 1);
+
+    for (unsigned i = 0; i < DATASHEET_POINTS; i++) {
+        double expected = divider(NTC_TOPOLOGY_LOW_SIDE, datasheet[i].ohm);
+        double actual = mv_of(NTC_Emulation_Apply(0, nominal_of(datasheet[i].celsius)));
+
+        CHECK_NEAR(actual, expected, 2.5);
+    }
+
+    // Classic coefficients of a 10 kOhm part give 10 kOhm at 25 degC
+    params = (NTCSteinhartHartParams){1.129148e-3f, 2.34125e-4f, 8.76741e-8f};
+    CHECK_EQ(configure_steinhart_hart(1, &params), 1);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(1, nominal_of(25.0))), SUPPLY_MV / 2.0, 1.0);
+}
+
+static void test_table_interpolation(void) {
+    uint16_t table[NTC_TABLE_SIZE];
+    NTCHeader header;
+
+    setup();
+    CHECK_EQ(configure_beta(2, NTC_TOPOLOGY_LOW_SIDE, 10000.0f, 3380.0f), 1);
+    CHECK_EQ(NTC_Emulation_Get(2, &header, table), 1);
+    CHECK_EQ(header.model, NTC_MODEL_BETA);
+    CHECK_EQ(header.fixed_ohm, FIXED_OHM);
+
+    // Table entries apply exactly, levels in between lie on the chord
+    for (uint16_t i = 0; i + 1 < NTC_TABLE_SIZE; i++) {
+        uint16_t nominal = i << NTC_TABLE_SHIFT;
+
+        if (nominal > ANALOG_FINE_MAX) {
+            break;
+        }
+        CHECK_EQ(NTC_Emulation_Apply(2, nominal), table[i]);
+        CHECK(table[i + 1] <= table[i]);
+
+        uint16_t middle = NTC_Emulation_Apply(2, nominal + (1 << (NTC_TABLE_SHIFT - 1)));
+        CHECK_NEAR(middle, (table[i] + table[i + 1]) / 2.0, 1.0);
+    }
+
+    // The full range is covered, including the last fine step
+    CHECK(NTC_Emulation_Apply(2, ANALOG_FINE_MAX) < NTC_Emulation_Apply(2, ANALOG_FINE_MAX - 600));
+}
+
+static void test_curve_resampling(void) {
+    static const NTCCurvePoint curve[] = {
+        {20, 3000},
+        {60, 2000},
+        {120, 800},
+        {200, 300},
+    };
+
+    setup();
+    CHECK_EQ(configure_curve(0, curve, 4), 1);
+
+    // End voltages hold outside the curve
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, 0)), 3000.0, 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(10.0))), 3000.0, 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(250.0))), 300.0, 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, ANALOG_FINE_MAX)), 300.0, 1.0);
+
+    // Within a segment the resampled table follows the line
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(40.0))), 2500.0, 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(90.0))), 1400.0, 1.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(160.0))), 550.0, 1.0);
+
+    // Corners are cut by at most one table step of the steeper side
+    double step_celsius = (double)(1 << NTC_TABLE_SHIFT) * ANALOG_TEMPERATURE_FULL_SCALE / ANALOG_FINE_MAX;
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(60.0))), 2000.0, step_celsius * 25.0);
+    CHECK_NEAR(mv_of(NTC_Emulation_Apply(0, nominal_of(20.0))), 3000.0, step_celsius * 25.0);
+}
+
+static void test_configure_rejects(void) {
+    NTCCurvePoint points[NTC_CURVE_MAX_POINTS + 1];
+    NTCSteinhartHartParams params = fit_steinhart_hart(0, 4, 8);
+    uint8_t payload[sizeof(NTCHeader) + sizeof(NTCBetaParams)];
+    NTCHeader header;
+
+    setup();
+
+    // Header and parameter framing
+    CHECK_EQ(configure_beta(3, NTC_TOPOLOGY_LOW_SIDE, 10000.0f, 3380.0f), 0);
+    CHECK_EQ(configure_beta(0, 2, 10000.0f, 3380.0f), 0);
+    CHECK_EQ(configure_beta(0, NTC_TOPOLOGY_LOW_SIDE, 0.0f, 3380.0f), 0);
+    CHECK_EQ(configure_beta(0, NTC_TOPOLOGY_LOW_SIDE, 10000.0f, -1.0f), 0);
+    CHECK_EQ(configure_beta(0, NTC_TOPOLOGY_LOW_SIDE, NAN, 3380.0f), 0);
+    CHECK_EQ(NTC_Emulation_Configure(0, NULL, sizeof(payload)), 0);
+    CHECK_EQ(NTC_Emulation_Configure(0, payload, sizeof(NTCHeader) - 1), 0);
+    build_header(payload, NTC_MODEL_BETA, NTC_TOPOLOGY_LOW_SIDE);
+    CHECK_EQ(NTC_Emulation_Configure(0, payload, sizeof(NTCHeader) + sizeof(NTCBetaParams) - 1), 0);
+    build_header(payload, NTC_MODEL_CURVE + 1, NTC_TOPOLOGY_LOW_SIDE);
+    CHECK_EQ(NTC_Emulation_Configure(0, payload, sizeof(NTCHeader)), 0);
+    build_header(payload, NTC_MODEL_LINEAR, NTC_TOPOLOGY_LOW_SIDE);
+    CHECK_EQ(NTC_Emulation_Configure(0, payload, sizeof(NTCHeader) + 1), 0);
+
+    // A divider needs a supply and a fixed resistor
+    NTCHeader divider_header = {NTC_MODEL_BETA, NTC_TOPOLOGY_LOW_SIDE, 0, FIXED_OHM};
+    NTCBetaParams beta = {10000.0f, 3380.0f};
+    memcpy(payload, &divider_header, sizeof(divider_header));
+    memcpy(payload + sizeof(divider_header), &beta, sizeof(beta));
+    CHECK_EQ(NTC_Emulation_Configure(0, payload, sizeof(payload)), 0);
+    divider_header.supply_mv = SUPPLY_MV;
+    divider_header.fixed_ohm = 0;
+    memcpy(payload, &divider_header, sizeof(divider_header));
+    CHECK_EQ(NTC_Emulation_Configure(0, payload, sizeof(payload)), 0);
+
+    // Steinhart-Hart needs positive B and C
+    params.c = 0.0f;
+    CHECK_EQ(configure_steinhart_hart(0, &params), 0);
+    params.c = 8.76741e-8f;
+    params.b = -2.34125e-4f;
+    CHECK_EQ(configure_steinhart_hart(0, &params), 0);
+
+    // Curves need 2-32 points of rising temperature
+    for (uint8_t i = 0; i <= NTC_CURVE_MAX_POINTS; i++) {
+        points[i] = (NTCCurvePoint){(uint16_t)(i * 10), (uint16_t)(3000 - i * 80)};
+    }
+    CHECK_EQ(configure_curve(0, points, 1), 0);
+    CHECK_EQ(configure_curve(0, points, NTC_CURVE_MAX_POINTS + 1), 0);
+    CHECK_EQ(configure_curve(0, points, NTC_CURVE_MAX_POINTS), 1);
+    points[5].temperature = points[4].temperature;
+    CHECK_EQ(configure_curve(1, points, 8), 0);
+
+    // Rejected uploads leave the output as it was, clearing returns it to linear
+    CHECK_EQ(NTC_Emulation_Get(1, &header, NULL), 1);
+    CHECK_EQ(header.model, NTC_MODEL_LINEAR);
+    CHECK_EQ(NTC_Emulation_Get(0, &header, NULL), 1);
+    CHECK_EQ(header.model, NTC_MODEL_CURVE);
+    CHECK_EQ(NTC_Emulation_Clear(3), 0);
+    CHECK_EQ(NTC_Emulation_Clear(0), 1);
+    CHECK_EQ(NTC_Emulation_Apply(0, 4321), 4321);
+    CHECK_EQ(NTC_Emulation_Get(3, &header, NULL), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_linear_by_default);
+    RUN_TEST(test_beta_against_datasheet);
+    RUN_TEST(test_steinhart_hart_against_datasheet);
+    RUN_TEST(test_table_interpolation);
+    RUN_TEST(test_curve_resampling);
+    RUN_TEST(test_configure_rejects);
+    return TEST_RESULT();
+}
@@ -0,0 +1,258 @@
+/**
+ * @file test_plant_model.c
+ * @brief Plant model stepping: Euler integration, steady state and coefficient limits
+ */
+
+#include "test_common.h"
+#include "plant_model.h"
+#include "analog_simulation.h"
+#include "pwm_capture.h"
+#include "tim.h"
+#include <math.h>
+
+// Captured input, replaced by a settable snapshot
+static PWMCaptureSnapshot capture;
+static uint8_t capture_valid;
+
+uint8_t PWM_Capture_GetSnapshot(uint8_t channel, PWMCaptureSnapshot* snapshot) {
+    *snapshot = capture;
+    return capture_valid;
+}
+
+// Analog outputs, replaced by the last written fine codes
+static uint16_t output_fine[3][2];
+static uint32_t output_writes;
+
+uint8_t Analog_SetOutputFine(uint8_t light_index, uint8_t output, uint16_t fine_value) {
+    output_fine[light_index][output] = fine_value;
+    output_writes++;
+    return 1;
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Plant_Model_Init();
+    memset(&capture, 0, sizeof(capture));
+    memset(output_fine, 0, sizeof(output_fine));
+    capture_valid = 0;
+    output_writes = 0;
+}
+
+static void set_duty(uint16_t pulse_width, uint16_t period) {
+    capture.pulse_width = pulse_width;
+    capture.period = period;
+    capture.duty_cycle = period ? pulse_width * 100 / period : 0;
+    capture.capture_flags = 0;
+    capture_valid = 1;
+}
+
+static void run(uint32_t steps) {
+    for (uint32_t i = 0; i < steps; i++) {
+        Plant_Model_Tick(&htim4);
+    }
+}
+
+static uint8_t configure(uint8_t light, const PlantParams* params) {
+    return Plant_Model_Configure(light, (const uint8_t*)params, sizeof(*params));
+}
+
+static void test_euler_step(void) {
+    PlantState state;
+
+    setup();
+    set_duty(500, 1000);
+    CHECK_EQ(Plant_Model_Enable(0, 1), 1);
+
+    // Defaults: 5 A at half duty, 3 V * 70 % heat -> 10.5 W, 5 K/W -> 77.5 degC target
+    double target = 25.0 + 10.5 * 5.0;
+    double alpha = 1.0 / 5000.0;
+    double reference = 25.0;
+
+    for (int step = 1; step <= 20000; step++) {
+        run(1);
+        reference += (target - reference) * alpha;
+        if (step % 1000 == 0) {
+            CHECK_EQ(Plant_Model_GetState(0, &state), 1);
+            CHECK_NEAR(state.temperature, reference * 10.0, 1.0);
+        }
+    }
+
+    CHECK_EQ(state.steps, 20000);
+    CHECK_EQ(state.duty, 5000);
+    CHECK_EQ(state.current, 50);
+    CHECK_EQ(state.power_mw, 10500);
+
+    // After one time constant the step response reaches 1 - 1/e of the rise
+    setup();
+    set_duty(500, 1000);
+    Plant_Model_Enable(0, 1);
+    run(5000);
+    Plant_Model_GetState(0, &state);
+    CHECK_NEAR(state.temperature / 10.0, 25.0 + (target - 25.0) * (1.0 - exp(-1.0)), 0.15);
+}
+
+static void test_steady_state(void) {
+    const PlantParams params = {
+        .current_gain = 200,          // 20 A at full duty
+        .forward_voltage = 2500,
+        .heat_fraction = 600,
+        .ambient = 400,               // 40 degC
+        .thermal_resistance = 150,    // 1.5 K/W
+        .time_constant = 200,
+    };
+    PlantState state;
+
+    setup();
+    CHECK_EQ(configure(1, &params), 1);
+    set_duty(750, 1000);
+    CHECK_EQ(Plant_Model_Enable(1, 1), 1);
+    run(10 * 200);
+
+    // 15 A, 2.5 V * 60 % -> 22.5 W, ambient + P * Rth = 73.75 degC
+    CHECK_EQ(Plant_Model_GetState(1, &state), 1);
+    CHECK_EQ(state.current, 150);
+    CHECK_EQ(state.power_mw, 22500);
+    CHECK_NEAR(state.temperature, 737.5, 0.6);
+
+    // Outputs carry the same state in fine steps of the full scale
+    CHECK_NEAR(output_fine[1][ANALOG_OUTPUT_CURRENT], 150.0 * ANALOG_FINE_MAX / ANALOG_CURRENT_FULL_SCALE, 1.0);
+    CHECK_NEAR(output_fine[1][ANALOG_OUTPUT_TEMPERATURE], 73.75 * ANALOG_FINE_MAX / ANALOG_TEMPERATURE_FULL_SCALE, 2.0);
+
+    // Back to ambient with the input off
+    set_duty(0, 1000);
+    run(20 * 200);
+    Plant_Model_GetState(1, &state);
+    CHECK_EQ(state.power_mw, 0);
+    CHECK_NEAR(state.temperature, 400, 0.6);
+}
+
+static void test_alpha_clamp(void) {
+    PlantParams params = {
+        .current_gain = 100,
+        .forward_voltage = 1000,
+        .heat_fraction = 1000,
+        .ambient = 200,
+        .thermal_resistance = 1000,   // 10 K/W
+        .time_constant = 1,           // Equal to the step: alpha reaches its limit of 1
+    };
+    PlantState state;
+
+    setup();
+    CHECK_EQ(configure(0, &params), 1);
+    set_duty(1000, 1000);
+    Plant_Model_Enable(0, 1);
+
+    // 10 A * 1 V -> 10 W, 100 K above ambient in one step and no overshoot after it
+    for (int i = 0; i < 5; i++) {
+        run(1);
+        Plant_Model_GetState(0, &state);
+        CHECK_EQ(state.temperature, 1200);
+    }
+
+    params.time_constant = 0;
+    CHECK_EQ(configure(0, &params), 0);
+}
+
+static void test_output_limits(void) {
+    const PlantParams params = {
+        .current_gain = ANALOG_CURRENT_FULL_SCALE,
+        .forward_voltage = 5000,
+        .heat_fraction = 1000,
+        .ambient = 3000,
+        .thermal_resistance = 2000,
+        .time_constant = 1,
+    };
+    PlantState state;
+
+    setup();
+    CHECK_EQ(configure(2, &params), 1);
+    set_duty(1000, 1000);
+    Plant_Model_Enable(2, 1);
+    run(3);
+
+    // The model runs past the output range, the outputs stop at full scale
+    Plant_Model_GetState(2, &state);
+    CHECK(state.temperature > ANALOG_TEMPERATURE_FULL_SCALE * 10);
+    CHECK_EQ(output_fine[2][ANALOG_OUTPUT_CURRENT], ANALOG_FINE_MAX);
+    CHECK_EQ(output_fine[2][ANALOG_OUTPUT_TEMPERATURE], ANALOG_FINE_MAX);
+}
+
+static void test_duty_sources(void) {
+    PlantState state;
+
+    setup();
+    Plant_Model_Enable(0, 1);
+
+    // No capture yet: no drive
+    run(1);
+    Plant_Model_GetState(0, &state);
+    CHECK_EQ(state.duty, 0);
+
+    // Pulse width over period keeps the sub-percent resolution
+    set_duty(1234, 4000);
+    run(1);
+    Plant_Model_GetState(0, &state);
+    CHECK_EQ(state.duty, 3085);
+
+    // A static line only carries the percent duty field
+    capture.capture_flags = PWM_CAPTURE_FLAG_STATIC | PWM_CAPTURE_FLAG_LEVEL_HIGH;
+    capture.duty_cycle = 100;
+    run(1);
+    Plant_Model_GetState(0, &state);
+    CHECK_EQ(state.duty, 10000);
+}
+
+static void test_configure_and_enable(void) {
+    PlantParams params = {100, 3000, 700, 250, 500, 5000};
+    PlantState state;
+
+    setup();
+    CHECK_EQ(Plant_Model_Configure(0, (const uint8_t*)&params, sizeof(params) - 1), 0);
+    CHECK_EQ(Plant_Model_Configure(3, (const uint8_t*)&params, sizeof(params)), 0);
+    CHECK_EQ(Plant_Model_Configure(0, NULL, sizeof(params)), 0);
+    params.current_gain = ANALOG_CURRENT_FULL_SCALE + 1;
+    CHECK_EQ(configure(0, &params), 0);
+    params.current_gain = 100;
+    params.heat_fraction = 1001;
+    CHECK_EQ(configure(0, &params), 0);
+    params.heat_fraction = 700;
+    params.ambient = ANALOG_TEMPERATURE_FULL_SCALE * 10 + 1;
+    CHECK_EQ(configure(0, &params), 0);
+
+    // The shared TIM4 tick runs while any model is enabled
+    CHECK_EQ(Plant_Model_Enable(0, 2), 0);
+    CHECK_EQ(Plant_Model_Enable(0, 1), 1);
+    CHECK_EQ(Plant_Model_Enable(2, 1), 1);
+    CHECK(TIM4->CR1 & TIM_CR1_CEN);
+    CHECK_EQ(Plant_Model_Enable(0, 0), 1);
+    CHECK(TIM4->CR1 & TIM_CR1_CEN);
+    CHECK_EQ(Plant_Model_Enable(2, 0), 1);
+    CHECK_EQ(TIM4->CR1 & TIM_CR1_CEN, 0);
+
+    // Other timers and disabled lights do not step the model
+    Plant_Model_Tick(&htim5);
+    run(1);
+    CHECK_EQ(output_writes, 0);
+    Plant_Model_GetState(0, &state);
+    CHECK_EQ(state.steps, 0);
+
+    // Re-enabling restarts from ambient
+    set_duty(1000, 1000);
+    Plant_Model_Enable(0, 1);
+    run(100);
+    Plant_Model_Enable(0, 0);
+    Plant_Model_Enable(0, 1);
+    Plant_Model_GetState(0, &state);
+    CHECK_EQ(state.temperature, 250);
+    CHECK_EQ(state.steps, 0);
+}
+
+int main(void) {
+    RUN_TEST(test_euler_step);
+    RUN_TEST(test_steady_state);
+    RUN_TEST(test_alpha_clamp);
+    RUN_TEST(test_output_limits);
+    RUN_TEST(test_duty_sources);
+    RUN_TEST(test_configure_and_enable);
+    return TEST_RESULT();
+}
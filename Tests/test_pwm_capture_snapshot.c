@@ -0,0 +1,151 @@
+/**
+ * @file test_pwm_capture_snapshot.c
+ * @brief Consistency of capture snapshots read while the capture interrupt publishes
+ *
+ * Channel 0 is driven with a fixed period and a high time that changes
+ * every cycle, so every field of a published record is a function of the
+ * cycle it belongs to. A snapshot mixing two publications breaks that
+ * relation.
+ */
+
+#include "test_common.h"
+#include "pwm_capture.h"
+#include "capture_sim.h"
+#include <pthread.h>
+
+#define TICK_CLOCKS     84U       // Default range, 0.5 us ticks
+#define PERIOD_TICKS    1000U
+#define HIGH_TICKS      100U
+#define HIGH_STEPS      8U
+#define STRESS_CYCLES   200000U
+
+static volatile int producer_done;
+static uint32_t inconsistent;
+
+/**
+ * @brief Check one snapshot against the cycle its timestamp names
+ * The first cycle only sets the period reference, so cycle k is publication k.
+ */
+static uint8_t snapshot_consistent(const PWMCaptureSnapshot* snap) {
+    uint32_t cycle = snap->rise_time / PERIOD_TICKS;
+    uint32_t pulse = HIGH_TICKS * (1 + cycle % HIGH_STEPS);
+
+    return snap->rise_time % PERIOD_TICKS == 0 &&
+           snap->sequence == cycle &&
+           snap->period == PERIOD_TICKS &&
+           snap->pulse_width == pulse &&
+           snap->duty_cycle == pulse * 100 / PERIOD_TICKS &&
+           snap->capture_flags == 0;
+}
+
+static void setup(void) {
+    Capture_Sim_Init();
+    Capture_Sim_SetSignal(0, PERIOD_TICKS * TICK_CLOCKS, HIGH_TICKS * TICK_CLOCKS, 0);
+    Capture_Sim_SetHighPattern(0, HIGH_TICKS * TICK_CLOCKS, HIGH_STEPS);
+    inconsistent = 0;
+}
+
+static void test_sequential(void) {
+    PWMCaptureSnapshot snap;
+
+    setup();
+    CHECK_EQ(PWM_Capture_GetSnapshot(0, &snap), 0);
+    CHECK_EQ(PWM_Capture_GetSnapshot(PWM_CAPTURE_CHANNELS, &snap), 0);
+
+    for (uint32_t i = 0; i < 50; i++) {
+        Capture_Sim_Run(PERIOD_TICKS * TICK_CLOCKS);
+        if (PWM_Capture_GetSnapshot(0, &snap) && !snapshot_consistent(&snap)) {
+            inconsistent++;
+        }
+    }
+    CHECK_EQ(inconsistent, 0);
+    CHECK(snap.sequence >= 48);
+}
+
+static uint32_t hook_calls;
+
+/**
+ * @brief Capture interrupt taken at every third reader barrier
+ */
+static void preempt_reader(void) {
+    if (++hook_calls % 3 == 0) {
+        Capture_Sim_Run(PERIOD_TICKS * TICK_CLOCKS);
+    }
+}
+
+static void test_preempted_at_barriers(void) {
+    PWMCaptureSnapshot snap;
+    uint32_t consumed = 0;
+    uint32_t last_sequence = 0;
+
+    setup();
+    Capture_Sim_Run(3 * PERIOD_TICKS * TICK_CLOCKS);
+
+    // Publications land between the sequence read and its recheck, forcing retries
+    hook_calls = 0;
+    stub_barrier_hook = preempt_reader;
+    for (uint32_t i = 0; i < 1000; i++) {
+        if (PWM_Capture_ConsumeSnapshot(0, &snap)) {
+            if (!snapshot_consistent(&snap) || snap.sequence <= last_sequence) {
+                inconsistent++;
+            }
+            last_sequence = snap.sequence;
+            consumed++;
+        }
+    }
+    stub_barrier_hook = NULL;
+
+    CHECK_EQ(inconsistent, 0);
+    CHECK(consumed > 100);
+
+    // Nothing new without another capture
+    CHECK_EQ(PWM_Capture_ConsumeSnapshot(0, &snap), 0);
+}
+
+static void* producer(void* arg) {
+    for (uint32_t i = 0; i < STRESS_CYCLES; i++) {
+        Capture_Sim_Run(PERIOD_TICKS * TICK_CLOCKS);
+    }
+    producer_done = 1;
+    return NULL;
+}
+
+static void test_concurrent_producer(void) {
+    PWMCaptureSnapshot snap;
+    pthread_t thread;
+    uint32_t reads = 0;
+    uint32_t distinct = 0;
+    uint32_t last_sequence = 0;
+
+    setup();
+    producer_done = 0;
+    CHECK_EQ(pthread_create(&thread, NULL, producer, NULL), 0);
+
+    // The producer thread stands in for the capture interrupt preempting the main loop
+    while (!producer_done) {
+        if (!PWM_Capture_GetSnapshot(0, &snap)) {
+            continue;
+        }
+        reads++;
+        if (!snapshot_consistent(&snap) || snap.sequence < last_sequence) {
+            inconsistent++;
+        }
+        if (snap.sequence != last_sequence) {
+            distinct++;
+            last_sequence = snap.sequence;
+        }
+    }
+    pthread_join(thread, NULL);
+
+    CHECK_EQ(inconsistent, 0);
+    CHECK(reads > 0);
+    CHECK(distinct > 0);
+    printf("  %u snapshots, %u distinct publications\n", (unsigned)reads, (unsigned)distinct);
+}
+
+int main(void) {
+    RUN_TEST(test_sequential);
+    RUN_TEST(test_preempted_at_barriers);
+    RUN_TEST(test_concurrent_producer);
+    return TEST_RESULT();
+}
@@ -0,0 +1,155 @@
+/**
+ * @file test_pwm_capture_sweep.c
+ * @brief Auto-ranging of the PWM capture over a simulated frequency sweep
+ */
+
+#include "test_common.h"
+#include "pwm_capture.h"
+#include "capture_sim.h"
+
+#define CLOCKS_PER_MS  (CAPTURE_SIM_CLOCK_HZ / 1000)
+
+// TIM1 clocks per capture tick of each range (prescaler + 1)
+static const uint32_t range_div[PWM_RANGE_COUNT] = {840, 84, 8, 1};
+
+typedef struct {
+    uint32_t frequency_hz;
+    uint8_t  range;           // Range auto-ranging settles in
+    uint8_t  icpsc_shift;     // Input capture prescaler it selects
+} SweepPoint;
+
+// Each point lies well inside its band, so the result does not depend on the direction
+static const SweepPoint sweep[] = {
+    {30, 0, 0},
+    {1000, 1, 0},
+    {5000, 2, 0},
+    {50000, 3, 0},
+    {200000, 3, 2},
+    {1000000, 3, 3},
+};
+#define SWEEP_POINTS  (sizeof(sweep) / sizeof(sweep[0]))
+
+/**
+ * @brief Drive channel 0 at a frequency and let auto-ranging settle
+ * @param frequency_hz Signal frequency
+ * @param duty_percent High time in percent of the period
+ */
+static void drive(uint32_t frequency_hz, uint32_t duty_percent) {
+    uint64_t period = CAPTURE_SIM_CLOCK_HZ / frequency_hz;
+
+    Capture_Sim_SetSignal(0, period, period * duty_percent / 100, 0);
+
+    // Every switch takes a few overflows of the range it leaves; 50 ms overflows are the slowest
+    Capture_Sim_Run(1500 * CLOCKS_PER_MS);
+}
+
+/**
+ * @brief Check the settled range and the period measured in it
+ */
+static void check_point(const SweepPoint* point) {
+    PWMCaptureSnapshot snap;
+    uint16_t range = PWM_Capture_GetRange(0);
+    double expected = (double)(CAPTURE_SIM_CLOCK_HZ / point->frequency_hz) / range_div[point->range];
+
+    CHECK_EQ(range & 0xFF, point->range);
+    CHECK_EQ(range >> 8, point->icpsc_shift);
+    CHECK_EQ(PWM_Capture_GetSnapshot(0, &snap), 1);
+    CHECK_EQ(snap.capture_flags & PWM_CAPTURE_FLAG_STATIC, 0);
+    CHECK_NEAR(snap.period, expected, 1.0);
+    if (point->icpsc_shift == 0) {
+        CHECK_EQ(snap.capture_flags, 0);
+        CHECK_NEAR(snap.duty_cycle, 25, 1);
+    } else {
+        CHECK_EQ(snap.capture_flags, PWM_CAPTURE_FLAG_PERIOD_ONLY);
+    }
+}
+
+static void test_sweep_up(void) {
+    Capture_Sim_Init();
+    CHECK_EQ(PWM_Capture_SetAutoRange(1), 1);
+
+    for (uint32_t i = 0; i < SWEEP_POINTS; i++) {
+        drive(sweep[i].frequency_hz, 25);
+        check_point(&sweep[i]);
+    }
+}
+
+static void test_sweep_down(void) {
+    Capture_Sim_Init();
+    CHECK_EQ(PWM_Capture_SetAutoRange(1), 1);
+
+    for (uint32_t i = SWEEP_POINTS; i-- > 0;) {
+        drive(sweep[i].frequency_hz, 25);
+        check_point(&sweep[i]);
+    }
+}
+
+static void test_hysteresis(void) {
+    Capture_Sim_Init();
+    CHECK_EQ(PWM_Capture_SetAutoRange(1), 1);
+
+    // 70 % of the range 1 wrap: too slow to switch up from range 0, fast enough to stay in range 1
+    uint32_t between = (uint32_t)(CAPTURE_SIM_CLOCK_HZ / (10000ULL * range_div[1] * 70 / 100));
+
+    drive(30, 50);
+    CHECK_EQ(PWM_Capture_GetRange(0), 0);
+    drive(between, 50);
+    CHECK_EQ(PWM_Capture_GetRange(0), 0);
+
+    drive(1000, 50);
+    CHECK_EQ(PWM_Capture_GetRange(0), 1);
+    uint32_t switches = Capture_Sim_RangeSwitches();
+    drive(between, 50);
+    CHECK_EQ(PWM_Capture_GetRange(0), 1);
+
+    // A band edge crossed once switches once
+    CHECK_EQ(Capture_Sim_RangeSwitches(), switches);
+}
+
+static void test_disable_returns_to_default(void) {
+    Capture_Sim_Init();
+    CHECK_EQ(PWM_Capture_SetAutoRange(1), 1);
+    drive(1000000, 50);
+    CHECK_EQ(PWM_Capture_GetRange(0) & 0xFF, 3);
+
+    CHECK_EQ(PWM_Capture_SetAutoRange(0), 1);
+    CHECK_EQ(PWM_Capture_GetRange(0), PWM_RANGE_DEFAULT);
+    CHECK_EQ(PWM_Capture_SetAutoRange(2), 0);
+
+    // Fixed range: 1 kHz is measured in 0.5 us ticks
+    PWMCaptureSnapshot snap;
+    drive(1000, 50);
+    CHECK_EQ(PWM_Capture_GetRange(0), PWM_RANGE_DEFAULT);
+    CHECK_EQ(PWM_Capture_GetSnapshot(0, &snap), 1);
+    CHECK_EQ(snap.period, 2000);
+    CHECK_EQ(snap.pulse_width, 1000);
+    CHECK_EQ(snap.duty_cycle, 50);
+}
+
+static void test_period_longer_than_wrap(void) {
+    PWMCaptureSnapshot snap;
+
+    Capture_Sim_Init();
+
+    // 150 Hz in the fixed default range spans 2.7 counter wraps, the pulse 2
+    drive(150, 75);
+    CHECK_EQ(PWM_Capture_GetSnapshot(0, &snap), 1);
+    CHECK_EQ(snap.capture_flags, 0);
+    CHECK_NEAR(snap.period, 13333, 1.0);
+    CHECK_NEAR(snap.pulse_width, 10000, 1.0);
+    CHECK_EQ(snap.duty_cycle, 75);
+
+    // Beyond the 16-bit fields the period saturates
+    drive(30, 50);
+    CHECK_EQ(PWM_Capture_GetSnapshot(0, &snap), 1);
+    CHECK_EQ(snap.period, 0xFFFF);
+}
+
+int main(void) {
+    RUN_TEST(test_sweep_up);
+    RUN_TEST(test_sweep_down);
+    RUN_TEST(test_hysteresis);
+    RUN_TEST(test_disable_returns_to_default);
+    RUN_TEST(test_period_longer_than_wrap);
+    return TEST_RESULT();
+}
@@ -0,0 +1,257 @@
+/**
+ * @file test_pwm_history.c
+ * @brief Round trip of the capture history bulk format through a host decoder
+ */
+
+#include "test_common.h"
+#include "pwm_history.h"
+#include "pwm_capture.h"
+#include "hil_stub.h"
+
+// Capture timer tick per range in 168 MHz TIM1 clocks (prescaler + 1)
+static const uint32_t range_tick_clocks[PWM_RANGE_COUNT] = {840, 84, 8, 1};
+
+typedef struct {
+    uint8_t  range;
+    uint16_t period;
+    uint16_t pulse_width;
+    uint64_t rise_clocks;     // Rising edge reconstructed by summing periods
+} DecodedCycle;
+
+static DecodedCycle decoded[PWM_HISTORY_DEPTH];
+static uint16_t decoded_count;
+static uint16_t decoded_dropped;
+
+static DecodedCycle expected[4 * PWM_HISTORY_DEPTH];
+static uint32_t expected_count;
+static uint8_t expected_range;
+static uint64_t expected_time;
+
+/**
+ * @brief Decode a history download the way the host tool does
+ * @param initial_range Range of the entries before the first marker
+ * @return Number of decoded cycles (markers excluded), or -1 if malformed
+ */
+static int decode(uint8_t initial_range) {
+    PWMHistoryHeader header;
+    uint8_t range = initial_range;
+    uint64_t time = 0;
+
+    if (stub_bulk_length < sizeof(header)) {
+        return -1;
+    }
+    memcpy(&header, stub_bulk, sizeof(header));
+    if (stub_bulk_length != sizeof(header) + header.count * sizeof(PWMHistoryEntry) ||
+        stub_bulk_announced != stub_bulk_length) {
+        return -1;
+    }
+
+    decoded_count = 0;
+    decoded_dropped = header.dropped;
+    for (uint16_t i = 0; i < header.count; i++) {
+        PWMHistoryEntry entry;
+        memcpy(&entry, &stub_bulk[sizeof(header) + i * sizeof(entry)], sizeof(entry));
+
+        if (entry.period == 0) {
+            // Range marker: later periods are in the ticks of the new range
+            range = (uint8_t)entry.pulse_width;
+            continue;
+        }
+
+        decoded[decoded_count].range = range;
+        decoded[decoded_count].period = entry.period;
+        decoded[decoded_count].pulse_width = entry.pulse_width;
+        decoded[decoded_count].rise_clocks = time;
+        decoded_count++;
+        time += (uint64_t)entry.period * range_tick_clocks[range];
+    }
+
+    return decoded_count;
+}
+
+static void expect_reset(uint8_t range) {
+    expected_count = 0;
+    expected_range = range;
+    expected_time = 0;
+}
+
+static void record_capture(uint8_t channel, uint16_t pulse_width, uint16_t period) {
+    PWM_History_Add(channel, pulse_width, period);
+    expected[expected_count].range = expected_range;
+    expected[expected_count].period = period;
+    expected[expected_count].pulse_width = pulse_width;
+    expected[expected_count].rise_clocks = expected_time;
+    expected_count++;
+    expected_time += (uint64_t)period * range_tick_clocks[expected_range];
+}
+
+static void record_range(uint8_t channel, uint8_t range) {
+    PWM_History_AddRangeMarker(channel, range);
+    expected_range = range;
+}
+
+/**
+ * @brief Check the decoded cycles against the last 'count' recorded ones
+ */
+static void check_tail(uint32_t count) {
+    CHECK_EQ(decoded_count, count);
+    if (decoded_count != count) {
+        return;
+    }
+
+    uint32_t first = expected_count - count;
+    uint64_t base = expected[first].rise_clocks;
+    for (uint32_t i = 0; i < count; i++) {
+        const DecodedCycle* e = &expected[first + i];
+        if (decoded[i].range != e->range || decoded[i].period != e->period ||
+            decoded[i].pulse_width != e->pulse_width || decoded[i].rise_clocks != e->rise_clocks - base) {
+            printf("cycle %u differs\n", (unsigned)i);
+            test_failures++;
+            return;
+        }
+    }
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Stub_HIL_Reset();
+    PWM_History_Init();
+}
+
+static void test_round_trip_with_range_change(void) {
+    setup();
+    expect_reset(1);
+
+    for (int i = 0; i < 10; i++) {
+        record_capture(0, 100 + i, 1000 + i);
+    }
+    record_range(0, 2);
+    for (int i = 0; i < 5; i++) {
+        record_capture(0, 20 + i, 125);
+    }
+
+    CHECK_EQ(PWM_History_Send(0, NULL), 1);
+    CHECK_EQ(decode(1), 15);
+    CHECK_EQ(decoded_dropped, 0);
+    check_tail(15);
+
+    // Rising edges of the second range are scaled by its own tick
+    CHECK_EQ(decoded[11].rise_clocks - decoded[10].rise_clocks, 125 * range_tick_clocks[2]);
+}
+
+static void test_channels_are_independent(void) {
+    setup();
+    PWM_History_Add(0, 1, 2);
+    PWM_History_Add(2, 3, 4);
+    PWM_History_Add(2, 5, 6);
+
+    CHECK_EQ(PWM_History_Send(1, NULL), 1);
+    CHECK_EQ(decode(PWM_RANGE_DEFAULT), 0);
+    CHECK_EQ(PWM_History_Send(2, NULL), 1);
+    CHECK_EQ(decode(PWM_RANGE_DEFAULT), 2);
+    CHECK_EQ(decoded[1].pulse_width, 5);
+    CHECK_EQ(PWM_History_Send(PWM_CAPTURE_CHANNELS, NULL), 0);
+}
+
+static void test_wrap_keeps_newest_entries(void) {
+    setup();
+    expect_reset(0);
+
+    // Markers occupy slots too; the oldest slots are overwritten in order
+    uint32_t slots = 0;
+    for (int i = 0; i < PWM_HISTORY_DEPTH + 300; i++) {
+        if (i % 97 == 0) {
+            record_range(0, (uint8_t)((i / 97) % PWM_RANGE_COUNT));
+            slots++;
+        }
+        record_capture(0, (uint16_t)(i & 0x3FF), (uint16_t)(1024 + (i & 0xFF)));
+        slots++;
+    }
+
+    // The marker just before the retained window sets its starting range
+    uint32_t first_slot = slots - PWM_HISTORY_DEPTH;
+    uint32_t slot = 0;
+    uint32_t dropped_captures = 0;
+    uint8_t initial_range = 0;
+    for (int i = 0; i < PWM_HISTORY_DEPTH + 300 && slot < first_slot; i++) {
+        if (i % 97 == 0) {
+            initial_range = (uint8_t)((i / 97) % PWM_RANGE_COUNT);
+            if (++slot == first_slot) {
+                break;
+            }
+        }
+        dropped_captures++;
+        slot++;
+    }
+
+    CHECK_EQ(PWM_History_Send(0, NULL), 1);
+    int count = decode(initial_range);
+    CHECK_EQ(count, (int)(expected_count - dropped_captures));
+    check_tail(expected_count - dropped_captures);
+}
+
+static int freeze_writes;
+
+static void capture_during_download(void) {
+    // Runs once per bulk write: captures and a range change arrive while frozen
+    if (freeze_writes++ == 1) {
+        PWM_History_Add(0, 1, 2);
+        PWM_History_Add(0, 3, 4);
+        PWM_History_AddRangeMarker(0, 3);
+        PWM_History_Add(0, 5, 6);
+    }
+}
+
+static void test_frozen_download(void) {
+    setup();
+    expect_reset(1);
+    for (int i = 0; i < 4; i++) {
+        record_capture(0, 10, 100);
+    }
+
+    freeze_writes = 0;
+    stub_bulk_write_hook = capture_during_download;
+    CHECK_EQ(PWM_History_Send(0, NULL), 1);
+    stub_bulk_write_hook = NULL;
+
+    // The download is the state at the freeze, the late captures are counted
+    CHECK_EQ(decode(1), 4);
+    CHECK_EQ(decoded_dropped, 0);
+    check_tail(4);
+
+    // The held back marker precedes the first capture after the download
+    expected_range = 3;
+    record_capture(0, 7, 8);
+    CHECK_EQ(PWM_History_Send(0, NULL), 1);
+    CHECK_EQ(decode(1), 5);
+    CHECK_EQ(decoded_dropped, 3);
+    CHECK_EQ(decoded[4].range, 3);
+    CHECK_EQ(decoded[4].period, 8);
+    check_tail(5);
+
+    // The drop counter restarts with every download
+    CHECK_EQ(PWM_History_Send(0, NULL), 1);
+    CHECK_EQ(decode(1), 5);
+    CHECK_EQ(decoded_dropped, 0);
+}
+
+static void test_clear(void) {
+    setup();
+    PWM_History_Add(1, 10, 100);
+    PWM_History_AddRangeMarker(1, 2);
+    CHECK_EQ(PWM_History_Clear(1), 1);
+    CHECK_EQ(PWM_History_Clear(PWM_CAPTURE_CHANNELS), 0);
+
+    CHECK_EQ(PWM_History_Send(1, NULL), 1);
+    CHECK_EQ(decode(PWM_RANGE_DEFAULT), 0);
+    CHECK_EQ(stub_bulk_length, sizeof(PWMHistoryHeader));
+}
+
+int main(void) {
+    RUN_TEST(test_round_trip_with_range_change);
+    RUN_TEST(test_channels_are_independent);
+    RUN_TEST(test_wrap_keeps_newest_entries);
+    RUN_TEST(test_frozen_download);
+    RUN_TEST(test_clear);
+    return TEST_RESULT();
+}
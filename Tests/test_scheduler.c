@@ -0,0 +1,297 @@
+/**
+ * @file test_scheduler.c
+ * @brief Scheduler in virtual time: base-rate selection, release order and overrun accounting
+ *
+ * Time advances in steps of one microsecond. TIM14 counts at its 1 MHz
+ * timer clock and runs Scheduler_IRQHandler on each update while the
+ * update interrupt is enabled; DWT->CYCCNT follows at 168 cycles per
+ * microsecond. Tasks spend virtual time, so releases that fall inside a
+ * task arrive as they would on the target. The main loop runs
+ * Scheduler_Run whenever the scheduler event is pending.
+ */
+
+#include "test_common.h"
+#include "scheduler.h"
+#include "event_loop.h"
+#include "tim.h"
+
+#define CYCLES_PER_US  168
+
+static uint32_t now_us;
+static uint32_t interrupts;
+static uint32_t signalled;
+
+// Task runs in order, as task ids
+static uint8_t run_log[64];
+static uint32_t run_count;
+
+// Virtual time each task takes per run
+static uint32_t task_us[SCHEDULER_MAX_TASKS];
+
+void Event_Loop_Signal(uint32_t events) {
+    signalled |= events;
+}
+
+/**
+ * @brief Advance virtual time, TIM14 updates run the scheduler interrupt
+ */
+static void advance(uint32_t us) {
+    for (uint32_t i = 0; i < us; i++) {
+        now_us++;
+        DWT->CYCCNT += CYCLES_PER_US;
+        if (!(TIM14->CR1 & TIM_CR1_CEN)) {
+            continue;
+        }
+        if (TIM14->CNT++ >= TIM14->ARR) {
+            TIM14->CNT = 0;
+            TIM14->SR |= TIM_SR_UIF;
+            if (TIM14->DIER & TIM_IT_UPDATE) {
+                interrupts++;
+                Scheduler_IRQHandler();
+            }
+        }
+    }
+}
+
+static void task_run(uint8_t id) {
+    if (run_count < sizeof(run_log)) {
+        run_log[run_count] = id;
+    }
+    run_count++;
+    advance(task_us[id]);
+}
+
+static void task0(void) { task_run(0); }
+static void task1(void) { task_run(1); }
+static void task2(void) { task_run(2); }
+static void task3(void) { task_run(3); }
+
+/**
+ * @brief The main loop: run the released slots when signalled, else let a microsecond pass
+ * Releases due at time_us still run.
+ */
+static void run_until(uint32_t time_us) {
+    for (;;) {
+        if ((signalled & EVENT_LOOP_SCHEDULER) && (int32_t)(now_us - time_us) <= 0) {
+            signalled = 0;
+            Scheduler_Run();
+        } else if ((int32_t)(now_us - time_us) < 0) {
+            advance(1);
+        } else {
+            return;
+        }
+    }
+}
+
+static SchedulerStatus status(void) {
+    SchedulerStatus s;
+
+    Scheduler_GetStatus(&s);
+    return s;
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    htim14.Init.Prescaler = 83;
+    htim14.Init.Period = 99;
+    Scheduler_Init();
+    now_us = 0;
+    interrupts = 0;
+    signalled = 0;
+    run_count = 0;
+    memset(task_us, 0, sizeof(task_us));
+}
+
+static void test_base_rate_selection(void) {
+    static const struct {
+        uint8_t slots;            // Bit per slot with a task
+        uint32_t arr;
+        uint32_t interrupts;      // In one second
+    } cases[] = {
+        {0x07, 99, 10000},
+        {0x06, 999, 1000},
+        {0x04, 9999, 100},
+        {0x05, 99, 10000},
+        {0x02, 999, 1000},
+    };
+    static const uint32_t rates[SCHEDULER_SLOTS] = {10000, 1000, 100};
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        SchedulerStatus s;
+
+        setup();
+        for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+            if (cases[i].slots & (1 << slot)) {
+                CHECK_EQ(Scheduler_AddTask(slot, task0), 1);
+            }
+        }
+        Scheduler_Start();
+
+        // The timer ticks at the fastest slot in use, the others count down from it
+        CHECK_EQ(TIM14->ARR, cases[i].arr);
+        run_until(1000000);
+        s = status();
+        CHECK_EQ(interrupts, cases[i].interrupts);
+        for (uint8_t slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+            CHECK_EQ(s.releases[slot], (cases[i].slots & (1 << slot)) ? rates[slot] : 0);
+            CHECK_EQ(s.overruns[slot], 0);
+        }
+        CHECK_EQ(s.task[0].runs, s.releases[s.task[0].slot]);
+    }
+
+    // Without tasks the timer stays off
+    setup();
+    Scheduler_Start();
+    CHECK_EQ(TIM14->CR1 & TIM_CR1_CEN, 0);
+    run_until(10000);
+    CHECK_EQ(interrupts, 0);
+}
+
+static void test_release_order(void) {
+    setup();
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_100HZ, task0), 1);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task1), 1);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_10KHZ, task2), 1);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task3), 1);
+    Scheduler_Start();
+
+    // Up to just before the first 1 kHz release: only the 10 kHz slot
+    run_until(999);
+    CHECK_EQ(run_count, 9);
+    for (uint32_t i = 0; i < 9; i++) {
+        CHECK_EQ(run_log[i], 2);
+    }
+
+    // A common release runs the faster slot first, a slot's tasks in the order added
+    run_until(1000);
+    CHECK_EQ(run_count, 12);
+    CHECK_EQ(run_log[9], 2);
+    CHECK_EQ(run_log[10], 1);
+    CHECK_EQ(run_log[11], 3);
+
+    run_count = 0;
+    run_until(9999);
+    run_count = 0;
+    run_until(10000);
+    CHECK_EQ(run_count, 4);
+    CHECK_EQ(run_log[0], 2);
+    CHECK_EQ(run_log[1], 1);
+    CHECK_EQ(run_log[2], 3);
+    CHECK_EQ(run_log[3], 0);
+}
+
+static void test_overrun_accounting(void) {
+    SchedulerStatus s;
+
+    // A 1 kHz task taking 2.5 ms: each run finds two or three releases
+    // waiting, runs once for the latest and counts the others as overruns
+    setup();
+    task_us[0] = 2500;
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task0), 1);
+    Scheduler_Start();
+    run_until(1000000);
+    s = status();
+    CHECK_EQ(s.task[0].runs, 400);
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_1KHZ], 998 - 400);
+
+    // The last run, from 998.5 ms, leaves its three releases waiting
+    CHECK_EQ(s.releases[SCHEDULER_SLOT_1KHZ], 1001);
+
+    // A long 100 Hz task holds the 10 kHz slot back: of the three releases
+    // during its 350 us, the last one runs, the other two are overruns
+    setup();
+    task_us[0] = 10;
+    task_us[1] = 350;
+    task_us[2] = 10;
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_10KHZ, task0), 1);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_100HZ, task1), 1);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task2), 1);
+    Scheduler_Start();
+    run_until(1000000 - 1);
+    s = status();
+    CHECK_EQ(s.releases[SCHEDULER_SLOT_10KHZ], 9999);
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_10KHZ], 99 * 2);
+    CHECK_EQ(s.task[0].runs, 9999 - 99 * 2);
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_1KHZ], 0);
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_100HZ], 0);
+    CHECK_EQ(s.task[1].runs, 99);
+    CHECK_EQ(s.task[2].runs, 999);
+
+    // A stalled main loop does not catch up in a burst
+    setup();
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task0), 1);
+    Scheduler_Start();
+    advance(5000);
+    run_until(5001);
+    s = status();
+    CHECK_EQ(s.releases[SCHEDULER_SLOT_1KHZ], 5);
+    CHECK_EQ(s.task[0].runs, 1);
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_1KHZ], 4);
+
+    // Resetting the statistics keeps the release count that paces the slot
+    Scheduler_ResetStats();
+    s = status();
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_1KHZ], 0);
+    CHECK_EQ(s.task[0].runs, 0);
+    CHECK_EQ(s.releases[SCHEDULER_SLOT_1KHZ], 5);
+    run_until(6001);
+    s = status();
+    CHECK_EQ(s.task[0].runs, 1);
+    CHECK_EQ(s.overruns[SCHEDULER_SLOT_1KHZ], 0);
+}
+
+static void test_cycle_accounting(void) {
+    SchedulerStatus s;
+
+    setup();
+    task_us[0] = 50;
+    task_us[1] = 20;
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task0), 1);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, task1), 1);
+    Scheduler_Start();
+    run_until(10000);
+    task_us[1] = 80;
+    run_until(11000);
+    task_us[1] = 30;
+    run_until(12000);
+
+    s = status();
+    CHECK_EQ(s.tasks, 2);
+    CHECK_EQ(s.task[0].slot, SCHEDULER_SLOT_1KHZ);
+    CHECK_EQ(s.task[0].runs, 12);
+    CHECK_EQ(s.task[0].last_cycles, 50 * CYCLES_PER_US);
+    CHECK_EQ(s.task[0].max_cycles, 50 * CYCLES_PER_US);
+    CHECK_EQ(s.task[0].total_cycles, 12 * 50 * CYCLES_PER_US);
+    CHECK_EQ(s.task[1].last_cycles, 30 * CYCLES_PER_US);
+    CHECK_EQ(s.task[1].max_cycles, 80 * CYCLES_PER_US);
+    CHECK_EQ(s.task[1].total_cycles, (10 * 20 + 80 + 30) * CYCLES_PER_US);
+
+    Scheduler_GetStatus(NULL);
+}
+
+static void test_add_task_rejects(void) {
+    setup();
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOTS, task0), 0);
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_1KHZ, NULL), 0);
+    for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_100HZ, task0), 1);
+    }
+    CHECK_EQ(Scheduler_AddTask(SCHEDULER_SLOT_100HZ, task0), 0);
+    CHECK_EQ(status().tasks, SCHEDULER_MAX_TASKS);
+
+    // Init removes the tasks and stops the timer
+    Scheduler_Start();
+    CHECK(TIM14->CR1 & TIM_CR1_CEN);
+    Scheduler_Init();
+    CHECK_EQ(status().tasks, 0);
+    CHECK_EQ(TIM14->CR1 & TIM_CR1_CEN, 0);
+}
+
+int main(void) {
+    RUN_TEST(test_base_rate_selection);
+    RUN_TEST(test_release_order);
+    RUN_TEST(test_overrun_accounting);
+    RUN_TEST(test_cycle_accounting);
+    RUN_TEST(test_add_task_rejects);
+    return TEST_RESULT();
+}
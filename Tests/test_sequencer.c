@@ -0,0 +1,486 @@
+/**
+ * @file test_sequencer.c
+ * @brief Sequencer execution on an emulated TIM5: timestamps, lateness, forced compares and ownership
+ *
+ * TIM5 counts one microsecond per tick. Counting onto CCR1 sets CC1IF, as
+ * the compare match does, and a CC1G write sets it at once. A pending
+ * CC1IF calls the handler after the configured interrupt latency, and
+ * every output write by a step costs the configured time.
+ */
+
+#include "test_common.h"
+#include "sequencer.h"
+#include "analog_simulation.h"
+#include "hil_comm_protocol.h"
+#include "event_loop.h"
+#include "hil_stub.h"
+#include "tim.h"
+
+// Emulated timing
+static uint32_t irq_latency_us;
+static uint32_t write_cost_us;
+static uint32_t interrupts;
+static uint32_t loop_events;
+
+// Output writes in the order they happened
+typedef struct {
+    uint32_t time_us;
+    uint8_t  light;
+    uint8_t  output;
+    uint16_t value;
+} OutputWrite;
+
+static OutputWrite writes[64];
+static uint32_t write_count;
+
+// Ownership of the outputs
+static uint8_t plant_enabled[3];
+static uint8_t waveform_driving[3][2];
+static uint8_t ramping[3][2];
+
+// Sequencer staging set
+static uint16_t staged_values[3][2];
+static uint8_t staged_mask;
+static uint32_t discards;
+static uint32_t wrong_set;
+
+static void record(uint8_t light, uint8_t output, uint16_t value) {
+    if (write_count < sizeof(writes) / sizeof(writes[0])) {
+        writes[write_count] = (OutputWrite){TIM5->CNT, light, output, value};
+    }
+    write_count++;
+    TIM5->CNT += write_cost_us;
+}
+
+uint8_t Analog_SetCurrentSimulation(uint8_t light_index, uint16_t current_value) {
+    record(light_index, ANALOG_OUTPUT_CURRENT, current_value);
+    return 1;
+}
+
+uint8_t Analog_SetTemperatureSimulation(uint8_t light_index, uint16_t temperature_value) {
+    record(light_index, ANALOG_OUTPUT_TEMPERATURE, temperature_value);
+    return 1;
+}
+
+uint8_t Analog_StageSimulation(uint8_t set, uint8_t light_index, uint8_t output, uint16_t value) {
+    wrong_set += (set != ANALOG_STAGE_SEQUENCER);
+    staged_values[light_index][output] = value;
+    staged_mask |= 1 << (light_index * 2 + output);
+    return 1;
+}
+
+uint8_t Analog_GetStagedMask(uint8_t set) {
+    wrong_set += (set != ANALOG_STAGE_SEQUENCER);
+    return staged_mask;
+}
+
+void Analog_CommitStaged(uint8_t set) {
+    uint32_t start = TIM5->CNT;
+
+    wrong_set += (set != ANALOG_STAGE_SEQUENCER);
+    for (uint8_t i = 0; i < 6; i++) {
+        if (staged_mask & (1 << i)) {
+            record(i / 2, i % 2, staged_values[i / 2][i % 2]);
+        }
+    }
+    staged_mask = 0;
+
+    // One commit, one cost
+    TIM5->CNT = start + write_cost_us;
+}
+
+void Analog_DiscardStaged(uint8_t set) {
+    wrong_set += (set != ANALOG_STAGE_SEQUENCER);
+    staged_mask = 0;
+    discards++;
+}
+
+uint8_t Analog_IsRamping(uint8_t light_index, uint8_t output) {
+    return ramping[light_index][output];
+}
+
+uint8_t Plant_Model_IsEnabled(uint8_t light_index) {
+    return plant_enabled[light_index];
+}
+
+uint8_t Waveform_IsDriving(uint8_t light_index, uint8_t output) {
+    return waveform_driving[light_index][output];
+}
+
+void Capture_Trigger_NotifyCommand(void) {
+}
+
+void Event_Loop_Signal(uint32_t events) {
+    if (events & EVENT_LOOP_SEQUENCER) {
+        loop_events++;
+    }
+}
+
+/**
+ * @brief Run the CC1 interrupt for as long as it is pending
+ */
+static void service(void) {
+    for (;;) {
+        if (TIM5->EGR & TIM_EGR_CC1G) {
+            TIM5->EGR = 0;
+            TIM5->SR |= TIM_SR_CC1IF;
+        }
+        if (!((TIM5->DIER & TIM_IT_CC1) && (TIM5->SR & TIM_SR_CC1IF))) {
+            return;
+        }
+
+        // Entry latency: the counter runs on, a match in it only re-pends the flag
+        for (uint32_t i = 0; i < irq_latency_us; i++) {
+            TIM5->CNT++;
+        }
+        interrupts++;
+        Sequencer_IRQHandler();
+    }
+}
+
+/**
+ * @brief Count up to a time, serving the interrupt after every tick
+ */
+static void run_until(uint32_t time_us) {
+    while ((TIM5->CR1 & TIM_CR1_CEN) && TIM5->CNT < time_us) {
+        TIM5->CNT++;
+        if (TIM5->CNT == TIM5->CCR1) {
+            TIM5->SR |= TIM_SR_CC1IF;
+        }
+        service();
+    }
+}
+
+static uint8_t start(void) {
+    uint8_t started = Sequencer_Start();
+
+    service();
+    return started;
+}
+
+static uint8_t load(const SequencerStep* s, uint16_t count, uint16_t length, uint16_t offset) {
+    uint8_t payload[sizeof(SequencerHeader) + 16 * sizeof(SequencerStep)];
+    SequencerHeader header = {length, offset};
+
+    memcpy(payload, &header, sizeof(header));
+    memcpy(payload + sizeof(header), s, count * sizeof(SequencerStep));
+    return Sequencer_Load(payload, sizeof(header) + count * sizeof(SequencerStep));
+}
+
+static SequencerStatus status(void) {
+    SequencerStatus s;
+
+    Sequencer_GetStatus(&s);
+    return s;
+}
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Stub_HIL_Reset();
+    TIM5->ARR = 0xFFFFFFFF;
+    Sequencer_Init();
+    irq_latency_us = 0;
+    write_cost_us = 0;
+    interrupts = 0;
+    loop_events = 0;
+    write_count = 0;
+    memset(plant_enabled, 0, sizeof(plant_enabled));
+    memset(waveform_driving, 0, sizeof(waveform_driving));
+    memset(ramping, 0, sizeof(ramping));
+    staged_mask = 0;
+    discards = 0;
+    wrong_set = 0;
+}
+
+static void test_steps_apply_on_time(void) {
+    static const SequencerStep s[] = {
+        {50, '1', SIGNAL_CURRENT, 100},
+        {120, '2', SIGNAL_TEMPERATURE, 200},
+        {1000, '3', SIGNAL_CURRENT, 10},
+    };
+
+    setup();
+    CHECK_EQ(load(s, 3, 3, 0), 1);
+    CHECK_EQ(start(), 1);
+    CHECK_EQ(status().state, SEQUENCER_STATE_RUNNING);
+    run_until(2000);
+
+    CHECK_EQ(write_count, 3);
+    CHECK_EQ(interrupts, 3);
+    CHECK_EQ(writes[0].time_us, 50);
+    CHECK_EQ(writes[1].time_us, 120);
+    CHECK_EQ(writes[1].light, 1);
+    CHECK_EQ(writes[1].output, ANALOG_OUTPUT_TEMPERATURE);
+    CHECK_EQ(writes[1].value, 200);
+    CHECK_EQ(writes[2].time_us, 1000);
+
+    // Done: the timebase stops and the elapsed time freezes at the last step
+    SequencerStatus st = status();
+    CHECK_EQ(st.state, SEQUENCER_STATE_DONE);
+    CHECK_EQ(st.position, 3);
+    CHECK_EQ(st.applied, 3);
+    CHECK_EQ(st.rejected, 0);
+    CHECK_EQ(st.late, 0);
+    CHECK_EQ(st.first_late, 0xFFFF);
+    CHECK_EQ(st.elapsed_us, 1000);
+    CHECK_EQ(TIM5->CR1 & TIM_CR1_CEN, 0);
+    CHECK_EQ(TIM5->DIER & TIM_IT_CC1, 0);
+
+    // One completion event, sent from the main loop
+    CHECK_EQ(loop_events, 1);
+    Sequencer_ProcessEvents();
+    Sequencer_ProcessEvents();
+    CHECK_EQ(stub_event_count, 1);
+    CHECK_EQ(stub_last_event, SIGNAL_SEQUENCER);
+}
+
+static void test_equal_timestamps(void) {
+    static const SequencerStep s[] = {
+        {300, '1', SIGNAL_CURRENT, 1},
+        {300, '1', SIGNAL_TEMPERATURE, 2},
+        {300, '2', SIGNAL_CURRENT, 3},
+        {301, '3', SIGNAL_CURRENT, 4},
+        {301, '3', SIGNAL_TEMPERATURE, 5},
+    };
+
+    setup();
+    CHECK_EQ(load(s, 5, 5, 0), 1);
+    CHECK_EQ(start(), 1);
+
+    // Steps sharing a timestamp apply back to back, in upload order, in one interrupt
+    run_until(300);
+    CHECK_EQ(interrupts, 1);
+    CHECK_EQ(write_count, 3);
+    for (uint32_t i = 0; i < 3; i++) {
+        CHECK_EQ(writes[i].time_us, 300);
+        CHECK_EQ(writes[i].value, i + 1);
+    }
+    CHECK_EQ(status().position, 3);
+
+    run_until(400);
+    CHECK_EQ(interrupts, 2);
+    CHECK_EQ(write_count, 5);
+    CHECK_EQ(writes[4].time_us, 301);
+    CHECK_EQ(status().late, 0);
+}
+
+static void test_late_counting(void) {
+    static const SequencerStep s[] = {
+        {100, '1', SIGNAL_CURRENT, 1},
+        {200, '1', SIGNAL_CURRENT, 2},
+    };
+    static const SequencerStep burst[] = {
+        {100, '1', SIGNAL_CURRENT, 1},
+        {100, '2', SIGNAL_CURRENT, 2},
+        {100, '3', SIGNAL_CURRENT, 3},
+        {150, '1', SIGNAL_TEMPERATURE, 4},
+    };
+    SequencerStatus st;
+
+    // Lateness up to SEQUENCER_LATE_US is on time
+    setup();
+    irq_latency_us = SEQUENCER_LATE_US;
+    CHECK_EQ(load(s, 2, 2, 0), 1);
+    CHECK_EQ(start(), 1);
+    run_until(1000);
+    st = status();
+    CHECK_EQ(writes[0].time_us, 100 + SEQUENCER_LATE_US);
+    CHECK_EQ(st.late, 0);
+    CHECK_EQ(st.first_late, 0xFFFF);
+    CHECK_EQ(st.max_late_us, SEQUENCER_LATE_US);
+
+    // One microsecond more and every step is late
+    setup();
+    irq_latency_us = SEQUENCER_LATE_US + 1;
+    CHECK_EQ(load(s, 2, 2, 0), 1);
+    CHECK_EQ(start(), 1);
+    run_until(1000);
+    st = status();
+    CHECK_EQ(st.late, 2);
+    CHECK_EQ(st.first_late, 0);
+    CHECK_EQ(st.max_late_us, SEQUENCER_LATE_US + 1);
+    CHECK_EQ(st.applied, 2);
+
+    // Lateness builds up along a burst: each step waits for the writes before it
+    setup();
+    write_cost_us = 6;
+    CHECK_EQ(load(burst, 4, 4, 0), 1);
+    CHECK_EQ(start(), 1);
+    run_until(1000);
+    st = status();
+    CHECK_EQ(writes[1].time_us, 106);
+    CHECK_EQ(writes[2].time_us, 112);
+    CHECK_EQ(st.late, 1);
+    CHECK_EQ(st.first_late, 2);
+    CHECK_EQ(st.max_late_us, 12);
+    CHECK_EQ(writes[3].time_us, 150);
+
+    // The completion event reports the late count
+    Sequencer_ProcessEvents();
+    CHECK_EQ(stub_event_count, 1);
+}
+
+static void test_forced_compare(void) {
+    static const SequencerStep s[] = {
+        {0, '1', SIGNAL_CURRENT, 1},
+        {0, '2', SIGNAL_CURRENT, 2},
+        {5, '3', SIGNAL_CURRENT, 3},
+    };
+    static const SequencerStep passed[] = {
+        {100, '1', SIGNAL_CURRENT, 1},
+        {103, '2', SIGNAL_CURRENT, 2},
+        {200, '3', SIGNAL_CURRENT, 3},
+    };
+
+    // The counter starts on a compare value of 0 and never counts onto it:
+    // steps at time 0 only run through the CC1G the start generates
+    setup();
+    CHECK_EQ(load(s, 3, 3, 0), 1);
+    CHECK_EQ(start(), 1);
+    CHECK_EQ(TIM5->CNT, 0);
+    CHECK_EQ(interrupts, 1);
+    CHECK_EQ(write_count, 2);
+    CHECK_EQ(TIM5->CCR1, 5);
+    run_until(100);
+    CHECK_EQ(write_count, 3);
+    CHECK_EQ(writes[2].time_us, 5);
+    CHECK_EQ(status().state, SEQUENCER_STATE_DONE);
+
+    // A step the counter passed while the one before it was written applies
+    // in the same interrupt, as its compare value can no longer match
+    setup();
+    write_cost_us = 5;
+    CHECK_EQ(load(passed, 3, 3, 0), 1);
+    CHECK_EQ(start(), 1);
+    run_until(1000);
+    CHECK_EQ(interrupts, 2);
+    CHECK_EQ(writes[1].time_us, 105);
+    CHECK_EQ(writes[2].time_us, 200);
+    CHECK_EQ(status().max_late_us, 2);
+    CHECK_EQ(status().state, SEQUENCER_STATE_DONE);
+}
+
+static void test_ownership_rejects(void) {
+    static const SequencerStep s[] = {
+        {10, '2', SIGNAL_CURRENT, 1},           // Light 2: plant model
+        {10, '2', SIGNAL_TEMPERATURE, 2},
+        {10, '2', SIGNAL_SYNC, 3},
+        {20, '3', SIGNAL_CURRENT, 4},           // Light 3 current: waveform
+        {20, '3', SIGNAL_TEMPERATURE, 5},
+        {30, '1', SIGNAL_TEMPERATURE, 6},       // Light 1 temperature: ramp
+        {30, '1', SIGNAL_SYNC, 7},              // Light 1 current: staged
+        {40, 'S', SIGNAL_SYNC, 1},              // Commit after light 1 current was taken over
+        {50, 'S', SIGNAL_SYNC, 0},              // Discard instead
+        {60, '1', SIGNAL_SYNC, 0x8000 | 8},     // Light 1 temperature, still ramping
+    };
+
+    setup();
+    plant_enabled[1] = 1;
+    waveform_driving[2][ANALOG_OUTPUT_CURRENT] = 1;
+    ramping[0][ANALOG_OUTPUT_TEMPERATURE] = 1;
+    CHECK_EQ(load(s, 10, 10, 0), 1);
+    CHECK_EQ(start(), 1);
+    CHECK_EQ(discards, 1);
+
+    run_until(35);
+    CHECK_EQ(write_count, 1);
+    CHECK_EQ(writes[0].light, 2);
+    CHECK_EQ(writes[0].output, ANALOG_OUTPUT_TEMPERATURE);
+    CHECK_EQ(staged_mask, 1 << 0);
+
+    // The staged output is owned by the time of the commit: nothing applies
+    waveform_driving[0][ANALOG_OUTPUT_CURRENT] = 1;
+    run_until(45);
+    CHECK_EQ(write_count, 1);
+    CHECK_EQ(staged_mask, 1 << 0);
+
+    run_until(100);
+    CHECK_EQ(staged_mask, 0);
+
+    SequencerStatus st = status();
+    CHECK_EQ(st.state, SEQUENCER_STATE_DONE);
+    CHECK_EQ(st.applied, 3);
+    CHECK_EQ(st.rejected, 7);
+    CHECK_EQ(wrong_set, 0);
+}
+
+static void test_load_and_start_rejects(void) {
+    static const SequencerStep good[] = {
+        {10, '1', SIGNAL_CURRENT, ANALOG_CURRENT_FULL_SCALE},
+        {20, '1', SIGNAL_TEMPERATURE, ANALOG_TEMPERATURE_FULL_SCALE},
+        {30, '2', SIGNAL_SYNC, 0x8000 | ANALOG_TEMPERATURE_FULL_SCALE},
+        {40, 'S', SIGNAL_SYNC, 1},
+    };
+    static const SequencerStep bad[] = {
+        {0, '4', SIGNAL_CURRENT, 0},
+        {0, '0', SIGNAL_CURRENT, 0},
+        {0, '1', 'X', 0},
+        {0, '1', SIGNAL_CURRENT, ANALOG_CURRENT_FULL_SCALE + 1},
+        {0, '1', SIGNAL_TEMPERATURE, ANALOG_TEMPERATURE_FULL_SCALE + 1},
+        {0, '1', SIGNAL_SYNC, ANALOG_CURRENT_FULL_SCALE + 1},
+        {0, 'S', SIGNAL_SYNC, 2},
+        {0, 'S', SIGNAL_CURRENT, 1},
+    };
+    SequencerStep out_of_order[2] = {
+        {20, '1', SIGNAL_CURRENT, 1},
+        {10, '1', SIGNAL_CURRENT, 2},
+    };
+    uint8_t payload[sizeof(SequencerHeader) + sizeof(SequencerStep)];
+    SequencerHeader header = {1, 0};
+
+    setup();
+    CHECK_EQ(start(), 0);
+
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK_EQ(load(&bad[i], 1, 1, 0), 0);
+    }
+
+    // Framing: whole steps, within the declared length
+    memcpy(payload, &header, sizeof(header));
+    memcpy(payload + sizeof(header), good, sizeof(SequencerStep));
+    CHECK_EQ(Sequencer_Load(payload, sizeof(payload) - 1), 0);
+    CHECK_EQ(Sequencer_Load(NULL, sizeof(payload)), 0);
+    CHECK_EQ(load(good, 4, 3, 0), 0);
+    CHECK_EQ(load(good, 2, 4, 3), 0);
+    CHECK_EQ(load(good, 1, 0, 0), 0);
+    CHECK_EQ(load(good, 1, SEQUENCER_MAX_STEPS + 1, 0), 0);
+
+    // A scenario in two uploads
+    CHECK_EQ(load(&good[2], 2, 4, 2), 1);
+    CHECK_EQ(load(good, 2, 4, 0), 1);
+    CHECK_EQ(start(), 1);
+
+    // Running: no reload, no restart
+    CHECK_EQ(load(good, 4, 4, 0), 0);
+    CHECK_EQ(start(), 0);
+    run_until(25);
+
+    // Stop freezes the elapsed time and keeps the outputs
+    Sequencer_Stop();
+    SequencerStatus st = status();
+    CHECK_EQ(st.state, SEQUENCER_STATE_IDLE);
+    CHECK_EQ(st.elapsed_us, 25);
+    CHECK_EQ(st.position, 2);
+    CHECK_EQ(write_count, 2);
+    CHECK_EQ(TIM5->CR1 & TIM_CR1_CEN, 0);
+    CHECK_EQ(loop_events, 0);
+
+    // Timestamps must not decrease
+    CHECK_EQ(load(out_of_order, 2, 2, 0), 1);
+    CHECK_EQ(start(), 0);
+    out_of_order[1].time_us = 20;
+    CHECK_EQ(load(out_of_order, 2, 2, 0), 1);
+    CHECK_EQ(start(), 1);
+
+    Sequencer_GetStatus(NULL);
+}
+
+int main(void) {
+    RUN_TEST(test_steps_apply_on_time);
+    RUN_TEST(test_equal_timestamps);
+    RUN_TEST(test_late_counting);
+    RUN_TEST(test_forced_compare);
+    RUN_TEST(test_ownership_rejects);
+    RUN_TEST(test_load_and_start_rejects);
+    return TEST_RESULT();
+}
@@ -0,0 +1,309 @@
+/**
+ * @file test_waveform.c
+ * @brief Waveform table upload and playback against emulated pacing timers and DMA
+ *
+ * Tables come from the host-side generator and are uploaded in protocol
+ * sized chunks. Every emulated update of TIM6/TIM7 serves one DMA request,
+ * which moves the next sample into the compare register of the output.
+ */
+
+#include "test_common.h"
+#include "waveform.h"
+#include "waveform_gen.h"
+#include "analog_simulation.h"
+#include "analog_fault.h"
+#include "plant_model.h"
+#include "tim.h"
+
+// Analog output collaborators, replaced by settable state
+static uint16_t output_max[3][2];
+static uint16_t held_code[3][2];
+static uint8_t output_busy;       // Ramp, dither, noise, fault or plant model on every output
+
+uint16_t Analog_GetOutputMax(uint8_t light_index, uint8_t output) { return output_max[light_index][output]; }
+uint8_t Analog_IsRamping(uint8_t light_index, uint8_t output) { return output_busy; }
+uint8_t Analog_IsDithered(uint8_t light_index, uint8_t output) { return 0; }
+uint8_t Analog_HasNoise(uint8_t light_index, uint8_t output) { return 0; }
+uint8_t Analog_Fault_IsTargeted(uint8_t light_index, uint8_t output) { return 0; }
+uint8_t Plant_Model_IsEnabled(uint8_t light_index) { return 0; }
+
+volatile uint32_t* Analog_GetCompareRegister(uint8_t light_index, uint8_t output) {
+    TIM_TypeDef* tim = (output == ANALOG_OUTPUT_CURRENT) ? TIM2 : TIM3;
+    return &tim->CCR1 + light_index;
+}
+
+uint8_t Analog_SetOutputCode(uint8_t light_index, uint8_t output, uint16_t code) {
+    held_code[light_index][output] = code;
+    return 1;
+}
+
+static uint16_t table[4 * WAVEFORM_MAX_SAMPLES];
+static uint8_t payload[HIL_UPLOAD_MAX_SIZE];
+
+static void setup(void) {
+    Stub_HAL_Reset();
+    Waveform_Init();
+    for (int i = 0; i < 3; i++) {
+        output_max[i][ANALOG_OUTPUT_CURRENT] = ANALOG_PWM_MAX;
+        output_max[i][ANALOG_OUTPUT_TEMPERATURE] = ANALOG_PWM_MAX;
+    }
+    memset(held_code, 0, sizeof(held_code));
+    output_busy = 0;
+}
+
+static WaveformHeader header_of(uint8_t player, uint8_t light, uint8_t output, uint8_t mode,
+                                uint16_t period_us, uint16_t length) {
+    WaveformHeader header = {player, light, output, mode, period_us, length, 0};
+    return header;
+}
+
+/**
+ * @brief Upload table[first, first + count) in protocol sized chunks
+ * @return 1 if every chunk was accepted
+ */
+static uint8_t upload(const WaveformHeader* header, const uint16_t* source, uint16_t first, uint16_t count) {
+    uint8_t ok = 1;
+
+    for (uint16_t done = 0; done < count;) {
+        uint16_t chunk = count - done;
+        if (chunk > WAVEFORM_GEN_CHUNK) {
+            chunk = WAVEFORM_GEN_CHUNK;
+        }
+        uint16_t length = Waveform_Gen_Payload(payload, header, source, first + done, chunk);
+        CHECK(length <= HIL_UPLOAD_MAX_SIZE);
+        ok &= Waveform_Load(payload, length);
+        done += chunk;
+    }
+    return ok;
+}
+
+/**
+ * @brief One update event of a pacing timer
+ * @return Compare register of the output after the event
+ */
+static uint32_t timer_update(TIM_HandleTypeDef* htim, volatile uint32_t* ccr) {
+    if ((htim->Instance->CR1 & TIM_CR1_CEN) && (htim->Instance->DIER & TIM_DMA_UPDATE)) {
+        Stub_DMA_Request(htim->hdma[TIM_DMA_ID_UPDATE]);
+    }
+    return *ccr;
+}
+
+static void test_generator(void) {
+    Waveform_Gen_Ramp(table, 101, 0, 1000);
+    CHECK_EQ(table[0], 0);
+    CHECK_EQ(table[50], 500);
+    CHECK_EQ(table[100], 1000);
+
+    // Sine of 256 samples around 512: quarter period at the peak, clamped at the range
+    Waveform_Gen_Sine(table, 256, 512, 400, ANALOG_PWM_MAX);
+    CHECK_EQ(table[0], 512);
+    CHECK_EQ(table[64], 912);
+    CHECK_EQ(table[192], 112);
+    uint32_t sum = 0;
+    for (int i = 0; i < 256; i++) {
+        sum += table[i];
+    }
+    CHECK_NEAR(sum / 256.0, 512, 0.5);
+    Waveform_Gen_Sine(table, 256, 512, 600, ANALOG_PWM_MAX);
+    CHECK_EQ(table[64], ANALOG_PWM_MAX);
+    CHECK_EQ(table[192], 0);
+
+    // Surge peaks at the end of the rise and falls to 1/e of its height after one time constant
+    Waveform_Gen_Surge(table, 200, 100, 900, 10, 40.0f);
+    CHECK_EQ(table[9], 900);
+    CHECK(table[8] < 900 && table[10] < 900);
+    CHECK_NEAR(table[49], 100 + 800 * 0.3679, 1.0);
+    CHECK(table[199] < 110);
+
+    // A table splits into chunks that fit one upload
+    WaveformHeader header = header_of(0, 0, 0, WAVEFORM_MODE_LOOP, 10, 300);
+    CHECK_EQ(Waveform_Gen_Payload(payload, &header, table, 0, WAVEFORM_GEN_CHUNK), HIL_UPLOAD_MAX_SIZE);
+}
+
+static void test_loop_playback(void) {
+    WaveformHeader header = header_of(0, 1, ANALOG_OUTPUT_CURRENT, WAVEFORM_MODE_LOOP, 50, 600);
+    WaveformStatus status[WAVEFORM_PLAYERS];
+    volatile uint32_t* ccr = &TIM2->CCR2;
+
+    setup();
+    Waveform_Gen_Sine(table, 600, 512, 500, ANALOG_PWM_MAX);
+    CHECK_EQ(upload(&header, table, 0, 600), 1);
+    CHECK_EQ(Waveform_Start(0), 1);
+    CHECK_EQ(Waveform_IsDriving(1, ANALOG_OUTPUT_CURRENT), 1);
+    CHECK_EQ(Waveform_IsDriving(1, ANALOG_OUTPUT_TEMPERATURE), 0);
+
+    // 50 us per sample on the 1 MHz tick, no request before the first update
+    CHECK_EQ(TIM6->ARR, 49);
+    CHECK_EQ(*ccr, 0);
+
+    uint32_t mismatches = 0;
+    for (uint32_t n = 0; n < 3 * 600 + 123; n++) {
+        if (timer_update(&htim6, ccr) != table[n % 600]) {
+            mismatches++;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    Waveform_GetStatus(status);
+    CHECK_EQ(status[0].state, WAVEFORM_STATE_PLAYING);
+    CHECK_EQ(status[0].passes, 3);
+    CHECK_EQ(status[0].position, 123);
+    CHECK_EQ(status[1].state, WAVEFORM_STATE_IDLE);
+
+    // Stopping holds the sample on the output and stops the requests
+    CHECK_EQ(Waveform_Stop(0), 1);
+    CHECK_EQ(held_code[1][ANALOG_OUTPUT_CURRENT], table[122]);
+    CHECK_EQ(timer_update(&htim6, ccr), table[122]);
+    CHECK_EQ(Waveform_IsDriving(1, ANALOG_OUTPUT_CURRENT), 0);
+}
+
+static void test_one_shot_holds_last_sample(void) {
+    WaveformHeader header = header_of(1, 2, ANALOG_OUTPUT_TEMPERATURE, WAVEFORM_MODE_ONE_SHOT, 2, 64);
+    WaveformStatus status[WAVEFORM_PLAYERS];
+    volatile uint32_t* ccr = &TIM3->CCR3;
+
+    setup();
+    Waveform_Gen_Ramp(table, 64, 1000, 200);
+    CHECK_EQ(upload(&header, table, 0, 64), 1);
+    CHECK_EQ(Waveform_Start(1), 1);
+
+    for (int n = 0; n < 64; n++) {
+        CHECK_EQ(timer_update(&htim7, ccr), table[n]);
+    }
+
+    // Done after one pass: the timer stops, the last sample stays
+    Waveform_GetStatus(status);
+    CHECK_EQ(status[1].state, WAVEFORM_STATE_DONE);
+    CHECK_EQ(status[1].passes, 1);
+    CHECK_EQ(TIM7->CR1 & TIM_CR1_CEN, 0);
+    CHECK_EQ(timer_update(&htim7, ccr), 200);
+    CHECK_EQ(held_code[2][ANALOG_OUTPUT_TEMPERATURE], 200);
+
+    // A finished table can be started again
+    CHECK_EQ(Waveform_Start(1), 1);
+    CHECK_EQ(timer_update(&htim7, ccr), 1000);
+}
+
+static void test_ping_pong_streaming(void) {
+    const uint16_t length = 512;
+    const uint16_t half = length / 2;
+    const uint16_t profile_length = 4 * WAVEFORM_MAX_SAMPLES;
+    WaveformHeader header = header_of(0, 0, ANALOG_OUTPUT_CURRENT, WAVEFORM_MODE_PING_PONG, 20, length);
+    WaveformStatus status[WAVEFORM_PLAYERS];
+    volatile uint32_t* ccr = &TIM2->CCR1;
+
+    setup();
+
+    // A profile eight times the table streams through the two halves
+    Waveform_Gen_Surge(table, profile_length, 50, 1000, 100, 800.0f);
+    CHECK_EQ(upload(&header, table, 0, length), 1);
+    CHECK_EQ(Waveform_Start(0), 1);
+
+    uint16_t next = length;   // Next profile sample to upload
+    uint32_t mismatches = 0;
+    uint32_t passes = 0;
+    for (uint32_t n = 0; n < profile_length; n++) {
+        if (timer_update(&htim6, ccr) != table[n]) {
+            mismatches++;
+        }
+
+        Waveform_GetStatus(status);
+        if (status[0].passes != passes && next < profile_length) {
+            passes = status[0].passes;
+
+            // The half just played is idle now; the half being played cannot be written
+            uint16_t idle = (status[0].active_half == 0) ? half : 0;
+            uint16_t active = half - idle;
+            CHECK_EQ(upload(&header, table, active, 1), 0);
+
+            // Upload the next profile half into the idle half of the table
+            uint16_t staged[WAVEFORM_MAX_SAMPLES];
+            memcpy(&staged[idle], &table[next], half * sizeof(uint16_t));
+            CHECK_EQ(upload(&header, staged, idle, half), 1);
+            next += half;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(next, profile_length);
+
+    // A different configuration cannot stream into the running table
+    header.sample_period_us = 40;
+    CHECK_EQ(upload(&header, table, 0, 2), 0);
+}
+
+static void test_load_validation(void) {
+    WaveformHeader header = header_of(0, 0, ANALOG_OUTPUT_CURRENT, WAVEFORM_MODE_LOOP, 10, 16);
+
+    setup();
+    Waveform_Gen_Ramp(table, 16, 0, 1023);
+    CHECK_EQ(upload(&header, table, 0, 16), 1);
+
+    // A chunk past the table end, an odd byte count and an out-of-range code
+    CHECK_EQ(upload(&header, table, 10, 7), 0);
+    uint16_t length = Waveform_Gen_Payload(payload, &header, table, 0, 4);
+    CHECK_EQ(Waveform_Load(payload, length - 1), 0);
+    CHECK_EQ(Waveform_Load(NULL, length), 0);
+    table[3] = ANALOG_PWM_MAX + 1;
+    CHECK_EQ(upload(&header, table, 0, 4), 0);
+    table[3] = 3;
+
+    WaveformHeader bad = header;
+    bad.sample_period_us = WAVEFORM_MIN_PERIOD_US - 1;
+    CHECK_EQ(upload(&bad, table, 0, 4), 0);
+    bad = header;
+    bad.mode = WAVEFORM_MODE_PING_PONG;
+    bad.length = 15;
+    CHECK_EQ(upload(&bad, table, 0, 4), 0);
+    bad = header;
+    bad.length = WAVEFORM_MAX_SAMPLES + 1;
+    CHECK_EQ(upload(&bad, table, 0, 4), 0);
+    bad = header;
+    bad.player = WAVEFORM_PLAYERS;
+    CHECK_EQ(upload(&bad, table, 0, 4), 0);
+
+    // DAC routing widens the code range of the output
+    output_max[0][ANALOG_OUTPUT_CURRENT] = 4095;
+    table[3] = 4095;
+    CHECK_EQ(upload(&header, table, 0, 4), 1);
+}
+
+static void test_start_refusals(void) {
+    WaveformHeader header = header_of(0, 0, ANALOG_OUTPUT_CURRENT, WAVEFORM_MODE_LOOP, 10, 16);
+
+    setup();
+    CHECK_EQ(Waveform_Start(0), 0);
+    CHECK_EQ(Waveform_Start(WAVEFORM_PLAYERS), 0);
+    Waveform_Gen_Ramp(table, 16, 0, 1023);
+    CHECK_EQ(upload(&header, table, 0, 16), 1);
+
+    // Another owner of the output
+    output_busy = 1;
+    CHECK_EQ(Waveform_Start(0), 0);
+    output_busy = 0;
+
+    // Table loaded for another backend
+    output_max[0][ANALOG_OUTPUT_CURRENT] = 4095;
+    CHECK_EQ(Waveform_Start(0), 0);
+    output_max[0][ANALOG_OUTPUT_CURRENT] = ANALOG_PWM_MAX;
+
+    // Two players on one output
+    header.player = 1;
+    CHECK_EQ(upload(&header, table, 0, 16), 1);
+    CHECK_EQ(Waveform_Start(0), 1);
+    CHECK_EQ(Waveform_Start(0), 0);
+    CHECK_EQ(Waveform_Start(1), 0);
+
+    // A playing loop or one-shot table cannot be reloaded
+    header.player = 0;
+    CHECK_EQ(upload(&header, table, 0, 16), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_generator);
+    RUN_TEST(test_loop_playback);
+    RUN_TEST(test_one_shot_holds_last_sample);
+    RUN_TEST(test_ping_pong_streaming);
+    RUN_TEST(test_load_validation);
+    RUN_TEST(test_start_refusals);
+    return TEST_RESULT();
+}